@@ -0,0 +1,4 @@
+@stage(fragment)
+fn main(@location(0) vCol : vec3<f32>) -> @location(0) vec4<f32> {
+	return vec4<f32>(vCol, 1.0);
+}
@@ -0,0 +1,108 @@
+/**
+ * \file alloctrack.h
+ * Heap allocation tracker. When built with \c #ALLOC_TRACK, every allocation
+ * is counted and attributed to the frame and the CPU zones open at the time
+ * (see \c profile#zones()). Once the app has warmed up, any frame allocating
+ * is reported as a regression (with the zones responsible), since heap
+ * allocations in the frame loop are a common source of latency spikes.
+ * \n
+ * The \c malloc family is hooked, so every module's allocations are seen
+ * (Dawn's included, with \c new going through \c malloc): with glibc by
+ * replacing \c malloc, \c free and friends, on macOS by patching the default
+ * malloc zone, and with the MSVC debug runtime through a CRT allocation hook.
+ * Elsewhere (e.g. the MSVC release runtime or Emscripten) only global
+ * \c operator \c new and \c delete can be replaced.
+ * \n
+ * The \c ALLOC_TRACK CMake option builds with the tracker fatal and, on
+ * Linux, adds a test running the headless app past the warm-up (see
+ * \c #ALLOC_TRACK_FATAL).
+ */
+#pragma once
+
+#include <stdio.h>
+
+#include "defines.h"
+
+/**
+ * \def ALLOC_TRACK
+ * Set to track heap allocations (off by default, since it replaces the global
+ * allocation functions and locks on every allocation).
+ */
+#ifndef ALLOC_TRACK
+#define ALLOC_TRACK 0
+#endif
+
+/**
+ * \def ALLOC_TRACK_WARMUP
+ * Number of frames before the app is considered to be in a steady state (after
+ * which allocating frames are reported).
+ */
+#ifndef ALLOC_TRACK_WARMUP
+#define ALLOC_TRACK_WARMUP 120
+#endif
+
+/**
+ * \def ALLOC_TRACK_FATAL
+ * Set to abort on the first steady state frame that allocates (for automated
+ * runs, to fail the run rather than log).
+ */
+#ifndef ALLOC_TRACK_FATAL
+#define ALLOC_TRACK_FATAL 0
+#endif
+
+/**
+ * \def ALLOC_TRACK_STACKS
+ * Maximum number of distinct zone stacks allocations are attributed to
+ * (further stacks are counted together).
+ */
+#ifndef ALLOC_TRACK_STACKS
+#define ALLOC_TRACK_STACKS 256
+#endif
+
+/**
+ * \def ALLOC_TRACK_DEPTH
+ * Deepest zone stack recorded (deeper zones are attributed to their parent).
+ */
+#ifndef ALLOC_TRACK_DEPTH
+#define ALLOC_TRACK_DEPTH 8
+#endif
+
+namespace alloctrack {
+/**
+ * Tracker counters (since startup).
+ */
+struct Stats {
+	unsigned long long allocs; ///< Allocations made
+	unsigned long long frees;  ///< Allocations freed
+	unsigned long long bytes;  ///< Bytes allocated
+	unsigned long long frames; ///< Calls to \c #frame()
+	unsigned long long steady; ///< Allocations made in steady state frames
+};
+
+/**
+ * \return \c true if allocations are being tracked (built with \c #ALLOC_TRACK)
+ */
+bool enabled();
+
+/**
+ * Marks the end of a frame. If past the warm-up, any allocations made during
+ * the frame are reported to \c stderr (and with \c #ALLOC_TRACK_FATAL, abort).
+ *
+ * \return number of allocations made during the frame
+ */
+unsigned frame();
+
+/**
+ * \return tracker counters
+ */
+Stats stats();
+
+/**
+ * Writes the allocations per zone stack in folded format (one line per stack,
+ * \c zone;zone;zone \c count, as read by \c flamegraph.pl and speedscope).
+ *
+ * \param[in] out destination stream
+ * \param[in] steady \c true for only the steady state allocations (otherwise all)
+ */
+void flame(FILE* _NONNULL out = stdout, bool steady = false);
+}
@@ -0,0 +1,90 @@
+/**
+ * \file apistats.h
+ * WebGPU API call counters, gathered by interposing on Dawn's proc table.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "defines.h"
+
+/**
+ * \def WEBGPU_API_STATS
+ * Set to install the counting proc table when creating the device (see
+ * \c webgpu#create()). Off by default; when off the counters stay at zero and
+ * cost nothing.
+ */
+#ifndef WEBGPU_API_STATS
+#define WEBGPU_API_STATS 0
+#endif
+
+/*
+ * Dawn's proc table (only needed, and only available, for native builds).
+ */
+struct DawnProcTable;
+
+namespace apistats {
+/**
+ * Counters for one frame, summed over all threads.
+ */
+struct Stats {
+	unsigned long long calls;      ///< WebGPU calls of any kind
+	unsigned long long bytes;      ///< Bytes uploaded with \c wgpuQueueWriteBuffer() or \c wgpuQueueWriteTexture()
+	unsigned long long pipelines;  ///< Render and compute pipeline switches
+	unsigned long long bindGroups; ///< Bind group switches
+	unsigned long long draws;      ///< Draw calls (direct and indirect)
+	unsigned long long triangles;  ///< Triangles submitted by direct draws (assuming triangle lists)
+};
+
+/**
+ * Calls made to a single WebGPU entry point.
+ */
+struct Entry {
+	const char* name;         ///< Proc table entry (e.g. \c queueWriteBuffer)
+	unsigned long long calls; ///< Calls made in the last frame
+};
+
+/**
+ * Replaces every entry in \a procs with one that counts the call before
+ * forwarding to the original. Call before passing \a procs to
+ * \c dawnProcSetProcs().
+ *
+ * \note Not available with Emscripten (where this does nothing).
+ *
+ * \param[in,out] procs proc table to wrap
+ */
+void install(DawnProcTable* _NONNULL procs);
+
+/**
+ * \return \c true if \c #install() has been called
+ */
+bool installed();
+
+/**
+ * Ends a frame, returning the counts since the previous call. Called once per
+ * frame from a single thread (counting itself needs no locking, each thread
+ * writing only to its own counters).
+ *
+ * \return counters for the frame
+ */
+Stats frame();
+
+/**
+ * Retrieves the per entry point calls for the frame ended by the last call to
+ * \c #frame(), omitting any not called.
+ *
+ * \param[out] entries destination for the calls
+ * \param[in] max maximum number of entries to write
+ * \return number of entries written
+ */
+size_t entries(Entry* _NONNULL entries, size_t max);
+
+/**
+ * Prints the frame's counters and its most called entry points.
+ *
+ * \param[in] stats counters returned from \c #frame()
+ * \param[in] out destination stream
+ */
+void print(const Stats& stats, FILE* _NONNULL out = stdout);
+}
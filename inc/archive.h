@@ -0,0 +1,227 @@
+/**
+ * \file archive.h
+ * Packed asset archive, memory mapped so the assets are used straight from
+ * the file's pages: nothing is parsed or copied at startup beyond reading the
+ * header and table of contents (the blobs being in their upload-ready form,
+ * handed to \c wgpuQueueWriteBuffer() or the transcoder as-is).
+ * \n
+ * The file is a \c Header, the TOC (\c Entry per blob, sorted by name hash),
+ * the name strings, then the blobs, each starting on a \c #ARCHIVE_ALIGN
+ * boundary. Lookups record the order blobs are first used in, which can be
+ * saved (see \c #record()) and fed back to the packer (see \c tools/pack) so
+ * the blobs are laid out in that order. Ordered archives then prefetch ahead
+ * of each access (\c madvise() or \c PrefetchVirtualMemory()), so cold
+ * starts become sequential reads.
+ * \n
+ * \code
+ * if (archive::Archive assets = archive::open("assets.pak")) {
+ *	archive::Blob blob;
+ *	archive::Mesh mesh;
+ *	if (archive::find(assets, "cube.obj", blob) && archive::mesh(blob, mesh)) {
+ *		wgpuQueueWriteBuffer(queue, vertBuf, 0, mesh.vertices, mesh.vertexCount * mesh.stride);
+ *		...
+ *	}
+ * }
+ * \endcode
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "defines.h"
+
+/**
+ * \def ARCHIVE_MAGIC
+ * Archive file identifier (\c WPAK when read as bytes).
+ */
+#ifndef ARCHIVE_MAGIC
+#define ARCHIVE_MAGIC 0x4B415057
+#endif
+
+/**
+ * \def ARCHIVE_VERSION
+ * Archive format version (files of other versions fail to open).
+ */
+#ifndef ARCHIVE_VERSION
+#define ARCHIVE_VERSION 1
+#endif
+
+/**
+ * \def ARCHIVE_ALIGN
+ * Alignment of each blob in the file (a page, so no two blobs share one).
+ */
+#ifndef ARCHIVE_ALIGN
+#define ARCHIVE_ALIGN 4096
+#endif
+
+/**
+ * \def ARCHIVE_READAHEAD
+ * Bytes prefetched ahead of each access in ordered archives.
+ */
+#ifndef ARCHIVE_READAHEAD
+#define ARCHIVE_READAHEAD (1024 * 1024)
+#endif
+
+namespace archive {
+/**
+ * Archive file header, followed by the TOC then the names (all
+ * little-endian).
+ */
+struct Header {
+	uint32_t magic;   ///< \c #ARCHIVE_MAGIC
+	uint16_t version; ///< \c #ARCHIVE_VERSION
+	uint16_t flags;   ///< \c #FLAG_ORDERED
+	uint32_t count;   ///< Number of TOC entries
+	uint32_t names;   ///< Size of the name strings in bytes
+};
+
+/**
+ * TOC entry.
+ */
+struct Entry {
+	uint64_t id;     ///< \c #hash() of the name
+	uint64_t hash;   ///< \c #hash() of the contents
+	uint64_t offset; ///< Start of the blob (from the start of the file)
+	uint64_t size;   ///< Blob size in bytes
+	uint32_t name;   ///< Offset of the null terminated name in the name strings
+	uint32_t type;   ///< \c #Type
+};
+
+/**
+ * Blob contents.
+ */
+enum Type {
+	TYPE_BLOB,    ///< Raw bytes
+	TYPE_MESH,    ///< \c MeshHeader then the vertex and index data
+	TYPE_SHADER,  ///< WGSL source (null terminated, the terminator not counted in the size)
+	TYPE_TEXTURE, ///< Universal texture file (see \c transcode.h)
+};
+
+/**
+ * Blobs are laid out in a recorded access order.
+ */
+const uint16_t FLAG_ORDERED = 1;
+
+/**
+ * Mesh blob header, followed by the vertices then the indices (padded to a
+ * multiple of four bytes, as buffer writes need).
+ */
+struct MeshHeader {
+	uint32_t vertexCount;
+	uint16_t stride;      ///< Vertex size in bytes
+	uint16_t indexSize;   ///< Index size in bytes (2 or 4)
+	uint32_t indexCount;
+	uint32_t indexOffset; ///< Start of the indices (from the start of the blob)
+};
+
+/**
+ * Opened archive.
+ */
+typedef struct ArchiveImpl* Archive;
+
+/**
+ * Blob found in an archive (valid until the archive is closed).
+ */
+struct Blob {
+	const void* _NULLABLE data;
+	size_t size;
+	uint64_t hash;            ///< \c Entry#hash
+	Type type;
+	const char* _NULLABLE name;
+};
+
+/**
+ * Mesh blob contents.
+ */
+struct Mesh {
+	const void* _NULLABLE vertices;
+	const void* _NULLABLE indices;
+	uint32_t vertexCount;
+	uint32_t stride;
+	uint32_t indexCount;
+	uint32_t indexSize;
+};
+
+/**
+ * 64-bit FNV-1a hash (of names and of blob contents).
+ *
+ * \param[in] data bytes to hash
+ * \param[in] size size of \a data in bytes
+ * \return hash of \a data
+ */
+uint64_t hash(const void* _NONNULL data, size_t size);
+
+/**
+ * Maps an archive file, validating the header and TOC.
+ *
+ * \param[in] path archive file path
+ * \return the archive (or \c null if it couldn't be mapped or isn't valid, or on Emscripten)
+ */
+Archive _NULLABLE open(const char* _NONNULL path);
+
+/**
+ * Opens an archive already in memory (for Emscripten, fetched by the page).
+ *
+ * \param[in] data archive contents (which must outlive the archive)
+ * \param[in] size size of \a data in bytes
+ * \return the archive (or \c null if not valid)
+ */
+Archive _NULLABLE open(const void* _NONNULL data, size_t size);
+
+/**
+ * Unmaps an archive.
+ */
+void close(Archive _NULLABLE archive);
+
+/**
+ * Finds a blob by name, noting the access (and prefetching ahead of it).
+ *
+ * \param[in] archive archive to search
+ * \param[in] name blob name (its path relative to the packed directory)
+ * \param[out] blob found blob
+ * \return \c true if \a name was found
+ */
+bool find(Archive _NONNULL archive, const char* _NONNULL name, Blob& blob);
+
+/**
+ * Checks a blob's contents against its TOC hash (touching every page).
+ *
+ * \return \c true if the contents match
+ */
+bool verify(const Blob& blob);
+
+/**
+ * Reads a mesh blob's header.
+ *
+ * \param[in] blob blob of type \c #TYPE_MESH
+ * \param[out] mesh the vertex and index data
+ * \return \c true if \a blob is a valid mesh
+ */
+bool mesh(const Blob& blob, Mesh& mesh);
+
+/**
+ * Builds the stored form of a source asset, by its extension (as the packer
+ * does): \c .obj meshes are converted to \c #TYPE_MESH (positions with the
+ * optional per-vertex colour extension, \c v \c x \c y \c z \c r \c g
+ * \c b, and polygon faces split into fans), \c .wgsl is null terminated as
+ * \c #TYPE_SHADER, \c .utx is \c #TYPE_TEXTURE, and anything else is raw.
+ *
+ * \param[in] name source file name
+ * \param[in] src source file contents
+ * \param[in] size size of \a src in bytes
+ * \param[out] blob built blob (its data allocated with \c malloc(), for the caller to \c free())
+ * \return \c false if the source couldn't be converted
+ */
+bool build(const char* _NONNULL name, const void* _NONNULL src, size_t size, Blob& blob);
+
+/**
+ * Saves the order blobs were first found in (one name per line, as read by
+ * the packer's \c -order option).
+ *
+ * \param[in] archive archive to save the order of
+ * \param[in] path file to write
+ * \return \c true if the file was written
+ */
+bool record(Archive _NONNULL archive, const char* _NONNULL path);
+}
@@ -0,0 +1,235 @@
+/**
+ * \file arena.h
+ * Per-frame linear allocators. Each frame slot has an arena which is bumped
+ * for every allocation and reset in one step when the slot comes round again,
+ * so per-frame CPU data never goes near the general heap. Nothing waits on the
+ * GPU to reuse a slot: WebGPU copies whatever it's passed, so CPU data only
+ * needs to outlive the calls using it. Worker threads take their own
+ * sub-arenas from the frame's arena to allocate without contention.
+ * \n
+ * The frame arenas belong to the render thread: \c arena#begin() switches
+ * slots on it, so only the render thread (and the jobs it runs while
+ * recording) may allocate from them, never the simulation thread running
+ * alongside (which would be handed a slot being reset under it). The
+ * simulation has its own slots, switched by \c arena#step() at the start of
+ * each update, for data handed to the render thread with the snapshot (the
+ * scheduler's lockstep keeping a slot alive until the render thread is done
+ * with its snapshot, see \c frame.h).
+ * \n
+ * An arena running out of space falls back to the heap for the rest of the
+ * frame, then grows to its high-water mark on the next reset, so a steady
+ * state frame makes no heap allocations.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <new>
+
+#include "defines.h"
+
+/**
+ * \def ARENA_FRAMES
+ * Number of frame slots (frames an allocation lasts before its arena is reused).
+ */
+#ifndef ARENA_FRAMES
+#define ARENA_FRAMES 3
+#endif
+
+/**
+ * \def ARENA_FRAME_SIZE
+ * Initial size of each frame's arena.
+ */
+#ifndef ARENA_FRAME_SIZE
+#define ARENA_FRAME_SIZE (1024 * 1024)
+#endif
+
+/**
+ * \def ARENA_LOCAL_SIZE
+ * Size of each block a thread's sub-arena takes from the frame's arena.
+ */
+#ifndef ARENA_LOCAL_SIZE
+#define ARENA_LOCAL_SIZE (64 * 1024)
+#endif
+
+/**
+ * \def ARENA_ALIGN
+ * Default allocation alignment.
+ */
+#ifndef ARENA_ALIGN
+#define ARENA_ALIGN 16
+#endif
+
+namespace arena {
+/**
+ * Arena counters.
+ */
+struct Stats {
+	size_t used;      ///< Bytes allocated since the last reset
+	size_t highWater; ///< Most bytes allocated between resets
+	size_t capacity;  ///< Bytes available before falling back to the heap
+	unsigned overflows; ///< Heap allocations made (since creation)
+};
+
+/**
+ * Linear allocator. Allocating is lock-free (and safe from any thread);
+ * resetting frees everything at once (and must not overlap allocating).
+ */
+class Arena {
+public:
+	/**
+	 * \param[in] capacity initial size
+	 */
+	Arena(size_t capacity = ARENA_FRAME_SIZE);
+	~Arena();
+
+	/**
+	 * Allocates \a size bytes (uninitialised).
+	 *
+	 * \param[in] size bytes required
+	 * \param[in] align alignment (a power of two)
+	 * \return the allocation (or \c null if even the heap fallback failed)
+	 */
+	void* _NULLABLE alloc(size_t size, size_t align = ARENA_ALIGN);
+
+	/**
+	 * Allocates an array of \a count default constructed \a T (which are
+	 * never destructed, so should be trivially destructible).
+	 */
+	template<typename T>
+	T* _NULLABLE alloc(size_t count) {
+		T* data = static_cast<T*>(alloc(count * sizeof(T), alignof(T)));
+		if (data) {
+			for (size_t n = 0; n < count; n++) {
+				new (data + n) T();
+			}
+		}
+		return data;
+	}
+
+	/**
+	 * Frees every allocation, growing the arena first if it overflowed.
+	 */
+	void reset();
+
+	/**
+	 * \return the arena's counters
+	 */
+	Stats stats() const;
+
+	/**
+	 * \return incremented on every \c #reset() (used to spot stale sub-arenas)
+	 */
+	unsigned epoch() const {
+		return generation;
+	}
+
+private:
+	Arena(const Arena&);
+	Arena& operator =(const Arena&);
+
+	struct Impl;
+	Impl* _NONNULL impl;
+	unsigned generation;
+};
+
+/**
+ * STL allocator adapter, e.g. \c std::vector<int,arena::Allocator<int>>.
+ * Deallocating does nothing (the memory returns with the arena's reset).
+ */
+template<typename T>
+class Allocator {
+public:
+	typedef T value_type;
+
+	/**
+	 * \param[in] arena arena to allocate from
+	 */
+	Allocator(Arena& arena)
+		: arena(&arena) {}
+
+	template<typename U>
+	Allocator(const Allocator<U>& other)
+		: arena(other.arena) {}
+
+	T* allocate(size_t count) {
+		T* data = static_cast<T*>(arena->alloc(count * sizeof(T), alignof(T)));
+		if (!data) {
+			abort();
+		}
+		return data;
+	}
+
+	void deallocate(T* /*data*/, size_t /*count*/) {}
+
+	template<typename U>
+	bool operator ==(const Allocator<U>& other) const {
+		return arena == other.arena;
+	}
+
+	template<typename U>
+	bool operator !=(const Allocator<U>& other) const {
+		return arena != other.arena;
+	}
+
+private:
+	template<typename U>
+	friend class Allocator;
+
+	Arena* _NONNULL arena;
+};
+
+/**
+ * Creates the frame arenas.
+ *
+ * \param[in] capacity initial size of each frame's arena
+ */
+void init(size_t capacity = ARENA_FRAME_SIZE);
+
+/**
+ * Frees the frame arenas.
+ */
+void destroy();
+
+/**
+ * Moves to the next frame slot and resets its arena. Called on the render
+ * thread before recording.
+ */
+void begin();
+
+/**
+ * \return the current frame's arena (render thread only)
+ */
+Arena& frame();
+
+/**
+ * Moves the simulation to its next slot and resets the slot's arena. Called on
+ * the simulation thread at the start of each update.
+ */
+void step();
+
+/**
+ * \return the arena for the snapshot being filled (simulation thread only,
+ * and the jobs it runs)
+ */
+Arena& snapshot();
+
+/**
+ * Allocates from the calling thread's sub-arena of the current frame (taking
+ * a new block from the frame's arena if needed). Allocations last until the
+ * slot's arena is next reset, like those from \c #frame(). Only for the
+ * render thread and the jobs it runs between \c #begin() calls.
+ *
+ * \param[in] size bytes required
+ * \param[in] align alignment (a power of two)
+ * \return the allocation (or \c null if even the heap fallback failed)
+ */
+void* _NULLABLE local(size_t size, size_t align = ARENA_ALIGN);
+
+/**
+ * Writes every frame (and snapshot) arena's counters to \a out.
+ */
+void print(FILE* _NONNULL out = stdout);
+}
@@ -0,0 +1,121 @@
+/**
+ * \file binding.h
+ * Bind group and bind group layout cache. Descriptors are hashed by content so
+ * identical layouts and groups are created once and shared (with reference
+ * counts), instead of per material or per object.
+ */
+#pragma once
+
+#include <stdio.h>
+
+#include <webgpu/webgpu.h>
+
+#include "defines.h"
+
+/**
+ * \def BINDING_CACHE_BUCKETS
+ * Number of hash buckets (per object type, and a power of two).
+ */
+#ifndef BINDING_CACHE_BUCKETS
+#define BINDING_CACHE_BUCKETS 256
+#endif
+
+namespace binding {
+/**
+ * Cache counters (lifetime totals plus what's currently held).
+ */
+struct Stats {
+	unsigned long long layoutHits;
+	unsigned long long layoutMisses;
+	unsigned long long groupHits;
+	unsigned long long groupMisses;
+	unsigned layouts; ///< Layouts currently cached
+	unsigned groups;  ///< Groups currently cached
+};
+
+/**
+ * Sets the device the cached objects are created with.
+ *
+ * \param[in] device device to create layouts and groups with
+ */
+void init(WGPUDevice _NONNULL device);
+
+/**
+ * Releases every cached object (whether or not still referenced).
+ */
+void destroy();
+
+/**
+ * Gets the layout matching \a desc, creating it on first use. Each call adds
+ * a reference, to be given back with \c #release().
+ *
+ * \note chained structs (\c nextInChain) and labels aren't compared
+ *
+ * \param[in] desc layout descriptor
+ * \return shared layout
+ */
+WGPUBindGroupLayout layout(const WGPUBindGroupLayoutDescriptor& desc);
+
+/**
+ * Gets the bind group matching \a desc, creating it on first use. Each call
+ * adds a reference, to be given back with \c #release(). Groups are matched
+ * on the object handles they bind, so call \c #invalidate() before
+ * releasing a buffer that might be referenced.
+ *
+ * \note chained structs (\c nextInChain) and labels aren't compared
+ *
+ * \param[in] desc group descriptor
+ * \return shared group
+ */
+WGPUBindGroup group(const WGPUBindGroupDescriptor& desc);
+
+/**
+ * Gives back a reference from \c #layout(). Unreferenced layouts stay cached
+ * until \c #trim().
+ *
+ * \param[in] layout layout to release
+ */
+void release(WGPUBindGroupLayout _NONNULL layout);
+
+/**
+ * Gives back a reference from \c #group(). Unreferenced groups stay cached
+ * until \c #trim().
+ *
+ * \param[in] group group to release
+ */
+void release(WGPUBindGroup _NONNULL group);
+
+/**
+ * Removes every group binding \a buffer from the cache (e.g. when the buffer
+ * is being reallocated). Groups still referenced live on, uncached, until
+ * their last \c #release().
+ *
+ * \param[in] buffer buffer being released
+ */
+void invalidate(WGPUBuffer _NONNULL buffer);
+
+/**
+ * Removes every group binding \a view from the cache (e.g. when a streamed
+ * texture's view is replaced).
+ *
+ * \param[in] view texture view being released
+ */
+void invalidate(WGPUTextureView _NONNULL view);
+
+/**
+ * Releases cached layouts and groups no longer referenced.
+ */
+void trim();
+
+/**
+ * \return cache counters
+ */
+Stats stats();
+
+/**
+ * Prints the cache hit rates.
+ *
+ * \param[in] out destination stream
+ */
+void print(FILE* _NONNULL out = stdout);
+}
@@ -0,0 +1,146 @@
+/**
+ * \file capture.h
+ * WebGPU command capture. When enabled, every call the app makes goes through
+ * \c dawn::wire: the client serialises it (upload payloads included), the
+ * stream is appended to a file, then handed to a server running the calls on
+ * the real device. The \c replay tool plays the file back without the app.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include <webgpu/webgpu.h>
+
+#include "defines.h"
+
+/**
+ * \def WEBGPU_CAPTURE
+ * Set to route the app's WebGPU calls through the capturing wire when
+ * creating the device (see \c webgpu#create()). Off by default (when off
+ * nothing links against \c dawn_wire), and not available with Emscripten.
+ * The CMake option of the same name sets it, also building \c replay.
+ */
+#ifndef WEBGPU_CAPTURE
+#define WEBGPU_CAPTURE 0
+#endif
+
+/**
+ * \def WEBGPU_CAPTURE_FILE
+ * Default capture file name.
+ */
+#ifndef WEBGPU_CAPTURE_FILE
+#define WEBGPU_CAPTURE_FILE "capture.wgpc"
+#endif
+
+/**
+ * \def CAPTURE_MAX_ALLOCATION
+ * Largest single serialised command (which bounds the largest buffer or
+ * texture upload that can be captured).
+ */
+#ifndef CAPTURE_MAX_ALLOCATION
+#define CAPTURE_MAX_ALLOCATION (64 * 1024 * 1024)
+#endif
+
+/*
+ * Dawn's proc table (only needed, and only available, for native builds).
+ */
+struct DawnProcTable;
+
+namespace capture {
+/**
+ * Capture file layout: a \c Header followed by \c Chunk records, each
+ * followed by \c Chunk#size bytes.
+ */
+namespace format {
+/**
+ * File identifier (\c WGPC little-endian).
+ */
+static const uint32_t MAGIC = 0x43504757;
+/**
+ * Bumped whenever the layout (or the Dawn revision, and so the wire
+ * protocol) changes.
+ */
+static const uint32_t VERSION = 1;
+
+/**
+ * Start of the file.
+ */
+struct Header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t deviceId;  ///< Wire ID the device was injected with
+	uint32_t deviceGen; ///< Wire generation the device was injected with
+};
+
+/**
+ * Chunk types.
+ */
+enum Type {
+	COMMANDS  = 1, ///< Serialised wire commands
+	FRAME     = 2, ///< End of a frame (no payload)
+	SWAPCHAIN = 3, ///< Swap chain injected (\c SwapChain payload)
+};
+
+/**
+ * Chunk record.
+ */
+struct Chunk {
+	uint32_t type; ///< One of \c #Type
+	uint32_t size; ///< Bytes of payload following
+};
+
+/**
+ * \c SWAPCHAIN payload.
+ */
+struct SwapChain {
+	uint32_t id;
+	uint32_t gen;
+	uint32_t deviceId;
+	uint32_t deviceGen;
+	uint32_t width;
+	uint32_t height;
+	uint32_t format; ///< \c WGPUTextureFormat
+};
+}
+
+/**
+ * Starts capturing. Calls made through \a procs from now on are serialised to
+ * \a path then run on \a device.
+ *
+ * \param[in] device native device
+ * \param[in] native native procs (used to run the captured calls)
+ * \param[out] procs set to the wire's procs (to pass to \c dawnProcSetProcs())
+ * \param[in] path capture file name
+ * \return device to use in place of \a device (or \c null if capture couldn't start, leaving \a procs unchanged)
+ */
+WGPUDevice begin(WGPUDevice _NONNULL device, const DawnProcTable& native, DawnProcTable* _NONNULL procs,
+	const char* _NONNULL path = WEBGPU_CAPTURE_FILE);
+
+/**
+ * \return \c true if capturing (between \c #begin() and \c #end())
+ */
+bool active();
+
+/**
+ * Hands a natively created swap chain to the wire (which can't create one
+ * itself, the native implementation being passed by pointer).
+ *
+ * \param[in] swapchain configured native swap chain
+ * \param[in] width swap chain width
+ * \param[in] height swap chain height
+ * \param[in] format swap chain format
+ * \return swap chain to use in place of \a swapchain
+ */
+WGPUSwapChain inject(WGPUSwapChain _NONNULL swapchain, uint32_t width, uint32_t height, WGPUTextureFormat format);
+
+/**
+ * Marks the end of a frame, flushing the frame's commands to the file and the
+ * device (and delivering any callbacks). Does nothing when not capturing.
+ */
+void frame();
+
+/**
+ * Flushes and closes the capture file.
+ */
+void end();
+}
@@ -0,0 +1,143 @@
+/**
+ * \file draw.h
+ * Sorted draw packet queue. Draws are queued with a 64-bit key ordering them
+ * by pass, pipeline, material, mesh then depth; once sorted, encoding skips
+ * any pipeline, bind group or buffer already bound by the previous draw.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <webgpu/webgpu.h>
+
+#include "defines.h"
+
+/**
+ * \def DRAW_MAX_PACKETS
+ * Maximum number of draws per queue per frame (further draws are dropped).
+ */
+#ifndef DRAW_MAX_PACKETS
+#define DRAW_MAX_PACKETS 16384
+#endif
+
+/**
+ * \def DRAW_SORT_GRAIN
+ * Minimum number of keys per job when sorting (below this sorting runs on the
+ * calling thread, see \c jobs#parallel()).
+ */
+#ifndef DRAW_SORT_GRAIN
+#define DRAW_SORT_GRAIN 2048
+#endif
+
+namespace draw {
+/**
+ * Key field widths, most significant first (pass, pipeline, material, mesh,
+ * depth).
+ */
+enum KeyBits {
+	PASS_BITS     = 4,
+	PIPELINE_BITS = 12,
+	MATERIAL_BITS = 16,
+	MESH_BITS     = 16,
+	DEPTH_BITS    = 16,
+};
+
+/**
+ * Builds a sort key. IDs are truncated to their field width.
+ *
+ * \param[in] pass pass the draw belongs to (see \c Queue#encode())
+ * \param[in] pipeline pipeline ID
+ * \param[in] material material (bind group) ID
+ * \param[in] mesh mesh (vertex and index buffer) ID
+ * \param[in] depth view depth from \c 0 (near) to \c 1 (far); pass \c 1-depth for back to front
+ * \return key for \c Packet#key
+ */
+uint64_t key(unsigned pass, unsigned pipeline, unsigned material, unsigned mesh, float depth);
+
+/**
+ * Everything needed for one indexed draw.
+ */
+struct Packet {
+	uint64_t key;                ///< Sort key (see \c #key())
+	WGPURenderPipeline pipeline;
+	WGPUBindGroup bindGroup;     ///< Bound to group 0
+	WGPUBuffer vertBuf;          ///< Bound to slot 0
+	WGPUBuffer indxBuf;
+	WGPUIndexFormat indxFmt;
+	uint32_t indexCount;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t  baseVertex;
+	uint32_t firstInstance;
+};
+
+/**
+ * State changes made (and avoided) by \c Queue#encode(), since the last
+ * \c Queue#clear().
+ */
+struct Stats {
+	unsigned draws;
+	unsigned pipelines;     ///< \c SetPipeline calls made
+	unsigned bindGroups;    ///< \c SetBindGroup calls made
+	unsigned vertexBuffers; ///< \c SetVertexBuffer calls made
+	unsigned indexBuffers;  ///< \c SetIndexBuffer calls made
+	unsigned avoided;       ///< Calls skipped for setting what was already set
+};
+
+/**
+ * Draw packets for a frame, held in the frame's arena (so filled, sorted and
+ * encoded on the render thread between \c arena#begin() calls, sorting fanning
+ * out to the job workers).
+ */
+class Queue {
+public:
+	Queue();
+	~Queue();
+
+	/**
+	 * Empties the queue (and resets the stats) for the next frame. Called after
+	 * \c arena#begin(), the previous frame's packets going with its arena.
+	 */
+	void clear();
+
+	/**
+	 * Adds a draw.
+	 *
+	 * \param[in] packet draw to add (copied)
+	 * \return \c false if the queue was full
+	 */
+	bool push(const Packet& packet);
+
+	/**
+	 * Sorts the draws by key (an LSD radix sort, skipping any byte where all
+	 * keys are the same).
+	 */
+	void sort();
+
+	/**
+	 * Encodes the sorted draws belonging to \a pass.
+	 *
+	 * \param[in] encoder render pass to draw into
+	 * \param[in] pass pass ID the draws were keyed with
+	 */
+	void encode(WGPURenderPassEncoder _NONNULL encoder, unsigned pass);
+
+	/**
+	 * \return number of queued draws
+	 */
+	size_t size() const;
+
+	/**
+	 * \return state changes since the last \c #clear()
+	 */
+	const Stats& stats() const;
+
+private:
+	Queue(const Queue&);
+	Queue& operator =(const Queue&);
+
+	struct Impl;
+	Impl* _NONNULL impl;
+};
+}
@@ -0,0 +1,175 @@
+/**
+ * \file dynres.h
+ * Dynamic resolution. The scene renders into an offscreen target at a scale
+ * of the output size, a controller adjusts the scale from the measured CPU
+ * and GPU frame times to stay within a frame budget, and a final pass
+ * upscales the result to the swap chain.
+ * \n
+ * The scale moves in coarse steps (so the graph's pooled targets are only
+ * reallocated when a step changes) and drops straight away on a spike but
+ * only climbs back after a run of calm frames: under load it's better to lose
+ * resolution than frames.
+ */
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include "defines.h"
+#include "graph.h"
+
+/**
+ * \def DYNRES_BUDGET_MS
+ * Default frame budget (in milliseconds), one display period at 60Hz. Any
+ * less and a vsync-locked frame could never be under budget.
+ */
+#ifndef DYNRES_BUDGET_MS
+#define DYNRES_BUDGET_MS (1000.0 / 60.0)
+#endif
+
+/**
+ * \def DYNRES_MIN
+ * Smallest scale factor.
+ */
+#ifndef DYNRES_MIN
+#define DYNRES_MIN 0.5f
+#endif
+
+/**
+ * \def DYNRES_STEP
+ * Size of each step between \c #DYNRES_MIN and full resolution.
+ */
+#ifndef DYNRES_STEP
+#define DYNRES_STEP 0.125f
+#endif
+
+/**
+ * \def DYNRES_SPIKE
+ * Multiple of the budget a single frame can take before the scale drops
+ * (without waiting for the average to catch up).
+ */
+#ifndef DYNRES_SPIKE
+#define DYNRES_SPIKE 1.25
+#endif
+
+/**
+ * \def DYNRES_HEADROOM
+ * Fraction of the budget the average must stay under before the scale climbs
+ * (enough that the next step up should still fit).
+ */
+#ifndef DYNRES_HEADROOM
+#define DYNRES_HEADROOM 0.7
+#endif
+
+/**
+ * \def DYNRES_RAISE_FRAMES
+ * Consecutive frames under the headroom before the scale climbs a step.
+ */
+#ifndef DYNRES_RAISE_FRAMES
+#define DYNRES_RAISE_FRAMES 60
+#endif
+
+/**
+ * \def DYNRES_SETTLE_FRAMES
+ * Frames ignored after a change (the timings lag by the frames in flight).
+ */
+#ifndef DYNRES_SETTLE_FRAMES
+#define DYNRES_SETTLE_FRAMES 4
+#endif
+
+/**
+ * \def DYNRES_ALIGN
+ * Scaled sizes are rounded up to a multiple of this.
+ */
+#ifndef DYNRES_ALIGN
+#define DYNRES_ALIGN 8
+#endif
+
+namespace dynres {
+/**
+ * Picks the scale factor from the frame times.
+ */
+class Controller {
+public:
+	/**
+	 * \param[in] budget target frame time (in milliseconds)
+	 */
+	Controller(double budget = DYNRES_BUDGET_MS);
+
+	/**
+	 * Feeds in the last frame's times, moving the scale a step if needed.
+	 * Either time may be zero if unknown (the larger is the bottleneck).
+	 *
+	 * \param[in] cpuMs CPU time of the busiest thread, excluding any waits on the GPU or display (in milliseconds)
+	 * \param[in] gpuMs GPU time (in milliseconds)
+	 * \return \c true if the scale changed
+	 */
+	bool update(double cpuMs, double gpuMs);
+
+	/**
+	 * \return current scale factor (\c #DYNRES_MIN to \c 1)
+	 */
+	float factor() const;
+
+	/**
+	 * Scales an output size by the current \c #factor().
+	 *
+	 * \param[in] outW output (swap chain) width
+	 * \param[in] outH output (swap chain) height
+	 * \param[out] w scaled width
+	 * \param[out] h scaled height
+	 * \return \c true if the scaled size differs from the output (so needs upscaling)
+	 */
+	bool size(uint32_t outW, uint32_t outH, uint32_t& w, uint32_t& h) const;
+
+	/**
+	 * Sets the frame budget.
+	 *
+	 * \param[in] ms target frame time (in milliseconds)
+	 */
+	void budget(double ms);
+
+	/**
+	 * \return number of times the scale has changed
+	 */
+	unsigned changes() const {
+		return changed;
+	}
+
+private:
+	double target;  ///< Frame budget
+	double average; ///< Smoothed frame time (or zero to seed from the next)
+	unsigned step;  ///< Steps above \c #DYNRES_MIN
+	unsigned calm;  ///< Consecutive frames under the headroom
+	unsigned settle; ///< Frames left to ignore after a change
+	unsigned changed;
+};
+
+/**
+ * Final pass, sampling the scaled scene into the output.
+ */
+class Upscaler {
+public:
+	/**
+	 * \param[in] device device to create the pipeline with
+	 * \param[in] format output (swap chain) format
+	 */
+	Upscaler(WGPUDevice _NONNULL device, WGPUTextureFormat format);
+	~Upscaler();
+
+	/**
+	 * Adds a pass filtering \a src over the whole of \a dst.
+	 *
+	 * \param[in] graph frame's graph
+	 * \param[in] src scaled scene
+	 * \param[in] dst output
+	 */
+	void addPass(graph::Graph& graph, graph::Resource src, graph::Resource dst);
+
+private:
+	Upscaler(const Upscaler&);
+	Upscaler& operator =(const Upscaler&);
+
+	struct Impl;
+	Impl* _NONNULL impl;
+};
+}
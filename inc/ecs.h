@@ -0,0 +1,267 @@
+/**
+ * \file ecs.h
+ * Entity component storage. Entities with the same set of components (their
+ * archetype) are stored together in fixed-size chunks, each chunk holding one
+ * contiguous array per component, so systems stream through exactly the data
+ * they touch. Systems run over the chunks matching a set of components, the
+ * chunks being spread across the job workers (see \c jobs#parallel()).
+ * \n
+ * Structural changes (creating and destroying entities, adding and removing
+ * components) are queued and applied together by \c World#flush(), called at
+ * the frame boundary, so chunks never move while systems are iterating them
+ * (and systems can safely queue changes from any worker). Removals swap the
+ * archetype's last entity into the hole, keeping every chunk but the last
+ * full.
+ * \n
+ * Components are plain data (copied with \c memcpy() and zero initialised),
+ * identified by type without needing RTTI.
+ *
+ * \code
+ * struct Spin { vec3 axis; float speed; };
+ * ecs::World world;
+ * ecs::Entity cube = world.create(ecs::mask<Transform, Spin>());
+ * world.set(cube, Spin{vec3(0.0f, 1.0f, 0.0f), 2.0f});
+ * world.flush();
+ * ...
+ * world.each(ecs::mask<Transform, Spin>(), animate, &delta);
+ * \endcode
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "defines.h"
+
+/**
+ * \def ECS_MAX_ENTITIES
+ * Default entity capacity of an \c ecs#World (at most 2^24).
+ */
+#ifndef ECS_MAX_ENTITIES
+#define ECS_MAX_ENTITIES 65536
+#endif
+
+/**
+ * \def ECS_MAX_COMPONENTS
+ * Most component types (one bit each in an \c ecs#Mask, so at most 32).
+ */
+#ifndef ECS_MAX_COMPONENTS
+#define ECS_MAX_COMPONENTS 32
+#endif
+
+/**
+ * \def ECS_MAX_ARCHETYPES
+ * Most distinct component sets per world.
+ */
+#ifndef ECS_MAX_ARCHETYPES
+#define ECS_MAX_ARCHETYPES 64
+#endif
+
+/**
+ * \def ECS_CHUNK_SIZE
+ * Chunk size in bytes (small enough for a chunk's arrays to stay in cache
+ * while a system works through them, with archetypes whose entities are
+ * larger getting one entity per chunk).
+ */
+#ifndef ECS_CHUNK_SIZE
+#define ECS_CHUNK_SIZE 16384
+#endif
+
+namespace ecs {
+/**
+ * Entity handle (an index and a generation, so handles to destroyed entities
+ * are detected rather than reaching the index's next user).
+ */
+typedef uint32_t Entity;
+
+/**
+ * No entity (returned when full).
+ */
+const Entity NONE = 0xFFFFFFFF;
+
+/**
+ * Component type ID (see \c #id()).
+ */
+typedef uint32_t Component;
+
+/**
+ * Set of components, one bit per \c Component.
+ */
+typedef uint32_t Mask;
+
+/**
+ * Registers a component type (called once per type, from \c #id()).
+ *
+ * \param[in] size size of the type in bytes
+ * \param[in] align alignment of the type
+ * \return the type's ID
+ */
+Component declare(size_t size, size_t align);
+
+/**
+ * \return the ID of component type \a T (assigned on first use)
+ */
+template<typename T>
+Component id() {
+	static const Component type = declare(sizeof(T), alignof(T));
+	return type;
+}
+
+/**
+ * \return the set of the component types \a T
+ */
+template<typename... T>
+Mask mask() {
+	const Mask bits[] = {0, (1u << id<T>())...};
+	Mask all = 0;
+	for (size_t n = 0; n < sizeof bits / sizeof bits[0]; n++) {
+		all |= bits[n];
+	}
+	return all;
+}
+
+/**
+ * A chunk's entities, as passed to a \c System.
+ */
+struct Chunk {
+	uint8_t* _NONNULL data;
+	const uint32_t* _NONNULL offsets; ///< Offset of each component's array in \c #data (zero if absent)
+	unsigned count; ///< Number of entities
+	unsigned first; ///< Number of matching entities in the chunks before this one (for writing to shared arrays)
+
+	/**
+	 * \return the chunk's entity handles
+	 */
+	const Entity* _NONNULL entities() const {
+		return reinterpret_cast<const Entity*>(data);
+	}
+	/**
+	 * \return the chunk's array of component \a T (or \c null if the archetype hasn't it)
+	 */
+	template<typename T>
+	T* _NULLABLE get() const {
+		uint32_t offset = offsets[id<T>()];
+		return (offset) ? reinterpret_cast<T*>(data + offset) : NULLPTR;
+	}
+};
+
+/**
+ * System body, called for each chunk matching the system's components (from
+ * multiple threads at once).
+ *
+ * \param[in] chunk the chunk's entities and component arrays
+ * \param[in] user user data passed to \c World#each()
+ */
+typedef void (*System)(const Chunk& chunk, void* _NULLABLE user);
+
+/**
+ * Entities and their components.
+ */
+class World {
+public:
+	/**
+	 * \param[in] capacity most entities the world can hold
+	 */
+	World(unsigned capacity = ECS_MAX_ENTITIES);
+	~World();
+
+	/**
+	 * Creates an entity with zeroed components (on the next flush, until
+	 * then having none).
+	 *
+	 * \param[in] components the entity's component set
+	 * \return the new entity (or \c #NONE if full)
+	 */
+	Entity create(Mask components);
+
+	/**
+	 * Destroys an entity (on the next flush).
+	 */
+	void destroy(Entity entity);
+
+	/**
+	 * Adds (or overwrites) a component (on the next flush, moving the entity
+	 * to its new archetype).
+	 *
+	 * \param[in] type component type
+	 * \param[in] data component value (copied now)
+	 * \param[in] size size of \a data in bytes
+	 */
+	void add(Entity entity, Component type, const void* _NONNULL data, size_t size);
+
+	/**
+	 * Removes a component (on the next flush).
+	 */
+	void remove(Entity entity, Component type);
+
+	/**
+	 * Sets a component (on the next flush, after the changes queued before
+	 * it, so values can be given to entities not yet created). Ignored if the
+	 * entity hasn't the component by then.
+	 *
+	 * \param[in] type component type
+	 * \param[in] data component value (copied now)
+	 * \param[in] size size of \a data in bytes
+	 */
+	void set(Entity entity, Component type, const void* _NONNULL data, size_t size);
+
+	template<typename T>
+	void add(Entity entity, const T& value) {
+		add(entity, id<T>(), &value, sizeof(T));
+	}
+	template<typename T>
+	void remove(Entity entity) {
+		remove(entity, id<T>());
+	}
+	template<typename T>
+	void set(Entity entity, const T& value) {
+		set(entity, id<T>(), &value, sizeof(T));
+	}
+
+	/**
+	 * \return the entity's component of \a type (valid until the next flush, or \c null if it hasn't one)
+	 */
+	void* _NULLABLE get(Entity entity, Component type) const;
+
+	template<typename T>
+	T* _NULLABLE get(Entity entity) const {
+		return static_cast<T*>(get(entity, id<T>()));
+	}
+
+	/**
+	 * \return \c true if the entity exists (as of the last flush)
+	 */
+	bool alive(Entity entity) const;
+
+	/**
+	 * Applies the queued structural changes, in the order they were made.
+	 * Call with no systems running (typically once per frame).
+	 *
+	 * \return number of changes applied
+	 */
+	unsigned flush();
+
+	/**
+	 * Runs a system over the chunks whose archetypes have all of \a all,
+	 * spread across the job workers, returning once all the chunks are done.
+	 *
+	 * \param[in] all components the chunks must have
+	 * \param[in] func system body
+	 * \param[in] user user data passed to \a func
+	 * \return number of entities \a func was run over
+	 */
+	unsigned each(Mask all, System _NONNULL func, void* _NULLABLE user = NULLPTR);
+
+	/**
+	 * \return number of entities with all of \a all (as of the last flush)
+	 */
+	unsigned count(Mask all = 0) const;
+
+private:
+	World(const World&);
+	World& operator =(const World&);
+
+	struct Impl;
+	Impl* _NONNULL impl;
+};
+}
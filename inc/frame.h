@@ -0,0 +1,175 @@
+/**
+ * \file frame.h
+ * Staged frame scheduler. Simulation for the next frame runs on its own
+ * thread while the render thread records and submits the current one, the
+ * two exchanging immutable scene snapshots through a triple buffer.
+ * \n
+ * Handing a snapshot over is a single atomic exchange, but the threads run in
+ * lockstep: the simulation publishes a snapshot then sleeps (on a condition
+ * variable) until the render thread takes it, so it's never more than one
+ * snapshot ahead, and the render thread sleeps until each next snapshot is
+ * published. No snapshot is skipped, so per-snapshot steps (such as a time
+ * step handed to the GPU) always add up to the simulated time. The third
+ * slot lets the simulation publish while the render thread is still reading
+ * the previous snapshot (only starting the next update waits).
+ */
+#pragma once
+
+#include <stddef.h>
+
+#include <atomic>
+
+#include "defines.h"
+
+/**
+ * \def FRAME_THREADED
+ * Set if simulation runs on its own thread (otherwise all the stages run in
+ * sequence on the calling thread). Defaults to threaded everywhere except
+ * Emscripten builds without pthreads.
+ */
+#ifndef FRAME_THREADED
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define FRAME_THREADED 0
+#else
+#define FRAME_THREADED 1
+#endif
+#endif
+
+namespace frame {
+/**
+ * Single-producer/single-consumer triple buffer. The producer always has a
+ * slot to write to, the consumer always has a complete slot to read from, and
+ * the third slot sits between the two. Publishing and acquiring are a single
+ * atomic exchange each (neither side ever waits on the other).
+ *
+ * \tparam T slot type
+ */
+template<typename T>
+class TripleBuffer {
+public:
+	TripleBuffer()
+		: middle(1)
+		, back  (0)
+		, front (2) {}
+
+	/**
+	 * \return the producer's slot (owned exclusively until \c #publish())
+	 */
+	T& writable() {
+		return slots[back];
+	}
+
+	/**
+	 * Hands the producer's slot to the consumer, taking the middle slot in
+	 * exchange (whose contents are stale and free to overwrite).
+	 */
+	void publish() {
+		back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+	}
+
+	/**
+	 * Swaps the consumer's slot for the most recently published one.
+	 *
+	 * \return \c true if a newer slot was acquired (\c false leaves \c #readable() unchanged)
+	 */
+	bool acquire() {
+		if ((middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+			return false;
+		}
+		front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+
+	/**
+	 * \return the consumer's slot (owned exclusively until the next \c #acquire())
+	 */
+	T& readable() {
+		return slots[front];
+	}
+
+private:
+	TripleBuffer(const TripleBuffer&);
+	TripleBuffer& operator =(const TripleBuffer&);
+
+	/**
+	 * Bits of \c #middle holding the slot index.
+	 */
+	static const unsigned INDEX = 3;
+	/**
+	 * Bit of \c #middle set when its slot was published but not yet acquired.
+	 */
+	static const unsigned FRESH = 4;
+
+	T slots[3];
+	std::atomic<unsigned> middle; ///< Shared slot index (plus the \c #FRESH flag)
+	unsigned back;  ///< Producer-owned slot index
+	unsigned front; ///< Consumer-owned slot index
+};
+
+/**
+ * Per-frame callbacks, in the order they run. Any may be \c null.
+ */
+struct Stages {
+	/**
+	 * Simulation stage, run on the simulation thread (and the only stage
+	 * allowed to touch mutable application state). Advances the state and
+	 * writes everything the render thread needs into the snapshot.
+	 *
+	 * \param[out] snapshot scene snapshot to fill (\c #size bytes, holding whatever an earlier update wrote)
+	 * \param[in] delta seconds since the previous update
+	 * \param[in] user \c #user data
+	 * \return \c true to continue, \c false to quit
+	 */
+	bool (*update)(void* _NONNULL snapshot, double delta, void* _NULLABLE user);
+	/**
+	 * Command recording stage, run on the render thread.
+	 *
+	 * \param[in] snapshot immutable scene snapshot
+	 * \param[in] user \c #user data
+	 */
+	void (*record)(const void* _NONNULL snapshot, void* _NULLABLE user);
+	/**
+	 * Queue submission (and presentation) stage, run on the render thread.
+	 *
+	 * \param[in] user \c #user data
+	 * \return \c true to continue, \c false to quit
+	 */
+	bool (*submit)(void* _NULLABLE user);
+	/**
+	 * Size in bytes of a scene snapshot.
+	 */
+	size_t size;
+	/**
+	 * User data passed to each stage.
+	 */
+	void* _NULLABLE user;
+};
+
+/**
+ * Drives the \c #Stages. The simulation thread is started on construction and
+ * joined on destruction.
+ */
+class Scheduler {
+public:
+	/**
+	 * \param[in] stages callbacks to run (copied)
+	 */
+	Scheduler(const Stages& stages);
+	~Scheduler();
+
+	/**
+	 * Runs the render thread's stages for one frame, using the next snapshot
+	 * (blocking until the simulation has published it).
+	 *
+	 * \return \c false if any stage requested to quit
+	 */
+	bool tick();
+
+private:
+	Scheduler(const Scheduler&);
+	Scheduler& operator =(const Scheduler&);
+
+	struct Impl;
+	Impl* _NONNULL impl;
+};
+}
@@ -0,0 +1,211 @@
+/**
+ * \file graph.h
+ * Declarative render graph. Passes declare the textures they read and write;
+ * compiling the graph culls passes whose results go unused, picks load and
+ * store ops from how each attachment is used, and aliases transient textures
+ * whose lifetimes don't overlap. All passes are recorded into one encoder
+ * (and so one submission).
+ */
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include "defines.h"
+
+/**
+ * \def GRAPH_MAX_PASSES
+ * Maximum number of passes per frame.
+ */
+#ifndef GRAPH_MAX_PASSES
+#define GRAPH_MAX_PASSES 32
+#endif
+
+/**
+ * \def GRAPH_MAX_RESOURCES
+ * Maximum number of declared (transient plus imported) textures per frame.
+ */
+#ifndef GRAPH_MAX_RESOURCES
+#define GRAPH_MAX_RESOURCES 32
+#endif
+
+/**
+ * \def GRAPH_MAX_TEXTURES
+ * Maximum number of physical textures kept in the pool (across frames). Once
+ * full, further transients get textures created (and freed) per frame.
+ */
+#ifndef GRAPH_MAX_TEXTURES
+#define GRAPH_MAX_TEXTURES 32
+#endif
+
+/**
+ * \def GRAPH_MAX_COLOR
+ * Maximum number of colour attachments per pass.
+ */
+#ifndef GRAPH_MAX_COLOR
+#define GRAPH_MAX_COLOR 4
+#endif
+
+/**
+ * \def GRAPH_MAX_READS
+ * Maximum number of sampled (or otherwise read) textures per pass.
+ */
+#ifndef GRAPH_MAX_READS
+#define GRAPH_MAX_READS 4
+#endif
+
+namespace graph {
+/**
+ * \typedef Resource
+ * Handle to a texture declared in the current frame's graph.
+ */
+typedef unsigned Resource;
+
+/**
+ * Invalid (or unused) resource handle.
+ */
+static const Resource NONE = ~0U;
+
+/**
+ * Transient texture description.
+ */
+struct TextureDesc {
+	WGPUTextureFormat format;
+	uint32_t width;
+	uint32_t height;
+	/**
+	 * Any usage beyond what the graph infers (attachments and reads are
+	 * added automatically).
+	 */
+	WGPUTextureUsageFlags usage;
+};
+
+class Graph;
+
+/**
+ * Render pass callback, called with the pass already begun on the declared
+ * attachments.
+ *
+ * \param[in] pass encoder for the render pass
+ * \param[in] graph owning graph (to look up the views of read resources)
+ * \param[in] user \c PassDesc#user data
+ */
+typedef void (*Execute)(WGPURenderPassEncoder _NONNULL pass, const Graph& graph, void* _NULLABLE user);
+
+/**
+ * Raw encoder callback, for compute passes and copies.
+ *
+ * \param[in] encoder frame's command encoder
+ * \param[in] graph owning graph (to look up the views of declared resources)
+ * \param[in] user \c PassDesc#user data
+ */
+typedef void (*Encode)(WGPUCommandEncoder _NONNULL encoder, const Graph& graph, void* _NULLABLE user);
+
+/**
+ * Pass declaration. Zero-initialise, then fill in what's needed (unused
+ * resource slots must be \c #NONE).
+ */
+struct PassDesc {
+	const char* _NONNULL name;   ///< Pass name (for labels and profiling, so with the lifetime \c profile#begin() requires)
+	Resource color[GRAPH_MAX_COLOR]; ///< Colour attachments written (render passes)
+	unsigned colorCount;         ///< Number of entries in \c #color
+	Resource depth;              ///< Depth attachment written (render passes, or \c #NONE)
+	Resource reads[GRAPH_MAX_READS]; ///< Textures read by the pass
+	unsigned readCount;          ///< Number of entries in \c #reads
+	Resource writes;             ///< Texture written outside of attachments (encoder passes, or \c #NONE)
+	bool clear;                  ///< Clear the attachments (otherwise existing contents are kept)
+	WGPUColor clearColor;        ///< Clear colour (if \c #clear)
+	float clearDepth;            ///< Clear depth (if \c #clear)
+	bool sideEffects;            ///< Never cull (e.g. writes buffers the graph doesn't know about)
+	Execute _NULLABLE execute;   ///< Render pass contents (\c #encode must be \c null)
+	Encode  _NULLABLE encode;    ///< Raw encoder contents (\c #execute must be \c null)
+	void* _NULLABLE user;        ///< User data passed to the callback
+};
+
+/**
+ * Result of the last \c Graph#compile().
+ */
+struct Stats {
+	unsigned passes;    ///< Passes declared
+	unsigned culled;    ///< Passes dropped for having no used outputs
+	unsigned transient; ///< Transient textures declared (and used)
+	unsigned textures;  ///< Physical textures they were aliased onto
+	unsigned discards;  ///< Attachments stored with \c WGPUStoreOp_Discard
+	unsigned long long bytes; ///< Estimated memory in the physical textures
+};
+
+/**
+ * Render graph, rebuilt each frame (declaring is cheap and allocation free)
+ * but keeping a pool of physical textures across frames.
+ */
+class Graph {
+public:
+	/**
+	 * \param[in] device device to create the pooled textures with
+	 */
+	Graph(WGPUDevice _NONNULL device);
+	~Graph();
+
+	/**
+	 * Clears the previous frame's declarations (keeping the texture pool).
+	 */
+	void reset();
+
+	/**
+	 * Declares a transient texture, created (or aliased) by the graph.
+	 *
+	 * \param[in] name texture name
+	 * \param[in] desc texture format, size and any extra usage
+	 * \return handle to the texture
+	 */
+	Resource create(const char* _NONNULL name, const TextureDesc& desc);
+
+	/**
+	 * Declares an external texture, such as the swap chain's back buffer.
+	 *
+	 * \param[in] name texture name
+	 * \param[in] view texture view (owned by the caller)
+	 * \param[in] output \c true if the contents are needed after the graph runs (keeping the passes writing it)
+	 * \return handle to the texture
+	 */
+	Resource import(const char* _NONNULL name, WGPUTextureView _NONNULL view, bool output = true);
+
+	/**
+	 * Declares a pass. Passes run in the order added.
+	 *
+	 * \param[in] desc pass declaration (copied)
+	 */
+	void addPass(const PassDesc& desc);
+
+	/**
+	 * Culls unused passes, computes lifetimes, load/store ops and aliasing,
+	 * then creates any textures the pool is missing.
+	 */
+	void compile();
+
+	/**
+	 * Records all the surviving passes.
+	 *
+	 * \param[in] encoder encoder to record into
+	 */
+	void execute(WGPUCommandEncoder _NONNULL encoder);
+
+	/**
+	 * \return view of a declared texture (valid after \c #compile())
+	 *
+	 * \param[in] res texture handle
+	 */
+	WGPUTextureView _NULLABLE view(Resource res) const;
+
+	/**
+	 * \return results of the last \c #compile()
+	 */
+	const Stats& stats() const;
+
+private:
+	Graph(const Graph&);
+	Graph& operator =(const Graph&);
+
+	struct Impl;
+	Impl* _NONNULL impl;
+};
+}
@@ -0,0 +1,158 @@
+/**
+ * \file instance.h
+ * Compact instance transforms. Instead of a 64 byte matrix each instance is
+ * a rotation quaternion, a position and a uniform scale: 32 bytes as floats,
+ * or 16 as half floats with \c INSTANCE_HALF, halving (or quartering) what's
+ * uploaded and fetched per instance. Shaders expand them back to a matrix
+ * with the functions in \c #INSTANCE_WGSL (which also packs them, for compute
+ * shaders writing instances).
+ *
+ * \code
+ * static char const vert_wgsl[] = INSTANCE_WGSL R"(
+ *	struct Instances {
+ *		items : array<Instance>;
+ *	};
+ *	@group(0) @binding(0) var<storage, read> instances : Instances;
+ *	...
+ *	let model = instanceMatrix(instances.items[index]);
+ * )";
+ * ...
+ * instance::pack(transforms, snapshot->instances, count);
+ * \endcode
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "defines.h"
+
+/**
+ * \def INSTANCE_HALF
+ * Set to store instances as half floats (16 bytes, but with only around
+ * three significant digits, so positions need to stay close to the origin of
+ * the space the instances are placed in).
+ */
+#ifndef INSTANCE_HALF
+#define INSTANCE_HALF 0
+#endif
+
+namespace instance {
+/**
+ * Instance transform, on the CPU (and on the GPU at full precision).
+ */
+struct Transform {
+	glm::quat rotation;
+	glm::vec3 position;
+	float scale; ///< Uniform scale
+};
+
+/**
+ * Half precision instance (pairs of half floats, packed as WGSL's
+ * \c pack2x16float() does).
+ */
+struct Half {
+	uint32_t rotation[2]; ///< Rotation \c xy then \c zw
+	uint32_t position[2]; ///< Position \c xy then \c z and the scale
+};
+
+#if INSTANCE_HALF
+typedef Half Instance;
+#else
+typedef Transform Instance;
+#endif
+
+/**
+ * Converts a run of transforms to instances (a straight copy at full
+ * precision).
+ *
+ * \param[in] src transforms to convert
+ * \param[out] dst instances to write
+ * \param[in] count number of entries in \a src
+ */
+void pack(const Transform* _NONNULL src, Instance* _NONNULL dst, size_t count);
+
+/**
+ * Converts a run of matrices to instances (see \c #transform()), e.g. the
+ * world transforms of a \c scene#Graph.
+ *
+ * \param[in] src matrices to convert
+ * \param[out] dst instances to write
+ * \param[in] count number of entries in \a src
+ */
+void pack(const glm::mat4* _NONNULL src, Instance* _NONNULL dst, size_t count);
+
+/**
+ * \return the matrix \a transform expands to (as \c instanceMatrix() in the shader)
+ */
+glm::mat4 matrix(const Transform& transform);
+
+/**
+ * Splits a matrix back into a transform (the reverse of \c #matrix(), so
+ * only exact for a rotation, uniform scale and translation, any shear or
+ * non-uniform scale being lost).
+ *
+ * \param[in] matrix matrix to split
+ * \return the matrix's transform
+ */
+Transform transform(const glm::mat4& matrix);
+}
+
+/*
+ * Quaternion, position and scale to matrix (shared by both formats).
+ */
+#define INSTANCE_IMPL_EXPAND_WGSL \
+	"fn instanceExpand(q : vec4<f32>, position : vec3<f32>, scale : f32) -> mat4x4<f32> {\n" \
+	"	let x2 = q.xyz * (q.x + q.x);\n" \
+	"	let y2 = q.yz * (q.y + q.y);\n" \
+	"	let zz = q.z * (q.z + q.z);\n" \
+	"	let w2 = q.xyz * (q.w + q.w);\n" \
+	"	return mat4x4<f32>(\n" \
+	"		vec4<f32>(1.0 - (y2.x + zz), x2.y + w2.z, x2.z - w2.y, 0.0) * scale,\n" \
+	"		vec4<f32>(x2.y - w2.z, 1.0 - (x2.x + zz), y2.y + w2.x, 0.0) * scale,\n" \
+	"		vec4<f32>(x2.z + w2.y, y2.y - w2.x, 1.0 - (x2.x + y2.x), 0.0) * scale,\n" \
+	"		vec4<f32>(position, 1.0));\n" \
+	"}\n"
+
+#if INSTANCE_HALF
+#define INSTANCE_IMPL_FORMAT_WGSL \
+	"struct Instance {\n" \
+	"	rotation : vec2<u32>;\n" \
+	"	position : vec2<u32>;\n" \
+	"};\n" \
+	"fn instanceMatrix(inst : Instance) -> mat4x4<f32> {\n" \
+	"	let q = normalize(vec4<f32>(unpack2x16float(inst.rotation.x), unpack2x16float(inst.rotation.y)));\n" \
+	"	let zs = unpack2x16float(inst.position.y);\n" \
+	"	return instanceExpand(q, vec3<f32>(unpack2x16float(inst.position.x), zs.x), zs.y);\n" \
+	"}\n" \
+	"fn instancePack(rotation : vec4<f32>, position : vec3<f32>, scale : f32) -> Instance {\n" \
+	"	return Instance(\n" \
+	"		vec2<u32>(pack2x16float(rotation.xy), pack2x16float(rotation.zw)),\n" \
+	"		vec2<u32>(pack2x16float(position.xy), pack2x16float(vec2<f32>(position.z, scale))));\n" \
+	"}\n"
+#else
+#define INSTANCE_IMPL_FORMAT_WGSL \
+	"struct Instance {\n" \
+	"	rotation : vec4<f32>;\n" \
+	"	position : vec3<f32>;\n" \
+	"	scale : f32;\n" \
+	"};\n" \
+	"fn instanceMatrix(inst : Instance) -> mat4x4<f32> {\n" \
+	"	return instanceExpand(inst.rotation, inst.position, inst.scale);\n" \
+	"}\n" \
+	"fn instancePack(rotation : vec4<f32>, position : vec3<f32>, scale : f32) -> Instance {\n" \
+	"	return Instance(rotation, position, scale);\n" \
+	"}\n"
+#endif
+
+/**
+ * \def INSTANCE_WGSL
+ * WGSL declarations (as a string literal) of the \c Instance struct matching
+ * \c instance#Instance, plus \c instanceMatrix(), expanding an instance to
+ * its model matrix, and \c instancePack(), making an instance from a
+ * rotation quaternion (\c xyz vector part, \c w scalar), position and scale.
+ */
+#define INSTANCE_WGSL INSTANCE_IMPL_EXPAND_WGSL INSTANCE_IMPL_FORMAT_WGSL
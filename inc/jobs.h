@@ -0,0 +1,61 @@
+/**
+ * \file jobs.h
+ * Worker thread pool for splitting data-parallel loops across cores.
+ */
+#pragma once
+
+#include <stddef.h>
+
+#include "defines.h"
+#include "frame.h"
+
+/**
+ * \def JOBS_MAX_WORKERS
+ * Maximum number of worker threads (in addition to the calling thread).
+ */
+#ifndef JOBS_MAX_WORKERS
+#define JOBS_MAX_WORKERS 15
+#endif
+
+namespace jobs {
+/**
+ * Loop body, called with a sub-range of the work.
+ *
+ * \param[in] begin first item
+ * \param[in] end one past the last item
+ * \param[in] user user data passed to \c #parallel()
+ */
+typedef void (*Range)(size_t begin, size_t end, void* _NULLABLE user);
+
+/**
+ * Starts the worker threads. Without workers (before calling this, or when
+ * built without threads, see \c #FRAME_THREADED) all work runs on the calling
+ * thread.
+ *
+ * \param[in] workers number of workers (zero to use one fewer than the number of cores)
+ */
+void init(unsigned workers = 0);
+
+/**
+ * Stops and joins the worker threads.
+ */
+void destroy();
+
+/**
+ * \return number of threads \c #parallel() spreads work over (the workers plus the caller)
+ */
+unsigned count();
+
+/**
+ * Runs \a func over \c [0, \a items) split into chunks of at least \a grain
+ * items, returning once all the chunks are done. The calling thread works on
+ * chunks too. Calls from different threads share the workers, and \a func
+ * may itself call \c #parallel() (the inner loop is picked up first).
+ *
+ * \param[in] items number of items
+ * \param[in] grain minimum items per chunk (smaller loops run inline)
+ * \param[in] func loop body
+ * \param[in] user user data passed to \a func
+ */
+void parallel(size_t items, size_t grain, Range _NONNULL func, void* _NULLABLE user = NULLPTR);
+}
@@ -0,0 +1,129 @@
+/**
+ * \file mipgen.h
+ * Compute shader mip generation (WebGPU having no built-in equivalent of
+ * \c glGenerateMipmap). Each dispatch reads one level and writes up to the
+ * next four: every workgroup box filters a 16x16 tile of the source down to
+ * 8x8, then keeps halving it in workgroup memory, so the intermediate levels
+ * never round trip through the texture. sRGB data is decoded before
+ * filtering and encoded again after (averaging in linear space).
+ * \n
+ * Many textures can be queued then recorded together, into one compute pass
+ * of one command encoder. Generated textures need the \c #USAGE flags and a
+ * format storage textures support (\c rgba8unorm, \c rgba16float or
+ * \c rgba32float). sRGB colour is stored as \c rgba8unorm, created with
+ * \c RGBA8UnormSrgb in its \c viewFormats so it can be sampled through an
+ * sRGB view.
+ */
+#pragma once
+
+#include <stdio.h>
+
+#include <webgpu/webgpu.h>
+
+#include "defines.h"
+
+/**
+ * \def MIPGEN_MAX_TEXTURES
+ * Most textures queued for one \c mipgen#Generator#encode().
+ */
+#ifndef MIPGEN_MAX_TEXTURES
+#define MIPGEN_MAX_TEXTURES 64
+#endif
+
+/**
+ * \def MIPGEN_CHECK
+ * Set to build \c mipgen#check() (and run it at startup).
+ */
+#ifndef MIPGEN_CHECK
+#define MIPGEN_CHECK 0
+#endif
+
+namespace mipgen {
+/**
+ * Usage flags a texture needs for its mips to be generated.
+ */
+const WGPUTextureUsageFlags USAGE = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_StorageBinding;
+
+/**
+ * Texture to generate the mips of.
+ */
+struct TextureDesc {
+	uint32_t width;  ///< Size of level zero
+	uint32_t height;
+	uint32_t levels; ///< Mip levels in the texture
+	uint32_t base;   ///< Level to generate from (the levels after it being written)
+	WGPUTextureFormat format;
+	bool srgb;       ///< \c true if the contents are sRGB encoded (only for \c rgba8unorm)
+};
+
+/**
+ * \return number of levels in a full mip chain for a \a width by \a height texture
+ */
+uint32_t levels(uint32_t width, uint32_t height);
+
+/**
+ * \return \c true if the mips of a \a format texture can be generated
+ */
+bool supported(WGPUTextureFormat format);
+
+/**
+ * Records the compute passes generating mips.
+ */
+class Generator {
+public:
+	/**
+	 * \param[in] device device to create the pipelines with
+	 */
+	Generator(WGPUDevice _NONNULL device);
+	~Generator();
+
+	/**
+	 * Queues a texture (holding a reference until the next \c #encode()).
+	 *
+	 * \param[in] texture texture whose levels after \c TextureDesc#base are generated
+	 * \param[in] desc texture description
+	 * \return \c false if the format isn't supported or the queue is full
+	 */
+	bool add(WGPUTexture _NONNULL texture, const TextureDesc& desc);
+
+	/**
+	 * Records the queued textures into one compute pass, emptying the queue.
+	 *
+	 * \param[in] encoder encoder to record into
+	 */
+	void encode(WGPUCommandEncoder _NONNULL encoder);
+
+	/**
+	 * Records the queued textures into a new command buffer and submits it.
+	 *
+	 * \param[in] queue queue to submit to
+	 */
+	void submit(WGPUQueue _NONNULL queue);
+
+	/**
+	 * \return number of textures queued
+	 */
+	unsigned pending() const;
+
+private:
+	Generator(const Generator&);
+	Generator& operator =(const Generator&);
+
+	struct Impl;
+	Impl* _NONNULL impl;
+};
+
+#if MIPGEN_CHECK
+/**
+ * Generates the full chains of two test textures (one plain, one sRGB) then
+ * reads every level back, comparing it with the same filtering done on the
+ * CPU (within one step per channel). The readback is asynchronous, so the
+ * result is printed once the device has been ticked (e.g. by the frame loop).
+ *
+ * \param[in] device device to generate the mips with
+ * \param[in] queue queue to submit to
+ * \param[in] out destination for the result (open until it's printed)
+ */
+void check(WGPUDevice _NONNULL device, WGPUQueue _NONNULL queue, FILE* _NONNULL out = stdout);
+#endif
+}
@@ -0,0 +1,188 @@
+/**
+ * \file profile.h
+ * CPU zone and GPU pass timing, reported together per frame.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include <webgpu/webgpu.h>
+
+#include "defines.h"
+
+/**
+ * \def PROFILE_MAX_ZONES
+ * Maximum number of uniquely named CPU zones (and, separately, GPU passes).
+ */
+#ifndef PROFILE_MAX_ZONES
+#define PROFILE_MAX_ZONES 64
+#endif
+
+/**
+ * \def PROFILE_MAX_PASSES
+ * Maximum number of timed GPU passes per frame (further passes run untimed).
+ */
+#ifndef PROFILE_MAX_PASSES
+#define PROFILE_MAX_PASSES 16
+#endif
+
+/**
+ * \def PROFILE_TIMESTAMPS
+ * Set to request timestamp queries when creating the device. Dawn classes
+ * them as unsafe, so asking for them turns off its unsafe API guard for the
+ * whole device, hence only debug builds do by default (release builds
+ * timing each submission with the CPU fallback instead).
+ */
+#ifndef PROFILE_TIMESTAMPS
+#ifdef _DEBUG
+#define PROFILE_TIMESTAMPS 1
+#else
+#define PROFILE_TIMESTAMPS 0
+#endif
+#endif
+
+/**
+ * \def PROFILE_READBACK_RING
+ * Number of frames of GPU timings that can be in flight. When all are still
+ * waiting on readback the frame runs untimed (rather than stalling).
+ */
+#ifndef PROFILE_READBACK_RING
+#define PROFILE_READBACK_RING 4
+#endif
+
+namespace profile {
+/**
+ * Starts timing a CPU zone on the calling thread. Zones nest.
+ *
+ * \param[in] name zone name (compared by address, so must be a string literal or otherwise outlive the profiler)
+ * \param[in] wait \c true if the zone blocks on the display (acquiring or presenting the back buffer), which the CPU fallback leaves out of the GPU time
+ */
+void begin(const char* _NONNULL name, bool wait = false);
+
+/**
+ * Ends the innermost CPU zone started on the calling thread.
+ */
+void end();
+
+/**
+ * Helper to time a scope as a CPU zone.
+ */
+class Zone {
+public:
+	Zone(const char* _NONNULL name, bool wait = false) {
+		begin(name, wait);
+	}
+	~Zone() {
+		end();
+	}
+private:
+	Zone(const Zone&);
+	Zone& operator =(const Zone&);
+};
+
+/**
+ * Retrieves the CPU zones open on the calling thread. Safe to call from
+ * anywhere (it neither locks nor allocates).
+ *
+ * \param[out] names destination for the zone names, outermost first
+ * \param[in] max maximum number of names to write
+ * \return number of names written
+ */
+size_t zones(const char* _NULLABLE* _NONNULL names, size_t max);
+
+/**
+ * Creates the GPU timing resources. Timestamp queries are used if the device
+ * was created with \c WGPUFeatureName_TimestampQuery (see
+ * \c #PROFILE_TIMESTAMPS), otherwise the whole of each submission is timed
+ * from the CPU (from submit until the queue reports the work done). The work
+ * done callback only fires when the device is next ticked, after presenting,
+ * so any display waits in between (see \c #begin()) are taken off.
+ *
+ * \param[in] device device the timed passes will run on
+ */
+void init(WGPUDevice _NONNULL device);
+
+/**
+ * Frees the resources created in \c #init().
+ */
+void destroy();
+
+/**
+ * \return \c true if GPU passes are timed with timestamp queries (otherwise the CPU fallback is in use)
+ */
+bool hasTimestamps();
+
+/**
+ * Starts timing a GPU pass. Call on the encoder before beginning the pass.
+ *
+ * \param[in] encoder encoder the pass will be recorded with
+ * \param[in] name pass name (with the same lifetime requirements as \c #begin())
+ */
+void beginPass(WGPUCommandEncoder _NONNULL encoder, const char* _NONNULL name);
+
+/**
+ * Ends timing the current GPU pass. Call on the encoder after ending the pass.
+ *
+ * \param[in] encoder encoder the pass was recorded with
+ */
+void endPass(WGPUCommandEncoder _NONNULL encoder);
+
+/**
+ * Adds the commands to copy this frame's timestamps for readback. Call once
+ * per frame, after the last pass and before finishing \a encoder.
+ *
+ * \param[in] encoder encoder the timed passes were recorded with
+ */
+void resolve(WGPUCommandEncoder _NONNULL encoder);
+
+/**
+ * Starts the asynchronous readback of this frame's timings. Call once per
+ * frame, immediately after submitting.
+ *
+ * \param[in] queue queue the timed passes were submitted to
+ */
+void submitted(WGPUQueue _NONNULL queue);
+
+/**
+ * Marks the end of a frame, making its CPU zone totals (and the most recently
+ * read back GPU timings) available to \c #report().
+ */
+void frame();
+
+/**
+ * Single line of the report.
+ */
+struct Entry {
+	const char* name; ///< Zone or pass name
+	bool gpu;         ///< \c true if \c #ms is GPU time
+	unsigned calls;   ///< Number of times the zone or pass ran in the frame
+	double ms;        ///< Total time taken in the frame (in milliseconds)
+};
+
+/**
+ * Retrieves the last complete frame's timings.
+ *
+ * \param[out] entries destination for the report
+ * \param[in] max maximum number of entries to write
+ * \return number of entries written
+ */
+size_t report(Entry* _NONNULL entries, size_t max);
+
+/**
+ * \return wall-clock time between the last two calls to \c #frame() (in milliseconds)
+ */
+double frameTime();
+
+/**
+ * \return sum of the most recently read back GPU pass times (in milliseconds)
+ */
+double gpuTime();
+
+/**
+ * Prints the report as a table.
+ *
+ * \param[in] out destination stream
+ */
+void print(FILE* _NONNULL out = stdout);
+}
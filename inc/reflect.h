@@ -0,0 +1,109 @@
+/**
+ * \file reflect.h
+ * WGSL reflection. Shader source is scanned for its resource bindings, entry
+ * points and vertex inputs, from which bind group layouts and vertex buffer
+ * layouts are derived (instead of being declared by hand to match). Results
+ * are cached per source hash, and layouts come from the \c binding cache, so
+ * pipelines reflecting the same bindings share layouts (and so bind groups).
+ * \n
+ * Only declarations are read: structs, module-scope \c var (with \c @group
+ * and \c @binding), and entry point parameters (with \c @location); function
+ * bodies are skipped.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include <webgpu/webgpu.h>
+
+#include "defines.h"
+
+/**
+ * \def REFLECT_MAX_BINDINGS
+ * Maximum number of resource bindings per shader (and per merged layout).
+ */
+#ifndef REFLECT_MAX_BINDINGS
+#define REFLECT_MAX_BINDINGS 16
+#endif
+
+/**
+ * \def REFLECT_MAX_ATTRIBUTES
+ * Maximum number of vertex inputs per shader.
+ */
+#ifndef REFLECT_MAX_ATTRIBUTES
+#define REFLECT_MAX_ATTRIBUTES 16
+#endif
+
+/**
+ * \def REFLECT_MAX_GROUPS
+ * Maximum number of bind groups (WebGPU's default \c maxBindGroups limit).
+ */
+#ifndef REFLECT_MAX_GROUPS
+#define REFLECT_MAX_GROUPS 4
+#endif
+
+/**
+ * \def REFLECT_CACHE_SIZE
+ * Maximum number of reflected shaders held (once full, further shaders are
+ * reflected but not cached).
+ */
+#ifndef REFLECT_CACHE_SIZE
+#define REFLECT_CACHE_SIZE 64
+#endif
+
+namespace reflect {
+/**
+ * Resource binding.
+ */
+struct Binding {
+	uint32_t group;                 ///< Value of \c @group
+	WGPUBindGroupLayoutEntry entry; ///< Layout entry (\c visibility being the shader's stages)
+};
+
+/**
+ * Everything reflected from one shader.
+ */
+struct Shader {
+	uint64_t hash;                 ///< Hash of the source
+	WGPUShaderStageFlags stages;   ///< Stages of the entry points
+	Binding bindings[REFLECT_MAX_BINDINGS];
+	unsigned bindingCount;
+	WGPUVertexAttribute attributes[REFLECT_MAX_ATTRIBUTES]; ///< Vertex inputs, tightly packed in location order
+	unsigned attributeCount;
+	uint64_t stride;               ///< Size of all the vertex inputs
+};
+
+/**
+ * Reflects WGSL source, returning the cached result if already seen.
+ *
+ * \param[in] code WGSL source
+ * \return reflection (valid until \c #clear()), or \c null if the source couldn't be parsed
+ */
+const Shader* _NULLABLE shader(const char* _NONNULL code);
+
+/**
+ * Creates the bind group layouts for a pipeline built from \a shaders (merging
+ * bindings declared in more than one, with the visibility of each).
+ *
+ * \param[in] shaders reflected stages
+ * \param[in] count number of entries in \a shaders
+ * \param[out] layouts layouts for groups \c 0 to the return value (release with \c binding#release())
+ * \return number of groups (\c 0 if the bindings conflict or there are too many)
+ */
+unsigned layouts(const Shader* const* _NONNULL shaders, unsigned count,
+	WGPUBindGroupLayout _NULLABLE (&layouts)[REFLECT_MAX_GROUPS]);
+
+/**
+ * Vertex buffer layout with one attribute per vertex input.
+ *
+ * \param[in] shader reflected vertex stage
+ * \param[in] mode step mode
+ * \return layout (pointing at the attributes in \a shader)
+ */
+WGPUVertexBufferLayout vertexLayout(const Shader& shader, WGPUVertexStepMode mode = WGPUVertexStepMode_Vertex);
+
+/**
+ * Empties the cache (invalidating every \c Shader returned).
+ */
+void clear();
+}
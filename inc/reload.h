@@ -0,0 +1,115 @@
+/**
+ * \file reload.h
+ * Asset hot reloading. Source asset files are watched (with \c inotify on
+ * Linux, elsewhere by polling their modification times) and each one that
+ * changes is rebuilt on the watcher thread, alone, into the form the packer
+ * stores (see \c archive#build()). Rebuilt assets are handed to their
+ * handlers at the frame boundary, from \c #update(), which never waits on the
+ * watcher: a frame finding it busy leaves the hand over to the next.
+ * \n
+ * Handlers swap in the new GPU resources. Buffers whose size is unchanged are
+ * written in place (see \c #patch()), and pipelines can be rebuilt with
+ * \c wgpuDeviceCreateRenderPipelineAsync(), keeping the current one until
+ * (and unless) the new one is ready.
+ * \n
+ * Needs threads and a file system (so isn't available on Emscripten).
+ *
+ * \code
+ * reload::init("assets");
+ * reload::watch("cube.obj", reloadMesh, nullptr);
+ * ...
+ * // once per frame, before recording
+ * reload::update();
+ * \endcode
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <webgpu/webgpu.h>
+
+#include "archive.h"
+#include "defines.h"
+
+/**
+ * \def RELOAD_MAX_ASSETS
+ * Most assets watched at once.
+ */
+#ifndef RELOAD_MAX_ASSETS
+#define RELOAD_MAX_ASSETS 64
+#endif
+
+/**
+ * \def RELOAD_MAX_PATH
+ * Longest watched path (the root directory and asset name combined).
+ */
+#ifndef RELOAD_MAX_PATH
+#define RELOAD_MAX_PATH 260
+#endif
+
+/**
+ * \def RELOAD_POLL_MS
+ * Milliseconds between checks for changes (and for the watcher to stop).
+ */
+#ifndef RELOAD_POLL_MS
+#define RELOAD_POLL_MS 250
+#endif
+
+namespace reload {
+/**
+ * Rebuilt asset handler, called from \c #update() on the render thread.
+ *
+ * \param[in] blob the rebuilt asset (its \c name being as watched, its data only valid during the call)
+ * \param[in] user user data passed to \c #watch()
+ */
+typedef void (*Handler)(const archive::Blob& blob, void* _NULLABLE user);
+
+/**
+ * Starts the watcher thread.
+ *
+ * \param[in] root directory the watched asset names are relative to
+ * \return \c false if \a root can't be watched (or without threads)
+ */
+bool init(const char* _NONNULL root);
+
+/**
+ * Stops the watcher thread, dropping any rebuilt assets not yet handed over.
+ */
+void destroy();
+
+/**
+ * Watches an asset for changes.
+ *
+ * \param[in] name asset path relative to the root (as packed, see \c archive#find())
+ * \param[in] handler called with each rebuild
+ * \param[in] user user data passed to \a handler
+ * \return \c false if not started or too many assets are watched
+ */
+bool watch(const char* _NONNULL name, Handler _NONNULL handler, void* _NULLABLE user = nullptr);
+
+/**
+ * Hands the assets rebuilt since the last call to their handlers (skipping,
+ * rather than waiting, if the watcher is mid hand over).
+ *
+ * \return number of assets handed over
+ */
+unsigned update();
+
+/**
+ * Replaces a buffer's contents, writing in place if the size is unchanged,
+ * otherwise creating a new buffer (the old one being released, so freed once
+ * any commands using it are done).
+ *
+ * \param[in] device device to create a new buffer with
+ * \param[in] queue queue to write with
+ * \param[in] buffer current buffer (created with \c CopyDst usage)
+ * \param[in,out] size current size of \a buffer in bytes (updated if a new buffer is created)
+ * \param[in] data new contents
+ * \param[in] bytes size of \a data in bytes (a multiple of four)
+ * \param[in] usage usage for a new buffer (\c CopyDst is added)
+ * \return \a buffer if written in place, otherwise the new buffer
+ */
+WGPUBuffer _NONNULL patch(WGPUDevice _NONNULL device, WGPUQueue _NONNULL queue, WGPUBuffer _NONNULL buffer, uint64_t& size,
+	const void* _NONNULL data, uint64_t bytes, WGPUBufferUsageFlags usage);
+}
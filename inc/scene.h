@@ -0,0 +1,145 @@
+/**
+ * \file scene.h
+ * Transform hierarchy. Nodes are stored as structure-of-arrays sorted by
+ * depth, so every parent comes before its children and world transforms are
+ * propagated in one linear pass. Only nodes whose local transform was set,
+ * and their descendants, are recomputed (the pass starting from the first
+ * such node, and skipped entirely when nothing moved).
+ * \n
+ * World matrices are contiguous, in node order, ready to be packed into an
+ * instance buffer (see \c instance#pack()), with \c Graph#changed() giving
+ * the range the last update touched. Structural changes are batched: added nodes go on the end
+ * (only needing a re-sort if shallower than the last node) and removed nodes
+ * are compacted out, both on the next update.
+ *
+ * \code
+ * scene::Graph graph;
+ * scene::Node body = graph.add();
+ * scene::Node arm  = graph.add(body, translate(vec3(1.0f, 0.0f, 0.0f)));
+ * ...
+ * graph.set(body, rotate(angle, vec3(0.0f, 1.0f, 0.0f)));
+ * graph.update();
+ * unsigned first, count;
+ * if (graph.changed(first, count)) {
+ *	// on the simulation thread, so into the snapshot's arena
+ *	snap->first  = first;
+ *	snap->count  = count;
+ *	snap->packed = arena::snapshot().alloc<instance::Instance>(count);
+ *	instance::pack(graph.worlds() + first, snap->packed, count);
+ * }
+ * ...
+ * // then on the render thread
+ * wgpuQueueWriteBuffer(queue, instBuf, snap->first * sizeof(instance::Instance), snap->packed, snap->count * sizeof(instance::Instance));
+ * \endcode
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+
+#include "defines.h"
+
+/**
+ * \def SCENE_MAX_NODES
+ * Default node capacity of a \c scene#Graph.
+ */
+#ifndef SCENE_MAX_NODES
+#define SCENE_MAX_NODES 65536
+#endif
+
+namespace scene {
+/**
+ * Node handle (stable for the node's lifetime, unlike its position in the
+ * world matrices).
+ */
+typedef uint32_t Node;
+
+/**
+ * No node (the parent of root nodes, or returned when full).
+ */
+const Node NONE = 0xFFFFFFFF;
+
+/**
+ * Node hierarchy and its world transforms (not thread safe).
+ */
+class Graph {
+public:
+	/**
+	 * \param[in] capacity most nodes the graph can hold
+	 */
+	Graph(unsigned capacity = SCENE_MAX_NODES);
+	~Graph();
+
+	/**
+	 * Adds a node (its world transform being valid after the next update).
+	 *
+	 * \param[in] parent parent node (or \c #NONE for a root)
+	 * \param[in] local transform relative to \a parent
+	 * \return the new node (or \c #NONE if full)
+	 */
+	Node add(Node parent = NONE, const glm::mat4& local = glm::mat4(1.0f));
+
+	/**
+	 * Removes a node and its descendants (on the next update, their handles
+	 * then being reused).
+	 */
+	void remove(Node node);
+
+	/**
+	 * Sets a node's local transform, marking it (and so its descendants) for
+	 * recomputing.
+	 */
+	void set(Node node, const glm::mat4& local);
+
+	/**
+	 * \return the node's local transform
+	 */
+	const glm::mat4& local(Node node) const;
+
+	/**
+	 * \return the node's world transform (as of the last update)
+	 */
+	const glm::mat4& world(Node node) const;
+
+	/**
+	 * Applies any structural changes then propagates the world transforms of
+	 * the marked nodes to their descendants.
+	 *
+	 * \return number of world transforms recomputed
+	 */
+	unsigned update();
+
+	/**
+	 * \return the world transforms, in node order (see \c #index())
+	 */
+	const glm::mat4* _NONNULL worlds() const;
+
+	/**
+	 * \return number of nodes (and world transforms)
+	 */
+	unsigned size() const;
+
+	/**
+	 * \return position of the node's world transform in \c #worlds() (valid until the next structural change)
+	 */
+	unsigned index(Node node) const;
+
+	/**
+	 * Range of \c #worlds() recomputed by the last update (which may include
+	 * unchanged transforms between those recomputed).
+	 *
+	 * \param[out] first position of the first recomputed transform
+	 * \param[out] count number of transforms from \a first
+	 * \return \c false if nothing was recomputed
+	 */
+	bool changed(unsigned& first, unsigned& count) const;
+
+private:
+	Graph(const Graph&);
+	Graph& operator =(const Graph&);
+
+	struct Impl;
+	Impl* _NONNULL impl;
+};
+}
@@ -0,0 +1,140 @@
+/**
+ * \file shader.h
+ * WGSL shader variants. A shader's source is written once with feature flags;
+ * each combination of flags requested gets its own specialised shader, built
+ * only on first request and shared between requests producing the same code.
+ * \n
+ * Flags are specialised one of two ways:
+ * - \e constant flags become WGSL \c override constants, set per pipeline
+ *   (so flipping them needs no new module, the compiler folding away the
+ *   unused branches when the pipeline is created), used as plain \c bool
+ *   values in the code (e.g. \c if \c (FLAG) \c {...})
+ * - \e source flags select lines between \c //\#if \c FLAG (or
+ *   \c //\#if \c !FLAG), \c //\#else and \c //\#endif, for anything constants
+ *   can't express (such as different bindings or entry point signatures)
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include <webgpu/webgpu.h>
+
+#include "defines.h"
+
+/**
+ * \def SHADER_MAX_FLAGS
+ * Maximum number of flags per shader (limited to the bits in \c shader#Features).
+ */
+#ifndef SHADER_MAX_FLAGS
+#define SHADER_MAX_FLAGS 32
+#endif
+
+/**
+ * \def SHADER_MAX_VARIANTS
+ * Maximum number of variants (and, separately, compiled modules) per library.
+ */
+#ifndef SHADER_MAX_VARIANTS
+#define SHADER_MAX_VARIANTS 128
+#endif
+
+/**
+ * \def SHADER_OVERRIDES
+ * Set if \e constant flags are passed as WGSL \c override constants (clear
+ * to specialise them in the source too, for implementations without
+ * pipeline-overridable constants).
+ */
+#ifndef SHADER_OVERRIDES
+#define SHADER_OVERRIDES 1
+#endif
+
+namespace shader {
+/**
+ * \typedef Features
+ * Set of flags, bit \e n being the \e n th entry in \c Source#flags.
+ */
+typedef uint32_t Features;
+
+/**
+ * Feature flag.
+ */
+struct Flag {
+	const char* _NONNULL name; ///< Name used in the WGSL
+	bool constant;             ///< \c true for an \c override constant, \c false for a source flag
+};
+
+/**
+ * Shader source and its flags.
+ */
+struct Source {
+	const char* _NONNULL code;  ///< WGSL (without declarations for the \e constant flags, which are added)
+	const Flag* _NULLABLE flags;
+	unsigned flagCount;
+	const char* _NULLABLE label; ///< Optional name (for the compiled modules)
+};
+
+/**
+ * Everything needed to use a variant in a pipeline's vertex, fragment or
+ * compute state (valid for the lifetime of the \c Library).
+ */
+struct Variant {
+	WGPUShaderModule _NULLABLE module;       ///< Module (\c null if compiling failed)
+	const WGPUConstantEntry* _NULLABLE constants; ///< Values for the \e constant flags
+	uint32_t constantCount;
+};
+
+/**
+ * Library counters.
+ */
+struct Stats {
+	unsigned requests; ///< Calls to \c Library#get()
+	unsigned variants; ///< Distinct variants (source plus relevant flags)
+	unsigned modules;  ///< Modules compiled (after folding identical source)
+};
+
+/**
+ * Writes the source-specialised WGSL for a variant.
+ *
+ * \param[in] source shader source
+ * \param[in] features requested flags
+ * \param[out] out destination (or \c null to query the size)
+ * \param[in] size bytes available in \a out
+ * \return bytes needed (including the terminator)
+ */
+size_t specialise(const Source& source, Features features, char* _NULLABLE out, size_t size);
+
+/**
+ * Lazily built variants of any number of shaders.
+ */
+class Library {
+public:
+	/**
+	 * \param[in] device device to compile modules with
+	 */
+	Library(WGPUDevice _NONNULL device);
+	~Library();
+
+	/**
+	 * Gets the variant of \a source for \a features, compiling it on first
+	 * request. Flags the source doesn't use (and, with \c #SHADER_OVERRIDES,
+	 * the \e constant flags) don't make a new module, and neither do flags
+	 * producing the same code as an existing module.
+	 *
+	 * \param[in] source shader source (identified by address, so needs to outlive the library)
+	 * \param[in] features requested flags
+	 * \return the variant
+	 */
+	Variant get(const Source& source, Features features);
+
+	/**
+	 * \return library counters
+	 */
+	const Stats& stats() const;
+
+private:
+	Library(const Library&);
+	Library& operator =(const Library&);
+
+	struct Impl;
+	Impl* _NONNULL impl;
+};
+}
@@ -0,0 +1,92 @@
+/**
+ * \file spin.h
+ * GPU instance animation. Each instance's rotation, position, scale and
+ * angular velocity live in a storage buffer, written once, and a compute pass
+ * integrates the rotations in place every frame, writing each instance (in
+ * the compact format of \c instance.h) for the vertex shader to read. The
+ * only per-frame upload is the time step, so spinning any number of
+ * instances costs the CPU nothing per instance.
+ *
+ * \code
+ * spin::Animator animator(device, count);
+ * animator.write(queue, states, 0, count);
+ * ...
+ * // once per frame, before the passes drawing the instances
+ * animator.encode(queue, encoder, delta);
+ * \endcode
+ */
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "defines.h"
+#include "instance.h"
+
+namespace spin {
+/**
+ * Instance animation state (laid out as the compute shader's \c State).
+ */
+struct State {
+	glm::quat rotation; ///< Current rotation
+	glm::vec3 position;
+	float scale;        ///< Uniform scale
+	glm::vec3 axis;     ///< Unit rotation axis
+	float speed;        ///< Radians per second
+};
+
+/**
+ * Instance states and the compute pass animating them.
+ */
+class Animator {
+public:
+	/**
+	 * \param[in] device device to create the buffers and pipeline with
+	 * \param[in] capacity most instances animated
+	 */
+	Animator(WGPUDevice _NONNULL device, unsigned capacity);
+	~Animator();
+
+	/**
+	 * Sets instance states (the instances animated running up to the last
+	 * one written).
+	 *
+	 * \param[in] queue queue to write with
+	 * \param[in] states new states
+	 * \param[in] first index of the first instance to set
+	 * \param[in] count number of entries in \a states
+	 * \return \c false if the instances are out of range
+	 */
+	bool write(WGPUQueue _NONNULL queue, const State* _NONNULL states, unsigned first, unsigned count);
+
+	/**
+	 * Records the compute pass advancing the instances by \a delta, writing
+	 * their transforms. Call once per submission (the step being written
+	 * to the same uniform every time).
+	 *
+	 * \param[in] queue queue to write the time step with
+	 * \param[in] encoder encoder to record into
+	 * \param[in] delta seconds to advance by
+	 */
+	void encode(WGPUQueue _NONNULL queue, WGPUCommandEncoder _NONNULL encoder, float delta);
+
+	/**
+	 * \return storage buffer of each instance's transform (an array of \c instance#Instance)
+	 */
+	WGPUBuffer _NONNULL instances() const;
+
+	/**
+	 * \return number of instances animated
+	 */
+	unsigned size() const;
+
+private:
+	Animator(const Animator&);
+	Animator& operator =(const Animator&);
+
+	struct Impl;
+	Impl* _NONNULL impl;
+};
+}
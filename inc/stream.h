@@ -0,0 +1,211 @@
+/**
+ * \file stream.h
+ * Texture streaming. Each texture has a full mip chain but only the levels
+ * needed for its projected size on screen are resident: the coarsest levels
+ * (the tail) are loaded up front, finer ones are read in the background as
+ * they're requested then uploaded at the frame boundary, and under a memory
+ * budget the least recently needed levels are dropped again.
+ * \n
+ * WebGPU has no sparse textures, so the GPU texture only ever holds the
+ * resident levels: raising or lowering the residency reallocates it at the
+ * new size, copying the levels kept on the GPU (which is what bounds the
+ * memory). The texture's view therefore changes with its residency, so bind
+ * groups using it should be looked up per frame (see \c binding#group()).
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <webgpu/webgpu.h>
+
+#include "defines.h"
+
+/**
+ * \def STREAM_BUDGET_MB
+ * Default GPU memory budget for the streamed textures (in megabytes).
+ */
+#ifndef STREAM_BUDGET_MB
+#define STREAM_BUDGET_MB 256
+#endif
+
+/**
+ * \def STREAM_TAIL_SIZE
+ * Levels this size or smaller (in texels, along the longest side) are always
+ * resident, so there's always something to sample.
+ */
+#ifndef STREAM_TAIL_SIZE
+#define STREAM_TAIL_SIZE 64
+#endif
+
+/**
+ * \def STREAM_MAX_LOADS
+ * Level loads in flight at once (each holding a staging buffer).
+ */
+#ifndef STREAM_MAX_LOADS
+#define STREAM_MAX_LOADS 4
+#endif
+
+/**
+ * \def STREAM_UPLOAD_BYTES
+ * Most bytes uploaded per frame (spreading large uploads over frames rather
+ * than hitching; a single level is always allowed).
+ */
+#ifndef STREAM_UPLOAD_BYTES
+#define STREAM_UPLOAD_BYTES (8 * 1024 * 1024)
+#endif
+
+/**
+ * \def STREAM_LOD_BIAS
+ * Added to the level picked from the projected size (positive values favour
+ * memory over sharpness).
+ */
+#ifndef STREAM_LOD_BIAS
+#define STREAM_LOD_BIAS 0.0f
+#endif
+
+/**
+ * \def STREAM_CHECK
+ * Set to build \c stream#check() (and run it at startup).
+ */
+#ifndef STREAM_CHECK
+#define STREAM_CHECK 0
+#endif
+
+namespace stream {
+/**
+ * Reads one mip level. Rows are tightly packed (rows of blocks for compressed
+ * formats). Called on the loading thread (or, without threads, from
+ * \c #update()) so must only touch the loader's own state.
+ *
+ * \param[in] level mip level (zero being the full size)
+ * \param[out] dst destination for the level's texels
+ * \param[in] size size of the level in bytes
+ * \param[in] user user data from the \c TextureDesc
+ * \return \c true if the level was read (failures leave the level unloaded)
+ */
+typedef bool (*Loader)(unsigned level, void* _NONNULL dst, size_t size, void* _NULLABLE user);
+
+/**
+ * Streamed texture description.
+ */
+struct TextureDesc {
+	const char* label;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levels;  ///< Mip levels (zero for the full chain)
+	WGPUTextureFormat format;
+	Loader _NULLABLE load; ///< Level reader
+	void* _NULLABLE user;  ///< Passed to \c #load
+};
+
+/**
+ * Streaming counters (lifetime totals plus what's currently held).
+ */
+struct Stats {
+	unsigned long long loads;     ///< Levels loaded
+	unsigned long long failures;  ///< Levels the loader failed to read
+	unsigned long long evictions; ///< Levels dropped to stay within the budget
+	unsigned long long uploaded;  ///< Bytes uploaded
+	unsigned textures;  ///< Live textures
+	size_t resident;    ///< Bytes of resident levels
+	size_t budget;      ///< Budget in bytes
+};
+
+/**
+ * Opaque streamed texture.
+ */
+typedef struct TextureImpl* Texture;
+
+/**
+ * Sets the device textures are created with and starts the loading thread.
+ *
+ * \param[in] device device to create textures with
+ * \param[in] budget GPU memory budget in bytes (zero for \c #STREAM_BUDGET_MB)
+ */
+void init(WGPUDevice _NONNULL device, size_t budget = 0);
+
+/**
+ * Stops the loading thread and releases every texture.
+ */
+void destroy();
+
+/**
+ * Creates a streamed texture, loading its tail straight away (so it can be
+ * bound immediately). Textures are sampled with the \c TextureBinding usage
+ * and can be copied from.
+ *
+ * \param[in] desc texture description
+ * \return new texture (or \c null if the format isn't supported)
+ */
+Texture create(const TextureDesc& desc);
+
+/**
+ * Releases a texture (once any of its loads in flight have returned).
+ *
+ * \param[in] tex texture to release
+ */
+void release(Texture _NONNULL tex);
+
+/**
+ * Requests the levels needed to draw \a tex at \a texels on screen this frame
+ * (the projected size of its longest side, in pixels). Called from the render
+ * thread, any number of times per frame (the largest request wins).
+ *
+ * \param[in] tex texture being drawn
+ * \param[in] texels projected size in pixels
+ */
+void request(Texture _NONNULL tex, float texels);
+
+/**
+ * Frame boundary work, called once per frame on the render thread before
+ * recording: uploads finished loads, drops levels if over budget, and starts
+ * loading the levels requested last frame.
+ */
+void update();
+
+/**
+ * \return the view of the resident levels (valid until the next \c #update())
+ */
+WGPUTextureView view(Texture _NONNULL tex);
+
+/**
+ * \return the finest resident level (zero being full size)
+ */
+unsigned resident(Texture _NONNULL tex);
+
+/**
+ * Sets the GPU memory budget (lowering it drops levels on the next update).
+ *
+ * \param[in] bytes budget in bytes
+ */
+void budget(size_t bytes);
+
+/**
+ * \return streaming counters
+ */
+Stats stats();
+
+/**
+ * Prints the streaming counters.
+ *
+ * \param[in] out destination stream
+ */
+void print(FILE* _NONNULL out = stdout);
+
+#if STREAM_CHECK
+/**
+ * Streams a test texture in to full residency then evicts it back to its
+ * tail (under a budget only fitting the tail), checking the residency, the
+ * evictions and that a bind group made for each superseded view was dropped
+ * from the cache (see \c binding#invalidate()). The fully resident levels are
+ * read back and compared with what was loaded, which is printed once the
+ * device has been ticked (e.g. by the frame loop). Called after \c #init()
+ * and before any other textures are created.
+ *
+ * \param[in] out destination for the result (open until it's printed)
+ */
+void check(FILE* _NONNULL out = stdout);
+#endif
+}
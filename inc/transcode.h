@@ -0,0 +1,228 @@
+/**
+ * \file transcode.h
+ * Texture transcoder. Textures are stored once, in a universal intermediate
+ * file (a mip chain of delta filtered, LZ compressed RGBA8 levels), then at
+ * load time transcoded into whichever block compressed format the device
+ * supports: BC1, BC3 or BC7 (mode 6) on desktop, ETC2 or ASTC 4x4 on mobile,
+ * falling back to plain RGBA8.
+ * \n
+ * The encoders are single pass (endpoints fitted along the principal axis of
+ * each block, with the projections done with SSE2 where available), trading
+ * some quality for speed, and the block rows of each level are spread over
+ * the worker threads (see \c jobs#parallel()).
+ * \n
+ * \code
+ * transcode::Image image;
+ * if (transcode::open(fileData, fileSize, image)) {
+ *	transcode::Source* src = new transcode::Source(image, transcode::pick(device, image.alpha, image.srgb));
+ *	stream::TextureDesc desc = {};
+ *	transcode::describe(*src, desc);
+ *	stream::Texture tex = stream::create(desc);
+ *	...
+ * }
+ * \endcode
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <webgpu/webgpu.h>
+
+#include "defines.h"
+#include "stream.h"
+
+/**
+ * \def TRANSCODE_MAGIC
+ * Universal texture file identifier (\c UTX1 when read as bytes).
+ */
+#ifndef TRANSCODE_MAGIC
+#define TRANSCODE_MAGIC 0x31585455
+#endif
+
+/**
+ * \def TRANSCODE_MAX_LEVELS
+ * Most mip levels in a universal texture file.
+ */
+#ifndef TRANSCODE_MAX_LEVELS
+#define TRANSCODE_MAX_LEVELS 16
+#endif
+
+/**
+ * \def TRANSCODE_CHECK
+ * Set to build \c transcode#check() (and run it at startup).
+ */
+#ifndef TRANSCODE_CHECK
+#define TRANSCODE_CHECK 0
+#endif
+
+/**
+ * \def TRANSCODE_CHECK_PSNR
+ * Lowest PSNR (in dB) \c transcode#check() accepts for each format.
+ */
+#ifndef TRANSCODE_CHECK_PSNR
+#define TRANSCODE_CHECK_PSNR 26.0
+#endif
+
+namespace transcode {
+/**
+ * Universal texture file header, followed by the level table then the packed
+ * levels (all little-endian).
+ */
+struct Header {
+	uint32_t magic;  ///< \c #TRANSCODE_MAGIC
+	uint32_t width;
+	uint32_t height;
+	uint16_t levels;
+	uint16_t flags;  ///< \c #FLAG_SRGB and \c #FLAG_ALPHA
+};
+
+/**
+ * Level table entry.
+ */
+struct Level {
+	uint32_t offset; ///< Start of the packed level (from the start of the file)
+	uint32_t packed; ///< Packed size in bytes
+};
+
+/**
+ * Colour data is sRGB encoded.
+ */
+const uint16_t FLAG_SRGB  = 1;
+/**
+ * Alpha isn't fully opaque (so needs a format with alpha).
+ */
+const uint16_t FLAG_ALPHA = 2;
+
+/**
+ * Opened universal texture (pointing into the caller's file data).
+ */
+struct Image {
+	const uint8_t* _NULLABLE data;
+	size_t size;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levels;
+	bool srgb;
+	bool alpha;
+};
+
+/**
+ * Opens a universal texture file, validating the header and level table.
+ *
+ * \param[in] data file contents (which must outlive the image)
+ * \param[in] size size of \a data in bytes
+ * \param[out] image opened image
+ * \return \c true if the file is valid
+ */
+bool open(const void* _NONNULL data, size_t size, Image& image);
+
+/**
+ * Picks the compressed format the device best supports (enabled when the
+ * device was created), otherwise RGBA8.
+ *
+ * \param[in] device device the textures will be created with
+ * \param[in] alpha \c true if the format needs alpha
+ * \param[in] srgb \c true for an sRGB format
+ * \return format to transcode to
+ */
+WGPUTextureFormat pick(WGPUDevice _NONNULL device, bool alpha, bool srgb);
+
+/**
+ * \return size in bytes of a \a width by \a height level in \a format (or zero if not a transcoder format)
+ */
+size_t bytes(uint32_t width, uint32_t height, WGPUTextureFormat format);
+
+/**
+ * Unpacks a level to RGBA8.
+ *
+ * \param[in] image opened image
+ * \param[in] level mip level
+ * \param[out] rgba destination (four bytes per texel of the level)
+ * \return \c true if the level unpacked (\c false if corrupt)
+ */
+bool decode(const Image& image, unsigned level, uint8_t* _NONNULL rgba);
+
+/**
+ * Encodes RGBA8 texels to \a format, as rows of blocks (edge blocks being
+ * padded by repeating the last row and column).
+ *
+ * \param[in] rgba source texels
+ * \param[in] width width in texels
+ * \param[in] height height in texels
+ * \param[in] format any format \c #pick() returns
+ * \param[out] dst destination (\c #bytes() in size)
+ * \return \c false if \a format isn't supported
+ */
+bool encode(const uint8_t* _NONNULL rgba, uint32_t width, uint32_t height, WGPUTextureFormat format, void* _NONNULL dst);
+
+/**
+ * \return worst case size of the universal file \c #pack() writes
+ */
+size_t bound(uint32_t width, uint32_t height);
+
+/**
+ * Writes a universal texture file for an RGBA8 image, building its full mip
+ * chain (box filtered, in linear space for sRGB). For asset tools rather
+ * than at runtime.
+ *
+ * \param[in] rgba level zero texels
+ * \param[in] width width in texels
+ * \param[in] height height in texels
+ * \param[in] srgb \c true if \a rgba is sRGB encoded
+ * \param[out] dst destination
+ * \param[in] capacity size of \a dst in bytes (at least \c #bound())
+ * \return bytes written (zero on failure)
+ */
+size_t pack(const uint8_t* _NONNULL rgba, uint32_t width, uint32_t height, bool srgb, void* _NONNULL dst, size_t capacity);
+
+/**
+ * Streaming source for a universal texture, transcoding each level as it's
+ * loaded (see \c stream#Loader). Only one thread may load from a source.
+ */
+struct Source {
+	/**
+	 * \param[in] image opened image
+	 * \param[in] format format to transcode to (see \c #pick())
+	 */
+	Source(const Image& image, WGPUTextureFormat format);
+	~Source();
+
+	Image image;
+	WGPUTextureFormat format;
+	uint8_t* _NULLABLE scratch; ///< Unpacked level (grown as needed)
+	size_t capacity;
+
+private:
+	Source(const Source&);
+	Source& operator =(const Source&);
+};
+
+/**
+ * Streaming loader for a \c Source (passed as the user data).
+ */
+bool load(unsigned level, void* _NONNULL dst, size_t size, void* _NULLABLE user);
+
+/**
+ * Fills in a streamed texture description from a source.
+ *
+ * \param[in] src source (which must outlive the texture)
+ * \param[out] desc description loading from \a src
+ */
+void describe(Source& src, stream::TextureDesc& desc);
+
+#if TRANSCODE_CHECK
+/**
+ * Round trips a generated image: through \c #pack(), \c #open() and
+ * \c #decode() (which must give back level zero exactly), then through every
+ * block encoder. The blocks are decoded following the format specs (for the
+ * modes the encoders emit, any other mode failing), not by inverting the
+ * encoders, and compared with the source.
+ *
+ * \param[in] out destination for each format's PSNR
+ * \return \c true if every format is within \c #TRANSCODE_CHECK_PSNR
+ */
+bool check(FILE* _NONNULL out = stdout);
+#endif
+}
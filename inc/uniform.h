@@ -0,0 +1,240 @@
+/**
+ * \file uniform.h
+ * Uniform blocks declared once for both C++ and WGSL. A block is a list of
+ * fields given as an X-macro, from which \c #UNIFORM_BLOCK defines the C++
+ * struct (each member aligned as WGSL would) and \c #UNIFORM_WGSL the WGSL
+ * struct text. The WGSL offsets are computed at compile time from the WGSL
+ * layout rules, with a \c static_assert for any C++ member not matching.
+ * \n
+ * \code
+ * #define UNIFORM_LIGHT(FIELD) \
+ *	FIELD(vec3, direction) \
+ *	FIELD(f32,  intensity)
+ * UNIFORM_BLOCK(Light, UNIFORM_LIGHT)
+ *
+ * static char const shader_wgsl[] = UNIFORM_WGSL(Light, UNIFORM_LIGHT) R"(
+ *	@group(0) @binding(0) var<uniform> uLight : Light;
+ *	...
+ * )";
+ * \endcode
+ * Blocks are then packed into shared buffers (see \c uniform#Buffer).
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+
+#include <webgpu/webgpu.h>
+
+#include "defines.h"
+
+/**
+ * \def UNIFORM_OFFSET_ALIGNMENT
+ * Alignment of each block in a shared buffer (WebGPU's default
+ * \c minUniformBufferOffsetAlignment limit).
+ */
+#ifndef UNIFORM_OFFSET_ALIGNMENT
+#define UNIFORM_OFFSET_ALIGNMENT 256
+#endif
+
+namespace uniform {
+/**
+ * \return \a value rounded up to a multiple of \a align
+ */
+constexpr size_t roundUp(size_t value, size_t align) {
+	return (value + align - 1) / align * align;
+}
+
+/**
+ * Field types, each with the C++ type and the WGSL size and alignment for the
+ * \c uniform address space (the C++ type is checked to be the same size).
+ */
+struct f32    { typedef float      type; static const size_t size =  4; static const size_t align =  4; };
+struct i32    { typedef int32_t    type; static const size_t size =  4; static const size_t align =  4; };
+struct u32    { typedef uint32_t   type; static const size_t size =  4; static const size_t align =  4; };
+struct vec2   { typedef glm::vec2  type; static const size_t size =  8; static const size_t align =  8; };
+struct vec3   { typedef glm::vec3  type; static const size_t size = 12; static const size_t align = 16; };
+struct vec4   { typedef glm::vec4  type; static const size_t size = 16; static const size_t align = 16; };
+struct mat4x4 { typedef glm::mat4  type; static const size_t size = 64; static const size_t align = 16; };
+
+/**
+ * Marks the end of a \c Layout's fields.
+ */
+struct End {};
+
+/**
+ * WGSL layout of a struct with the fields \a T (terminated by \c End).
+ */
+template<typename... T>
+struct Layout;
+
+template<>
+struct Layout<End> {
+	static constexpr size_t offset(size_t /*field*/, size_t at) {
+		return at;
+	}
+	static constexpr size_t end(size_t at) {
+		return at;
+	}
+	static constexpr size_t align() {
+		return 1;
+	}
+};
+
+template<typename Head, typename... Tail>
+struct Layout<Head, Tail...> {
+	/**
+	 * \param[in] field index of the field
+	 * \param[in] at offset the fields start from
+	 * \return offset of \a field
+	 */
+	static constexpr size_t offset(size_t field, size_t at = 0) {
+		return (field == 0) ? roundUp(at, Head::align)
+			: Layout<Tail...>::offset(field - 1, roundUp(at, Head::align) + Head::size);
+	}
+	/**
+	 * \return offset after the last field (before any padding)
+	 */
+	static constexpr size_t end(size_t at = 0) {
+		return Layout<Tail...>::end(roundUp(at, Head::align) + Head::size);
+	}
+	/**
+	 * \return the struct's alignment (its largest field alignment)
+	 */
+	static constexpr size_t align() {
+		return (Head::align > Layout<Tail...>::align()) ? Head::align : Layout<Tail...>::align();
+	}
+	/**
+	 * \return the struct's size (padded to its alignment)
+	 */
+	static constexpr size_t size() {
+		return roundUp(end(), align());
+	}
+};
+
+/**
+ * Location of a block in a \c Buffer.
+ */
+struct Slot {
+	uint64_t offset; ///< Offset in the buffer (for \c WGPUBindGroupEntry#offset)
+	uint64_t size;   ///< Block size (for \c WGPUBindGroupEntry#size), \c 0 if the slot couldn't be added
+};
+
+/**
+ * Uniform buffer shared by any number of blocks. Blocks are added up front,
+ * after which the GPU buffer is created to fit; writes go to a CPU copy, the
+ * changed range being uploaded in a single write per \c #flush().
+ */
+class Buffer {
+public:
+	/**
+	 * \param[in] device device to create the buffer with
+	 */
+	Buffer(WGPUDevice _NONNULL device);
+	~Buffer();
+
+	/**
+	 * Adds space for a block of type \a T (initially zeroed).
+	 *
+	 * \return the block's location (with a zero size if the buffer was already created)
+	 */
+	template<typename T>
+	Slot add() {
+		return add(sizeof(T));
+	}
+
+	/**
+	 * Adds space for a block.
+	 *
+	 * \param[in] size bytes required
+	 * \return the block's location (with a zero size if the buffer was already created)
+	 */
+	Slot add(size_t size);
+
+	/**
+	 * Copies \a value into the block at \a slot.
+	 */
+	template<typename T>
+	void write(const Slot& slot, const T& value) {
+		write(slot, &value, sizeof(T));
+	}
+
+	/**
+	 * Copies \a size bytes of \a data into the block at \a slot.
+	 */
+	void write(const Slot& slot, const void* _NONNULL data, size_t size);
+
+	/**
+	 * Uploads everything written since the last flush.
+	 *
+	 * \param[in] queue queue to write the buffer with
+	 */
+	void flush(WGPUQueue _NONNULL queue);
+
+	/**
+	 * \return the GPU buffer (created on the first call, after which no more blocks can be added)
+	 */
+	WGPUBuffer buffer();
+
+private:
+	Buffer(const Buffer&);
+	Buffer& operator =(const Buffer&);
+
+	struct Impl;
+	Impl* _NONNULL impl;
+};
+}
+
+/*
+ * Expansions of the fields for each part of a block.
+ */
+#define UNIFORM_IMPL_MEMBER(T, name) alignas(uniform::T::align) uniform::T::type name;
+#define UNIFORM_IMPL_TYPE(T, name) uniform::T,
+#define UNIFORM_IMPL_INDEX(T, name) name##_field,
+#define UNIFORM_IMPL_CHECK(T, name) \
+	static_assert(sizeof(uniform::T::type) == uniform::T::size, \
+		"C++ type size differs from WGSL for: " #name); \
+	static_assert(offsetof(Self, name) == Layout::offset(name##_field), \
+		"C++ offset differs from WGSL for: " #name);
+#define UNIFORM_IMPL_WGSL(T, name) "\t" #name " : " UNIFORM_IMPL_WGSL_##T ";\n"
+#define UNIFORM_IMPL_WGSL_f32    "f32"
+#define UNIFORM_IMPL_WGSL_i32    "i32"
+#define UNIFORM_IMPL_WGSL_u32    "u32"
+#define UNIFORM_IMPL_WGSL_vec2   "vec2<f32>"
+#define UNIFORM_IMPL_WGSL_vec3   "vec3<f32>"
+#define UNIFORM_IMPL_WGSL_vec4   "vec4<f32>"
+#define UNIFORM_IMPL_WGSL_mat4x4 "mat4x4<f32>"
+
+/**
+ * \def UNIFORM_WGSL
+ * WGSL struct declaration (as a string literal) for a block.
+ *
+ * \param Name struct name
+ * \param FIELDS X-macro taking a \c FIELD(type, name) macro, listing the fields
+ */
+#define UNIFORM_WGSL(Name, FIELDS) "struct " #Name " {\n" FIELDS(UNIFORM_IMPL_WGSL) "};\n"
+
+/**
+ * \def UNIFORM_BLOCK
+ * Defines the C++ struct for a block, checked against its WGSL layout.
+ *
+ * \param Name struct name
+ * \param FIELDS X-macro taking a \c FIELD(type, name) macro, listing the fields
+ */
+#define UNIFORM_BLOCK(Name, FIELDS) \
+	struct Name { \
+		FIELDS(UNIFORM_IMPL_MEMBER) \
+		typedef uniform::Layout<FIELDS(UNIFORM_IMPL_TYPE) uniform::End> Layout; \
+		static const char* wgsl() { \
+			return UNIFORM_WGSL(Name, FIELDS); \
+		} \
+	private: \
+		typedef Name Self; \
+		enum Field { FIELDS(UNIFORM_IMPL_INDEX) }; \
+		static void check() { \
+			FIELDS(UNIFORM_IMPL_CHECK) \
+			static_assert(sizeof(Self) == Layout::size(), "C++ size differs from WGSL for: " #Name); \
+		} \
+	};
@@ -8,13 +8,62 @@
 
 #include "window.h"
 
+/**
+ * \def WEBGPU_SWAP_W
+ * Swap chain width if none is given.
+ */
+#ifndef WEBGPU_SWAP_W
+#define WEBGPU_SWAP_W 800
+#endif
+
+/**
+ * \def WEBGPU_SWAP_H
+ * Swap chain height if none is given.
+ */
+#ifndef WEBGPU_SWAP_H
+#define WEBGPU_SWAP_H 450
+#endif
+
+/*
+ * Dawn's proc table (only needed, and only available, for native builds).
+ */
+struct DawnProcTable;
+
 namespace webgpu {
 WGPUDevice create(window::Handle window, WGPUBackendType type = WGPUBackendType_Force32);
 
-WGPUSwapChain createSwapChain(WGPUDevice device);
+/**
+ * Creates the swap chain for the window passed to \c #create().
+ *
+ * \param[in] device device returned from \c #create()
+ * \param[in] width width in pixels (or zero for the default)
+ * \param[in] height height in pixels (or zero for the default)
+ */
+WGPUSwapChain createSwapChain(WGPUDevice device, uint32_t width = 0, uint32_t height = 0);
+
+/**
+ * Resizes the swap chain, reconfiguring it in place where the platform
+ * allows. Call between frames (with no texture view from the swap chain
+ * outstanding); earlier frames still in flight aren't waited on.
+ *
+ * \param[in] device device the swap chain was created with
+ * \param[in] swapchain swap chain to resize
+ * \param[in] width new width in pixels
+ * \param[in] height new height in pixels
+ * \return swap chain to use from now on (if a new one is created the old one is released)
+ */
+WGPUSwapChain resizeSwapChain(WGPUDevice device, WGPUSwapChain swapchain, uint32_t width, uint32_t height);
 
 /**
  * See \c #createSwapChain();
  */
 WGPUTextureFormat getSwapChainFormat(WGPUDevice device);
+
+/**
+ * Procs the device from \c #create() runs on natively, before any capture or
+ * stats wrapping, for a \c dawn::wire server replaying commands on it. These
+ * include any swap chain the platform emulates (on Linux, where only these
+ * procs may touch swap chains from \c #createSwapChain()). Native builds only.
+ */
+const DawnProcTable& procs();
 }
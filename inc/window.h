@@ -5,6 +5,18 @@
 #pragma once
 
 #include "defines.h"
+#include "frame.h"
+
+/**
+ * \def WINDOW_ON_DEMAND
+ * Set to render on demand by default: frames are only drawn when the window
+ * is invalidated, input arrives or it resizes (or while \c window#animate() is
+ * set), with the loop otherwise blocked waiting for events. Unset draws every
+ * frame until told otherwise. Either way, nothing is drawn while minimised.
+ */
+#ifndef WINDOW_ON_DEMAND
+#define WINDOW_ON_DEMAND 0
+#endif
 
 namespace window {
 /**
@@ -13,11 +25,6 @@ namespace window {
  */
 typedef struct HandleImpl* Handle;
 
-/**
- * Function prototype for the redraw callback. See \c #loop().
- */
-typedef bool (*Redraw) ();
-
 //****************************************************************************/
 
 /**
@@ -45,14 +52,58 @@ void destroy(Handle _NONNULL wHnd);
 void show(Handle _NONNULL wHnd, bool show = true);
 
 /**
- * Registers the redraw function to be called each frame.
+ * Runs the frame stages, the render side of which is synchronised with the
+ * window's redraw (see \c frame#Scheduler).
  *
- * \note Currently this blocks, returning only when the redraw function returns.
+ * \note Currently this blocks, returning only when one of the stages quits.
  *
  * \todo rethink this - what do we do for multiple windows?
  *
  * \param[in] wHnd window to synchronise the redraw with
- * \param[in] func function to be called each \e frame (or \c null to do nothing)
+ * \param[in] stages functions to be called each \e frame (or \c null to do nothing)
+ */
+void loop(Handle _NONNULL wHnd, const frame::Stages* _NULLABLE stages = NULLPTR);
+
+/**
+ * Retrieves the size of the window's drawable area in pixels (the backing
+ * size, so already scaled for hi-DPI displays).
+ *
+ * \param[in] wHnd window to query
+ * \param[out] w width in pixels
+ * \param[out] h height in pixels
+ */
+void size(Handle _NONNULL wHnd, unsigned& w, unsigned& h);
+
+/**
+ * Polls whether the window's drawable size changed since the last call (from
+ * resizing or moving to a display with a different DPI). Changes are
+ * coalesced: a drag is reported once, after it ends, and any number of
+ * changes between calls are reported once, with the latest size. Call from
+ * the render stages at the start of a frame.
+ *
+ * \param[in] wHnd window to query
+ * \param[out] w new width in pixels (unchanged if not resized)
+ * \param[out] h new height in pixels (unchanged if not resized)
+ * \return \c true if the size changed
+ */
+bool resized(Handle _NONNULL wHnd, unsigned& w, unsigned& h);
+
+/**
+ * Requests a single frame be drawn (e.g. after the scene changes), waking the
+ * loop if it's idle. Safe to call from any thread (including from the \c
+ * frame#Stages update).
+ *
+ * \param[in] wHnd window to redraw
+ */
+void invalidate(Handle _NONNULL wHnd);
+
+/**
+ * Sets whether the window is animating (drawing every frame regardless of
+ * invalidation). Starts as the opposite of \c #WINDOW_ON_DEMAND. Safe to call
+ * from any thread.
+ *
+ * \param[in] wHnd window to animate
+ * \param[in] active \c true to draw continuously, \c false to draw on demand
  */
-void loop(Handle _NONNULL wHnd, Redraw _NULLABLE func = NULLPTR);
+void animate(Handle _NONNULL wHnd, bool active = true);
 }
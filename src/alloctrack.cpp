@@ -0,0 +1,497 @@
+#include "alloctrack.h"
+
+#if ALLOC_TRACK
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <new>
+
+/*
+ * How malloc is seen: through the MSVC debug CRT's hook, by replacing glibc's
+ * entry points, or by patching the default macOS malloc zone. Elsewhere only
+ * operator new is replaced (and only when malloc isn't hooked, since new
+ * calls malloc).
+ */
+#if defined(_MSC_VER) && defined(_DEBUG)
+#include <crtdbg.h>
+#define ALLOC_TRACK_CRT_HOOK 1
+#else
+#define ALLOC_TRACK_CRT_HOOK 0
+#endif
+#if defined(__GLIBC__)
+#define ALLOC_TRACK_GLIBC 1
+#else
+#define ALLOC_TRACK_GLIBC 0
+#endif
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#include <mach/mach.h>
+#define ALLOC_TRACK_ZONE 1
+#else
+#define ALLOC_TRACK_ZONE 0
+#endif
+#define ALLOC_TRACK_MALLOC (ALLOC_TRACK_CRT_HOOK || ALLOC_TRACK_GLIBC || ALLOC_TRACK_ZONE)
+
+#include "profile.h"
+#endif
+
+//****************************************************************************/
+
+namespace impl {
+#if ALLOC_TRACK
+/**
+ * Allocations attributed to one stack of zones.
+ */
+struct Stack {
+	const char* names[ALLOC_TRACK_DEPTH]; ///< Open zones, outermost first
+	unsigned depth;    ///< Number of \c #names (\c ~0 if the entry is free)
+	unsigned long long count;  ///< Allocations since startup
+	unsigned long long steady; ///< Allocations in steady state frames
+	unsigned frame;    ///< Allocations in the current frame
+};
+
+/**
+ * Open-addressed table of stacks (the last entry catching any overflow).
+ */
+static Stack stacks[ALLOC_TRACK_STACKS];
+static std::atomic_flag lock = ATOMIC_FLAG_INIT; ///< Guards \c #stacks
+static bool ready = false; ///< Set once \c #stacks is initialised (guarded by \c #lock)
+/**
+ * Copies of the stacks for printing (render thread only).
+ */
+static Stack copies[ALLOC_TRACK_STACKS];
+
+static std::atomic<unsigned long long> allocs(0);
+static std::atomic<unsigned long long> frees (0);
+static std::atomic<unsigned long long> bytes (0);
+static std::atomic<unsigned long long> steady(0);
+static std::atomic<unsigned> inFrame(0);
+static unsigned long long frames = 0;
+
+/**
+ * Set while the calling thread is inside the tracker (so the tracker's own
+ * allocations, or those of anything it calls, aren't tracked).
+ */
+static thread_local bool inside = false;
+
+static void acquire() {
+	while (lock.test_and_set(std::memory_order_acquire)) {}
+	if (!ready) {
+		for (unsigned n = 0; n < ALLOC_TRACK_STACKS; n++) {
+			stacks[n].depth = ~0U;
+		}
+		ready = true;
+	}
+}
+
+static void release() {
+	lock.clear(std::memory_order_release);
+}
+
+/**
+ * \return the entry for the stack of \a depth \a names (called with the lock held)
+ */
+static Stack& find(const char** names, unsigned depth) {
+	size_t hash = depth;
+	for (unsigned n = 0; n < depth; n++) {
+		hash = hash * 31 + (reinterpret_cast<size_t>(names[n]) >> 3);
+	}
+	for (unsigned n = 0; n < ALLOC_TRACK_STACKS - 1; n++) {
+		Stack& stack = stacks[(hash + n) % (ALLOC_TRACK_STACKS - 1)];
+		if (stack.depth == ~0U) {
+			memcpy(stack.names, names, depth * sizeof(const char*));
+			stack.depth = depth;
+			return stack;
+		}
+		if (stack.depth == depth && memcmp(stack.names, names, depth * sizeof(const char*)) == 0) {
+			return stack;
+		}
+	}
+	Stack& other = stacks[ALLOC_TRACK_STACKS - 1];
+	if (other.depth == ~0U) {
+		other.names[0] = "(other)";
+		other.depth    = 1;
+	}
+	return other;
+}
+
+/**
+ * Records an allocation.
+ */
+static void allocated(size_t size) {
+	if (inside) {
+		return;
+	}
+	inside = true;
+	allocs.fetch_add(1, std::memory_order_relaxed);
+	bytes.fetch_add(size, std::memory_order_relaxed);
+	inFrame.fetch_add(1, std::memory_order_relaxed);
+	const char* names[ALLOC_TRACK_DEPTH];
+	unsigned depth = static_cast<unsigned>(profile::zones(names, ALLOC_TRACK_DEPTH));
+	acquire();
+	Stack& stack = find(names, depth);
+	stack.count++;
+	stack.frame++;
+	release();
+	inside = false;
+}
+
+/**
+ * Records a free.
+ */
+static void freed(void* ptr) {
+	if (ptr && !inside) {
+		frees.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+/**
+ * Writes a stack's zones separated by semicolons.
+ */
+static void fold(FILE* out, const Stack& stack) {
+	if (stack.depth == 0) {
+		fputs("(no zone)", out);
+	}
+	for (unsigned n = 0; n < stack.depth; n++) {
+		if (n) {
+			fputc(';', out);
+		}
+		fputs((stack.names[n]) ? stack.names[n] : "(unnamed)", out);
+	}
+}
+
+#if ALLOC_TRACK_CRT_HOOK
+/**
+ * Debug CRT hook (seeing \c malloc as well as \c new).
+ */
+static int hook(int type, void* ptr, size_t size, int block, long /*request*/, const unsigned char* /*file*/, int /*line*/) {
+	if (block != _CRT_BLOCK) {
+		if (type == _HOOK_ALLOC || type == _HOOK_REALLOC) {
+			allocated(size);
+		} else if (type == _HOOK_FREE) {
+			freed(ptr);
+		}
+	}
+	return TRUE;
+}
+
+/**
+ * Installs the hook during static initialisation.
+ */
+static struct Installer {
+	Installer() {
+		_CrtSetAllocHook(hook);
+	}
+} installer;
+#endif
+
+#if ALLOC_TRACK_ZONE
+/**
+ * Default zone's functions before patching.
+ */
+static malloc_zone_t original;
+
+static void* zoneMalloc(malloc_zone_t* zone, size_t size) {
+	allocated(size);
+	return original.malloc(zone, size);
+}
+
+static void* zoneCalloc(malloc_zone_t* zone, size_t count, size_t size) {
+	allocated(count * size);
+	return original.calloc(zone, count, size);
+}
+
+static void* zoneValloc(malloc_zone_t* zone, size_t size) {
+	allocated(size);
+	return original.valloc(zone, size);
+}
+
+static void* zoneRealloc(malloc_zone_t* zone, void* ptr, size_t size) {
+	allocated(size);
+	return original.realloc(zone, ptr, size);
+}
+
+static void* zoneMemalign(malloc_zone_t* zone, size_t align, size_t size) {
+	allocated(size);
+	return original.memalign(zone, align, size);
+}
+
+static void zoneFree(malloc_zone_t* zone, void* ptr) {
+	freed(ptr);
+	original.free(zone, ptr);
+}
+
+static void zoneFreeSized(malloc_zone_t* zone, void* ptr, size_t size) {
+	freed(ptr);
+	original.free_definite_size(zone, ptr, size);
+}
+
+/**
+ * Patches the default zone during static initialisation (its function
+ * table being read-only, so unprotected while writing).
+ */
+static struct Installer {
+	Installer() {
+		malloc_zone_t* zone = malloc_default_zone();
+		original = *zone;
+		vm_address_t page = reinterpret_cast<vm_address_t>(zone);
+		if (vm_protect(mach_task_self(), page, sizeof *zone, 0, VM_PROT_READ | VM_PROT_WRITE) == KERN_SUCCESS) {
+			zone->malloc  = zoneMalloc;
+			zone->calloc  = zoneCalloc;
+			zone->valloc  = zoneValloc;
+			zone->realloc = zoneRealloc;
+			zone->free    = zoneFree;
+			if (zone->version >= 5 && original.memalign) {
+				zone->memalign = zoneMemalign;
+			}
+			if (zone->version >= 6 && original.free_definite_size) {
+				zone->free_definite_size = zoneFreeSized;
+			}
+			vm_protect(mach_task_self(), page, sizeof *zone, 0, VM_PROT_READ);
+		}
+	}
+} installer;
+#endif
+#endif
+}
+
+#if ALLOC_TRACK && ALLOC_TRACK_GLIBC
+/*
+ * Replacement malloc family, forwarding to glibc's own entry points (the
+ * executable's definitions interposing for every module, Dawn included).
+ */
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t align, size_t size);
+void  __libc_free(void* ptr);
+
+void* malloc(size_t size) noexcept {
+	impl::allocated(size);
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept {
+	impl::allocated(count * size);
+	return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) noexcept {
+	impl::allocated(size);
+	return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t align, size_t size) noexcept {
+	impl::allocated(size);
+	return __libc_memalign(align, size);
+}
+
+void* aligned_alloc(size_t align, size_t size) noexcept {
+	return memalign(align, size);
+}
+
+int posix_memalign(void** ptr, size_t align, size_t size) noexcept {
+	void* mem = memalign(align, size);
+	if (!mem) {
+		return ENOMEM;
+	}
+	*ptr = mem;
+	return 0;
+}
+
+void free(void* ptr) noexcept {
+	impl::freed(ptr);
+	__libc_free(ptr);
+}
+}
+#endif
+
+#if ALLOC_TRACK && !ALLOC_TRACK_MALLOC
+/*
+ * Replacement global allocation functions (no exceptions, so failing aborts,
+ * apart from the nothrow versions).
+ */
+void* operator new(size_t size) {
+	impl::allocated(size);
+	void* ptr = malloc((size) ? size : 1);
+	if (!ptr) {
+		abort();
+	}
+	return ptr;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	impl::allocated(size);
+	return malloc((size) ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+	return operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept {
+	impl::freed(ptr);
+	free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+	operator delete(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+	operator delete(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+	operator delete(ptr);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* ptr, size_t) noexcept {
+	operator delete(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+	operator delete(ptr);
+}
+#endif
+
+#ifdef __cpp_aligned_new
+void* operator new(size_t size, std::align_val_t align) {
+	impl::allocated(size);
+#ifdef _MSC_VER
+	void* ptr = _aligned_malloc((size) ? size : 1, static_cast<size_t>(align));
+#else
+	void* ptr = nullptr;
+	if (posix_memalign(&ptr, static_cast<size_t>(align), (size) ? size : 1) != 0) {
+		ptr = nullptr;
+	}
+#endif
+	if (!ptr) {
+		abort();
+	}
+	return ptr;
+}
+
+void* operator new[](size_t size, std::align_val_t align) {
+	return operator new(size, align);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+	impl::freed(ptr);
+#ifdef _MSC_VER
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+void operator delete[](void* ptr, std::align_val_t align) noexcept {
+	operator delete(ptr, align);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t align) noexcept {
+	operator delete(ptr, align);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t align) noexcept {
+	operator delete(ptr, align);
+}
+#endif
+#endif
+
+//******************************** Public API ********************************/
+
+#if ALLOC_TRACK
+bool alloctrack::enabled() {
+	return true;
+}
+
+unsigned alloctrack::frame() {
+	unsigned count = impl::inFrame.exchange(0, std::memory_order_relaxed);
+	bool report = ++impl::frames > ALLOC_TRACK_WARMUP && count > 0;
+	/*
+	 * Stacks are copied then printed after unlocking (printing could wait on
+	 * another thread's stream lock while that thread waits on ours).
+	 */
+	unsigned found = 0;
+	impl::acquire();
+	for (unsigned n = 0; n < ALLOC_TRACK_STACKS; n++) {
+		impl::Stack& stack = impl::stacks[n];
+		if (stack.depth != ~0U && stack.frame) {
+			if (report) {
+				stack.steady += stack.frame;
+				impl::copies[found++] = stack;
+			}
+			stack.frame = 0;
+		}
+	}
+	impl::release();
+	if (report) {
+		impl::inside = true;
+		fprintf(stderr, "Frame %llu made %u heap allocation(s) in steady state:\n", impl::frames, count);
+		for (unsigned n = 0; n < found; n++) {
+			fputs("\t", stderr);
+			impl::fold(stderr, impl::copies[n]);
+			fprintf(stderr, " %u\n", impl::copies[n].frame);
+		}
+		impl::inside = false;
+		impl::steady.fetch_add(count, std::memory_order_relaxed);
+	#if ALLOC_TRACK_FATAL
+		abort();
+	#endif
+	}
+	return count;
+}
+
+alloctrack::Stats alloctrack::stats() {
+	Stats stats = {};
+	stats.allocs = impl::allocs.load(std::memory_order_relaxed);
+	stats.frees  = impl::frees .load(std::memory_order_relaxed);
+	stats.bytes  = impl::bytes .load(std::memory_order_relaxed);
+	stats.frames = impl::frames;
+	stats.steady = impl::steady.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void alloctrack::flame(FILE* out, bool steady) {
+	unsigned found = 0;
+	impl::acquire();
+	for (unsigned n = 0; n < ALLOC_TRACK_STACKS; n++) {
+		const impl::Stack& stack = impl::stacks[n];
+		if (stack.depth != ~0U && ((steady) ? stack.steady : stack.count)) {
+			impl::copies[found++] = stack;
+		}
+	}
+	impl::release();
+	impl::inside = true;
+	for (unsigned n = 0; n < found; n++) {
+		impl::fold(out, impl::copies[n]);
+		fprintf(out, " %llu\n", (steady) ? impl::copies[n].steady : impl::copies[n].count);
+	}
+	impl::inside = false;
+}
+#else
+bool alloctrack::enabled() {
+	return false;
+}
+
+unsigned alloctrack::frame() {
+	return 0;
+}
+
+alloctrack::Stats alloctrack::stats() {
+	Stats stats = {};
+	return stats;
+}
+
+void alloctrack::flame(FILE*, bool) {}
+#endif
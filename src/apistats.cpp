@@ -0,0 +1,488 @@
+#include "apistats.h"
+
+#include <atomic>
+
+#ifndef __EMSCRIPTEN__
+#include <dawn/dawn_proc_table.h>
+
+/**
+ * \def APISTATS_PROCS
+ * Every entry in \c DawnProcTable, in declaration order (mirroring the
+ * vendored \c dawn_proc_table.h; the \c static_assert below catches a Dawn
+ * update adding or removing entries).
+ *
+ * \param X macro applied to each entry name
+ */
+#define APISTATS_PROCS(X) \
+	X(createInstance) \
+	X(getProcAddress) \
+	X(adapterCreateDevice) \
+	X(adapterEnumerateFeatures) \
+	X(adapterGetLimits) \
+	X(adapterGetProperties) \
+	X(adapterHasFeature) \
+	X(adapterRequestDevice) \
+	X(adapterReference) \
+	X(adapterRelease) \
+	X(bindGroupSetLabel) \
+	X(bindGroupReference) \
+	X(bindGroupRelease) \
+	X(bindGroupLayoutSetLabel) \
+	X(bindGroupLayoutReference) \
+	X(bindGroupLayoutRelease) \
+	X(bufferDestroy) \
+	X(bufferGetConstMappedRange) \
+	X(bufferGetMappedRange) \
+	X(bufferMapAsync) \
+	X(bufferSetLabel) \
+	X(bufferUnmap) \
+	X(bufferReference) \
+	X(bufferRelease) \
+	X(commandBufferSetLabel) \
+	X(commandBufferReference) \
+	X(commandBufferRelease) \
+	X(commandEncoderBeginComputePass) \
+	X(commandEncoderBeginRenderPass) \
+	X(commandEncoderClearBuffer) \
+	X(commandEncoderCopyBufferToBuffer) \
+	X(commandEncoderCopyBufferToTexture) \
+	X(commandEncoderCopyTextureToBuffer) \
+	X(commandEncoderCopyTextureToTexture) \
+	X(commandEncoderCopyTextureToTextureInternal) \
+	X(commandEncoderFinish) \
+	X(commandEncoderInjectValidationError) \
+	X(commandEncoderInsertDebugMarker) \
+	X(commandEncoderPopDebugGroup) \
+	X(commandEncoderPushDebugGroup) \
+	X(commandEncoderResolveQuerySet) \
+	X(commandEncoderSetLabel) \
+	X(commandEncoderWriteBuffer) \
+	X(commandEncoderWriteTimestamp) \
+	X(commandEncoderReference) \
+	X(commandEncoderRelease) \
+	X(computePassEncoderDispatch) \
+	X(computePassEncoderDispatchIndirect) \
+	X(computePassEncoderEnd) \
+	X(computePassEncoderEndPass) \
+	X(computePassEncoderInsertDebugMarker) \
+	X(computePassEncoderPopDebugGroup) \
+	X(computePassEncoderPushDebugGroup) \
+	X(computePassEncoderSetBindGroup) \
+	X(computePassEncoderSetLabel) \
+	X(computePassEncoderSetPipeline) \
+	X(computePassEncoderWriteTimestamp) \
+	X(computePassEncoderReference) \
+	X(computePassEncoderRelease) \
+	X(computePipelineGetBindGroupLayout) \
+	X(computePipelineSetLabel) \
+	X(computePipelineReference) \
+	X(computePipelineRelease) \
+	X(deviceCreateBindGroup) \
+	X(deviceCreateBindGroupLayout) \
+	X(deviceCreateBuffer) \
+	X(deviceCreateCommandEncoder) \
+	X(deviceCreateComputePipeline) \
+	X(deviceCreateComputePipelineAsync) \
+	X(deviceCreateErrorBuffer) \
+	X(deviceCreateExternalTexture) \
+	X(deviceCreatePipelineLayout) \
+	X(deviceCreateQuerySet) \
+	X(deviceCreateRenderBundleEncoder) \
+	X(deviceCreateRenderPipeline) \
+	X(deviceCreateRenderPipelineAsync) \
+	X(deviceCreateSampler) \
+	X(deviceCreateShaderModule) \
+	X(deviceCreateSwapChain) \
+	X(deviceCreateTexture) \
+	X(deviceDestroy) \
+	X(deviceEnumerateFeatures) \
+	X(deviceGetLimits) \
+	X(deviceGetQueue) \
+	X(deviceHasFeature) \
+	X(deviceInjectError) \
+	X(deviceLoseForTesting) \
+	X(devicePopErrorScope) \
+	X(devicePushErrorScope) \
+	X(deviceSetDeviceLostCallback) \
+	X(deviceSetLabel) \
+	X(deviceSetLoggingCallback) \
+	X(deviceSetUncapturedErrorCallback) \
+	X(deviceTick) \
+	X(deviceReference) \
+	X(deviceRelease) \
+	X(externalTextureDestroy) \
+	X(externalTextureSetLabel) \
+	X(externalTextureReference) \
+	X(externalTextureRelease) \
+	X(instanceCreateSurface) \
+	X(instanceRequestAdapter) \
+	X(instanceReference) \
+	X(instanceRelease) \
+	X(pipelineLayoutSetLabel) \
+	X(pipelineLayoutReference) \
+	X(pipelineLayoutRelease) \
+	X(querySetDestroy) \
+	X(querySetSetLabel) \
+	X(querySetReference) \
+	X(querySetRelease) \
+	X(queueCopyTextureForBrowser) \
+	X(queueOnSubmittedWorkDone) \
+	X(queueSetLabel) \
+	X(queueSubmit) \
+	X(queueWriteBuffer) \
+	X(queueWriteTexture) \
+	X(queueReference) \
+	X(queueRelease) \
+	X(renderBundleReference) \
+	X(renderBundleRelease) \
+	X(renderBundleEncoderDraw) \
+	X(renderBundleEncoderDrawIndexed) \
+	X(renderBundleEncoderDrawIndexedIndirect) \
+	X(renderBundleEncoderDrawIndirect) \
+	X(renderBundleEncoderFinish) \
+	X(renderBundleEncoderInsertDebugMarker) \
+	X(renderBundleEncoderPopDebugGroup) \
+	X(renderBundleEncoderPushDebugGroup) \
+	X(renderBundleEncoderSetBindGroup) \
+	X(renderBundleEncoderSetIndexBuffer) \
+	X(renderBundleEncoderSetLabel) \
+	X(renderBundleEncoderSetPipeline) \
+	X(renderBundleEncoderSetVertexBuffer) \
+	X(renderBundleEncoderReference) \
+	X(renderBundleEncoderRelease) \
+	X(renderPassEncoderBeginOcclusionQuery) \
+	X(renderPassEncoderDraw) \
+	X(renderPassEncoderDrawIndexed) \
+	X(renderPassEncoderDrawIndexedIndirect) \
+	X(renderPassEncoderDrawIndirect) \
+	X(renderPassEncoderEnd) \
+	X(renderPassEncoderEndOcclusionQuery) \
+	X(renderPassEncoderEndPass) \
+	X(renderPassEncoderExecuteBundles) \
+	X(renderPassEncoderInsertDebugMarker) \
+	X(renderPassEncoderPopDebugGroup) \
+	X(renderPassEncoderPushDebugGroup) \
+	X(renderPassEncoderSetBindGroup) \
+	X(renderPassEncoderSetBlendConstant) \
+	X(renderPassEncoderSetIndexBuffer) \
+	X(renderPassEncoderSetLabel) \
+	X(renderPassEncoderSetPipeline) \
+	X(renderPassEncoderSetScissorRect) \
+	X(renderPassEncoderSetStencilReference) \
+	X(renderPassEncoderSetVertexBuffer) \
+	X(renderPassEncoderSetViewport) \
+	X(renderPassEncoderWriteTimestamp) \
+	X(renderPassEncoderReference) \
+	X(renderPassEncoderRelease) \
+	X(renderPipelineGetBindGroupLayout) \
+	X(renderPipelineSetLabel) \
+	X(renderPipelineReference) \
+	X(renderPipelineRelease) \
+	X(samplerSetLabel) \
+	X(samplerReference) \
+	X(samplerRelease) \
+	X(shaderModuleGetCompilationInfo) \
+	X(shaderModuleSetLabel) \
+	X(shaderModuleReference) \
+	X(shaderModuleRelease) \
+	X(surfaceReference) \
+	X(surfaceRelease) \
+	X(swapChainConfigure) \
+	X(swapChainGetCurrentTextureView) \
+	X(swapChainPresent) \
+	X(swapChainReference) \
+	X(swapChainRelease) \
+	X(textureCreateView) \
+	X(textureDestroy) \
+	X(textureSetLabel) \
+	X(textureReference) \
+	X(textureRelease) \
+	X(textureViewSetLabel) \
+	X(textureViewReference) \
+	X(textureViewRelease) \
+	/* end */
+#endif
+
+//****************************************************************************/
+
+namespace impl {
+#ifndef __EMSCRIPTEN__
+/**
+ * Index of each proc table entry.
+ */
+enum Proc {
+#define APISTATS_ENUM(name) PROC_##name,
+	APISTATS_PROCS(APISTATS_ENUM)
+#undef APISTATS_ENUM
+	PROC_COUNT
+};
+
+static_assert(sizeof(DawnProcTable) == PROC_COUNT * sizeof(void*), "APISTATS_PROCS is out of step with dawn_proc_table.h");
+
+/**
+ * Name of each proc table entry.
+ */
+static const char* const names[] = {
+#define APISTATS_NAME(name) #name,
+	APISTATS_PROCS(APISTATS_NAME)
+#undef APISTATS_NAME
+};
+
+/**
+ * Index of each summary counter (matching the order of \c apistats#Stats).
+ */
+enum Counter {
+	CALLS,
+	BYTES,
+	PIPELINES,
+	BIND_GROUPS,
+	DRAWS,
+	TRIANGLES,
+	COUNTER_COUNT
+};
+
+/**
+ * A single thread's counters. Only the owning thread writes to them (so a
+ * relaxed load and store suffices, no read-modify-write) whereas any thread
+ * may read them.
+ */
+struct Counters {
+	void add(Counter counter, unsigned long long n) {
+		totals[counter].store(totals[counter].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+	std::atomic<unsigned long long> totals[COUNTER_COUNT];
+	std::atomic<unsigned long long> procs[PROC_COUNT];
+	Counters* next; ///< Next thread's counters (set once, before publishing)
+};
+
+/**
+ * Head of the list of every thread's counters. Counters are never freed, so
+ * the totals of exited threads aren't lost.
+ */
+static std::atomic<Counters*> threads(nullptr);
+
+/**
+ * Calling thread's counters (created on first use).
+ */
+static thread_local Counters* local = nullptr;
+
+/**
+ * \return the calling thread's counters
+ */
+static Counters& counters() {
+	if (!local) {
+		local = new Counters();
+		local->next = threads.load(std::memory_order_relaxed);
+		while (!threads.compare_exchange_weak(local->next, local, std::memory_order_release, std::memory_order_relaxed)) {}
+	}
+	return *local;
+}
+
+/**
+ * Original (non-counting) procs.
+ */
+static DawnProcTable real;
+
+/**
+ * Extra counting for specific entry points (none by default).
+ *
+ * \tparam P proc table entry index
+ */
+template<unsigned P>
+struct Hook {
+	template<typename... A>
+	static void note(Counters& /*c*/, A... /*args*/) {}
+};
+
+/**
+ * Counts pipeline switches.
+ */
+struct CountPipeline {
+	template<typename... A>
+	static void note(Counters& c, A... /*args*/) {
+		c.add(PIPELINES, 1);
+	}
+};
+
+/**
+ * Counts bind group switches.
+ */
+struct CountBindGroup {
+	template<typename... A>
+	static void note(Counters& c, A... /*args*/) {
+		c.add(BIND_GROUPS, 1);
+	}
+};
+
+/**
+ * Counts indirect draws (whose triangles aren't known on the CPU).
+ */
+struct CountIndirect {
+	template<typename... A>
+	static void note(Counters& c, A... /*args*/) {
+		c.add(DRAWS, 1);
+	}
+};
+
+/**
+ * Counts direct draws, assuming triangle lists (strips are over-counted).
+ */
+struct CountDraw {
+	template<typename E, typename... A>
+	static void note(Counters& c, E /*encoder*/, uint32_t count, uint32_t instances, A... /*args*/) {
+		c.add(DRAWS, 1);
+		c.add(TRIANGLES, static_cast<unsigned long long>(count / 3) * instances);
+	}
+};
+
+template<> struct Hook<PROC_queueWriteBuffer> {
+	static void note(Counters& c, WGPUQueue, WGPUBuffer, uint64_t, void const*, size_t size) {
+		c.add(BYTES, size);
+	}
+};
+template<> struct Hook<PROC_queueWriteTexture> {
+	static void note(Counters& c, WGPUQueue, WGPUImageCopyTexture const*, void const*, size_t size, WGPUTextureDataLayout const*, WGPUExtent3D const*) {
+		c.add(BYTES, size);
+	}
+};
+template<> struct Hook<PROC_computePassEncoderSetPipeline>    : CountPipeline  {};
+template<> struct Hook<PROC_renderPassEncoderSetPipeline>     : CountPipeline  {};
+template<> struct Hook<PROC_renderBundleEncoderSetPipeline>   : CountPipeline  {};
+template<> struct Hook<PROC_computePassEncoderSetBindGroup>   : CountBindGroup {};
+template<> struct Hook<PROC_renderPassEncoderSetBindGroup>    : CountBindGroup {};
+template<> struct Hook<PROC_renderBundleEncoderSetBindGroup>  : CountBindGroup {};
+template<> struct Hook<PROC_renderPassEncoderDraw>            : CountDraw      {};
+template<> struct Hook<PROC_renderPassEncoderDrawIndexed>     : CountDraw      {};
+template<> struct Hook<PROC_renderBundleEncoderDraw>          : CountDraw      {};
+template<> struct Hook<PROC_renderBundleEncoderDrawIndexed>   : CountDraw      {};
+template<> struct Hook<PROC_renderPassEncoderDrawIndirect>           : CountIndirect {};
+template<> struct Hook<PROC_renderPassEncoderDrawIndexedIndirect>    : CountIndirect {};
+template<> struct Hook<PROC_renderBundleEncoderDrawIndirect>         : CountIndirect {};
+template<> struct Hook<PROC_renderBundleEncoderDrawIndexedIndirect>  : CountIndirect {};
+
+/**
+ * Counting replacement for a proc table entry.
+ *
+ * \tparam F entry's function pointer type
+ * \tparam M entry's member in \c DawnProcTable
+ * \tparam P entry's index
+ */
+template<typename F, F DawnProcTable::*M, unsigned P>
+struct Thunk;
+
+template<typename R, typename... A, R (*DawnProcTable::*M)(A...), unsigned P>
+struct Thunk<R (*)(A...), M, P> {
+	static R call(A... args) {
+		Counters& c = counters();
+		c.add(CALLS, 1);
+		c.procs[P].store(c.procs[P].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		Hook<P>::note(c, args...);
+		return (real.*M)(args...);
+	}
+};
+
+/**
+ * Running totals at the end of the previous frame, and the per entry point
+ * calls made during it (only touched by \c apistats#frame()).
+ */
+static unsigned long long prevTotals[COUNTER_COUNT];
+static unsigned long long prevProcs [PROC_COUNT];
+static unsigned long long lastProcs [PROC_COUNT];
+#endif
+
+/**
+ * Set once the counting procs are installed.
+ */
+static bool active = false;
+}
+
+//******************************** Public API ********************************/
+
+void apistats::install(DawnProcTable* procs) {
+#ifndef __EMSCRIPTEN__
+	impl::real = *procs;
+#define APISTATS_WRAP(name) \
+	if (procs->name) { \
+		procs->name = impl::Thunk<decltype(procs->name), &DawnProcTable::name, impl::PROC_##name>::call; \
+	}
+	APISTATS_PROCS(APISTATS_WRAP)
+#undef APISTATS_WRAP
+	impl::active = true;
+#else
+	(void) procs;
+#endif
+}
+
+bool apistats::installed() {
+	return impl::active;
+}
+
+apistats::Stats apistats::frame() {
+	Stats stats = {};
+#ifndef __EMSCRIPTEN__
+	unsigned long long totals[impl::COUNTER_COUNT] = {};
+	unsigned long long procs [impl::PROC_COUNT]    = {};
+	for (impl::Counters* c = impl::threads.load(std::memory_order_acquire); c; c = c->next) {
+		for (unsigned n = 0; n < impl::COUNTER_COUNT; n++) {
+			totals[n] += c->totals[n].load(std::memory_order_relaxed);
+		}
+		for (unsigned n = 0; n < impl::PROC_COUNT; n++) {
+			procs[n] += c->procs[n].load(std::memory_order_relaxed);
+		}
+	}
+	for (unsigned n = 0; n < impl::COUNTER_COUNT; n++) {
+		unsigned long long total = totals[n];
+		totals[n] -= impl::prevTotals[n];
+		impl::prevTotals[n] = total;
+	}
+	for (unsigned n = 0; n < impl::PROC_COUNT; n++) {
+		impl::lastProcs[n] = procs[n] - impl::prevProcs[n];
+		impl::prevProcs[n] = procs[n];
+	}
+	stats.calls      = totals[impl::CALLS];
+	stats.bytes      = totals[impl::BYTES];
+	stats.pipelines  = totals[impl::PIPELINES];
+	stats.bindGroups = totals[impl::BIND_GROUPS];
+	stats.draws      = totals[impl::DRAWS];
+	stats.triangles  = totals[impl::TRIANGLES];
+#endif
+	return stats;
+}
+
+size_t apistats::entries(Entry* entries, size_t max) {
+	size_t used = 0;
+#ifndef __EMSCRIPTEN__
+	for (unsigned n = 0; n < impl::PROC_COUNT && used < max; n++) {
+		if (impl::lastProcs[n]) {
+			entries[used].name  = impl::names[n];
+			entries[used].calls = impl::lastProcs[n];
+			used++;
+		}
+	}
+#else
+	(void) entries;
+	(void) max;
+#endif
+	return used;
+}
+
+void apistats::print(const Stats& stats, FILE* out) {
+	fprintf(out, "api: %llu calls, %llu bytes, %llu pipelines, %llu bind groups, %llu draws, %llu triangles\n",
+		stats.calls, stats.bytes, stats.pipelines, stats.bindGroups, stats.draws, stats.triangles);
+	/*
+	 * The top few entry points (a simple selection, since most frames call
+	 * only a handful).
+	 */
+	Entry all[256];
+	size_t count = entries(all, sizeof all / sizeof *all);
+	for (unsigned top = 0; top < 8 && count > 0; top++) {
+		size_t best = 0;
+		for (size_t n = 1; n < count; n++) {
+			if (all[n].calls > all[best].calls) {
+				best = n;
+			}
+		}
+		fprintf(out, "  %-40s %8llu\n", all[best].name, all[best].calls);
+		all[best] = all[--count];
+	}
+}
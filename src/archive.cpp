@@ -0,0 +1,476 @@
+#include "archive.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ARCHIVE_MMAP 1
+#endif
+
+//****************************************************************************/
+
+/**
+ * Opened archive state.
+ */
+struct archive::ArchiveImpl {
+	const uint8_t* base;     ///< Start of the file
+	size_t size;             ///< File size in bytes
+	bool mapped;             ///< \c true if \c #base is a mapping (\c false if caller's memory)
+	bool ordered;            ///< Blobs are in access order (so prefetched ahead)
+	const Entry* toc;
+	const char* names;
+	uint32_t count;
+	std::atomic<uint8_t>* seen;   ///< Per entry flag, set on first access
+	uint32_t* order;              ///< Entries in first access order
+	std::atomic<uint32_t> used;   ///< Entries in \c #order
+	std::atomic<uint64_t> ahead;  ///< End of the range prefetched so far
+};
+
+namespace impl {
+#ifdef _WIN32
+/**
+ * \c PrefetchVirtualMemory() (Windows 8 onwards, looked up at runtime since
+ * the build targets Windows 7).
+ */
+typedef BOOL (WINAPI *PrefetchProc)(HANDLE process, ULONG_PTR count, void* ranges, ULONG flags);
+
+/**
+ * Matches \c WIN32_MEMORY_RANGE_ENTRY.
+ */
+struct Range {
+	void* addr;
+	SIZE_T size;
+};
+#endif
+
+/**
+ * Hints that \a from to \a to will be read soon, so the OS starts paging it
+ * in (rounded out to whole pages and clamped to the file).
+ */
+static void prefetch(const archive::ArchiveImpl* archive, uint64_t from, uint64_t to) {
+	if (!archive->mapped) {
+		return;
+	}
+	if (to > archive->size) {
+		to = archive->size;
+	}
+	from &= ~static_cast<uint64_t>(ARCHIVE_ALIGN - 1);
+	if (from >= to) {
+		return;
+	}
+#if defined(_WIN32)
+	static PrefetchProc const proc = reinterpret_cast<PrefetchProc>(
+		reinterpret_cast<void*>(GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory")));
+	if (proc) {
+		Range range = {const_cast<uint8_t*>(archive->base) + from, static_cast<SIZE_T>(to - from)};
+		proc(GetCurrentProcess(), 1, &range, 0);
+	}
+#elif ARCHIVE_MMAP
+	madvise(const_cast<uint8_t*>(archive->base) + from, static_cast<size_t>(to - from), MADV_WILLNEED);
+#endif
+}
+
+/**
+ * Notes the first access of entry \a n then prefetches it (and, in ordered
+ * archives, the blobs after it up to \c #ARCHIVE_READAHEAD).
+ */
+static void touch(archive::ArchiveImpl* archive, uint32_t n) {
+	if (archive->seen[n].exchange(1, std::memory_order_relaxed) == 0) {
+		archive->order[archive->used.fetch_add(1, std::memory_order_relaxed)] = n;
+	}
+	const archive::Entry& entry = archive->toc[n];
+	uint64_t from = entry.offset;
+	uint64_t to   = entry.offset + entry.size;
+	if (archive->ordered) {
+		to += ARCHIVE_READAHEAD;
+		uint64_t ahead = archive->ahead.load(std::memory_order_relaxed);
+		do {
+			if (to <= ahead) {
+				return;
+			}
+		} while (!archive->ahead.compare_exchange_weak(ahead, to, std::memory_order_relaxed));
+		if (from < ahead) {
+			from = ahead;
+		}
+	}
+	prefetch(archive, from, to);
+}
+
+/**
+ * Validates the header and TOC of \a size bytes of archive at \a base.
+ *
+ * \return the opened archive (or \c null if not valid)
+ */
+static archive::ArchiveImpl* validate(const uint8_t* base, size_t size, bool mapped) {
+	if (size < sizeof(archive::Header)) {
+		return nullptr;
+	}
+	const archive::Header* header = reinterpret_cast<const archive::Header*>(base);
+	if (header->magic != ARCHIVE_MAGIC || header->version != ARCHIVE_VERSION) {
+		return nullptr;
+	}
+	uint64_t names = sizeof(archive::Header) + static_cast<uint64_t>(header->count) * sizeof(archive::Entry);
+	if (names + header->names > size || (header->names && base[names + header->names - 1] != 0)) {
+		return nullptr;
+	}
+	const archive::Entry* toc = reinterpret_cast<const archive::Entry*>(base + sizeof(archive::Header));
+	uint64_t first = size;
+	for (uint32_t n = 0; n < header->count; n++) {
+		const archive::Entry& entry = toc[n];
+		if (entry.offset > size || entry.size > size - entry.offset || entry.name >= header->names
+				|| (n > 0 && toc[n - 1].id >= entry.id)) {
+			return nullptr;
+		}
+		if (entry.type == archive::TYPE_SHADER && (entry.offset + entry.size >= size || base[entry.offset + entry.size] != 0)) {
+			return nullptr;
+		}
+		if (entry.offset < first) {
+			first = entry.offset;
+		}
+	}
+	archive::ArchiveImpl* archive = new archive::ArchiveImpl();
+	archive->base    = base;
+	archive->size    = size;
+	archive->mapped  = mapped;
+	archive->ordered = (header->flags & archive::FLAG_ORDERED) != 0;
+	archive->toc     = toc;
+	archive->names   = reinterpret_cast<const char*>(base + names);
+	archive->count   = header->count;
+	archive->seen    = new std::atomic<uint8_t>[header->count ? header->count : 1];
+	archive->order   = new uint32_t[header->count ? header->count : 1];
+	for (uint32_t n = 0; n < header->count; n++) {
+		archive->seen[n].store(0, std::memory_order_relaxed);
+	}
+	archive->used.store(0, std::memory_order_relaxed);
+	archive->ahead.store(0, std::memory_order_relaxed);
+	/*
+	 * The TOC is about to be searched, and in an ordered archive the first
+	 * blobs are the first needed.
+	 */
+	prefetch(archive, 0, names + header->names);
+	if (archive->ordered) {
+		archive->ahead.store(first + ARCHIVE_READAHEAD, std::memory_order_relaxed);
+		prefetch(archive, first, first + ARCHIVE_READAHEAD);
+	}
+	return archive;
+}
+
+/**
+ * Growable array (of plain data only, for building meshes).
+ */
+template <typename T>
+struct Array {
+	Array()
+		: data    (nullptr)
+		, size    (0)
+		, capacity(0) {}
+	~Array() {
+		free(data);
+	}
+	bool push(const T& item) {
+		if (size == capacity) {
+			size_t grown = (capacity) ? capacity * 2 : 64;
+			T* next = static_cast<T*>(realloc(data, grown * sizeof(T)));
+			if (!next) {
+				return false;
+			}
+			data     = next;
+			capacity = grown;
+		}
+		data[size++] = item;
+		return true;
+	}
+	T* data;
+	size_t size;
+	size_t capacity;
+private:
+	Array(const Array&);
+	Array& operator =(const Array&);
+};
+
+/**
+ * \return \c true if \a name ends with \a ext
+ */
+static bool extension(const char* name, const char* ext) {
+	size_t nameLen = strlen(name);
+	size_t extLen  = strlen(ext);
+	return nameLen >= extLen && strcmp(name + nameLen - extLen, ext) == 0;
+}
+
+/**
+ * Converts \c .obj text to a mesh blob (vertices being a position then a
+ * colour, three floats each).
+ *
+ * \param[in] text null terminated source (modified whilst parsing)
+ * \param[out] size blob size in bytes
+ * \return blob allocated with \c malloc() (or \c null if a face indexes a missing vertex)
+ */
+static uint8_t* mesh(char* text, size_t& size) {
+	Array<float> verts;
+	Array<uint32_t> indices;
+	for (char* line = text; line && *line;) {
+		char* next = strchr(line, '\n');
+		if (next) {
+			*next++ = 0;
+		}
+		if (line[0] == 'v' && line[1] == ' ') {
+			float v[6] = {0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f};
+			sscanf(line + 2, "%f %f %f %f %f %f", v, v + 1, v + 2, v + 3, v + 4, v + 5);
+			for (unsigned n = 0; n < 6; n++) {
+				if (!verts.push(v[n])) {
+					return nullptr;
+				}
+			}
+		} else if (line[0] == 'f' && line[1] == ' ') {
+			long count = static_cast<long>(verts.size / 6);
+			uint32_t first = 0;
+			uint32_t prev  = 0;
+			unsigned corners = 0;
+			const char* pos = line + 2;
+			char* after;
+			long index;
+			while ((index = strtol(pos, &after, 10)) != 0 || after != pos) {
+				index = (index < 0) ? count + index : index - 1;
+				if (index < 0 || index >= count) {
+					return nullptr;
+				}
+				if (corners == 0) {
+					first = static_cast<uint32_t>(index);
+				} else if (corners >= 2) {
+					if (!indices.push(first) || !indices.push(prev) || !indices.push(static_cast<uint32_t>(index))) {
+						return nullptr;
+					}
+				}
+				prev = static_cast<uint32_t>(index);
+				corners++;
+				pos  = after;
+				while (*pos && *pos != ' ' && *pos != '\t') {
+					pos++; // skips any texcoord and normal indices
+				}
+			}
+		}
+		line = next;
+	}
+	archive::MeshHeader header = {};
+	header.vertexCount = static_cast<uint32_t>(verts.size / 6);
+	header.stride      = 6 * sizeof(float);
+	header.indexSize   = (header.vertexCount <= 0x10000) ? 2 : 4;
+	header.indexCount  = static_cast<uint32_t>(indices.size);
+	header.indexOffset = static_cast<uint32_t>(sizeof header + verts.size * sizeof(float));
+	size = (header.indexOffset + indices.size * header.indexSize + 3) & ~static_cast<size_t>(3);
+	uint8_t* blob = static_cast<uint8_t*>(calloc(size, 1));
+	if (blob) {
+		memcpy(blob, &header, sizeof header);
+		if (verts.size) {
+			memcpy(blob + sizeof header, verts.data, verts.size * sizeof(float));
+		}
+		for (size_t n = 0; n < indices.size; n++) {
+			if (header.indexSize == 2) {
+				uint16_t index = static_cast<uint16_t>(indices.data[n]);
+				memcpy(blob + header.indexOffset + n * 2, &index, 2);
+			} else {
+				memcpy(blob + header.indexOffset + n * 4, &indices.data[n], 4);
+			}
+		}
+	}
+	return blob;
+}
+
+/**
+ * Releases the mapping at \a base (of \a size bytes).
+ */
+static void unmap(const uint8_t* base, size_t size) {
+#if defined(_WIN32)
+	(void) size;
+	UnmapViewOfFile(base);
+#elif ARCHIVE_MMAP
+	munmap(const_cast<uint8_t*>(base), size);
+#else
+	(void) base;
+	(void) size;
+#endif
+}
+}
+
+//******************************** Public API ********************************/
+
+uint64_t archive::hash(const void* data, size_t size) {
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	for (size_t n = 0; n < size; n++) {
+		hash ^= bytes[n];
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+archive::Archive archive::open(const char* path) {
+	const uint8_t* base = nullptr;
+	size_t size = 0;
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return nullptr;
+	}
+	LARGE_INTEGER fileSize;
+	if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+		size = static_cast<size_t>(fileSize.QuadPart);
+		if (HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL)) {
+			base = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			CloseHandle(mapping);
+		}
+	}
+	CloseHandle(file);
+#elif ARCHIVE_MMAP
+	int file = ::open(path, O_RDONLY);
+	if (file < 0) {
+		return nullptr;
+	}
+	struct stat info;
+	if (fstat(file, &info) == 0 && info.st_size > 0) {
+		size = static_cast<size_t>(info.st_size);
+		void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0);
+		base = (mapping != MAP_FAILED) ? static_cast<const uint8_t*>(mapping) : nullptr;
+	}
+	::close(file);
+#else
+	/*
+	 * No file system (the page should fetch the archive then open it from
+	 * memory).
+	 */
+	(void) path;
+#endif
+	if (!base) {
+		return nullptr;
+	}
+	ArchiveImpl* archive = impl::validate(base, size, true);
+	if (!archive) {
+		impl::unmap(base, size);
+	}
+	return archive;
+}
+
+archive::Archive archive::open(const void* data, size_t size) {
+	return impl::validate(static_cast<const uint8_t*>(data), size, false);
+}
+
+void archive::close(Archive archive) {
+	if (archive) {
+		if (archive->mapped) {
+			impl::unmap(archive->base, archive->size);
+		}
+		delete[] archive->seen;
+		delete[] archive->order;
+		delete archive;
+	}
+}
+
+bool archive::find(Archive archive, const char* name, Blob& blob) {
+	uint64_t id = hash(name, strlen(name));
+	uint32_t lo = 0;
+	uint32_t hi = archive->count;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (archive->toc[mid].id < id) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	if (lo == archive->count || archive->toc[lo].id != id || strcmp(archive->names + archive->toc[lo].name, name) != 0) {
+		return false;
+	}
+	const Entry& entry = archive->toc[lo];
+	blob.data = archive->base + entry.offset;
+	blob.size = static_cast<size_t>(entry.size);
+	blob.hash = entry.hash;
+	blob.type = static_cast<Type>(entry.type);
+	blob.name = archive->names + entry.name;
+	impl::touch(archive, lo);
+	return true;
+}
+
+bool archive::verify(const Blob& blob) {
+	return blob.data && hash(blob.data, blob.size) == blob.hash;
+}
+
+bool archive::mesh(const Blob& blob, Mesh& mesh) {
+	if (blob.type != TYPE_MESH || !blob.data || blob.size < sizeof(MeshHeader)) {
+		return false;
+	}
+	const MeshHeader* header = static_cast<const MeshHeader*>(blob.data);
+	uint64_t vertEnd = sizeof(MeshHeader) + static_cast<uint64_t>(header->vertexCount) * header->stride;
+	uint64_t indxEnd = header->indexOffset + static_cast<uint64_t>(header->indexCount) * header->indexSize;
+	if ((header->indexSize != 2 && header->indexSize != 4) || header->indexOffset % 4 != 0
+			|| vertEnd > header->indexOffset || indxEnd > blob.size) {
+		return false;
+	}
+	const uint8_t* bytes = static_cast<const uint8_t*>(blob.data);
+	mesh.vertices    = bytes + sizeof(MeshHeader);
+	mesh.indices     = bytes + header->indexOffset;
+	mesh.vertexCount = header->vertexCount;
+	mesh.stride      = header->stride;
+	mesh.indexCount  = header->indexCount;
+	mesh.indexSize   = header->indexSize;
+	return true;
+}
+
+bool archive::build(const char* name, const void* src, size_t size, Blob& blob) {
+	/*
+	 * Every type gets a spare terminator, so text can be parsed in place (and
+	 * shaders keep it).
+	 */
+	uint8_t* data = static_cast<uint8_t*>(malloc(size + 1));
+	if (!data) {
+		return false;
+	}
+	if (size) {
+		memcpy(data, src, size);
+	}
+	data[size] = 0;
+	if (impl::extension(name, ".obj")) {
+		uint8_t* built = impl::mesh(reinterpret_cast<char*>(data), size);
+		free(data);
+		if (!built) {
+			return false;
+		}
+		data = built;
+		blob.type = TYPE_MESH;
+	} else {
+		blob.type = (impl::extension(name, ".wgsl")) ? TYPE_SHADER
+			: (impl::extension(name, ".utx")) ? TYPE_TEXTURE : TYPE_BLOB;
+	}
+	blob.data = data;
+	blob.size = size;
+	blob.hash = hash(data, size);
+	blob.name = name;
+	return true;
+}
+
+bool archive::record(Archive archive, const char* path) {
+#ifndef __EMSCRIPTEN__
+	if (FILE* file = fopen(path, "wb")) {
+		uint32_t used = archive->used.load(std::memory_order_relaxed);
+		for (uint32_t n = 0; n < used; n++) {
+			fprintf(file, "%s\n", archive->names + archive->toc[archive->order[n]].name);
+		}
+		return fclose(file) == 0;
+	}
+#else
+	(void) archive;
+	(void) path;
+#endif
+	return false;
+}
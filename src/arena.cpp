@@ -0,0 +1,244 @@
+#include "arena.h"
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "frame.h"
+
+#if FRAME_THREADED
+#include <mutex>
+#endif
+
+//****************************************************************************/
+
+namespace impl {
+/**
+ * Header of a heap allocation made when an arena overflows.
+ */
+struct Overflow {
+	Overflow* next;
+};
+
+/**
+ * \return \a value rounded up to a multiple of \a align (a power of two)
+ */
+static uintptr_t alignUp(uintptr_t value, size_t align) {
+	return (value + align - 1) & ~static_cast<uintptr_t>(align - 1);
+}
+}
+
+/**
+ * Arena storage, the bump offset and any heap fallbacks.
+ */
+struct arena::Arena::Impl {
+	Impl(size_t capacity)
+		: base     (static_cast<unsigned char*>(malloc(capacity)))
+		, capacity ((base) ? capacity : 0)
+		, used     (0)
+		, spilled  (0)
+		, highWater(0)
+		, overflow (nullptr)
+		, overflows(0) {}
+
+	~Impl() {
+		release();
+		free(base);
+	}
+
+	/**
+	 * Frees the heap fallbacks.
+	 */
+	void release() {
+		while (overflow) {
+			impl::Overflow* next = overflow->next;
+			free(overflow);
+			overflow = next;
+		}
+	}
+
+	unsigned char* base;
+	size_t capacity;
+	std::atomic<size_t> used;    ///< Bump offset from \c #base
+	std::atomic<size_t> spilled; ///< Bytes allocated from the heap since the last reset
+	size_t highWater;
+	impl::Overflow* overflow;    ///< Heap fallbacks (freed on reset)
+	unsigned overflows;
+#if FRAME_THREADED
+	std::mutex lock;             ///< Guards \c #overflow
+#endif
+};
+
+namespace impl {
+/**
+ * Thread's sub-arena (a block taken from a frame's arena).
+ */
+struct Local {
+	unsigned slot;  ///< Frame slot the block came from
+	unsigned epoch; ///< Arena epoch the block came from
+	unsigned char* pos;
+	unsigned char* end;
+};
+
+static arena::Arena* frames[ARENA_FRAMES] = {};
+static unsigned current = 0;
+static arena::Arena* snaps[ARENA_FRAMES] = {}; ///< Simulation thread's slots
+static unsigned snapCurrent = 0;
+static thread_local Local local = {};
+}
+
+//******************************** Public API ********************************/
+
+arena::Arena::Arena(size_t capacity)
+	: impl(new Impl(capacity))
+	, generation(0) {}
+
+arena::Arena::~Arena() {
+	delete impl;
+}
+
+void* arena::Arena::alloc(size_t size, size_t align) {
+	uintptr_t base = reinterpret_cast<uintptr_t>(impl->base);
+	size_t at = impl->used.load(std::memory_order_relaxed);
+	while (impl->base) {
+		size_t beg = static_cast<size_t>(impl::alignUp(base + at, align) - base);
+		size_t end = beg + size;
+		if (end > impl->capacity) {
+			break;
+		}
+		if (impl->used.compare_exchange_weak(at, end, std::memory_order_relaxed)) {
+			return impl->base + beg;
+		}
+	}
+	/*
+	 * Out of space, so to the heap until the next reset.
+	 */
+	impl::Overflow* block = static_cast<impl::Overflow*>(malloc(sizeof(impl::Overflow) + size + align));
+	if (!block) {
+		return nullptr;
+	}
+	{
+	#if FRAME_THREADED
+		std::lock_guard<std::mutex> hold(impl->lock);
+	#endif
+		block->next    = impl->overflow;
+		impl->overflow = block;
+		impl->overflows++;
+	}
+	impl->spilled.fetch_add(size, std::memory_order_relaxed);
+	return reinterpret_cast<void*>(impl::alignUp(reinterpret_cast<uintptr_t>(block + 1), align));
+}
+
+void arena::Arena::reset() {
+	Stats now = stats();
+	if (impl->highWater < now.used) {
+		impl->highWater = now.used;
+	}
+	if (impl->overflow) {
+		/*
+		 * Grown to the high-water mark (plus a quarter) so the same frame
+		 * next time fits. The contents are discarded so no need to realloc.
+		 */
+		impl->release();
+		size_t grow = impl->highWater + impl->highWater / 4;
+		if (unsigned char* more = static_cast<unsigned char*>(malloc(grow))) {
+			free(impl->base);
+			impl->base     = more;
+			impl->capacity = grow;
+		}
+	}
+	impl->used.store(0, std::memory_order_relaxed);
+	impl->spilled.store(0, std::memory_order_relaxed);
+	generation++;
+}
+
+arena::Stats arena::Arena::stats() const {
+	size_t used = impl->used.load(std::memory_order_relaxed);
+	Stats stats = {};
+	stats.used      = ((used < impl->capacity) ? used : impl->capacity) + impl->spilled.load(std::memory_order_relaxed);
+	stats.highWater = (impl->highWater > stats.used) ? impl->highWater : stats.used;
+	stats.capacity  = impl->capacity;
+	stats.overflows = impl->overflows;
+	return stats;
+}
+
+void arena::init(size_t capacity) {
+	impl::current     = 0;
+	impl::snapCurrent = 0;
+	for (unsigned n = 0; n < ARENA_FRAMES; n++) {
+		if (!impl::frames[n]) {
+			impl::frames[n] = new Arena(capacity);
+		}
+		if (!impl::snaps[n]) {
+			impl::snaps[n] = new Arena(capacity);
+		}
+	}
+}
+
+void arena::destroy() {
+	for (unsigned n = 0; n < ARENA_FRAMES; n++) {
+		delete impl::frames[n];
+		delete impl::snaps[n];
+		impl::frames[n] = nullptr;
+		impl::snaps [n] = nullptr;
+	}
+}
+
+void arena::begin() {
+	impl::current = (impl::current + 1) % ARENA_FRAMES;
+	impl::frames[impl::current]->reset();
+}
+
+arena::Arena& arena::frame() {
+	return *impl::frames[impl::current];
+}
+
+void arena::step() {
+	impl::snapCurrent = (impl::snapCurrent + 1) % ARENA_FRAMES;
+	impl::snaps[impl::snapCurrent]->reset();
+}
+
+arena::Arena& arena::snapshot() {
+	return *impl::snaps[impl::snapCurrent];
+}
+
+void* arena::local(size_t size, size_t align) {
+	Arena& owner = frame();
+	impl::Local& local = impl::local;
+	if (local.slot != impl::current || local.epoch != owner.epoch()) {
+		local.slot  = impl::current;
+		local.epoch = owner.epoch();
+		local.pos   = nullptr;
+		local.end   = nullptr;
+	}
+	uintptr_t beg = impl::alignUp(reinterpret_cast<uintptr_t>(local.pos), align);
+	if (!local.pos || beg + size > reinterpret_cast<uintptr_t>(local.end)) {
+		size_t block = (size + align > ARENA_LOCAL_SIZE) ? size + align : ARENA_LOCAL_SIZE;
+		local.pos = static_cast<unsigned char*>(owner.alloc(block));
+		if (!local.pos) {
+			local.end = nullptr;
+			return nullptr;
+		}
+		local.end = local.pos + block;
+		beg = impl::alignUp(reinterpret_cast<uintptr_t>(local.pos), align);
+	}
+	local.pos = reinterpret_cast<unsigned char*>(beg + size);
+	return reinterpret_cast<void*>(beg);
+}
+
+void arena::print(FILE* out) {
+	for (unsigned n = 0; n < ARENA_FRAMES; n++) {
+		if (impl::frames[n]) {
+			Stats stats = impl::frames[n]->stats();
+			fprintf(out, "arena %u: %zu bytes used, high water %zu of %zu (%u heap allocations)\n",
+				n, stats.used, stats.highWater, stats.capacity, stats.overflows);
+		}
+	}
+	for (unsigned n = 0; n < ARENA_FRAMES; n++) {
+		if (impl::snaps[n]) {
+			Stats stats = impl::snaps[n]->stats();
+			fprintf(out, "snapshot arena %u: %zu bytes used, high water %zu of %zu (%u heap allocations)\n",
+				n, stats.used, stats.highWater, stats.capacity, stats.overflows);
+		}
+	}
+}
@@ -0,0 +1,379 @@
+#include "binding.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+//****************************************************************************/
+
+namespace impl {
+/**
+ * FNV-1a style mixing of one value into \a hash.
+ */
+static uint64_t mix(uint64_t hash, uint64_t value) {
+	for (unsigned n = 0; n < 8; n++) {
+		hash ^= (value >> (n * 8)) & 0xFF;
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+/**
+ * \return pointer as a hashable value
+ */
+static uint64_t bits(const void* ptr) {
+	return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ptr));
+}
+
+/*
+ * Entries are hashed and compared field by field (any padding being
+ * indeterminate).
+ */
+
+static uint64_t hash(uint64_t seed, const WGPUBindGroupLayoutEntry& e) {
+	uint64_t hash = seed;
+	hash = mix(hash, e.binding);
+	hash = mix(hash, e.visibility);
+	hash = mix(hash, e.buffer.type);
+	hash = mix(hash, e.buffer.hasDynamicOffset);
+	hash = mix(hash, e.buffer.minBindingSize);
+	hash = mix(hash, e.sampler.type);
+	hash = mix(hash, e.texture.sampleType);
+	hash = mix(hash, e.texture.viewDimension);
+	hash = mix(hash, e.texture.multisampled);
+	hash = mix(hash, e.storageTexture.access);
+	hash = mix(hash, e.storageTexture.format);
+	hash = mix(hash, e.storageTexture.viewDimension);
+	return hash;
+}
+
+static bool same(const WGPUBindGroupLayoutEntry& a, const WGPUBindGroupLayoutEntry& b) {
+	return a.binding    == b.binding
+		&& a.visibility == b.visibility
+		&& a.buffer.type             == b.buffer.type
+		&& a.buffer.hasDynamicOffset == b.buffer.hasDynamicOffset
+		&& a.buffer.minBindingSize   == b.buffer.minBindingSize
+		&& a.sampler.type            == b.sampler.type
+		&& a.texture.sampleType      == b.texture.sampleType
+		&& a.texture.viewDimension   == b.texture.viewDimension
+		&& a.texture.multisampled    == b.texture.multisampled
+		&& a.storageTexture.access        == b.storageTexture.access
+		&& a.storageTexture.format        == b.storageTexture.format
+		&& a.storageTexture.viewDimension == b.storageTexture.viewDimension;
+}
+
+static uint64_t hash(uint64_t seed, const WGPUBindGroupEntry& e) {
+	uint64_t hash = seed;
+	hash = mix(hash, e.binding);
+	hash = mix(hash, bits(e.buffer));
+	hash = mix(hash, e.offset);
+	hash = mix(hash, e.size);
+	hash = mix(hash, bits(e.sampler));
+	hash = mix(hash, bits(e.textureView));
+	return hash;
+}
+
+static bool same(const WGPUBindGroupEntry& a, const WGPUBindGroupEntry& b) {
+	return a.binding     == b.binding
+		&& a.buffer      == b.buffer
+		&& a.offset      == b.offset
+		&& a.size        == b.size
+		&& a.sampler     == b.sampler
+		&& a.textureView == b.textureView;
+}
+
+/**
+ * \return \c true if \a entry binds \a buffer
+ */
+static bool binds(const WGPUBindGroupEntry& entry, WGPUBuffer buffer) {
+	return entry.buffer == buffer;
+}
+
+/**
+ * \return \c true if \a entry binds \a view
+ */
+static bool binds(const WGPUBindGroupEntry& entry, WGPUTextureView view) {
+	return entry.textureView == view;
+}
+
+static WGPUDevice device = nullptr;
+
+static WGPUBindGroupLayout create(const void* /*owner*/, const WGPUBindGroupLayoutEntry* entries, size_t count) {
+	WGPUBindGroupLayoutDescriptor desc = {};
+	desc.entryCount = static_cast<uint32_t>(count);
+	desc.entries    = entries;
+	return wgpuDeviceCreateBindGroupLayout(device, &desc);
+}
+
+static WGPUBindGroup create(const void* owner, const WGPUBindGroupEntry* entries, size_t count) {
+	WGPUBindGroupDescriptor desc = {};
+	desc.layout     = static_cast<WGPUBindGroupLayout>(const_cast<void*>(owner));
+	desc.entryCount = static_cast<uint32_t>(count);
+	desc.entries    = entries;
+	return wgpuDeviceCreateBindGroup(device, &desc);
+}
+
+static void drop(WGPUBindGroupLayout layout) {
+	wgpuBindGroupLayoutRelease(layout);
+}
+
+static void drop(WGPUBindGroup group) {
+	wgpuBindGroupRelease(group);
+}
+
+/**
+ * Hash table of cached objects, looked up both by content (to share) and by
+ * handle (to release).
+ *
+ * \tparam Handle WebGPU object type
+ * \tparam Entry descriptor entry type
+ */
+template<typename Handle, typename Entry>
+struct Table {
+	struct Node {
+		Node* next;         ///< Next in the content bucket
+		Node* nextByHandle; ///< Next in the handle bucket
+		Handle handle;
+		uint64_t hash;
+		const void* owner;  ///< Layout (groups only)
+		Entry* entries;     ///< Copy of the descriptor's entries
+		size_t count;
+		unsigned refs;
+		bool cached;        ///< Cleared once invalidated (no longer found by content)
+	};
+
+	Node* byContent[BINDING_CACHE_BUCKETS];
+	Node* byHandle [BINDING_CACHE_BUCKETS];
+	unsigned size;
+	unsigned long long hits;
+	unsigned long long misses;
+
+	static size_t handleBucket(Handle handle) {
+		return (bits(handle) >> 4) & (BINDING_CACHE_BUCKETS - 1);
+	}
+
+	/**
+	 * Finds or creates the object for the descriptor contents, adding a reference.
+	 */
+	Handle acquire(const void* owner, const Entry* entries, size_t count) {
+		uint64_t key = mix(0xCBF29CE484222325ULL, bits(owner));
+		key = mix(key, count);
+		for (size_t n = 0; n < count; n++) {
+			key = hash(key, entries[n]);
+		}
+		Node** bucket = &byContent[key & (BINDING_CACHE_BUCKETS - 1)];
+		for (Node* node = *bucket; node; node = node->next) {
+			if (node->hash == key && node->owner == owner && node->count == count && matches(node->entries, entries, count)) {
+				node->refs++;
+				hits++;
+				return node->handle;
+			}
+		}
+		misses++;
+		Handle handle = create(owner, entries, count);
+		Node* node = static_cast<Node*>(malloc(sizeof(Node)));
+		if (!handle || !node) {
+			free(node);
+			return handle;
+		}
+		node->entries = static_cast<Entry*>(malloc(count * sizeof(Entry) + 1));
+		if (node->entries) {
+			memcpy(node->entries, entries, count * sizeof(Entry));
+		}
+		node->handle = handle;
+		node->hash   = key;
+		node->owner  = owner;
+		node->count  = (node->entries) ? count : 0;
+		node->refs   = 1;
+		node->cached = node->entries != nullptr;
+		node->next   = nullptr;
+		if (node->cached) {
+			node->next = *bucket;
+			*bucket = node;
+		}
+		Node** byRef = &byHandle[handleBucket(handle)];
+		node->nextByHandle = *byRef;
+		*byRef = node;
+		size++;
+		return handle;
+	}
+
+	static bool matches(const Entry* a, const Entry* b, size_t count) {
+		for (size_t n = 0; n < count; n++) {
+			if (!same(a[n], b[n])) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Unlinks \a node from its content bucket (leaving it findable by handle).
+	 */
+	void uncache(Node* node) {
+		if (node->cached) {
+			for (Node** link = &byContent[node->hash & (BINDING_CACHE_BUCKETS - 1)]; *link; link = &(*link)->next) {
+				if (*link == node) {
+					*link = node->next;
+					break;
+				}
+			}
+			node->cached = false;
+		}
+	}
+
+	/**
+	 * Unlinks and frees \a *link (in its handle bucket) and its object.
+	 */
+	void erase(Node** link) {
+		Node* node = *link;
+		*link = node->nextByHandle;
+		uncache(node);
+		drop(node->handle);
+		free(node->entries);
+		free(node);
+		size--;
+	}
+
+	/**
+	 * Gives back a reference, freeing the object if it's unreferenced and
+	 * no longer cached.
+	 */
+	void release(Handle handle) {
+		for (Node** link = &byHandle[handleBucket(handle)]; *link; link = &(*link)->nextByHandle) {
+			Node* node = *link;
+			if (node->handle == handle) {
+				if (node->refs > 0 && --node->refs == 0 && !node->cached) {
+					erase(link);
+				}
+				return;
+			}
+		}
+	}
+
+	/**
+	 * Frees the objects \a func matches.
+	 *
+	 * \param[in] func predicate taking a \c Node
+	 * \param[in] all free referenced objects as well (otherwise only unreferenced ones)
+	 */
+	template<typename Func>
+	void sweep(Func func, bool all) {
+		for (size_t b = 0; b < BINDING_CACHE_BUCKETS; b++) {
+			Node** link = &byHandle[b];
+			while (*link) {
+				if (func(**link) && (all || (*link)->refs == 0)) {
+					erase(link);
+				} else {
+					link = &(*link)->nextByHandle;
+				}
+			}
+		}
+	}
+};
+
+/**
+ * Sweep predicate matching every node.
+ */
+struct Any {
+	template<typename Node>
+	bool operator ()(const Node&) const {
+		return true;
+	}
+};
+
+/**
+ * Sweep predicate matching groups binding a given buffer or texture view
+ * (uncaching those it can't yet free).
+ *
+ * \tparam Resource \c WGPUBuffer or \c WGPUTextureView
+ */
+template<typename Resource>
+struct Binds {
+	Resource resource;
+	Table<WGPUBindGroup, WGPUBindGroupEntry>* table;
+	bool operator ()(Table<WGPUBindGroup, WGPUBindGroupEntry>::Node& node) const {
+		for (size_t n = 0; n < node.count; n++) {
+			if (binds(node.entries[n], resource)) {
+				table->uncache(&node);
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+static Table<WGPUBindGroupLayout, WGPUBindGroupLayoutEntry> layouts;
+static Table<WGPUBindGroup, WGPUBindGroupEntry> groups;
+
+/**
+ * \return hits as a percentage of all lookups
+ */
+static double rate(unsigned long long hits, unsigned long long misses) {
+	return (hits + misses) ? hits * 100.0 / (hits + misses) : 0.0;
+}
+}
+
+//******************************** Public API ********************************/
+
+void binding::init(WGPUDevice device) {
+	impl::device = device;
+}
+
+void binding::destroy() {
+	/*
+	 * Groups first, since they hold references to their layouts.
+	 */
+	impl::groups .sweep(impl::Any(), true);
+	impl::layouts.sweep(impl::Any(), true);
+	impl::device = nullptr;
+}
+
+WGPUBindGroupLayout binding::layout(const WGPUBindGroupLayoutDescriptor& desc) {
+	return impl::layouts.acquire(nullptr, desc.entries, desc.entryCount);
+}
+
+WGPUBindGroup binding::group(const WGPUBindGroupDescriptor& desc) {
+	return impl::groups.acquire(desc.layout, desc.entries, desc.entryCount);
+}
+
+void binding::release(WGPUBindGroupLayout layout) {
+	impl::layouts.release(layout);
+}
+
+void binding::release(WGPUBindGroup group) {
+	impl::groups.release(group);
+}
+
+void binding::invalidate(WGPUBuffer buffer) {
+	impl::Binds<WGPUBuffer> binds = {buffer, &impl::groups};
+	impl::groups.sweep(binds, false);
+}
+
+void binding::invalidate(WGPUTextureView view) {
+	impl::Binds<WGPUTextureView> binds = {view, &impl::groups};
+	impl::groups.sweep(binds, false);
+}
+
+void binding::trim() {
+	impl::groups .sweep(impl::Any(), false);
+	impl::layouts.sweep(impl::Any(), false);
+}
+
+binding::Stats binding::stats() {
+	Stats stats = {};
+	stats.layoutHits   = impl::layouts.hits;
+	stats.layoutMisses = impl::layouts.misses;
+	stats.groupHits    = impl::groups.hits;
+	stats.groupMisses  = impl::groups.misses;
+	stats.layouts = impl::layouts.size;
+	stats.groups  = impl::groups.size;
+	return stats;
+}
+
+void binding::print(FILE* out) {
+	Stats s = stats();
+	fprintf(out, "bind group layouts %u (%.1f%% hits), groups %u (%.1f%% hits)\n",
+		s.layouts, impl::rate(s.layoutHits, s.layoutMisses),
+		s.groups,  impl::rate(s.groupHits,  s.groupMisses));
+}
@@ -0,0 +1,266 @@
+#include "capture.h"
+
+#if WEBGPU_CAPTURE && !defined(__EMSCRIPTEN__)
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dawn/dawn_proc_table.h>
+#include <dawn/wire/WireClient.h>
+#include <dawn/wire/WireServer.h>
+
+#ifdef _MSC_VER
+#pragma comment(lib, "dawn_wire.dll.lib")
+#endif
+#endif
+
+//****************************************************************************/
+
+namespace impl {
+#if WEBGPU_CAPTURE && !defined(__EMSCRIPTEN__)
+/**
+ * Command buffer for one direction of the wire, handing its contents to the
+ * other side when flushed.
+ */
+class Buffer : public dawn::wire::CommandSerializer {
+public:
+	Buffer()
+		: target  (nullptr)
+		, data    (nullptr)
+		, spare   (nullptr)
+		, used    (0)
+		, capacity(0)
+		, flushing(false) {}
+
+	~Buffer() override {
+		free(data);
+		free(spare);
+	}
+
+	void* GetCmdSpace(size_t size) override {
+		if (used + size > capacity) {
+			if (!Flush() || used + size > capacity) {
+				/*
+				 * Still no room (the flush was re-entrant, or the command is
+				 * larger than the buffer) so grow both buffers to match.
+				 */
+				size_t grow = (capacity) ? capacity : 1024 * 1024;
+				while (grow < used + size) {
+					grow *= 2;
+				}
+				void* more = realloc(data, grow);
+				if (!more) {
+					return nullptr;
+				}
+				data = static_cast<char*>(more);
+				free(spare);
+				spare    = static_cast<char*>(malloc(grow));
+				capacity = (spare) ? grow : 0;
+				if (!spare) {
+					return nullptr;
+				}
+			}
+		}
+		void* space = data + used;
+		used += size;
+		return space;
+	}
+
+	/**
+	 * Swaps buffers then sends the pending commands, so any commands issued
+	 * while the other side handles them (from callbacks) queue up safely.
+	 * Re-entrant calls leave the commands for the outer flush's next pass.
+	 */
+	bool Flush() override {
+		if (flushing) {
+			return true;
+		}
+		flushing = true;
+		bool sent = true;
+		while (used > 0 && sent) {
+			char* send = data;
+			size_t size = used;
+			data  = spare;
+			spare = send;
+			used  = 0;
+			sent  = written(send, size) && target && target->HandleCommands(send, size) != nullptr;
+		}
+		flushing = false;
+		return sent;
+	}
+
+	size_t GetMaximumAllocationSize() const override {
+		return CAPTURE_MAX_ALLOCATION;
+	}
+
+	/**
+	 * Called with each batch of commands before sending them.
+	 *
+	 * \return \c false to drop the batch
+	 */
+	virtual bool written(const char* /*commands*/, size_t /*size*/) {
+		return true;
+	}
+
+	dawn::wire::CommandHandler* target; ///< Receiving side of the wire
+
+private:
+	char* data;  ///< Commands being serialised
+	char* spare; ///< Commands being sent
+	size_t used;
+	size_t capacity;
+	bool flushing;
+};
+
+/**
+ * Client to server buffer, appending everything it sends to the file.
+ */
+class Recorder : public Buffer {
+public:
+	Recorder()
+		: file(nullptr) {}
+
+	/**
+	 * Writes a chunk record (and its payload).
+	 */
+	bool chunk(uint32_t type, const void* payload, size_t size) {
+		capture::format::Chunk record = {};
+		record.type = type;
+		record.size = static_cast<uint32_t>(size);
+		return file
+			&& fwrite(&record, sizeof record, 1, file) == 1
+			&& (size == 0 || fwrite(payload, size, 1, file) == 1);
+	}
+
+	bool written(const char* commands, size_t size) override {
+		return chunk(capture::format::COMMANDS, commands, size);
+	}
+
+	FILE* file;
+};
+
+static DawnProcTable native;    ///< Real procs (for the server)
+static WGPUDevice device = nullptr; ///< Real device
+static WGPUDevice wired  = nullptr; ///< Client side of \c #device
+static Recorder toServer;
+static Buffer   toClient;
+static dawn::wire::WireClient* client = nullptr;
+static dawn::wire::WireServer* server = nullptr;
+#endif
+}
+
+//******************************** Public API ********************************/
+
+#if WEBGPU_CAPTURE && !defined(__EMSCRIPTEN__)
+WGPUDevice capture::begin(WGPUDevice device, const DawnProcTable& native, DawnProcTable* procs, const char* path) {
+	if (impl::client) {
+		return nullptr;
+	}
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		return nullptr;
+	}
+	impl::native = native;
+	impl::device = device;
+
+	dawn::wire::WireServerDescriptor serverDesc = {};
+	serverDesc.procs      = &impl::native;
+	serverDesc.serializer = &impl::toClient;
+	impl::server = new dawn::wire::WireServer(serverDesc);
+
+	dawn::wire::WireClientDescriptor clientDesc = {};
+	clientDesc.serializer = &impl::toServer;
+	impl::client = new dawn::wire::WireClient(clientDesc);
+
+	impl::toServer.file   = file;
+	impl::toServer.target = impl::server;
+	impl::toClient.target = impl::client;
+
+	dawn::wire::ReservedDevice reserved = impl::client->ReserveDevice();
+	impl::server->InjectDevice(device, reserved.id, reserved.generation);
+
+	format::Header header = {};
+	header.magic     = format::MAGIC;
+	header.version   = format::VERSION;
+	header.deviceId  = reserved.id;
+	header.deviceGen = reserved.generation;
+	fwrite(&header, sizeof header, 1, file);
+
+	*procs = dawn::wire::client::GetProcs();
+	impl::wired = reserved.device;
+	return reserved.device;
+}
+
+bool capture::active() {
+	return impl::client != nullptr;
+}
+
+WGPUSwapChain capture::inject(WGPUSwapChain swapchain, uint32_t width, uint32_t height, WGPUTextureFormat format) {
+	if (!impl::client) {
+		return swapchain;
+	}
+	/*
+	 * Pending commands are flushed first so the file has them before the
+	 * swap chain record (which replay injects on reading).
+	 */
+	impl::toServer.Flush();
+	dawn::wire::ReservedSwapChain reserved = impl::client->ReserveSwapChain(impl::wired);
+	impl::server->InjectSwapChain(swapchain, reserved.id, reserved.generation, reserved.deviceId, reserved.deviceGeneration);
+
+	format::SwapChain record = {};
+	record.id        = reserved.id;
+	record.gen       = reserved.generation;
+	record.deviceId  = reserved.deviceId;
+	record.deviceGen = reserved.deviceGeneration;
+	record.width     = width;
+	record.height    = height;
+	record.format    = static_cast<uint32_t>(format);
+	impl::toServer.chunk(format::SWAPCHAIN, &record, sizeof record);
+	return reserved.swapchain;
+}
+
+void capture::frame() {
+	if (impl::client) {
+		impl::toServer.Flush();
+		impl::toServer.chunk(format::FRAME, nullptr, 0);
+		/*
+		 * The server doesn't tick the device by itself; ticking fires the
+		 * callbacks, whose replies are then flushed back to the client.
+		 */
+		impl::native.deviceTick(impl::device);
+		impl::toClient.Flush();
+	}
+}
+
+void capture::end() {
+	if (impl::client) {
+		impl::toServer.Flush();
+		impl::client->Disconnect();
+		delete impl::client;
+		delete impl::server;
+		impl::client = nullptr;
+		impl::server = nullptr;
+		impl::toServer.target = nullptr;
+		impl::toClient.target = nullptr;
+		fclose(impl::toServer.file);
+		impl::toServer.file = nullptr;
+		impl::device = nullptr;
+		impl::wired  = nullptr;
+	}
+}
+#else
+WGPUDevice capture::begin(WGPUDevice, const DawnProcTable&, DawnProcTable*, const char*) {
+	return nullptr;
+}
+
+bool capture::active() {
+	return false;
+}
+
+WGPUSwapChain capture::inject(WGPUSwapChain swapchain, uint32_t, uint32_t, WGPUTextureFormat) {
+	return swapchain;
+}
+
+void capture::frame() {}
+
+void capture::end() {}
+#endif
@@ -0,0 +1,332 @@
+#include "draw.h"
+
+#include <string.h>
+
+#include "arena.h"
+#include "jobs.h"
+
+//****************************************************************************/
+
+namespace impl {
+/**
+ * Maximum number of slices the keys are split into when sorting.
+ */
+static const unsigned SLICES = JOBS_MAX_WORKERS + 1;
+
+/**
+ * Key plus the index of its packet (sorting these rather than the packets).
+ */
+struct Entry {
+	uint64_t key;
+	uint32_t index;
+};
+
+/**
+ * State shared by the sort jobs. Each job works on one slice of the keys.
+ */
+struct Sort {
+	const Entry* src;
+	Entry* dst;
+	size_t count;
+	size_t slice;   ///< Keys per slice
+	unsigned shift; ///< Bit offset of the byte being sorted
+	uint64_t diff[SLICES];          ///< Per-slice OR of each key with the first key
+	uint32_t hist[SLICES][256];     ///< Per-slice counts (turned into write offsets)
+};
+
+/**
+ * Finds the range of keys in the \a n th slice.
+ */
+static void bounds(const Sort& sort, size_t n, size_t& beg, size_t& end) {
+	beg = n * sort.slice;
+	end = beg + sort.slice;
+	if (end > sort.count) {
+		end = sort.count;
+	}
+}
+
+/**
+ * Finds which bits differ between keys (adheres to \c jobs#Range).
+ */
+static void diffJob(size_t first, size_t last, void* user) {
+	Sort& sort = *static_cast<Sort*>(user);
+	uint64_t base = sort.src[0].key;
+	for (size_t n = first; n < last; n++) {
+		size_t beg, end;
+		bounds(sort, n, beg, end);
+		uint64_t diff = 0;
+		for (size_t i = beg; i < end; i++) {
+			diff |= sort.src[i].key ^ base;
+		}
+		sort.diff[n] = diff;
+	}
+}
+
+/**
+ * Counts the current byte's digits per slice (adheres to \c jobs#Range).
+ */
+static void countJob(size_t first, size_t last, void* user) {
+	Sort& sort = *static_cast<Sort*>(user);
+	for (size_t n = first; n < last; n++) {
+		size_t beg, end;
+		bounds(sort, n, beg, end);
+		uint32_t* hist = sort.hist[n];
+		memset(hist, 0, sizeof(sort.hist[n]));
+		for (size_t i = beg; i < end; i++) {
+			hist[(sort.src[i].key >> sort.shift) & 0xFF]++;
+		}
+	}
+}
+
+/**
+ * Scatters each slice to its offsets (adheres to \c jobs#Range). Slices
+ * write to disjoint ranges in slice order, keeping the sort stable.
+ */
+static void scatterJob(size_t first, size_t last, void* user) {
+	Sort& sort = *static_cast<Sort*>(user);
+	for (size_t n = first; n < last; n++) {
+		size_t beg, end;
+		bounds(sort, n, beg, end);
+		uint32_t* offs = sort.hist[n];
+		for (size_t i = beg; i < end; i++) {
+			sort.dst[offs[(sort.src[i].key >> sort.shift) & 0xFF]++] = sort.src[i];
+		}
+	}
+}
+
+/**
+ * Packets (and their keys) first allocated each frame, before growing.
+ */
+static const size_t MIN_PACKETS = 64;
+
+/**
+ * \return bits \a bits wide from \a value shifted to \a shift
+ */
+static uint64_t field(unsigned value, unsigned bits, unsigned shift) {
+	return (static_cast<uint64_t>(value) & ((1ULL << bits) - 1)) << shift;
+}
+}
+
+/**
+ * Queue storage. The packets and keys are taken from the frame's arena (see
+ * \c arena#frame()) on the first push after a clear, sized for the busiest
+ * frame so far, so queuing and sorting never touch the heap.
+ */
+struct draw::Queue::Impl {
+	Impl()
+		: packets (nullptr)
+		, entries (nullptr)
+		, count   (0)
+		, capacity(0)
+		, peak    (impl::MIN_PACKETS)
+		, stats() {}
+
+	/**
+	 * Moves the packets and keys to larger arrays (the old ones going back
+	 * with the arena's reset).
+	 *
+	 * \return \c false if already at \c #DRAW_MAX_PACKETS (or out of memory)
+	 */
+	bool grow() {
+		size_t more = (capacity) ? capacity * 2 : peak;
+		if (more > DRAW_MAX_PACKETS) {
+			more = DRAW_MAX_PACKETS;
+		}
+		if (more <= capacity) {
+			return false;
+		}
+		arena::Arena& frame = arena::frame();
+		Packet* morePackets = frame.alloc<Packet>(more);
+		impl::Entry* moreEntries = static_cast<impl::Entry*>(frame.alloc(more * sizeof(impl::Entry), alignof(impl::Entry)));
+		if (!morePackets || !moreEntries) {
+			return false;
+		}
+		if (count) {
+			memcpy(morePackets, packets, count * sizeof(Packet));
+			memcpy(moreEntries, entries, count * sizeof(impl::Entry));
+		}
+		packets  = morePackets;
+		entries  = moreEntries;
+		capacity = more;
+		if (peak < more) {
+			peak = more;
+		}
+		return true;
+	}
+
+	Packet* packets;
+	impl::Entry* entries; ///< Sorted keys
+	size_t count;
+	size_t capacity;      ///< Size of \c #packets and \c #entries this frame
+	size_t peak;          ///< Largest \c #capacity needed so far
+	Stats stats;
+};
+
+//******************************** Public API ********************************/
+
+uint64_t draw::key(unsigned pass, unsigned pipeline, unsigned material, unsigned mesh, float depth) {
+	if (!(depth > 0.0f)) {
+		depth = 0.0f;
+	}
+	if (depth > 1.0f) {
+		depth = 1.0f;
+	}
+	unsigned z = static_cast<unsigned>(depth * ((1U << DEPTH_BITS) - 1) + 0.5f);
+	return impl::field(pass,     PASS_BITS,     DEPTH_BITS + MESH_BITS + MATERIAL_BITS + PIPELINE_BITS)
+		 | impl::field(pipeline, PIPELINE_BITS, DEPTH_BITS + MESH_BITS + MATERIAL_BITS)
+		 | impl::field(material, MATERIAL_BITS, DEPTH_BITS + MESH_BITS)
+		 | impl::field(mesh,     MESH_BITS,     DEPTH_BITS)
+		 | impl::field(z,        DEPTH_BITS,    0);
+}
+
+draw::Queue::Queue()
+	: impl(new Impl()) {}
+
+draw::Queue::~Queue() {
+	delete impl;
+}
+
+void draw::Queue::clear() {
+	impl->packets  = nullptr;
+	impl->entries  = nullptr;
+	impl->count    = 0;
+	impl->capacity = 0;
+	impl->stats = Stats();
+}
+
+bool draw::Queue::push(const Packet& packet) {
+	if (impl->count == impl->capacity && !impl->grow()) {
+		return false;
+	}
+	impl->packets[impl->count] = packet;
+	impl->entries[impl->count].key   = packet.key;
+	impl->entries[impl->count].index = static_cast<uint32_t>(impl->count);
+	impl->count++;
+	return true;
+}
+
+void draw::Queue::sort() {
+	size_t count = impl->count;
+	if (count < 2) {
+		return;
+	}
+	/*
+	 * The sort's other buffer and working state (kept off the stack, the
+	 * histograms being large) only last the frame too.
+	 */
+	arena::Arena& frame = arena::frame();
+	impl::Entry* scratch = static_cast<impl::Entry*>(frame.alloc(count * sizeof(impl::Entry), alignof(impl::Entry)));
+	impl::Sort* state = static_cast<impl::Sort*>(frame.alloc(sizeof(impl::Sort), alignof(impl::Sort)));
+	if (!scratch || !state) {
+		return;
+	}
+	impl::Sort& sort = *state;
+	size_t slices = (count + DRAW_SORT_GRAIN - 1) / DRAW_SORT_GRAIN;
+	if (slices > jobs::count()) {
+		slices = jobs::count();
+	}
+	if (slices > impl::SLICES) {
+		slices = impl::SLICES;
+	}
+	sort.src   = impl->entries;
+	sort.dst   = scratch;
+	sort.count = count;
+	sort.slice = (count + slices - 1) / slices;
+	/*
+	 * Bytes where every key is the same don't change the order, so are
+	 * skipped (typically the pass and pipeline, for most of a frame).
+	 */
+	jobs::parallel(slices, 1, impl::diffJob, &sort);
+	uint64_t diff = 0;
+	for (size_t n = 0; n < slices; n++) {
+		diff |= sort.diff[n];
+	}
+	for (unsigned shift = 0; shift < 64; shift += 8) {
+		if (((diff >> shift) & 0xFF) == 0) {
+			continue;
+		}
+		sort.shift = shift;
+		jobs::parallel(slices, 1, impl::countJob, &sort);
+		uint32_t total = 0;
+		for (unsigned digit = 0; digit < 256; digit++) {
+			for (size_t n = 0; n < slices; n++) {
+				uint32_t num = sort.hist[n][digit];
+				sort.hist[n][digit] = total;
+				total += num;
+			}
+		}
+		jobs::parallel(slices, 1, impl::scatterJob, &sort);
+		impl::Entry* swap = sort.dst;
+		sort.dst = const_cast<impl::Entry*>(sort.src);
+		sort.src = swap;
+	}
+	if (sort.src != impl->entries) {
+		memcpy(impl->entries, sort.src, count * sizeof(impl::Entry));
+	}
+}
+
+void draw::Queue::encode(WGPURenderPassEncoder encoder, unsigned pass) {
+	const unsigned shift = DEPTH_BITS + MESH_BITS + MATERIAL_BITS + PIPELINE_BITS;
+	/*
+	 * Sorted by pass first, so the pass's draws are contiguous.
+	 */
+	size_t beg = 0;
+	size_t end = impl->count;
+	while (beg < end) {
+		size_t mid = beg + (end - beg) / 2;
+		if ((impl->entries[mid].key >> shift) < pass) {
+			beg = mid + 1;
+		} else {
+			end = mid;
+		}
+	}
+	WGPURenderPipeline pipeline = nullptr;
+	WGPUBindGroup bindGroup = nullptr;
+	WGPUBuffer vertBuf = nullptr;
+	WGPUBuffer indxBuf = nullptr;
+	WGPUIndexFormat indxFmt = WGPUIndexFormat_Undefined;
+	Stats& stats = impl->stats;
+	for (size_t n = beg; n < impl->count && (impl->entries[n].key >> shift) == pass; n++) {
+		const Packet& draw = impl->packets[impl->entries[n].index];
+		if (draw.pipeline != pipeline) {
+			wgpuRenderPassEncoderSetPipeline(encoder, draw.pipeline);
+			pipeline = draw.pipeline;
+			stats.pipelines++;
+		} else {
+			stats.avoided++;
+		}
+		if (draw.bindGroup != bindGroup) {
+			wgpuRenderPassEncoderSetBindGroup(encoder, 0, draw.bindGroup, 0, nullptr);
+			bindGroup = draw.bindGroup;
+			stats.bindGroups++;
+		} else {
+			stats.avoided++;
+		}
+		if (draw.vertBuf != vertBuf) {
+			wgpuRenderPassEncoderSetVertexBuffer(encoder, 0, draw.vertBuf, 0, WGPU_WHOLE_SIZE);
+			vertBuf = draw.vertBuf;
+			stats.vertexBuffers++;
+		} else {
+			stats.avoided++;
+		}
+		if (draw.indxBuf != indxBuf || draw.indxFmt != indxFmt) {
+			wgpuRenderPassEncoderSetIndexBuffer(encoder, draw.indxBuf, draw.indxFmt, 0, WGPU_WHOLE_SIZE);
+			indxBuf = draw.indxBuf;
+			indxFmt = draw.indxFmt;
+			stats.indexBuffers++;
+		} else {
+			stats.avoided++;
+		}
+		wgpuRenderPassEncoderDrawIndexed(encoder, draw.indexCount, draw.instanceCount,
+			draw.firstIndex, draw.baseVertex, draw.firstInstance);
+		stats.draws++;
+	}
+}
+
+size_t draw::Queue::size() const {
+	return impl->count;
+}
+
+const draw::Stats& draw::Queue::stats() const {
+	return impl->stats;
+}
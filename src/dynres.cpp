@@ -0,0 +1,244 @@
+#include "dynres.h"
+
+#include "binding.h"
+
+//****************************************************************************/
+
+namespace impl {
+/**
+ * Number of steps above \c #DYNRES_MIN (the last being full resolution).
+ */
+static const unsigned STEPS = static_cast<unsigned>((1.0f - DYNRES_MIN) / DYNRES_STEP + 0.5f);
+
+/**
+ * Weight of each new frame time in the average.
+ */
+static const double SMOOTHING = 0.1;
+
+/**
+ * Full-screen triangle sampling the scaled scene.
+ */
+static char const upscale_wgsl[] = R"(
+	struct VertexOut {
+		@location(0) vUV : vec2<f32>;
+		@builtin(position) Position : vec4<f32>;
+	};
+	@group(0) @binding(0) var tScene : texture_2d<f32>;
+	@group(0) @binding(1) var sScene : sampler;
+	@stage(vertex)
+	fn vert(@builtin(vertex_index) index : u32) -> VertexOut {
+		var uv = vec2<f32>(f32((index << 1u) & 2u), f32(index & 2u));
+		var output : VertexOut;
+		output.Position = vec4<f32>(uv.x * 2.0 - 1.0, 1.0 - uv.y * 2.0, 0.0, 1.0);
+		output.vUV = uv;
+		return output;
+	}
+	@stage(fragment)
+	fn frag(@location(0) vUV : vec2<f32>) -> @location(0) vec4<f32> {
+		return textureSample(tScene, sScene, vUV);
+	}
+)";
+}
+
+/**
+ * Upscale pipeline plus the pass's per-frame inputs.
+ */
+struct dynres::Upscaler::Impl {
+	Impl(WGPUDevice device, WGPUTextureFormat format)
+		: src(graph::NONE) {
+		WGPUBindGroupLayoutEntry entries[2] = {};
+		entries[0].binding    = 0;
+		entries[0].visibility = WGPUShaderStage_Fragment;
+		entries[0].texture.sampleType    = WGPUTextureSampleType_Float;
+		entries[0].texture.viewDimension = WGPUTextureViewDimension_2D;
+		entries[1].binding    = 1;
+		entries[1].visibility = WGPUShaderStage_Fragment;
+		entries[1].sampler.type = WGPUSamplerBindingType_Filtering;
+		WGPUBindGroupLayoutDescriptor layoutDesc = {};
+		layoutDesc.entryCount = 2;
+		layoutDesc.entries    = entries;
+		layout = binding::layout(layoutDesc);
+
+		WGPUSamplerDescriptor samplerDesc = {};
+		samplerDesc.addressModeU  = WGPUAddressMode_ClampToEdge;
+		samplerDesc.addressModeV  = WGPUAddressMode_ClampToEdge;
+		samplerDesc.addressModeW  = WGPUAddressMode_ClampToEdge;
+		samplerDesc.magFilter     = WGPUFilterMode_Linear;
+		samplerDesc.minFilter     = WGPUFilterMode_Linear;
+		samplerDesc.mipmapFilter  = WGPUFilterMode_Nearest;
+		samplerDesc.lodMaxClamp   = 32.0f;
+		samplerDesc.maxAnisotropy = 1;
+		sampler = wgpuDeviceCreateSampler(device, &samplerDesc);
+
+		WGPUShaderModuleWGSLDescriptor wgsl = {};
+		wgsl.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor;
+		wgsl.source = impl::upscale_wgsl;
+		WGPUShaderModuleDescriptor moduleDesc = {};
+		moduleDesc.nextInChain = reinterpret_cast<WGPUChainedStruct*>(&wgsl);
+		moduleDesc.label = "upscale";
+		WGPUShaderModule module = wgpuDeviceCreateShaderModule(device, &moduleDesc);
+
+		WGPUPipelineLayoutDescriptor pipeLayoutDesc = {};
+		pipeLayoutDesc.bindGroupLayoutCount = 1;
+		pipeLayoutDesc.bindGroupLayouts = &layout;
+		WGPUPipelineLayout pipeLayout = wgpuDeviceCreatePipelineLayout(device, &pipeLayoutDesc);
+
+		WGPUColorTargetState target = {};
+		target.format    = format;
+		target.writeMask = WGPUColorWriteMask_All;
+		WGPUFragmentState fragment = {};
+		fragment.module      = module;
+		fragment.entryPoint  = "frag";
+		fragment.targetCount = 1;
+		fragment.targets     = &target;
+
+		WGPURenderPipelineDescriptor desc = {};
+		desc.label  = "upscale";
+		desc.layout = pipeLayout;
+		desc.vertex.module     = module;
+		desc.vertex.entryPoint = "vert";
+		desc.fragment = &fragment;
+		desc.multisample.count = 1;
+		desc.multisample.mask  = 0xFFFFFFFF;
+		desc.primitive.topology  = WGPUPrimitiveTopology_TriangleList;
+		desc.primitive.frontFace = WGPUFrontFace_CCW;
+		desc.primitive.cullMode  = WGPUCullMode_None;
+		pipeline = wgpuDeviceCreateRenderPipeline(device, &desc);
+
+		wgpuPipelineLayoutRelease(pipeLayout);
+		wgpuShaderModuleRelease(module);
+	}
+
+	~Impl() {
+		wgpuRenderPipelineRelease(pipeline);
+		wgpuSamplerRelease(sampler);
+		binding::release(layout);
+	}
+
+	/**
+	 * Pass contents (the \c graph#Execute callback).
+	 */
+	static void execute(WGPURenderPassEncoder pass, const graph::Graph& graph, void* user) {
+		Impl* impl = static_cast<Impl*>(user);
+		/*
+		 * The graph keeps the same pooled texture (and view) for as long as
+		 * the scale doesn't change, so the cached group is reused.
+		 */
+		WGPUBindGroupEntry entries[2] = {};
+		entries[0].binding     = 0;
+		entries[0].textureView = graph.view(impl->src);
+		entries[1].binding     = 1;
+		entries[1].sampler     = impl->sampler;
+		WGPUBindGroupDescriptor desc = {};
+		desc.layout     = impl->layout;
+		desc.entryCount = 2;
+		desc.entries    = entries;
+		WGPUBindGroup group = binding::group(desc);
+		wgpuRenderPassEncoderSetPipeline(pass, impl->pipeline);
+		wgpuRenderPassEncoderSetBindGroup(pass, 0, group, 0, nullptr);
+		wgpuRenderPassEncoderDraw(pass, 3, 1, 0, 0);
+		binding::release(group);
+	}
+
+	WGPUBindGroupLayout layout;
+	WGPUSampler sampler;
+	WGPURenderPipeline pipeline;
+	graph::Resource src; ///< Current frame's scaled scene
+};
+
+//******************************** Public API ********************************/
+
+dynres::Controller::Controller(double budget)
+	: target (budget)
+	, average(0.0)
+	, step   (impl::STEPS)
+	, calm   (0)
+	, settle (0)
+	, changed(0) {}
+
+bool dynres::Controller::update(double cpuMs, double gpuMs) {
+	double ms = (cpuMs > gpuMs) ? cpuMs : gpuMs;
+	if (ms <= 0.0) {
+		return false;
+	}
+	if (settle) {
+		settle--;
+		return false;
+	}
+	average = (average > 0.0) ? average + (ms - average) * impl::SMOOTHING : ms;
+	unsigned next = step;
+	if (ms > target * DYNRES_SPIKE || average > target) {
+		calm = 0;
+		if (step > 0) {
+			next = step - 1;
+		}
+	} else {
+		if (average < target * DYNRES_HEADROOM) {
+			if (++calm >= DYNRES_RAISE_FRAMES && step < impl::STEPS) {
+				next = step + 1;
+			}
+		} else {
+			calm = 0;
+		}
+	}
+	if (next == step) {
+		return false;
+	}
+	step    = next;
+	average = 0.0;
+	calm    = 0;
+	settle  = DYNRES_SETTLE_FRAMES;
+	changed++;
+	return true;
+}
+
+float dynres::Controller::factor() const {
+	return (step < impl::STEPS) ? DYNRES_MIN + DYNRES_STEP * step : 1.0f;
+}
+
+bool dynres::Controller::size(uint32_t outW, uint32_t outH, uint32_t& w, uint32_t& h) const {
+	float f = factor();
+	if (f >= 1.0f) {
+		w = outW;
+		h = outH;
+		return false;
+	}
+	w = (static_cast<uint32_t>(outW * f) + DYNRES_ALIGN - 1) / DYNRES_ALIGN * DYNRES_ALIGN;
+	h = (static_cast<uint32_t>(outH * f) + DYNRES_ALIGN - 1) / DYNRES_ALIGN * DYNRES_ALIGN;
+	if (w > outW) {
+		w = outW;
+	}
+	if (h > outH) {
+		h = outH;
+	}
+	return w != outW || h != outH;
+}
+
+void dynres::Controller::budget(double ms) {
+	target  = ms;
+	average = 0.0;
+	calm    = 0;
+}
+
+dynres::Upscaler::Upscaler(WGPUDevice device, WGPUTextureFormat format)
+	: impl(new Impl(device, format)) {}
+
+dynres::Upscaler::~Upscaler() {
+	delete impl;
+}
+
+void dynres::Upscaler::addPass(graph::Graph& graph, graph::Resource src, graph::Resource dst) {
+	impl->src = src;
+	graph::PassDesc pass = {};
+	pass.name = "upscale";
+	pass.color[0]   = dst;
+	pass.colorCount = 1;
+	pass.depth      = graph::NONE;
+	pass.reads[0]   = src;
+	pass.readCount  = 1;
+	pass.writes     = graph::NONE;
+	pass.clear      = true; // every pixel is drawn, so nothing to load
+	pass.execute    = Impl::execute;
+	pass.user       = impl;
+	graph.addPass(pass);
+}
@@ -0,0 +1,519 @@
+#include "ecs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "jobs.h"
+
+#if FRAME_THREADED
+#include <mutex>
+#endif
+
+//****************************************************************************/
+
+namespace impl {
+/**
+ * Registered component sizes and alignments (indexed by \c ecs#Component).
+ */
+static size_t sizes [ECS_MAX_COMPONENTS];
+static size_t aligns[ECS_MAX_COMPONENTS];
+static std::atomic<unsigned> types(0);
+
+/**
+ * Entity index bits of an \c ecs#Entity (the rest being its generation).
+ */
+const uint32_t INDEX_BITS = 24;
+const uint32_t INDEX_MASK = (1 << INDEX_BITS) - 1;
+
+/**
+ * Archetype of an entity not (or no longer) stored in a chunk.
+ */
+const uint16_t UNPLACED = 0xFFFF;
+
+/**
+ * Queued structural change (followed by \c #size bytes of component data,
+ * padded to four bytes).
+ */
+struct Command {
+	enum Op {
+		OP_CREATE,
+		OP_DESTROY,
+		OP_ADD,
+		OP_REMOVE,
+		OP_SET,
+	};
+	uint32_t op;
+	ecs::Entity entity;
+	uint32_t value; ///< Component set (create) or component type
+	uint32_t size;  ///< Bytes of component data following
+};
+
+/**
+ * Chunk of entities (the entity handles, then each component's array).
+ */
+struct Block {
+	uint8_t* data;
+	unsigned count;
+};
+
+/**
+ * Entities sharing a component set, and the layout of their chunks.
+ */
+struct Archetype {
+	ecs::Mask mask;
+	uint32_t offsets[ECS_MAX_COMPONENTS]; ///< Offset of each component's array (zero if absent)
+	unsigned capacity; ///< Entities per chunk
+	size_t bytes;      ///< Chunk size in bytes
+	Block* blocks;     ///< Chunks, all full apart from the last
+	unsigned blockCount;
+	unsigned blockCapacity;
+	unsigned total;    ///< Entities across all chunks
+};
+
+/**
+ * Where an entity is stored.
+ */
+struct Slot {
+	uint16_t type;  ///< Archetype index (or \c #UNPLACED)
+	uint16_t pad;
+	uint32_t block;
+	uint32_t row;
+};
+
+/**
+ * Grows \a array to hold at least \a needed items (doubling, aborting if out
+ * of memory, as \c new would).
+ */
+template<typename T>
+static void reserve(T*& array, unsigned& capacity, unsigned needed) {
+	if (needed > capacity) {
+		unsigned grown = (capacity) ? capacity * 2 : 16;
+		while (grown < needed) {
+			grown *= 2;
+		}
+		T* moved = static_cast<T*>(realloc(array, grown * sizeof(T)));
+		if (!moved) {
+			abort();
+		}
+		array    = moved;
+		capacity = grown;
+	}
+}
+
+/**
+ * Work shared with the job workers by \c ecs#World#each().
+ */
+struct Pass {
+	const ecs::Chunk* chunks;
+	ecs::System func;
+	void* user;
+};
+
+/**
+ * Runs a pass's system over a range of its chunks (see \c jobs#Range).
+ */
+static void run(size_t begin, size_t end, void* user) {
+	const Pass* pass = static_cast<const Pass*>(user);
+	for (size_t n = begin; n < end; n++) {
+		pass->func(pass->chunks[n], pass->user);
+	}
+}
+}
+
+struct ecs::World::Impl {
+	Impl(unsigned capacity)
+		: capacity   (capacity)
+		, slots      (new impl::Slot[capacity])
+		, gens       (new uint8_t   [capacity]())
+		, spare      (new uint32_t  [capacity])
+		, freed      (new uint32_t  [capacity])
+		, spareCount (0)
+		, freedCount (0)
+		, handles    (0)
+		, typeCount  (0)
+		, queue      (nullptr)
+		, queueUsed  (0)
+		, queueSize  (0)
+		, views      (nullptr)
+		, viewSize   (0) {}
+
+	~Impl() {
+		for (unsigned t = 0; t < typeCount; t++) {
+			for (unsigned n = 0; n < types[t].blockCount; n++) {
+				free(types[t].blocks[n].data);
+			}
+			free(types[t].blocks);
+		}
+		free(views);
+		free(queue);
+		delete[] freed;
+		delete[] spare;
+		delete[] gens;
+		delete[] slots;
+	}
+
+	/**
+	 * \return \c true if \a entity is the current user of its index
+	 */
+	bool valid(Entity entity) const {
+		uint32_t index = entity & impl::INDEX_MASK;
+		return entity != NONE && index < handles && gens[index] == (entity >> impl::INDEX_BITS);
+	}
+
+	/**
+	 * Queues a change (thread safe).
+	 */
+	void push(impl::Command::Op op, Entity entity, uint32_t value, const void* data, size_t size) {
+	#if FRAME_THREADED
+		std::lock_guard<std::mutex> hold(lock);
+	#endif
+		size_t bytes = sizeof(impl::Command) + ((size + 3) & ~3);
+		if (queueUsed + bytes > queueSize) {
+			size_t grown = (queueSize) ? queueSize * 2 : 4096;
+			while (grown < queueUsed + bytes) {
+				grown *= 2;
+			}
+			uint8_t* moved = static_cast<uint8_t*>(realloc(queue, grown));
+			if (!moved) {
+				abort();
+			}
+			queue     = moved;
+			queueSize = grown;
+		}
+		impl::Command cmd = {static_cast<uint32_t>(op), entity, value, static_cast<uint32_t>(size)};
+		memcpy(queue + queueUsed, &cmd, sizeof cmd);
+		if (size) {
+			memcpy(queue + queueUsed + sizeof cmd, data, size);
+		}
+		queueUsed += bytes;
+	}
+
+	/**
+	 * \return index of the archetype for \a mask (created if needed, or \c #UNPLACED if too many)
+	 */
+	uint16_t archetype(Mask mask) {
+		for (unsigned t = 0; t < typeCount; t++) {
+			if (types[t].mask == mask) {
+				return static_cast<uint16_t>(t);
+			}
+		}
+		if (typeCount == ECS_MAX_ARCHETYPES) {
+			return impl::UNPLACED;
+		}
+		/*
+		 * As many entities as fit in a chunk, each component's array aligned
+		 * for its type (one entity per chunk if even that doesn't fit).
+		 */
+		impl::Archetype& type = types[typeCount];
+		memset(&type, 0, sizeof type);
+		type.mask = mask;
+		size_t row = sizeof(Entity);
+		for (unsigned c = 0; c < ECS_MAX_COMPONENTS; c++) {
+			if (mask & (1u << c)) {
+				row += impl::sizes[c];
+			}
+		}
+		unsigned fit = static_cast<unsigned>(ECS_CHUNK_SIZE / row);
+		for (type.capacity = (fit) ? fit : 1;; type.capacity--) {
+			size_t end = sizeof(Entity) * type.capacity;
+			for (unsigned c = 0; c < ECS_MAX_COMPONENTS; c++) {
+				if (mask & (1u << c)) {
+					end = (end + impl::aligns[c] - 1) & ~(impl::aligns[c] - 1);
+					type.offsets[c] = static_cast<uint32_t>(end);
+					end += impl::sizes[c] * type.capacity;
+				}
+			}
+			type.bytes = end;
+			if (end <= ECS_CHUNK_SIZE || type.capacity == 1) {
+				break;
+			}
+		}
+		return static_cast<uint16_t>(typeCount++);
+	}
+
+	/**
+	 * Appends entity \a index to the archetype \a t's last chunk, zeroing its
+	 * components.
+	 */
+	void place(uint32_t index, uint16_t t) {
+		impl::Archetype& type = types[t];
+		if (type.blockCount == 0 || type.blocks[type.blockCount - 1].count == type.capacity) {
+			impl::reserve(type.blocks, type.blockCapacity, type.blockCount + 1);
+			impl::Block& block = type.blocks[type.blockCount++];
+			block.data  = static_cast<uint8_t*>(malloc(type.bytes));
+			block.count = 0;
+			if (!block.data) {
+				abort();
+			}
+		}
+		uint32_t b = type.blockCount - 1;
+		impl::Block& block = type.blocks[b];
+		uint32_t row = block.count++;
+		reinterpret_cast<Entity*>(block.data)[row] = index | (static_cast<uint32_t>(gens[index]) << impl::INDEX_BITS);
+		for (unsigned c = 0; c < ECS_MAX_COMPONENTS; c++) {
+			if (type.offsets[c]) {
+				memset(block.data + type.offsets[c] + impl::sizes[c] * row, 0, impl::sizes[c]);
+			}
+		}
+		type.total++;
+		impl::Slot& slot = slots[index];
+		slot.type  = t;
+		slot.block = b;
+		slot.row   = row;
+	}
+
+	/**
+	 * Removes the entity stored at \a from, moving the archetype's last entity
+	 * into its place.
+	 */
+	void erase(const impl::Slot& from) {
+		impl::Archetype& type = types[from.type];
+		uint32_t b = type.blockCount - 1;
+		impl::Block& last = type.blocks[b];
+		uint32_t row = last.count - 1;
+		if (from.block != b || from.row != row) {
+			impl::Block& hole = type.blocks[from.block];
+			Entity moved = reinterpret_cast<Entity*>(last.data)[row];
+			reinterpret_cast<Entity*>(hole.data)[from.row] = moved;
+			for (unsigned c = 0; c < ECS_MAX_COMPONENTS; c++) {
+				if (type.offsets[c]) {
+					memcpy(hole.data + type.offsets[c] + impl::sizes[c] * from.row,
+						   last.data + type.offsets[c] + impl::sizes[c] * row, impl::sizes[c]);
+				}
+			}
+			slots[moved & impl::INDEX_MASK] = from;
+		}
+		type.total--;
+		if (--last.count == 0) {
+			free(last.data);
+			type.blockCount--;
+		}
+	}
+
+	/**
+	 * Moves entity \a index to the archetype for \a mask, keeping the
+	 * components the two share.
+	 */
+	void move(uint32_t index, Mask mask) {
+		uint16_t t = archetype(mask);
+		if (t == impl::UNPLACED) {
+			return;
+		}
+		impl::Slot from = slots[index];
+		const impl::Archetype& src = types[from.type];
+		const uint8_t* data = src.blocks[from.block].data;
+		place(index, t);
+		const impl::Slot& to = slots[index];
+		const impl::Archetype& dst = types[t];
+		uint8_t* dest = dst.blocks[to.block].data;
+		for (unsigned c = 0; c < ECS_MAX_COMPONENTS; c++) {
+			if (src.offsets[c] && dst.offsets[c]) {
+				memcpy(dest + dst.offsets[c] + impl::sizes[c] * to.row,
+					   data + src.offsets[c] + impl::sizes[c] * from.row, impl::sizes[c]);
+			}
+		}
+		erase(from);
+	}
+
+	/**
+	 * \return entity \a index's component \a c (or \c null if it hasn't one)
+	 */
+	uint8_t* component(uint32_t index, Component c) const {
+		const impl::Slot& slot = slots[index];
+		if (slot.type == impl::UNPLACED || c >= ECS_MAX_COMPONENTS || !types[slot.type].offsets[c]) {
+			return nullptr;
+		}
+		const impl::Archetype& type = types[slot.type];
+		return type.blocks[slot.block].data + type.offsets[c] + impl::sizes[c] * slot.row;
+	}
+
+	/**
+	 * Applies a queued change.
+	 */
+	void apply(const impl::Command& cmd, const uint8_t* data) {
+		if (!valid(cmd.entity)) {
+			return;
+		}
+		uint32_t index = cmd.entity & impl::INDEX_MASK;
+		impl::Slot& slot = slots[index];
+		switch (cmd.op) {
+		case impl::Command::OP_CREATE:
+			if (slot.type == impl::UNPLACED) {
+				uint16_t t = archetype(cmd.value);
+				if (t != impl::UNPLACED) {
+					place(index, t);
+				}
+			}
+			break;
+		case impl::Command::OP_DESTROY:
+			if (slot.type != impl::UNPLACED) {
+				erase(slot);
+				slot.type = impl::UNPLACED;
+			}
+			gens[index]++;
+			freed[freedCount++] = index;
+			break;
+		case impl::Command::OP_ADD:
+			if (slot.type != impl::UNPLACED && !(types[slot.type].mask & (1u << cmd.value))) {
+				move(index, types[slot.type].mask | (1u << cmd.value));
+			}
+			/* fall through */
+		case impl::Command::OP_SET:
+			if (uint8_t* dest = component(index, cmd.value)) {
+				memcpy(dest, data, (cmd.size < impl::sizes[cmd.value]) ? cmd.size : impl::sizes[cmd.value]);
+			}
+			break;
+		case impl::Command::OP_REMOVE:
+			if (slot.type != impl::UNPLACED && (types[slot.type].mask & (1u << cmd.value))) {
+				move(index, types[slot.type].mask & ~(1u << cmd.value));
+			}
+			break;
+		}
+	}
+
+	unsigned capacity;
+	impl::Slot* slots; ///< Where each entity is stored (indexed by entity index)
+	uint8_t* gens;     ///< Generation of each entity index
+	uint32_t* spare;   ///< Free entity indices
+	uint32_t* freed;   ///< Indices freed by the current flush (only reused after it)
+	unsigned spareCount;
+	unsigned freedCount;
+	unsigned handles;  ///< Entity indices handed out so far (any after never used)
+	impl::Archetype types[ECS_MAX_ARCHETYPES];
+	unsigned typeCount;
+	uint8_t* queue;    ///< Queued changes (see \c impl#Command)
+	size_t queueUsed;
+	size_t queueSize;
+	Chunk* views;      ///< Matching chunks (for \c #each())
+	unsigned viewSize;
+#if FRAME_THREADED
+	std::mutex lock;   ///< Guards the queue and handing out entities
+#endif
+};
+
+//******************************** Public API ********************************/
+
+ecs::Component ecs::declare(size_t size, size_t align) {
+	unsigned type = impl::types.fetch_add(1);
+	if (type >= ECS_MAX_COMPONENTS) {
+		printf("Too many component types (see ECS_MAX_COMPONENTS)\n");
+		abort();
+	}
+	impl::sizes [type] = size;
+	impl::aligns[type] = align;
+	return type;
+}
+
+ecs::World::World(unsigned capacity)
+	: impl(new Impl((capacity < impl::INDEX_MASK) ? capacity : impl::INDEX_MASK)) {}
+
+ecs::World::~World() {
+	delete impl;
+}
+
+ecs::Entity ecs::World::create(Mask components) {
+	Entity entity = NONE;
+	{
+	#if FRAME_THREADED
+		std::lock_guard<std::mutex> hold(impl->lock);
+	#endif
+		uint32_t index;
+		if (impl->spareCount) {
+			index = impl->spare[--impl->spareCount];
+		} else if (impl->handles < impl->capacity) {
+			index = impl->handles++;
+		} else {
+			return NONE;
+		}
+		impl->slots[index].type = impl::UNPLACED;
+		entity = index | (static_cast<uint32_t>(impl->gens[index]) << impl::INDEX_BITS);
+	}
+	impl->push(impl::Command::OP_CREATE, entity, components, nullptr, 0);
+	return entity;
+}
+
+void ecs::World::destroy(Entity entity) {
+	impl->push(impl::Command::OP_DESTROY, entity, 0, nullptr, 0);
+}
+
+void ecs::World::add(Entity entity, Component type, const void* data, size_t size) {
+	if (type < ECS_MAX_COMPONENTS) {
+		impl->push(impl::Command::OP_ADD, entity, type, data, size);
+	}
+}
+
+void ecs::World::remove(Entity entity, Component type) {
+	if (type < ECS_MAX_COMPONENTS) {
+		impl->push(impl::Command::OP_REMOVE, entity, type, nullptr, 0);
+	}
+}
+
+void ecs::World::set(Entity entity, Component type, const void* data, size_t size) {
+	if (type < ECS_MAX_COMPONENTS) {
+		impl->push(impl::Command::OP_SET, entity, type, data, size);
+	}
+}
+
+void* ecs::World::get(Entity entity, Component type) const {
+	return (impl->valid(entity)) ? impl->component(entity & impl::INDEX_MASK, type) : nullptr;
+}
+
+bool ecs::World::alive(Entity entity) const {
+	return impl->valid(entity) && impl->slots[entity & impl::INDEX_MASK].type != impl::UNPLACED;
+}
+
+unsigned ecs::World::flush() {
+	unsigned applied = 0;
+	for (size_t pos = 0; pos < impl->queueUsed; applied++) {
+		impl::Command cmd;
+		memcpy(&cmd, impl->queue + pos, sizeof cmd);
+		impl->apply(cmd, impl->queue + pos + sizeof cmd);
+		pos += sizeof cmd + ((cmd.size + 3) & ~3);
+	}
+	impl->queueUsed = 0;
+	/*
+	 * Destroyed indices only become free now, so a handle queued for
+	 * destruction can't be reused by a create queued after it.
+	 */
+	for (unsigned n = 0; n < impl->freedCount; n++) {
+		impl->spare[impl->spareCount++] = impl->freed[n];
+	}
+	impl->freedCount = 0;
+	return applied;
+}
+
+unsigned ecs::World::each(Mask all, System func, void* user) {
+	unsigned count = 0;
+	unsigned entities = 0;
+	for (unsigned t = 0; t < impl->typeCount; t++) {
+		const impl::Archetype& type = impl->types[t];
+		if ((type.mask & all) != all) {
+			continue;
+		}
+		impl::reserve(impl->views, impl->viewSize, count + type.blockCount);
+		for (unsigned n = 0; n < type.blockCount; n++) {
+			Chunk& view  = impl->views[count++];
+			view.data    = type.blocks[n].data;
+			view.offsets = type.offsets;
+			view.count   = type.blocks[n].count;
+			view.first   = entities;
+			entities += view.count;
+		}
+	}
+	impl::Pass pass = {impl->views, func, user};
+	jobs::parallel(count, 1, impl::run, &pass);
+	return entities;
+}
+
+unsigned ecs::World::count(Mask all) const {
+	unsigned total = 0;
+	for (unsigned t = 0; t < impl->typeCount; t++) {
+		if ((impl->types[t].mask & all) == all) {
+			total += impl->types[t].total;
+		}
+	}
+	return total;
+}
@@ -43,7 +43,13 @@ EM_JS(void, glue_preint, (), {
 		 */
 		if (navigator["gpu"]) {
 			navigator["gpu"]["requestAdapter"]().then(function (adapter) {
-				adapter["requestDevice"]().then( function (device) {
+				/*
+				 * Any compressed texture formats are enabled (see transcode.h).
+				 */
+				var features = ["texture-compression-bc", "texture-compression-etc2", "texture-compression-astc"].filter(function (name) {
+					return adapter["features"]["has"](name);
+				});
+				adapter["requestDevice"]({"requiredFeatures": features}).then( function (device) {
 					Module["preinitializedWebGPUDevice"] = device;
 					entry();
 				});
@@ -7,6 +7,7 @@
 #error "Emscripten 1.40.1 or higher required"
 #endif
 
+#include <emscripten/html5.h>
 #include <emscripten/html5_webgpu.h>
 
 //******************************** Public API ********************************/
@@ -20,7 +21,17 @@ WGPUDevice webgpu::create(window::Handle /*window*/, WGPUBackendType /*type*/) {
 	return emscripten_webgpu_get_device();
 }
 
-WGPUSwapChain webgpu::createSwapChain(WGPUDevice device) {
+WGPUSwapChain webgpu::createSwapChain(WGPUDevice device, uint32_t width, uint32_t height) {
+	if (!width || !height) {
+		width  = WEBGPU_SWAP_W;
+		height = WEBGPU_SWAP_H;
+	}
+	/*
+	 * The canvas backing store is sized to match (otherwise the browser
+	 * scales the swap chain to whatever size it is).
+	 */
+	emscripten_set_canvas_element_size("canvas", static_cast<int>(width), static_cast<int>(height));
+
 	WGPUSurfaceDescriptorFromCanvasHTMLSelector canvDesc = {};
 	canvDesc.chain.sType = WGPUSType_SurfaceDescriptorFromCanvasHTMLSelector;
 	canvDesc.selector = "canvas";
@@ -33,8 +44,8 @@ WGPUSwapChain webgpu::createSwapChain(WGPUDevice device) {
 	WGPUSwapChainDescriptor swapDesc = {};
 	swapDesc.usage  = WGPUTextureUsage_RenderAttachment;
 	swapDesc.format = WGPUTextureFormat_BGRA8Unorm;
-	swapDesc.width  = 800;
-	swapDesc.height = 450;
+	swapDesc.width  = width;
+	swapDesc.height = height;
 	swapDesc.presentMode = WGPUPresentMode_Fifo;
 	
 	WGPUSwapChain swapchain = wgpuDeviceCreateSwapChain(device, surface, &swapDesc);
@@ -42,6 +53,15 @@ WGPUSwapChain webgpu::createSwapChain(WGPUDevice device) {
 	return swapchain;
 }
 
+WGPUSwapChain webgpu::resizeSwapChain(WGPUDevice device, WGPUSwapChain swapchain, uint32_t width, uint32_t height) {
+	/*
+	 * There's no configure in the browser, so a new swap chain is created on
+	 * the same canvas (which is cheap, the canvas owning the textures).
+	 */
+	wgpuSwapChainRelease(swapchain);
+	return createSwapChain(device, width, height);
+}
+
 WGPUTextureFormat webgpu::getSwapChainFormat(WGPUDevice /*device*/) {
 	return WGPUTextureFormat_BGRA8Unorm;
 }
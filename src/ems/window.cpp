@@ -5,19 +5,79 @@
 namespace window {
 /**
  * Temporary dummy window handle.
- */ 
+ */
 struct HandleImpl {} DUMMY;
 
-EM_BOOL em_redraw(double /*time*/, void *userData) {
-	window::Redraw redraw = (window::Redraw)userData;
-	return redraw(); // If this returns true, rAF() will continue, otherwise it will terminate
+/**
+ * Registered frame scheduler (or \c null before the loop starts).
+ */
+static frame::Scheduler* sched = NULLPTR;
+
+/**
+ * \c true whilst the \c requestAnimationFrame() loop is running.
+ */
+static bool looping = false;
+
+/**
+ * \c true if a frame was requested (by input, resizing, etc.).
+ */
+static bool dirty = true;
+
+/**
+ * \c true if every frame should be drawn (regardless of \c #dirty).
+ */
+static bool animating = !WINDOW_ON_DEMAND;
+
+/**
+ * \c false once one of the stages quits.
+ */
+static bool running = true;
+
+/**
+ * Last size reported by \c window#resized().
+ */
+static unsigned sizeW = 0;
+static unsigned sizeH = 0;
+
+EM_BOOL em_redraw(double /*time*/, void* /*userData*/) {
+	if (animating || dirty) {
+		dirty   = false;
+		running = sched->tick();
+	}
+	/*
+	 * Stops the rAF() loop when idle (restarted by em_wake()). Hidden tabs
+	 * get no rAF() callbacks so nothing is drawn whilst minimised.
+	 */
+	looping = running && (animating || dirty);
+	return looping; // If this returns true, rAF() will continue, otherwise it will terminate
 }
 
+/**
+ * Restarts the \c requestAnimationFrame() loop if it stopped.
+ */
+static void em_wake() {
+	if (sched && running && !looping) {
+		looping = true;
+		emscripten_request_animation_frame_loop(em_redraw, NULLPTR);
+	}
+}
+
+/**
+ * Input and resize callback (for any of the \c emscripten_set_*_callback
+ * event types) requesting a redraw.
+ */
+template<typename T>
+EM_BOOL em_input(int /*type*/, const T* /*event*/, void* /*userData*/) {
+	dirty = true;
+	em_wake();
+	return EM_FALSE;
+}
 }
 
 //******************************** Public API ********************************/
 
 window::Handle window::create(unsigned /*winW*/, unsigned /*winH*/, const char* /*name*/) {
+	size(&DUMMY, sizeW, sizeH);
 	return &DUMMY;
 }
 
@@ -25,6 +85,56 @@ void window::destroy(window::Handle /*wHnd*/) {}
 
 void window::show(window::Handle /*wHnd*/, bool /*show*/) {}
 
-void window::loop(window::Handle /*wHnd*/, window::Redraw func) {
-	emscripten_request_animation_frame_loop(window::em_redraw, (void*)func);
+void window::loop(window::Handle /*wHnd*/, const frame::Stages* stages) {
+	/*
+	 * The scheduler outlives this call (the runtime never exits) so is never
+	 * freed.
+	 */
+	if (stages) {
+		sched = new frame::Scheduler(*stages);
+		emscripten_set_resize_callback   (EMSCRIPTEN_EVENT_TARGET_WINDOW,   NULLPTR, EM_FALSE, em_input<EmscriptenUiEvent>);
+		emscripten_set_keydown_callback  (EMSCRIPTEN_EVENT_TARGET_DOCUMENT, NULLPTR, EM_FALSE, em_input<EmscriptenKeyboardEvent>);
+		emscripten_set_keyup_callback    (EMSCRIPTEN_EVENT_TARGET_DOCUMENT, NULLPTR, EM_FALSE, em_input<EmscriptenKeyboardEvent>);
+		emscripten_set_mousedown_callback(EMSCRIPTEN_EVENT_TARGET_DOCUMENT, NULLPTR, EM_FALSE, em_input<EmscriptenMouseEvent>);
+		emscripten_set_mouseup_callback  (EMSCRIPTEN_EVENT_TARGET_DOCUMENT, NULLPTR, EM_FALSE, em_input<EmscriptenMouseEvent>);
+		emscripten_set_mousemove_callback(EMSCRIPTEN_EVENT_TARGET_DOCUMENT, NULLPTR, EM_FALSE, em_input<EmscriptenMouseEvent>);
+		emscripten_set_wheel_callback    (EMSCRIPTEN_EVENT_TARGET_DOCUMENT, NULLPTR, EM_FALSE, em_input<EmscriptenWheelEvent>);
+		em_wake();
+	}
+}
+
+void window::size(window::Handle /*wHnd*/, unsigned& w, unsigned& h) {
+	double cssW = 0.0;
+	double cssH = 0.0;
+	emscripten_get_element_css_size("canvas", &cssW, &cssH);
+	double ratio = emscripten_get_device_pixel_ratio();
+	w = static_cast<unsigned>(cssW * ratio + 0.5);
+	h = static_cast<unsigned>(cssH * ratio + 0.5);
+}
+
+bool window::resized(window::Handle wHnd, unsigned& w, unsigned& h) {
+	/*
+	 * Polled once per frame (which coalesces the resize events, and also
+	 * catches the pixel ratio changing, which has no event).
+	 */
+	unsigned nowW, nowH;
+	size(wHnd, nowW, nowH);
+	if (nowW && nowH && (nowW != sizeW || nowH != sizeH)) {
+		sizeW = nowW;
+		sizeH = nowH;
+		w = nowW;
+		h = nowH;
+		return true;
+	}
+	return false;
+}
+
+void window::invalidate(window::Handle /*wHnd*/) {
+	dirty = true;
+	em_wake();
+}
+
+void window::animate(window::Handle /*wHnd*/, bool active) {
+	animating = active;
+	em_wake();
 }
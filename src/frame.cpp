@@ -0,0 +1,159 @@
+#include "frame.h"
+
+#include <stdlib.h>
+
+#include <chrono>
+#if FRAME_THREADED
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+//****************************************************************************/
+
+namespace impl {
+/**
+ * \return seconds elapsed since \a last (updating \a last to now)
+ */
+static double elapsed(std::chrono::steady_clock::time_point& last) {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double delta = std::chrono::duration<double>(now - last).count();
+	last = now;
+	return delta;
+}
+}
+
+/**
+ * Scheduler state (hidden to keep the threading headers out of \c frame.h).
+ */
+struct frame::Scheduler::Impl {
+	Impl(const Stages& stages)
+		: stages (stages)
+		, storage(static_cast<unsigned char*>(calloc(3, (stages.size) ? stages.size : 1)))
+		, running(true)
+		, last   (std::chrono::steady_clock::now()) {
+		size_t size = (stages.size) ? stages.size : 1;
+		/*
+		 * Points each slot at its third of the storage: front and back
+		 * directly, the middle by passing one through a publish/acquire
+		 * (which leaves nothing flagged as fresh).
+		 */
+		snaps.writable() = storage;
+		snaps.readable() = storage + size * 2;
+		snaps.publish();
+		snaps.writable() = storage + size;
+		snaps.acquire();
+	#if FRAME_THREADED
+		published = 0;
+		acquired  = 0;
+		sim = std::thread(&Impl::simulate, this);
+	#endif
+	}
+
+	~Impl() {
+	#if FRAME_THREADED
+		{
+			std::lock_guard<std::mutex> hold(lock);
+			running = false;
+		}
+		signal.notify_all();
+		if (sim.joinable()) {
+			sim.join();
+		}
+	#endif
+		free(storage);
+	}
+
+	/**
+	 * Runs the \c update stage once, then hands the snapshot over.
+	 *
+	 * \return \c false if the update requested to quit
+	 */
+	bool step() {
+		double delta = impl::elapsed(last);
+		return !stages.update || stages.update(snaps.writable(), delta, stages.user);
+	}
+
+	/**
+	 * Runs the render thread's stages on the current snapshot.
+	 */
+	bool render() {
+		const void* snapshot = snaps.readable();
+		if (stages.record) {
+			stages.record(snapshot, stages.user);
+		}
+		return !stages.submit || stages.submit(stages.user);
+	}
+
+#if FRAME_THREADED
+	/**
+	 * Simulation thread entry point. Produces at most one snapshot ahead of
+	 * the render thread (starting the next as soon as the render thread has
+	 * taken the last).
+	 */
+	void simulate() {
+		while (running) {
+			bool more = step();
+			std::unique_lock<std::mutex> hold(lock);
+			snaps.publish();
+			published++;
+			if (!more) {
+				running = false;
+			}
+			signal.notify_all();
+			signal.wait(hold, [this] {
+				return !running || acquired >= published;
+			});
+		}
+	}
+#endif
+
+	Stages stages;
+	unsigned char* storage; ///< Backing memory for all three snapshots
+	TripleBuffer<unsigned char*> snaps;
+	std::atomic<bool> running; ///< \c false once any stage quits
+	std::chrono::steady_clock::time_point last; ///< Time of the previous \c update
+#if FRAME_THREADED
+	std::thread sim;
+	/*
+	 * The snapshots themselves are exchanged with atomics; the mutex guards
+	 * the counters keeping the threads in lockstep (which both sleep on, so
+	 * neither spins when idle).
+	 */
+	std::mutex lock;
+	std::condition_variable signal;
+	unsigned long long published; ///< Snapshots handed over by the simulation thread
+	unsigned long long acquired;  ///< Snapshots taken by the render thread
+#endif
+};
+
+//******************************** Public API ********************************/
+
+frame::Scheduler::Scheduler(const Stages& stages)
+	: impl(new Impl(stages)) {}
+
+frame::Scheduler::~Scheduler() {
+	delete impl;
+}
+
+bool frame::Scheduler::tick() {
+#if FRAME_THREADED
+	{
+		std::unique_lock<std::mutex> hold(impl->lock);
+		impl->signal.wait(hold, [this] {
+			return !impl->running || impl->published > impl->acquired;
+		});
+		if (!impl->running || !impl->snaps.acquire()) {
+			return false;
+		}
+		impl->acquired = impl->published;
+	}
+	impl->signal.notify_all();
+	return impl->render();
+#else
+	bool more = impl->step();
+	impl->snaps.publish();
+	impl->snaps.acquire();
+	return impl->render() && more;
+#endif
+}
@@ -0,0 +1,542 @@
+#include "graph.h"
+
+#include <stdio.h>
+
+#include "binding.h"
+#include "profile.h"
+
+//****************************************************************************/
+
+namespace impl {
+/**
+ * Number of attachment slots tracked per pass (colour plus depth).
+ */
+static const unsigned ATTACHMENTS = GRAPH_MAX_COLOR + 1;
+
+/**
+ * Declared texture (transient or imported).
+ */
+struct Resource {
+	const char* name;
+	graph::TextureDesc desc;  ///< Transient description (with the inferred usage)
+	WGPUTextureView imported; ///< External view (or \c null if transient)
+	bool output;     ///< Contents needed after the graph has run
+	bool needed;     ///< Working flag for culling (contents are needed further on)
+	int  first;      ///< First surviving pass to use the texture (or -1 if unused)
+	int  last;       ///< Last surviving pass to use the texture
+	int  dependent;  ///< Last surviving pass needing the existing contents
+	int  written;    ///< Last surviving pass so far to write the texture (used when picking load ops)
+	unsigned physical; ///< Index into the pool (transients only)
+	unsigned spilled;  ///< Index into the frame's spilled textures (when the pool was full)
+};
+
+/**
+ * Declared pass plus what compiling decided for it.
+ */
+struct Pass {
+	graph::PassDesc desc;
+	bool alive;
+	WGPULoadOp  load [ATTACHMENTS];
+	WGPUStoreOp store[ATTACHMENTS];
+};
+
+/**
+ * Pooled texture, kept across frames.
+ */
+struct Physical {
+	graph::TextureDesc desc;
+	WGPUTexture texture;
+	WGPUTextureView view;
+	int busy;  ///< Last pass (this frame) using the texture (or -1 if free)
+	bool used; ///< Assigned to a resource this frame
+};
+
+/**
+ * \return \c true if \a fmt has a stencil aspect
+ */
+static bool hasStencil(WGPUTextureFormat fmt) {
+	return fmt == WGPUTextureFormat_Stencil8
+		|| fmt == WGPUTextureFormat_Depth24PlusStencil8;
+}
+
+/**
+ * \return approximate bytes per texel of \a fmt (for the stats only)
+ */
+static unsigned texelSize(WGPUTextureFormat fmt) {
+	switch (fmt) {
+	case WGPUTextureFormat_R8Unorm:
+	case WGPUTextureFormat_Stencil8:
+		return 1;
+	case WGPUTextureFormat_RG8Unorm:
+	case WGPUTextureFormat_R16Float:
+	case WGPUTextureFormat_Depth16Unorm:
+		return 2;
+	case WGPUTextureFormat_RGBA16Float:
+	case WGPUTextureFormat_RG32Float:
+		return 8;
+	case WGPUTextureFormat_RGBA32Float:
+		return 16;
+	default:
+		return 4;
+	}
+}
+
+/**
+ * \return \c true if \a a and \a b describe interchangeable textures
+ */
+static bool same(const graph::TextureDesc& a, const graph::TextureDesc& b) {
+	return a.format == b.format
+		&& a.width  == b.width
+		&& a.height == b.height
+		&& a.usage  == b.usage;
+}
+
+/**
+ * Sets the clear colour (Dawn has both \c clearValue and \c clearColor but
+ * only \c clearColor works; Emscripten only has \c clearValue).
+ */
+static void setClear(WGPURenderPassColorAttachment& color, const WGPUColor& value) {
+#ifdef __EMSCRIPTEN__
+	color.clearValue = value;
+#else
+	color.clearColor = value;
+#endif
+}
+}
+
+/**
+ * Graph state (fixed size, so declaring and compiling never allocate).
+ */
+struct graph::Graph::Impl {
+	Impl(WGPUDevice device)
+		: device(device)
+		, resCount (0)
+		, passCount(0)
+		, poolCount(0)
+		, spillCount(0)
+		, warned(false)
+		, stats() {
+		wgpuDeviceReference(device);
+	}
+
+	~Impl() {
+		for (unsigned n = 0; n < poolCount; n++) {
+			release(pool[n]);
+		}
+		for (unsigned n = 0; n < spillCount; n++) {
+			release(spills[n]);
+		}
+		wgpuDeviceRelease(device);
+	}
+
+	/**
+	 * Creates the texture (and view) for \a tex's description.
+	 */
+	void create(impl::Physical& tex) {
+		WGPUTextureDescriptor desc = {};
+		desc.usage = tex.desc.usage;
+		desc.dimension = WGPUTextureDimension_2D;
+		desc.size.width  = tex.desc.width;
+		desc.size.height = tex.desc.height;
+		desc.size.depthOrArrayLayers = 1;
+		desc.format = tex.desc.format;
+		desc.mipLevelCount = 1;
+		desc.sampleCount   = 1;
+		tex.texture = wgpuDeviceCreateTexture(device, &desc);
+		tex.view    = wgpuTextureCreateView(tex.texture, nullptr);
+	}
+
+	/**
+	 * Frees a pooled texture, first dropping any cached bind groups using its
+	 * view (whose handle could otherwise be matched once reused).
+	 */
+	static void release(impl::Physical& tex) {
+		binding::invalidate(tex.view);
+		wgpuTextureViewRelease(tex.view);
+		wgpuTextureDestroy(tex.texture);
+		wgpuTextureRelease(tex.texture);
+	}
+
+	/**
+	 * \return \c true if \a res is a valid handle
+	 */
+	bool valid(Resource res) const {
+		return res < resCount;
+	}
+
+	/**
+	 * Calls \a func for every resource \a pass touches, with the attachment
+	 * slot (or -1 for non-attachments) and whether it reads the contents.
+	 */
+	template<typename Func>
+	void each(const PassDesc& pass, Func func) const {
+		for (unsigned n = 0; n < pass.colorCount; n++) {
+			if (valid(pass.color[n])) {
+				func(pass.color[n], static_cast<int>(n), !pass.clear, true);
+			}
+		}
+		if (valid(pass.depth)) {
+			func(pass.depth, static_cast<int>(GRAPH_MAX_COLOR), !pass.clear, true);
+		}
+		if (valid(pass.writes)) {
+			func(pass.writes, -1, false, true);
+		}
+		for (unsigned n = 0; n < pass.readCount; n++) {
+			if (valid(pass.reads[n])) {
+				func(pass.reads[n], -1, true, false);
+			}
+		}
+	}
+
+	/**
+	 * Walks the passes backwards from the outputs, keeping only those
+	 * producing something that's needed.
+	 */
+	void cull() {
+		for (unsigned n = 0; n < resCount; n++) {
+			res[n].needed = res[n].imported && res[n].output;
+		}
+		for (int p = static_cast<int>(passCount) - 1; p >= 0; p--) {
+			impl::Pass& pass = passes[p];
+			pass.alive = pass.desc.sideEffects;
+			each(pass.desc, [&](Resource r, int, bool, bool writes) {
+				if (writes && res[r].needed) {
+					pass.alive = true;
+				}
+			});
+			if (pass.alive) {
+				/*
+				 * Writes replace the contents (so earlier writers aren't
+				 * needed for them) unless the pass also reads them.
+				 */
+				each(pass.desc, [&](Resource r, int, bool, bool writes) {
+					if (writes) {
+						res[r].needed = false;
+					}
+				});
+				each(pass.desc, [&](Resource r, int, bool reads, bool) {
+					if (reads) {
+						res[r].needed = true;
+					}
+				});
+			}
+		}
+	}
+
+	/**
+	 * Computes each resource's lifetime over the surviving passes.
+	 */
+	void lifetimes() {
+		for (unsigned n = 0; n < resCount; n++) {
+			res[n].first     = -1;
+			res[n].last      = -1;
+			res[n].dependent = -1;
+			res[n].written   = -1;
+		}
+		for (unsigned p = 0; p < passCount; p++) {
+			if (!passes[p].alive) {
+				continue;
+			}
+			each(passes[p].desc, [&](Resource r, int slot, bool reads, bool) {
+				impl::Resource& tex = res[r];
+				if (tex.first < 0) {
+					tex.first = static_cast<int>(p);
+				}
+				tex.last = static_cast<int>(p);
+				if (reads) {
+					tex.dependent = static_cast<int>(p);
+				}
+				/*
+				 * The graph owns transient usage: attachments need to be
+				 * renderable, anything read by a render pass sampled.
+				 */
+				if (!tex.imported) {
+					if (slot >= 0) {
+						tex.desc.usage |= WGPUTextureUsage_RenderAttachment;
+					} else if (reads) {
+						tex.desc.usage |= WGPUTextureUsage_TextureBinding;
+					}
+				}
+			});
+		}
+	}
+
+	/**
+	 * Picks the load and store op for each attachment. Contents are only
+	 * loaded if a previous pass wrote them (or they were imported), and only
+	 * stored if a later pass depends on them (or they're an output).
+	 */
+	void operations() {
+		for (unsigned p = 0; p < passCount; p++) {
+			impl::Pass& pass = passes[p];
+			if (!pass.alive) {
+				continue;
+			}
+			each(pass.desc, [&](Resource r, int slot, bool reads, bool writes) {
+				impl::Resource& tex = res[r];
+				if (slot >= 0) {
+					bool keep = reads && (tex.written >= 0 || tex.imported);
+					pass.load [slot] = (keep) ? WGPULoadOp_Load : WGPULoadOp_Clear;
+					pass.store[slot] = (tex.dependent > static_cast<int>(p) || (tex.imported && tex.output))
+						? WGPUStoreOp_Store : WGPUStoreOp_Discard;
+					if (pass.store[slot] == WGPUStoreOp_Discard) {
+						stats.discards++;
+					}
+				}
+				if (writes) {
+					tex.written = static_cast<int>(p);
+				}
+			});
+		}
+	}
+
+	/**
+	 * Assigns each used transient a pooled texture, sharing between
+	 * transients with matching descriptions whose lifetimes don't overlap.
+	 * Transients are visited in order of first use, so a texture freed by
+	 * one pass can be picked up by the next.
+	 */
+	void alias() {
+		for (unsigned n = 0; n < poolCount; n++) {
+			pool[n].busy = -1;
+			pool[n].used = false;
+		}
+		for (unsigned p = 0; p < passCount; p++) {
+			for (unsigned r = 0; r < resCount; r++) {
+				impl::Resource& tex = res[r];
+				if (tex.imported || tex.first != static_cast<int>(p)) {
+					continue;
+				}
+				stats.transient++;
+				unsigned pick = poolCount;
+				for (unsigned n = 0; n < poolCount; n++) {
+					if (pool[n].busy < tex.first && impl::same(pool[n].desc, tex.desc)) {
+						pick = n;
+						break;
+					}
+				}
+				if (pick == poolCount) {
+					if (poolCount == GRAPH_MAX_TEXTURES) {
+						/*
+						 * Left for allocate() to create just for this frame.
+						 */
+						if (!warned) {
+							printf("Render graph texture pool full (see GRAPH_MAX_TEXTURES), creating per frame: %s\n", tex.name);
+							warned = true;
+						}
+						continue;
+					}
+					impl::Physical& fresh = pool[poolCount++];
+					fresh.desc    = tex.desc;
+					fresh.texture = nullptr;
+					fresh.view    = nullptr;
+				}
+				pool[pick].busy = tex.last;
+				pool[pick].used = true;
+				tex.physical = pick;
+			}
+		}
+	}
+
+	/**
+	 * Creates the textures new to the pool this frame and frees those no
+	 * longer used (e.g. after a resize), compacting what's left. Transients
+	 * that didn't fit in the pool get textures of their own, freed on the
+	 * next compile.
+	 */
+	void allocate() {
+		for (unsigned n = 0; n < spillCount; n++) {
+			release(spills[n]);
+		}
+		spillCount = 0;
+		unsigned kept = 0;
+		unsigned remap[GRAPH_MAX_TEXTURES];
+		for (unsigned n = 0; n < poolCount; n++) {
+			impl::Physical& tex = pool[n];
+			if (!tex.used) {
+				if (tex.texture) {
+					release(tex);
+				}
+				remap[n] = GRAPH_MAX_TEXTURES;
+				continue;
+			}
+			if (!tex.texture) {
+				create(tex);
+			}
+			stats.bytes += static_cast<unsigned long long>(tex.desc.width) * tex.desc.height * impl::texelSize(tex.desc.format);
+			remap[n] = kept;
+			pool[kept++] = tex;
+		}
+		poolCount = kept;
+		for (unsigned r = 0; r < resCount; r++) {
+			if (!res[r].imported && res[r].first >= 0) {
+				res[r].physical = (res[r].physical < GRAPH_MAX_TEXTURES) ? remap[res[r].physical] : GRAPH_MAX_TEXTURES;
+				if (res[r].physical == GRAPH_MAX_TEXTURES) {
+					impl::Physical& spill = spills[spillCount];
+					spill.desc = res[r].desc;
+					create(spill);
+					stats.bytes += static_cast<unsigned long long>(spill.desc.width) * spill.desc.height * impl::texelSize(spill.desc.format);
+					res[r].spilled = spillCount++;
+				}
+			}
+		}
+		stats.textures = poolCount;
+	}
+
+	/**
+	 * Begins, runs and ends a single render pass.
+	 */
+	void render(WGPUCommandEncoder encoder, const impl::Pass& pass, const Graph& graph) {
+		const PassDesc& desc = pass.desc;
+		WGPURenderPassColorAttachment colorDesc[GRAPH_MAX_COLOR] = {};
+		unsigned colorCount = 0;
+		for (unsigned n = 0; n < desc.colorCount; n++) {
+			if (WGPUTextureView view = graph.view(desc.color[n])) {
+				WGPURenderPassColorAttachment& color = colorDesc[colorCount++];
+				color.view    = view;
+				color.loadOp  = pass.load [n];
+				color.storeOp = pass.store[n];
+				impl::setClear(color, desc.clearColor);
+			}
+		}
+		WGPURenderPassDepthStencilAttachment depthDesc = {};
+		WGPUTextureView depthView = graph.view(desc.depth);
+		if (depthView) {
+			depthDesc.view = depthView;
+			depthDesc.depthLoadOp  = pass.load [GRAPH_MAX_COLOR];
+			depthDesc.depthStoreOp = pass.store[GRAPH_MAX_COLOR];
+			depthDesc.depthClearValue = desc.clearDepth;
+			depthDesc.clearDepth      = desc.clearDepth;
+			if (impl::hasStencil(res[desc.depth].desc.format)) {
+				depthDesc.stencilLoadOp  = depthDesc.depthLoadOp;
+				depthDesc.stencilStoreOp = depthDesc.depthStoreOp;
+			}
+		}
+		WGPURenderPassDescriptor renderPass = {};
+		renderPass.label = desc.name;
+		renderPass.colorAttachmentCount = colorCount;
+		renderPass.colorAttachments = colorDesc;
+		renderPass.depthStencilAttachment = (depthView) ? &depthDesc : nullptr;
+
+		WGPURenderPassEncoder encoded = wgpuCommandEncoderBeginRenderPass(encoder, &renderPass);
+		desc.execute(encoded, graph, desc.user);
+		wgpuRenderPassEncoderEnd(encoded);
+		wgpuRenderPassEncoderRelease(encoded);
+	}
+
+	WGPUDevice device;
+	impl::Resource res[GRAPH_MAX_RESOURCES];
+	unsigned resCount;
+	impl::Pass passes[GRAPH_MAX_PASSES];
+	unsigned passCount;
+	impl::Physical pool[GRAPH_MAX_TEXTURES];
+	unsigned poolCount;
+	impl::Physical spills[GRAPH_MAX_RESOURCES]; ///< Textures for this frame's transients not fitting in the pool
+	unsigned spillCount;
+	bool warned; ///< The pool full message was printed
+	Stats stats;
+};
+
+//******************************** Public API ********************************/
+
+graph::Graph::Graph(WGPUDevice device)
+	: impl(new Impl(device)) {}
+
+graph::Graph::~Graph() {
+	delete impl;
+}
+
+void graph::Graph::reset() {
+	impl->resCount  = 0;
+	impl->passCount = 0;
+}
+
+graph::Resource graph::Graph::create(const char* name, const TextureDesc& desc) {
+	if (impl->resCount == GRAPH_MAX_RESOURCES) {
+		return NONE;
+	}
+	impl::Resource& res = impl->res[impl->resCount];
+	res = impl::Resource();
+	res.name = name;
+	res.desc = desc;
+	res.physical = GRAPH_MAX_TEXTURES;
+	res.spilled  = GRAPH_MAX_RESOURCES;
+	return impl->resCount++;
+}
+
+graph::Resource graph::Graph::import(const char* name, WGPUTextureView view, bool output) {
+	if (impl->resCount == GRAPH_MAX_RESOURCES) {
+		return NONE;
+	}
+	impl::Resource& res = impl->res[impl->resCount];
+	res = impl::Resource();
+	res.name     = name;
+	res.imported = view;
+	res.output   = output;
+	res.physical = GRAPH_MAX_TEXTURES;
+	res.spilled  = GRAPH_MAX_RESOURCES;
+	return impl->resCount++;
+}
+
+void graph::Graph::addPass(const PassDesc& desc) {
+	if (impl->passCount < GRAPH_MAX_PASSES) {
+		impl::Pass& pass = impl->passes[impl->passCount++];
+		pass.desc  = desc;
+		pass.alive = false;
+		if (pass.desc.colorCount > GRAPH_MAX_COLOR) {
+			pass.desc.colorCount = GRAPH_MAX_COLOR;
+		}
+		if (pass.desc.readCount > GRAPH_MAX_READS) {
+			pass.desc.readCount = GRAPH_MAX_READS;
+		}
+	}
+}
+
+void graph::Graph::compile() {
+	impl->stats = Stats();
+	impl->stats.passes = impl->passCount;
+	impl->cull();
+	for (unsigned p = 0; p < impl->passCount; p++) {
+		if (!impl->passes[p].alive) {
+			impl->stats.culled++;
+		}
+	}
+	impl->lifetimes();
+	impl->operations();
+	impl->alias();
+	impl->allocate();
+}
+
+void graph::Graph::execute(WGPUCommandEncoder encoder) {
+	for (unsigned p = 0; p < impl->passCount; p++) {
+		const impl::Pass& pass = impl->passes[p];
+		if (!pass.alive) {
+			continue;
+		}
+		profile::beginPass(encoder, pass.desc.name);
+		if (pass.desc.execute) {
+			impl->render(encoder, pass, *this);
+		} else if (pass.desc.encode) {
+			pass.desc.encode(encoder, *this, pass.desc.user);
+		}
+		profile::endPass(encoder);
+	}
+}
+
+WGPUTextureView graph::Graph::view(Resource res) const {
+	if (!impl->valid(res)) {
+		return nullptr;
+	}
+	const impl::Resource& tex = impl->res[res];
+	if (tex.imported) {
+		return tex.imported;
+	}
+	if (tex.physical < impl->poolCount) {
+		return impl->pool[tex.physical].view;
+	}
+	return (tex.spilled < impl->spillCount) ? impl->spills[tex.spilled].view : nullptr;
+}
+
+const graph::Stats& graph::Graph::stats() const {
+	return impl->stats;
+}
@@ -0,0 +1,64 @@
+#include "instance.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include <glm/gtc/packing.hpp>
+
+//****************************************************************************/
+
+namespace impl {
+/*
+ * The shaders read the quaternion as a vec4 (so glm mustn't be storing it
+ * scalar first) and, at full precision, the transforms as they are.
+ */
+static_assert(offsetof(glm::quat, x) == 0 && offsetof(glm::quat, w) == 12, "glm::quat needs storing as x, y, z, w");
+static_assert(sizeof(instance::Transform) == 32, "instance::Transform differs from the WGSL Instance");
+static_assert(sizeof(instance::Half) == 16, "instance::Half differs from the WGSL Instance");
+}
+
+//******************************** Public API ********************************/
+
+void instance::pack(const Transform* src, Instance* dst, size_t count) {
+#if INSTANCE_HALF
+	for (size_t n = 0; n < count; n++) {
+		const Transform& from = src[n];
+		Half& to = dst[n];
+		to.rotation[0] = glm::packHalf2x16(glm::vec2(from.rotation.x, from.rotation.y));
+		to.rotation[1] = glm::packHalf2x16(glm::vec2(from.rotation.z, from.rotation.w));
+		to.position[0] = glm::packHalf2x16(glm::vec2(from.position.x, from.position.y));
+		to.position[1] = glm::packHalf2x16(glm::vec2(from.position.z, from.scale));
+	}
+#else
+	memcpy(dst, src, count * sizeof(Transform));
+#endif
+}
+
+glm::mat4 instance::matrix(const Transform& transform) {
+	glm::mat3 basis = glm::mat3_cast(transform.rotation) * transform.scale;
+	return glm::mat4(
+		glm::vec4(basis[0], 0.0f),
+		glm::vec4(basis[1], 0.0f),
+		glm::vec4(basis[2], 0.0f),
+		glm::vec4(transform.position, 1.0f));
+}
+
+void instance::pack(const glm::mat4* src, Instance* dst, size_t count) {
+	for (size_t n = 0; n < count; n++) {
+		Transform from = transform(src[n]);
+		pack(&from, dst + n, 1);
+	}
+}
+
+instance::Transform instance::transform(const glm::mat4& matrix) {
+	glm::mat3 basis(matrix);
+	Transform split;
+	/*
+	 * The scale is averaged over the axes (which for a uniform scale only
+	 * smooths out rounding).
+	 */
+	split.scale    = (glm::length(basis[0]) + glm::length(basis[1]) + glm::length(basis[2])) / 3.0f;
+	split.rotation = (split.scale > 0.0f) ? glm::normalize(glm::quat_cast(basis / split.scale)) : glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	split.position = glm::vec3(matrix[3]);
+	return split;
+}
@@ -0,0 +1,187 @@
+#include "jobs.h"
+
+#if FRAME_THREADED
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+//****************************************************************************/
+
+namespace impl {
+#if FRAME_THREADED
+/**
+ * Work shared with the workers by one \c jobs#parallel() call. Lives on the
+ * caller's stack until every worker that picked it up has let go.
+ */
+struct Batch {
+	jobs::Range func;
+	void* user;
+	size_t items;
+	size_t chunk;  ///< Items per chunk
+	size_t chunks; ///< Number of chunks
+	std::atomic<size_t> next; ///< Next chunk to claim
+	unsigned refs; ///< Workers running chunks of this batch (guarded by \c #lock)
+	Batch* link;   ///< Next batch in \c #queue (guarded by \c #lock)
+};
+
+static std::thread workers[JOBS_MAX_WORKERS];
+static unsigned workerCount = 0;
+static bool running = false;
+
+static Batch* queue = NULLPTR; ///< Batches with chunks left to claim, newest first (guarded by \c #lock)
+static std::mutex lock;        ///< Guards \c #queue, \c #running and the batches' \c Batch#refs
+static std::condition_variable wake;     ///< Signals the workers of a new batch
+static std::condition_variable finished; ///< Signals callers a worker let go of a batch
+
+/**
+ * Removes \a batch from the queue (if it's still there). The lock must be held.
+ */
+static void unlink(Batch* batch) {
+	for (Batch** at = &queue; *at; at = &(*at)->link) {
+		if (*at == batch) {
+			*at = batch->link;
+			break;
+		}
+	}
+}
+
+/**
+ * Claims and runs chunks of \a batch until none remain.
+ */
+static void drain(Batch& batch) {
+	size_t n;
+	while ((n = batch.next.fetch_add(1, std::memory_order_relaxed)) < batch.chunks) {
+		size_t beg = n * batch.chunk;
+		size_t end = beg + batch.chunk;
+		batch.func(beg, (end < batch.items) ? end : batch.items, batch.user);
+	}
+}
+
+/**
+ * Worker thread entry point.
+ */
+static void work() {
+	while (true) {
+		Batch* batch;
+		{
+			std::unique_lock<std::mutex> hold(lock);
+			wake.wait(hold, [] {
+				return !running || queue;
+			});
+			if (!running) {
+				return;
+			}
+			/*
+			 * Newest first, so a loop started from inside another's body is
+			 * worked on before the outer one's remaining chunks.
+			 */
+			batch = queue;
+			batch->refs++;
+		}
+		drain(*batch);
+		/*
+		 * Once a worker finds no chunks left nobody else needs to pick the
+		 * batch up; the caller returns once every holder has let go, so it's
+		 * never freed under a straggler.
+		 */
+		std::lock_guard<std::mutex> hold(lock);
+		unlink(batch);
+		if (--batch->refs == 0) {
+			finished.notify_all();
+		}
+	}
+}
+#endif
+}
+
+//******************************** Public API ********************************/
+
+void jobs::init(unsigned workers) {
+#if FRAME_THREADED
+	destroy();
+	if (workers == 0) {
+		unsigned cores = std::thread::hardware_concurrency();
+		workers = (cores > 1) ? cores - 1 : 0;
+	}
+	if (workers > JOBS_MAX_WORKERS) {
+		workers = JOBS_MAX_WORKERS;
+	}
+	impl::running = true;
+	for (unsigned n = 0; n < workers; n++) {
+		impl::workers[n] = std::thread(impl::work);
+	}
+	impl::workerCount = workers;
+#else
+	(void) workers;
+#endif
+}
+
+void jobs::destroy() {
+#if FRAME_THREADED
+	{
+		std::lock_guard<std::mutex> hold(impl::lock);
+		impl::running = false;
+	}
+	impl::wake.notify_all();
+	for (unsigned n = 0; n < impl::workerCount; n++) {
+		impl::workers[n].join();
+	}
+	impl::workerCount = 0;
+#endif
+}
+
+unsigned jobs::count() {
+#if FRAME_THREADED
+	return impl::workerCount + 1;
+#else
+	return 1;
+#endif
+}
+
+void jobs::parallel(size_t items, size_t grain, Range func, void* user) {
+	if (grain == 0) {
+		grain = 1;
+	}
+#if FRAME_THREADED
+	if (impl::workerCount > 0 && items > grain) {
+		/*
+		 * A few chunks per thread evens out uneven chunks without the
+		 * claiming itself becoming the cost.
+		 */
+		size_t chunk = items / (count() * 4);
+		if (chunk < grain) {
+			chunk = grain;
+		}
+		impl::Batch batch;
+		batch.func   = func;
+		batch.user   = user;
+		batch.items  = items;
+		batch.chunk  = chunk;
+		batch.chunks = (items + chunk - 1) / chunk;
+		batch.next.store(0, std::memory_order_relaxed);
+		batch.refs   = 0;
+		{
+			std::lock_guard<std::mutex> hold(impl::lock);
+			batch.link  = impl::queue;
+			impl::queue = &batch;
+		}
+		impl::wake.notify_all();
+		impl::drain(batch);
+		/*
+		 * Only this call's chunks are waited on, so other threads' calls run
+		 * alongside it and a nested call (from a chunk) can't deadlock.
+		 */
+		std::unique_lock<std::mutex> hold(impl::lock);
+		impl::unlink(&batch);
+		impl::finished.wait(hold, [&batch] {
+			return batch.refs == 0;
+		});
+		return;
+	}
+#endif
+	if (items > 0) {
+		func(0, items, user);
+	}
+}
@@ -0,0 +1,391 @@
+#include "webgpu.h"
+
+#include "apistats.h"
+#include "capture.h"
+#include "profile.h"
+
+/*
+ * Linux is headless: rendering goes to offscreen textures on a CPU Vulkan
+ * adapter (lavapipe or SwiftShader), for running on build machines without a
+ * GPU. Dawn should be built with Vulkan (and optionally SwiftShader) only.
+ */
+#define DAWN_ENABLE_BACKEND_VULKAN
+
+/**
+ * \def WEBGPU_FORCE_SWIFTSHADER
+ * Set to use Dawn's bundled SwiftShader even if the system has its own CPU
+ * adapter (otherwise SwiftShader is only the fallback, e.g. to lavapipe).
+ */
+#ifndef WEBGPU_FORCE_SWIFTSHADER
+#define WEBGPU_FORCE_SWIFTSHADER 0
+#endif
+
+/**
+ * \def WEBGPU_CPU_ONLY
+ * Set to only accept CPU adapters (otherwise any Vulkan adapter is taken if
+ * neither lavapipe nor SwiftShader are found).
+ */
+#ifndef WEBGPU_CPU_ONLY
+#define WEBGPU_CPU_ONLY 1
+#endif
+
+/**
+ * \def WEBGPU_OFFSCREEN_DUMP
+ * Interval in frames to write the offscreen \e swap chain to a \c .ppm file,
+ * to verify the pixel output (zero never writes).
+ */
+#ifndef WEBGPU_OFFSCREEN_DUMP
+#define WEBGPU_OFFSCREEN_DUMP 0
+#endif
+
+//****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <dawn/dawn_proc.h>
+#include <dawn/webgpu_cpp.h>
+#include <dawn/native/VulkanBackend.h>
+
+namespace impl {
+/*
+ * NOTE: keeping these here for a single device until I work out more.
+ */
+
+/*
+ * Chosen backend type for \c #device.
+ */
+WGPUBackendType backend;
+
+/*
+ * WebGPU graphics API-specific device, created from a \c dawn::native::Adapter
+ * and optional feature requests.
+ */
+WGPUDevice device;
+
+/*
+ * Dawn's own procs (the offscreen swap chain calls these directly, so its
+ * work isn't counted or captured as the app's).
+ */
+static DawnProcTable native;
+
+/*
+ * Procs with the swap chain entries replaced (see \c #installOffscreen()).
+ */
+static DawnProcTable procs;
+
+/*
+ * Offscreen swap chain format. RGBA to keep the dump simple.
+ */
+static const WGPUTextureFormat swapPref = WGPUTextureFormat_RGBA8Unorm;
+
+//********************************** Helpers *********************************/
+
+/**
+ * Analogous to the browser's \c GPU.requestAdapter(), preferring CPU Vulkan
+ * adapters. System adapters are tried first (lavapipe being a regular Vulkan
+ * driver), then Dawn's SwiftShader.
+ *
+ * \param[in] type backend type (only \c WGPUBackendType_Null overrides the default Vulkan)
+ * \return the best choice adapter or an empty adapter wrapper
+ */
+static dawn::native::Adapter requestAdapter(WGPUBackendType type) {
+	static dawn::native::Instance instance;
+	wgpu::AdapterProperties properties;
+	if (type == WGPUBackendType_Null) {
+		instance.DiscoverDefaultAdapters();
+	} else {
+		dawn::native::vulkan::AdapterDiscoveryOptions options;
+		options.forceSwiftShader = WEBGPU_FORCE_SWIFTSHADER;
+		instance.DiscoverAdapters(&options);
+		if (!options.forceSwiftShader) {
+			bool found = false;
+			std::vector<dawn::native::Adapter> adapters = instance.GetAdapters();
+			for (auto it = adapters.begin(); it != adapters.end(); ++it) {
+				it->GetProperties(&properties);
+				found |= properties.adapterType == wgpu::AdapterType::CPU;
+			}
+			if (!found) {
+				options.forceSwiftShader = true;
+				instance.DiscoverAdapters(&options);
+			}
+		}
+		type = WGPUBackendType_Vulkan;
+	}
+	std::vector<dawn::native::Adapter> adapters = instance.GetAdapters();
+	for (auto it = adapters.begin(); it != adapters.end(); ++it) {
+		it->GetProperties(&properties);
+		if (static_cast<WGPUBackendType>(properties.backendType) == type) {
+			if (type == WGPUBackendType_Null || properties.adapterType == wgpu::AdapterType::CPU) {
+				return *it;
+			}
+		}
+	}
+#if !WEBGPU_CPU_ONLY
+	for (auto it = adapters.begin(); it != adapters.end(); ++it) {
+		it->GetProperties(&properties);
+		if (static_cast<WGPUBackendType>(properties.backendType) == type) {
+			return *it;
+		}
+	}
+#endif
+	return dawn::native::Adapter();
+}
+
+//*************************** Offscreen Swap Chain ***************************/
+
+/**
+ * Swap chain emulated with a texture (there being no surface to present to).
+ * Queue ordering keeps each frame's writes after the previous frame's, so a
+ * single texture is enough.
+ */
+struct Offscreen {
+	unsigned refs;
+	WGPUDevice device;
+	WGPUTexture texture; ///< Configured target (or \c null before configuring)
+	uint32_t width;
+	uint32_t height;
+	unsigned frames;     ///< Frames presented
+	WGPUBuffer readback; ///< Dump staging buffer (created on first use)
+	bool mapped;
+};
+
+static Offscreen* toOffscreen(WGPUSwapChain swapchain) {
+	return reinterpret_cast<Offscreen*>(swapchain);
+}
+
+#if WEBGPU_OFFSCREEN_DUMP
+/**
+ * Buffer map callback setting the \c Offscreen#mapped flag.
+ */
+static void mapped(WGPUBufferMapAsyncStatus /*status*/, void* user) {
+	static_cast<Offscreen*>(user)->mapped = true;
+}
+
+/**
+ * Copies the texture back and writes it as a binary \c .ppm (blocking until
+ * the copy completes, so only to verify the output).
+ */
+static void dump(Offscreen* swap) {
+	uint32_t rowBytes = (swap->width * 4 + 255) & ~255U;
+	if (!swap->readback) {
+		WGPUBufferDescriptor desc = {};
+		desc.usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead;
+		desc.size  = static_cast<uint64_t>(rowBytes) * swap->height;
+		swap->readback = native.deviceCreateBuffer(swap->device, &desc);
+	}
+	WGPUImageCopyTexture src = {};
+	src.texture = swap->texture;
+	WGPUImageCopyBuffer dst = {};
+	dst.buffer = swap->readback;
+	dst.layout.bytesPerRow  = rowBytes;
+	dst.layout.rowsPerImage = swap->height;
+	WGPUExtent3D size = {swap->width, swap->height, 1};
+	WGPUCommandEncoder encoder = native.deviceCreateCommandEncoder(swap->device, nullptr);
+	native.commandEncoderCopyTextureToBuffer(encoder, &src, &dst, &size);
+	WGPUCommandBuffer commands = native.commandEncoderFinish(encoder, nullptr);
+	WGPUQueue queue = native.deviceGetQueue(swap->device);
+	native.queueSubmit(queue, 1, &commands);
+	native.commandBufferRelease(commands);
+	native.commandEncoderRelease(encoder);
+	native.queueRelease(queue);
+
+	swap->mapped = false;
+	native.bufferMapAsync(swap->readback, WGPUMapMode_Read, 0, WGPU_WHOLE_MAP_SIZE, impl::mapped, swap);
+	while (!swap->mapped) {
+		native.deviceTick(swap->device);
+	}
+	const uint8_t* data = static_cast<const uint8_t*>(native.bufferGetConstMappedRange(swap->readback, 0, WGPU_WHOLE_MAP_SIZE));
+	char name[32];
+	snprintf(name, sizeof name, "frame%05u.ppm", swap->frames);
+	if (FILE* out = (data) ? fopen(name, "wb") : nullptr) {
+		fprintf(out, "P6\n%u %u\n255\n", swap->width, swap->height);
+		for (uint32_t y = 0; y < swap->height; y++) {
+			const uint8_t* row = data + y * rowBytes;
+			for (uint32_t x = 0; x < swap->width; x++) {
+				fwrite(row + x * 4, 1, 3, out);
+			}
+		}
+		fclose(out);
+	}
+	native.bufferUnmap(swap->readback);
+}
+#endif
+
+static WGPUSwapChain createSwap(WGPUDevice device, WGPUSurface /*surface*/, const WGPUSwapChainDescriptor* /*desc*/) {
+	Offscreen* swap = new Offscreen();
+	swap->refs   = 1;
+	swap->device = device;
+	native.deviceReference(device);
+	return reinterpret_cast<WGPUSwapChain>(swap);
+}
+
+static void configureSwap(WGPUSwapChain swapchain, WGPUTextureFormat format, WGPUTextureUsageFlags usage, uint32_t width, uint32_t height) {
+	Offscreen* swap = toOffscreen(swapchain);
+	if (swap->texture) {
+		native.textureRelease(swap->texture);
+	}
+	if (swap->readback) {
+		native.bufferRelease(swap->readback);
+		swap->readback = nullptr;
+	}
+	WGPUTextureDescriptor desc = {};
+	desc.usage  = usage | WGPUTextureUsage_CopySrc;
+	desc.dimension = WGPUTextureDimension_2D;
+	desc.size.width  = width;
+	desc.size.height = height;
+	desc.size.depthOrArrayLayers = 1;
+	desc.format = format;
+	desc.mipLevelCount = 1;
+	desc.sampleCount   = 1;
+	swap->texture = native.deviceCreateTexture(swap->device, &desc);
+	swap->width   = width;
+	swap->height  = height;
+}
+
+static WGPUTextureView getSwapView(WGPUSwapChain swapchain) {
+	Offscreen* swap = toOffscreen(swapchain);
+	return (swap->texture) ? native.textureCreateView(swap->texture, nullptr) : nullptr;
+}
+
+static void presentSwap(WGPUSwapChain swapchain) {
+	Offscreen* swap = toOffscreen(swapchain);
+	swap->frames++;
+#if WEBGPU_OFFSCREEN_DUMP
+	if (swap->texture && swap->frames % WEBGPU_OFFSCREEN_DUMP == 0) {
+		dump(swap);
+	}
+#endif
+}
+
+static void referenceSwap(WGPUSwapChain swapchain) {
+	toOffscreen(swapchain)->refs++;
+}
+
+static void releaseSwap(WGPUSwapChain swapchain) {
+	Offscreen* swap = toOffscreen(swapchain);
+	if (--swap->refs == 0) {
+		if (swap->readback) {
+			native.bufferRelease(swap->readback);
+		}
+		if (swap->texture) {
+			native.textureRelease(swap->texture);
+		}
+		native.deviceRelease(swap->device);
+		delete swap;
+	}
+}
+
+/**
+ * Replaces the swap chain entries in \a table with the offscreen versions.
+ */
+static void installOffscreen(DawnProcTable* table) {
+	table->deviceCreateSwapChain          = createSwap;
+	table->swapChainConfigure             = configureSwap;
+	table->swapChainGetCurrentTextureView = getSwapView;
+	table->swapChainPresent               = presentSwap;
+	table->swapChainReference             = referenceSwap;
+	table->swapChainRelease               = releaseSwap;
+}
+
+/**
+ * Dawn error handling callback (adheres to \c WGPUErrorCallback).
+ *
+ * \param[in] message error string
+ */
+static void printError(WGPUErrorType /*type*/, const char* message, void*) {
+	puts(message);
+}
+} // impl
+
+//******************************** Public API ********************************/
+
+WGPUDevice webgpu::create(window::Handle /*window*/, WGPUBackendType type) {
+	if (dawn::native::Adapter adapter = impl::requestAdapter(type)) {
+		wgpu::AdapterProperties properties;
+		adapter.GetProperties(&properties);
+		impl::backend = static_cast<WGPUBackendType>(properties.backendType);
+		printf("Adapter: %s (%s)\n", properties.name, properties.driverDescription);
+		/*
+		 * Timestamp queries (see profile.h) are only enabled if the adapter
+		 * has them and profiling asks for them. Dawn also classes them as
+		 * unsafe, hence the toggle. Any compressed texture formats are
+		 * enabled too (see transcode.h).
+		 */
+		dawn::native::DawnDeviceDescriptor desc;
+		std::vector<const char*> features = adapter.GetSupportedFeatures();
+		for (auto it = features.begin(); it != features.end(); ++it) {
+			if (PROFILE_TIMESTAMPS && strcmp(*it, "timestamp-query") == 0) {
+				desc.requiredFeatures.push_back(*it);
+				desc.forceDisabledToggles.push_back("disallow_unsafe_apis");
+			}
+			if (strncmp(*it, "texture-compression-", 20) == 0) {
+				desc.requiredFeatures.push_back(*it);
+			}
+		}
+		impl::device = adapter.CreateDevice(&desc);
+		impl::native = dawn::native::GetProcs();
+		/*
+		 * Swap chain replaced before the capture and stats see the procs (so
+		 * the replay server also renders offscreen).
+		 */
+		DawnProcTable procs(impl::native);
+		impl::installOffscreen(&procs);
+		impl::procs = procs;
+		procs.deviceSetUncapturedErrorCallback(impl::device, impl::printError, nullptr);
+	#if WEBGPU_CAPTURE
+		/*
+		 * When capturing the app gets the wire's device (and procs) instead.
+		 */
+		WGPUDevice wired = capture::begin(impl::device, procs, &procs);
+	#endif
+	#if WEBGPU_API_STATS
+		apistats::install(&procs);
+	#endif
+		dawnProcSetProcs(&procs);
+	#if WEBGPU_CAPTURE
+		if (wired) {
+			return wired;
+		}
+	#endif
+	}
+	return impl::device;
+}
+
+WGPUSwapChain webgpu::createSwapChain(WGPUDevice device, uint32_t width, uint32_t height) {
+	if (!width || !height) {
+		width  = WEBGPU_SWAP_W;
+		height = WEBGPU_SWAP_H;
+	}
+	WGPUSwapChainDescriptor swapDesc = {};
+#if WEBGPU_CAPTURE
+	if (capture::active()) {
+		/*
+		 * As with the other platforms, created natively and handed over.
+		 */
+		WGPUSwapChain swapchain = impl::procs.deviceCreateSwapChain(impl::device, nullptr, &swapDesc);
+		impl::procs.swapChainConfigure(swapchain, impl::swapPref, WGPUTextureUsage_RenderAttachment, width, height);
+		return capture::inject(swapchain, width, height, impl::swapPref);
+	}
+#endif
+	WGPUSwapChain swapchain = wgpuDeviceCreateSwapChain(device, nullptr, &swapDesc);
+	wgpuSwapChainConfigure(swapchain, impl::swapPref, WGPUTextureUsage_RenderAttachment, width, height);
+	return swapchain;
+}
+
+WGPUSwapChain webgpu::resizeSwapChain(WGPUDevice /*device*/, WGPUSwapChain swapchain, uint32_t width, uint32_t height) {
+	/*
+	 * Replaces the offscreen texture (frames in flight keep their own
+	 * references to the old one, so nothing waits on the queue).
+	 */
+	wgpuSwapChainConfigure(swapchain, impl::swapPref, WGPUTextureUsage_RenderAttachment, width, height);
+	return swapchain;
+}
+
+WGPUTextureFormat webgpu::getSwapChainFormat(WGPUDevice /*device*/) {
+	return impl::swapPref;
+}
+
+const DawnProcTable& webgpu::procs() {
+	return impl::procs;
+}
@@ -0,0 +1,79 @@
+#include "window.h"
+
+#include <stdio.h>
+
+#include <chrono>
+
+/**
+ * \def WINDOW_HEADLESS_FRAMES
+ * Number of frames to run before returning from the loop (zero runs until one
+ * of the stages quits). Throughput runs on build machines set this.
+ */
+#ifndef WINDOW_HEADLESS_FRAMES
+#define WINDOW_HEADLESS_FRAMES 0
+#endif
+
+/**
+ * \def WINDOW_WIN_W
+ * Offscreen width (there being no window to size it).
+ */
+#ifndef WINDOW_WIN_W
+#define WINDOW_WIN_W 800
+#endif
+
+/**
+ * \def WINDOW_WIN_H
+ * Offscreen height.
+ */
+#ifndef WINDOW_WIN_H
+#define WINDOW_WIN_H 450
+#endif
+
+namespace window {
+/**
+ * Temporary dummy window handle (there being no windowing, see \c webgpu.cpp).
+ */
+struct HandleImpl {} DUMMY;
+}
+
+//******************************** Public API ********************************/
+
+window::Handle window::create(unsigned /*winW*/, unsigned /*winH*/, const char* /*name*/) {
+	return &DUMMY;
+}
+
+void window::destroy(window::Handle /*wHnd*/) {}
+
+void window::show(window::Handle /*wHnd*/, bool /*show*/) {}
+
+void window::loop(window::Handle /*wHnd*/, const frame::Stages* stages) {
+	/*
+	 * Headless runs draw every frame as fast as the adapter allows (there's
+	 * no display to wait on), reporting the rate at the end.
+	 */
+	if (stages) {
+		frame::Scheduler sched(*stages);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		unsigned long long frames = 0;
+		while (sched.tick()) {
+			if (++frames == WINDOW_HEADLESS_FRAMES) {
+				break;
+			}
+		}
+		double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("%llu frames in %.2fs (%.1f fps)\n", frames, secs, (secs > 0.0) ? frames / secs : 0.0);
+	}
+}
+
+void window::size(window::Handle /*wHnd*/, unsigned& w, unsigned& h) {
+	w = WINDOW_WIN_W;
+	h = WINDOW_WIN_H;
+}
+
+bool window::resized(window::Handle /*wHnd*/, unsigned& /*w*/, unsigned& /*h*/) {
+	return false;
+}
+
+void window::invalidate(window::Handle /*wHnd*/) {}
+
+void window::animate(window::Handle /*wHnd*/, bool /*active*/) {}
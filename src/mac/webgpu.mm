@@ -1,10 +1,16 @@
 #include "webgpu.h"
 
+#include "apistats.h"
+#include "capture.h"
+#include "profile.h"
+
 /*
  * On Mac Dawn should have been built with Metal support.
  */
 #define DAWN_ENABLE_BACKEND_METAL
 
+#include <string.h>
+
 #include <dawn/dawn_proc.h>
 #include <dawn/webgpu_cpp.h>
 #include <dawn/native/MetalBackend.h>
@@ -224,16 +230,48 @@ WGPUDevice webgpu::create(window::Handle window, WGPUBackendType type) {
 		wgpu::AdapterProperties properties;
 		adapter.GetProperties(&properties);
 		impl::backend = static_cast<WGPUBackendType>(properties.backendType);
-		impl::device  = adapter.CreateDevice();
+		/*
+		 * Timestamp queries (see profile.h) are only enabled if the adapter
+		 * has them and profiling asks for them. Dawn also classes them as
+		 * unsafe, hence the toggle. Any compressed texture formats are
+		 * enabled too (see transcode.h).
+		 */
+		dawn_native::DawnDeviceDescriptor desc;
+		std::vector<const char*> features = adapter.GetSupportedFeatures();
+		for (auto it = features.begin(); it != features.end(); ++it) {
+			if (PROFILE_TIMESTAMPS && strcmp(*it, "timestamp-query") == 0) {
+				desc.requiredFeatures.push_back(*it);
+				desc.forceDisabledToggles.push_back("disallow_unsafe_apis");
+			}
+			if (strncmp(*it, "texture-compression-", 20) == 0) {
+				desc.requiredFeatures.push_back(*it);
+			}
+		}
+		impl::device  = adapter.CreateDevice(&desc);
 		impl::initSwapChain(impl::backend, impl::device, window);
 		DawnProcTable procs(dawn_native::GetProcs());
 		procs.deviceSetUncapturedErrorCallback(impl::device, impl::printError, nullptr);
+	#if WEBGPU_CAPTURE
+		WGPUDevice wired = capture::begin(impl::device, procs, &procs);
+	#endif
+	#if WEBGPU_API_STATS
+		apistats::install(&procs);
+	#endif
 		dawnProcSetProcs(&procs);
+	#if WEBGPU_CAPTURE
+		if (wired) {
+			return wired;
+		}
+	#endif
 	}
 	return impl::device;
 }
 
-WGPUSwapChain webgpu::createSwapChain(WGPUDevice device) {
+WGPUSwapChain webgpu::createSwapChain(WGPUDevice device, uint32_t width, uint32_t height) {
+	if (!width || !height) {
+		width  = WEBGPU_SWAP_W;
+		height = WEBGPU_SWAP_H;
+	}
 	WGPUSwapChainDescriptor swapDesc = {};
 	/*
 	 * See the Windows implementation. This is mostly the same (find the docs
@@ -246,14 +284,36 @@ WGPUSwapChain webgpu::createSwapChain(WGPUDevice device) {
 	swapDesc.presentMode = WGPUPresentMode_Immediate;
 	 */
 	swapDesc.implementation = reinterpret_cast<uintptr_t>(&impl::swapImpl);
+#if WEBGPU_CAPTURE
+	if (capture::active()) {
+		const DawnProcTable& native = dawn_native::GetProcs();
+		WGPUSwapChain swapchain = native.deviceCreateSwapChain(impl::device, nullptr, &swapDesc);
+		native.swapChainConfigure(swapchain, impl::swapPref, WGPUTextureUsage_RenderAttachment, width, height);
+		return capture::inject(swapchain, width, height, impl::swapPref);
+	}
+#endif
 	WGPUSwapChain swapchain = wgpuDeviceCreateSwapChain(device, nullptr, &swapDesc);
 	/*
 	 * Currently failing on hi-DPI (with Vulkan on Windows).
 	 */
-	wgpuSwapChainConfigure(swapchain, impl::swapPref, WGPUTextureUsage_RenderAttachment, 800, 450);
+	wgpuSwapChainConfigure(swapchain, impl::swapPref, WGPUTextureUsage_RenderAttachment, width, height);
+	return swapchain;
+}
+
+WGPUSwapChain webgpu::resizeSwapChain(WGPUDevice /*device*/, WGPUSwapChain swapchain, uint32_t width, uint32_t height) {
+	/*
+	 * Dawn recreates the underlying swap chain without waiting for the queue
+	 * (frames in flight keep their own references to the old textures). When
+	 * capturing this goes over the wire and is replayed in the same place.
+	 */
+	wgpuSwapChainConfigure(swapchain, impl::swapPref, WGPUTextureUsage_RenderAttachment, width, height);
 	return swapchain;
 }
 
 WGPUTextureFormat webgpu::getSwapChainFormat(WGPUDevice /*device*/) {
 	return impl::swapPref;
 }
+
+const DawnProcTable& webgpu::procs() {
+	return dawn_native::GetProcs();
+}
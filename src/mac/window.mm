@@ -2,6 +2,8 @@
 
 #import <CoreVideo/CoreVideo.h>
 
+#include <atomic>
+
 #include "glue.h"
 
 /**
@@ -79,6 +81,32 @@ namespace impl {
  */
 bool running = true;
 
+/**
+ * \c true if a frame was requested (by input, resizing, etc.).
+ */
+std::atomic<bool> dirty(true);
+
+/**
+ * \c true if every frame should be drawn (regardless of \c #dirty).
+ */
+std::atomic<bool> animating(!WINDOW_ON_DEMAND);
+
+/**
+ * \c true whilst the window is in the dock (when nothing is drawn).
+ */
+std::atomic<bool> minimised(false);
+
+/*
+ * Resize state (only touched on the main thread, where the display link's
+ * redraws also run).
+ */
+unsigned sizeW = 0; ///< Last size reported by \c window#resized()
+unsigned sizeH = 0;
+unsigned pendW = 0; ///< Latest backing size
+unsigned pendH = 0;
+bool pending = false; ///< Size changed since the last report
+bool sizing  = false; ///< In a live resize (reports wait until the end)
+
 /**
  * Display link callback (with the \c CVDisplayLinkOutputCallback signature).
  *
@@ -105,9 +133,9 @@ static CVReturn update(CVDisplayLinkRef dispLink, const CVTimeStamp* callTime, c
 CVDisplayLinkRef dispLink;
 
 /**
- * Registered redraw function to call each frame via \c #dispLink.
+ * Registered frame scheduler to tick each frame via \c #dispLink (owned).
  */
-window::Redraw redrawFunc;
+frame::Scheduler* sched;
 }
 @end
 
@@ -122,7 +150,7 @@ window::Redraw redrawFunc;
 	if ((self = [super initWithContentRect:rect styleMask:style backing:type defer:flag])) {
 		CVDisplayLinkCreateWithActiveCGDisplays(&dispLink);
 		CVDisplayLinkSetOutputCallback(dispLink, &impl::update, self);
-		redrawFunc = NULLPTR;
+		sched = NULLPTR;
 		/*
 		 * Note: added as a notification instead of an NSWindowDelegate,
 		 * allowing other parts of metal to add their own.
@@ -130,6 +158,24 @@ window::Redraw redrawFunc;
 		[[NSNotificationCenter defaultCenter] addObserver:self
 			selector:@selector(windowWillClose:)
 				name:NSWindowWillCloseNotification object:self];
+		[[NSNotificationCenter defaultCenter] addObserver:self
+			selector:@selector(windowDidChange:)
+				name:NSWindowDidResizeNotification object:self];
+		[[NSNotificationCenter defaultCenter] addObserver:self
+			selector:@selector(windowDidChange:)
+				name:NSWindowDidChangeBackingPropertiesNotification object:self];
+		[[NSNotificationCenter defaultCenter] addObserver:self
+			selector:@selector(windowDidChange:)
+				name:NSWindowDidMiniaturizeNotification object:self];
+		[[NSNotificationCenter defaultCenter] addObserver:self
+			selector:@selector(windowDidChange:)
+				name:NSWindowDidDeminiaturizeNotification object:self];
+		[[NSNotificationCenter defaultCenter] addObserver:self
+			selector:@selector(windowLiveResize:)
+				name:NSWindowWillStartLiveResizeNotification object:self];
+		[[NSNotificationCenter defaultCenter] addObserver:self
+			selector:@selector(windowLiveResize:)
+				name:NSWindowDidEndLiveResizeNotification object:self];
 	}
 	return self;
 }
@@ -139,34 +185,36 @@ window::Redraw redrawFunc;
  */
 - (void)dealloc {
 	CVDisplayLinkRelease(dispLink);
+	delete sched;
 	[super dealloc];
 }
 
 /**
- * Hmm, hackily sets the redraw function called by the display link.
+ * Hmm, hackily sets the frame scheduler ticked by the display link.
  *
  * \todo tidy!
  * \todo this is freezing sometime on calling CVDisplayLinkStop (reproducible more in debug and with the Big Sur beta)
  *
- * \param[in] func redraw function (\c null to stop the redraw callbacks)
+ * \param[in] func frame scheduler, taking ownership (\c null to stop the redraw callbacks)
  */
-- (void)setRedraw:(window::Redraw) func {
+- (void)setRedraw:(frame::Scheduler*) func {
 	if (func) {
-		redrawFunc = func;
+		sched = func;
 		CVDisplayLinkStart(dispLink);
 	} else {
 		impl::running = false;
-		redrawFunc = NULLPTR;
 		CVDisplayLinkStop(dispLink);
+		delete sched;
+		sched = NULLPTR;
 	}
 }
 
 /**
- * Called by the \c impl#update() redirector to call and handle \c #redrawFunc.
+ * Called by the \c impl#update() redirector to tick and handle \c #sched.
  */
 - (void)doRedraw {
 AUTO_RELEASE_POOL_ACQUIRE;
-	if (!(redrawFunc && redrawFunc())) {
+	if (!(sched && sched->tick())) {
 		[self setRedraw:NULLPTR];
 	}
 AUTO_RELEASE_POOL_RELEASE;
@@ -187,10 +235,44 @@ AUTO_RELEASE_POOL_RELEASE;
 	[self setRedraw:NULLPTR];
 	
 }
+
+/**
+ * Called when the window resizes, changes scale, or goes in or out of the
+ * dock, requesting a redraw (or stopping them whilst minimised).
+ *
+ * \note Added via \c NSNotificationCenter not as a \c NSWindowDelegate.
+ */
+- (void)windowDidChange:(NSNotification*)__unused notification {
+	impl::minimised = [self isMiniaturized];
+	impl::dirty = true;
+	if (!impl::minimised) {
+		window::size(TO_HND(self), impl::pendW, impl::pendH);
+		impl::pending = true;
+	}
+}
+
+/**
+ * Called when a live resize starts or ends (holding back the size changes
+ * until the end, so a drag reconfigures the swap chain once).
+ *
+ * \note Added via \c NSNotificationCenter not as a \c NSWindowDelegate.
+ */
+- (void)windowLiveResize:(NSNotification*)notification {
+	impl::sizing = [[notification name] isEqualToString:NSWindowWillStartLiveResizeNotification];
+	impl::dirty = true;
+}
 @end
 
 namespace impl {
 static CVReturn update(CVDisplayLinkRef dispLink, const CVTimeStamp* callTime, const CVTimeStamp* drawTime, CVOptionFlags, CVOptionFlags*, void* user) {
+	/*
+	 * Idle frames return straight away without waking the main thread (the
+	 * display link itself keeps running, since stopping it from here can
+	 * deadlock with the main thread).
+	 */
+	if (minimised || !(animating || dirty.exchange(false))) {
+		return kCVReturnSuccess;
+	}
 	[TO_WIN(user)
 		performSelectorOnMainThread:@selector(doRedraw)
 			withObject:nil waitUntilDone:YES];
@@ -223,6 +305,19 @@ AUTO_RELEASE_POOL_ACQUIRE;
 			/*
 			 * Any of the events we're interested in go here.
 			 */
+			case NSEventTypeKeyDown:
+			case NSEventTypeKeyUp:
+			case NSEventTypeFlagsChanged:
+			case NSEventTypeLeftMouseDown:
+			case NSEventTypeLeftMouseUp:
+			case NSEventTypeLeftMouseDragged:
+			case NSEventTypeRightMouseDown:
+			case NSEventTypeRightMouseUp:
+			case NSEventTypeRightMouseDragged:
+			case NSEventTypeMouseMoved:
+			case NSEventTypeScrollWheel:
+				dirty = true;
+				break;
 			default:
 				break;
 			}
@@ -244,6 +339,7 @@ window::Handle window::create(unsigned /*winW*/, unsigned /*winH*/, const char*
 	[win center];
 	[win makeKeyAndOrderFront:win];
 	[win makeMainWindow];
+	window::size(TO_HND(win), impl::sizeW, impl::sizeH);
 	return TO_HND(win);
 }
 
@@ -253,13 +349,49 @@ void window::destroy(window::Handle wHnd) {
 
 void window::show(window::Handle /*wHnd*/, bool /*show*/) {}
 
-void window::loop(window::Handle wHnd, window::Redraw func) {
+void window::loop(window::Handle wHnd, const frame::Stages* stages) {
 	/*
-	 * Starts with an initial call to the draw function (which, for example,
-	 * clears the screen early).
+	 * Starts with an initial tick (which, for example, clears the screen
+	 * early).
 	 */
-	if (func && func()) {
-		[TO_WIN(wHnd) setRedraw:func];
-		impl::wait();
+	if (stages) {
+		frame::Scheduler* sched = new frame::Scheduler(*stages);
+		if (sched->tick()) {
+			[TO_WIN(wHnd) setRedraw:sched];
+			impl::wait();
+		} else {
+			delete sched;
+		}
 	}
 }
+
+void window::size(window::Handle wHnd, unsigned& w, unsigned& h) {
+	NSRect rect = [TO_WIN(wHnd) convertRectToBacking:[[TO_WIN(wHnd) contentView] bounds]];
+	w = static_cast<unsigned>(rect.size.width);
+	h = static_cast<unsigned>(rect.size.height);
+}
+
+bool window::resized(window::Handle /*wHnd*/, unsigned& w, unsigned& h) {
+	if (impl::pending && !impl::sizing) {
+		impl::pending = false;
+		if (impl::pendW && impl::pendH && (impl::pendW != impl::sizeW || impl::pendH != impl::sizeH)) {
+			impl::sizeW = impl::pendW;
+			impl::sizeH = impl::pendH;
+			w = impl::sizeW;
+			h = impl::sizeH;
+			return true;
+		}
+	}
+	return false;
+}
+
+void window::invalidate(window::Handle /*wHnd*/) {
+	/*
+	 * Picked up by the next display link callback.
+	 */
+	impl::dirty = true;
+}
+
+void window::animate(window::Handle /*wHnd*/, bool active) {
+	impl::animating = active;
+}
@@ -1,12 +1,37 @@
 #include "webgpu.h"
+#include "alloctrack.h"
+#include "apistats.h"
+#include "archive.h"
+#include "arena.h"
+#include "binding.h"
+#include "capture.h"
+#include "draw.h"
+#include "dynres.h"
+#include "ecs.h"
+#include "graph.h"
+#include "instance.h"
+#include "jobs.h"
+#include "mipgen.h"
+#include "profile.h"
+#include "reflect.h"
+#include "reload.h"
+#include "scene.h"
+#include "shader.h"
+#include "spin.h"
+#include "stream.h"
+#include "transcode.h"
+#include "uniform.h"
 #include <math.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/constants.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/transform.hpp>
 #include <time.h>
+#include <atomic>
 using namespace glm;
 
 WGPUDevice device;
@@ -14,36 +39,254 @@ WGPUQueue queue;
 WGPUSwapChain swapchain;
 
 WGPURenderPipeline pipeline;
+WGPURenderPipeline rebuilt; // pipeline created in the background, swapped in at the start of the next frame
 
 WGPUBuffer vertBuf; // vertex buffer with triangle position and colours
 WGPUBuffer indxBuf; // index buffer
-WGPUBuffer uRotBuf; // uniform buffer (containing the rotation angle)
-WGPUBuffer uMVPBuf;
+WGPUBuffer instBuf; // storage buffer with each cube's transform (see instance.h)
+uniform::Buffer* uniforms; // uniform buffer (holding the matrices)
+uniform::Slot uMVPSlot;
 
 WGPUBindGroup bindGroup;
 
+/**
+ * Frame's passes (rebuilt per frame, keeping its transient textures).
+ */
+graph::Graph* frameGraph;
+
+/**
+ * Frame's draws, sorted to minimise state changes.
+ */
+draw::Queue* drawQueue;
+
+/**
+ * Shader variants (built on first use by each pipeline).
+ */
+shader::Library* shaders;
+
+/**
+ * Scene hierarchy (owned by the simulation thread): a stage, turned by the
+ * spinner below it, which carries the grid the cubes are placed in (see
+ * \c #buildScene()).
+ */
+scene::Graph* sceneGraph;
+scene::Node spinNode;
+scene::Node cubeNode;
+
+/**
+ * Renderable entities (owned by the simulation thread): the cubes, each
+ * spinning at its own speed.
+ */
+ecs::World* world;
+
+/**
+ * \def CUBE_GRID
+ * Cubes along each side of the grid (so \c CUBE_GRID cubed in all).
+ */
+#ifndef CUBE_GRID
+#define CUBE_GRID 16
+#endif
+
+/**
+ * Number of cubes (and most instances drawn).
+ */
+#define CUBE_COUNT (CUBE_GRID * CUBE_GRID * CUBE_GRID)
+
+/**
+ * \def ANIMATE_ON_GPU
+ * Set to spin the cubes in a compute pass (see \c spin.h), the entity
+ * systems then only culling (the visible cubes being drawn as runs of the
+ * GPU's instances), otherwise the entity systems animate, cull and build the
+ * instances on the CPU (only the visible cubes being drawn).
+ */
+#ifndef ANIMATE_ON_GPU
+#define ANIMATE_ON_GPU 1
+#endif
+
+#if ANIMATE_ON_GPU
+/**
+ * Cube transforms and spins, once handed over by the entities.
+ */
+spin::Animator* animator;
+#endif
+
+/**
+ * Mesh and material IDs (for \c MeshRef and \c Material).
+ */
+enum MeshId {
+	MESH_CUBE,
+};
+enum MaterialId {
+	MATERIAL_VERTEX_COLOUR,
+};
+
+/**
+ * Render scale picked from the frame times, and the pass upscaling the scene
+ * to the back buffer when it's below full resolution.
+ */
+dynres::Controller renderScale;
+dynres::Upscaler* upscaler;
+
+/**
+ * Pass IDs for the draw keys (see \c draw#key()).
+ */
+enum DrawPass {
+	PASS_SCENE,
+};
+
+/**
+ * Packed assets, overriding the built-in cube and shaders when present.
+ */
+archive::Archive assets;
+
+/**
+ * \def ASSETS_PATH
+ * Asset archive to map at startup (see \c archive.h).
+ */
+#ifndef ASSETS_PATH
+#define ASSETS_PATH "assets.pak"
+#endif
+
+/**
+ * \def ASSETS_ORDER
+ * File the order the assets were used in is saved to on exit (debug builds
+ * only, for the packer's \c -order option). CMake builds point this at the
+ * build directory, where the \c assets target reads it from.
+ */
+#ifndef ASSETS_ORDER
+#define ASSETS_ORDER "assets.order"
+#endif
+
+/**
+ * \def ASSETS_SOURCE
+ * Source asset directory watched for changes (see \c reload.h).
+ */
+#ifndef ASSETS_SOURCE
+#define ASSETS_SOURCE "assets"
+#endif
+
+/**
+ * \def PROFILE_PRINT_PERIOD
+ * Number of frames between printing the profiler's report (debug builds only).
+ */
+#ifndef PROFILE_PRINT_PERIOD
+#define PROFILE_PRINT_PERIOD 600
+#endif
+
 uint16_t WINDOW_WIDTH = 1200;
 uint16_t WINDOW_HEIGHT = 800;
 
+/**
+ * Swap chain size in pixels (matching the window's backing size, updated on
+ * the render thread and read for the aspect ratio by the simulation).
+ */
+std::atomic<uint32_t> SWAP_WIDTH (WEBGPU_SWAP_W);
+std::atomic<uint32_t> SWAP_HEIGHT(WEBGPU_SWAP_H);
+
 struct Cube {
-	uint16_t instanceCount = 0;
 	uint16_t indexCount = 0;
+	uint64_t vertBytes = 0; // buffer sizes (for patching in place)
+	uint64_t indxBytes = 0;
 } cube;
 
-/**
- * Current rotation angle (in degrees, updated per frame).
- */
-float rotDeg = 0.0f;
-
 struct Time {
 	double currentTime, deltaTime = 0.0f;
 }timeStamp;
 
-struct MVP {
-	mat4 model;
-	mat4 view;
-	mat4 projection;
-} view_mtr;
+/**
+ * Matrices uniform block.
+ */
+#define UNIFORM_MVP(FIELD) \
+	FIELD(mat4x4, model) \
+	FIELD(mat4x4, view) \
+	FIELD(mat4x4, projection)
+UNIFORM_BLOCK(MVP, UNIFORM_MVP)
+
+MVP view_mtr;
+
+#if ANIMATE_ON_GPU
+/**
+ * Run of consecutive visible instances (drawn with one instanced draw).
+ */
+struct Range {
+	uint32_t first;
+	uint32_t count;
+};
+#endif
+
+/**
+ * Everything the render thread needs from the simulation for one frame (see
+ * \c #update()).
+ */
+struct Snapshot {
+	MVP mvp;
+#if ANIMATE_ON_GPU
+	float delta; ///< Seconds to spin the cubes on by
+	uint32_t rangeCount;
+	const Range* ranges; ///< Runs of visible cubes (in the snapshot's arena, or \c null to draw them all)
+#else
+	uint32_t instanceCount;
+	const instance::Instance* instances; ///< Transform of each visible cube (in the snapshot's arena)
+#endif
+};
+
+/**
+ * Entity components (see \c ecs.h), the transform being the instance's (so
+ * copied to the GPU as is at full precision).
+ */
+typedef instance::Transform Transform;
+struct Bounds {
+	vec3 center;  ///< Bounding sphere centre, before the transform
+	float radius; ///< Bounding sphere radius, before scaling
+};
+struct MeshRef {
+	uint32_t mesh;
+};
+struct Material {
+	uint32_t material;
+};
+struct AngularVelocity {
+	vec3 axis;   ///< Unit rotation axis
+	float speed; ///< Radians per second
+};
+struct Visible {
+	uint32_t visible; ///< Set by the culling system if in view this frame
+};
+
+/**
+ * Frustum planes (as \c xyz normal pointing in, \c w distance) in the space
+ * of the entity transforms.
+ */
+struct Frustum {
+	vec4 planes[6];
+};
+
+#if ANIMATE_ON_GPU
+/**
+ * Runs of visible instances, filled in by the range gathering system.
+ */
+struct Runs {
+	Range* ranges;
+	std::atomic<unsigned> count;
+};
+#else
+/**
+ * Instances of one mesh and material, filled in by the draw building system.
+ */
+struct Batch {
+	uint32_t mesh;
+	uint32_t material;
+	instance::Instance* instances;
+	std::atomic<unsigned> count;
+};
+#endif
+
+/**
+ * Current frame's back buffer and commands (between \c #record() and
+ * \c #submit()).
+ */
+WGPUTextureView backBufView;
+WGPUCommandBuffer commands;
 
 /**
  * WGSL equivalent of \c triangle_vert_spirv.
@@ -52,44 +295,38 @@ static char const triangle_vert_wgsl[] = R"(
 	struct VertexIn {
 		@location(0) aPos : vec3<f32>;
 		@location(1) aCol : vec3<f32>;
+		@builtin(instance_index) inst : u32;
 	};
 	struct VertexOut {
 		@location(0) vCol : vec3<f32>;
 		@builtin(position) Position : vec4<f32>;
 	};
-	struct Rotation {
-		@location(0) degs : f32;
+)" UNIFORM_WGSL(MVP, UNIFORM_MVP) INSTANCE_WGSL R"(
+    @group(0) @binding(0) var<uniform> uMVP : MVP;
+	struct Instances {
+		items : array<Instance>;
 	};
-    struct MVP {
-		model: mat4x4<f32>;
-		view: mat4x4<f32>;
-		projection: mat4x4<f32>;
-	};	
-	@group(0) @binding(0) var<uniform> uRot : Rotation;
-    @group(0) @binding(1) var<uniform> uMVP : MVP;
+	@group(0) @binding(1) var<storage, read> instances : Instances;
 	@stage(vertex)
 	fn main(input : VertexIn) -> VertexOut {
-		var rads : f32 = radians(uRot.degs);
-		var cosA : f32 = cos(rads);
-		var sinA : f32 = sin(rads);
-		var rot : mat3x3<f32> = mat3x3<f32>(
-			vec3<f32>( cosA, sinA, 0.0),
-			vec3<f32>(-sinA, cosA, 0.0),
-			vec3<f32>( 0.0,  0.0,  1.0));
 		var output : VertexOut;
+		let instModel = instanceMatrix(instances.items[input.inst]);
 
 		// Rotate 1°  - Rotating Model Shader ش.
-		//var pos = uMVP.projection * uMVP.view * uMVP.model * vec4<f32>(input.aPos, 1.0); 	
-		//output.Position = pos;
-
-		// Rotate 2°  - Shader Ratate Model Matrix Ѵ.
-		var model = vec4<f32>(rot * vec3<f32>(input.aPos), 1.0);
-        output.Position = uMVP.projection * uMVP.view * model;
+		output.Position = uMVP.projection * uMVP.view * uMVP.model * instModel * vec4<f32>(input.aPos, 1.0);
 		output.vCol = input.aCol;
 		return output;
 	}
 )";
 
+/**
+ * \c triangle_vert_wgsl as a variant source (without flags, the cubes being
+ * rotated by their instances).
+ */
+static shader::Source const triangle_vert = {
+	triangle_vert_wgsl, nullptr, 0, "triangle_vert"
+};
+
 /**
  * WGSL equivalent of \c triangle_frag_spirv.
  */
@@ -152,57 +389,68 @@ static WGPUBuffer createBuffer(const void* data, size_t size, WGPUBufferUsage us
 
 static void setProjectionAndView()
 {
-	view_mtr.projection = perspective(glm::radians(25.0f), (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 0.1f, 10.0f);
+	view_mtr.projection = perspective(glm::radians(25.0f), (float)SWAP_WIDTH / (float)SWAP_HEIGHT, 0.1f, 10.0f);
 	view_mtr.view = lookAt(vec3(5.0f, 5.0f, 5.f), vec3(0.f, 0.f, 0.f), vec3(0.f, 1.f, 0.f));
 }
 
 /**
- * Bare minimum pipeline to draw a triangle using the above shaders.
+ * Keeps a pipeline created in the background for the next frame (or the
+ * current pipeline if creation failed).
  */
-static void createPipelineAndBuffers() {
-	// compile shaders
-	// NOTE: these are now the WGSL shaders (tested with Dawn and Chrome Canary)
-	WGPUShaderModule vertMod = createShader(triangle_vert_wgsl);
-	WGPUShaderModule fragMod = createShader(triangle_frag_wgsl);
-
-	WGPUBufferBindingLayout buf[2] = {};
-	buf[0].type = WGPUBufferBindingType_Uniform;
-
-	buf[1].type = WGPUBufferBindingType_Uniform;
+static void pipelineCreated(WGPUCreatePipelineAsyncStatus status, WGPURenderPipeline created, const char* message, void* /*user*/) {
+	if (status == WGPUCreatePipelineAsyncStatus_Success) {
+		if (rebuilt) {
+			wgpuRenderPipelineRelease(rebuilt);
+		}
+		rebuilt = created;
+	} else {
+		printf("Pipeline not rebuilt: %s\n", (message) ? message : "");
+		if (created) {
+			wgpuRenderPipelineRelease(created);
+		}
+	}
+}
 
-	// bind group layout (used by both the pipeline layout and uniform bind group, released at the end of this function)
-	WGPUBindGroupLayoutEntry bglEntry[2] = {};
-	bglEntry[0].binding = 0;
-	bglEntry[0].visibility = WGPUShaderStage_Vertex;
-	bglEntry[0].buffer = buf[0];
+/**
+ * Bare minimum pipeline to draw a triangle using the above vertex shader and
+ * \a fragWgsl. When \a async the pipeline is created in the background (see
+ * \c #rebuilt).
+ *
+ * \return the first bind group layout (for the caller to release), or \c null if the shaders couldn't be reflected (creating no pipeline)
+ */
+static WGPUBindGroupLayout createPipeline(const char* fragWgsl, bool async) {
+	// reflect the bindings and vertex inputs from the shaders (the vertex shader as specialised for its variant, since source flags can change the bindings)
+	shader::Features features = 0;
+	size_t vertSize = shader::specialise(triangle_vert, features, nullptr, 0);
+	char* vertWgsl = new char[vertSize];
+	shader::specialise(triangle_vert, features, vertWgsl, vertSize);
+	const reflect::Shader* vertInfo = reflect::shader(vertWgsl);
+	delete[] vertWgsl;
+	const reflect::Shader* fragInfo = reflect::shader(fragWgsl);
+	if (!vertInfo || !fragInfo) {
+		printf("Pipeline not created: %s shader not reflected\n", (vertInfo) ? "fragment" : "vertex");
+		return nullptr;
+	}
+	const reflect::Shader* stages[] = {vertInfo, fragInfo};
 
-	bglEntry[1].binding = 1;
-	bglEntry[1].visibility = WGPUShaderStage_Vertex;
-	bglEntry[1].buffer = buf[1];
+	// compile shaders
+	// NOTE: these are now the WGSL shaders (tested with Dawn and Chrome Canary)
+	shader::Variant vert = shaders->get(triangle_vert, features);
+	WGPUShaderModule fragMod = createShader(fragWgsl);
 
-	WGPUBindGroupLayoutDescriptor bglDesc = {};
-	bglDesc.entryCount = 2;
-	bglDesc.entries = bglEntry;
-	WGPUBindGroupLayout bindGroupLayout = wgpuDeviceCreateBindGroupLayout(device, &bglDesc);
+	// bind group layouts (used by both the pipeline layout and uniform bind group, released at the end of this function)
+	WGPUBindGroupLayout bindGroupLayouts[REFLECT_MAX_GROUPS] = {};
+	unsigned groupCount = reflect::layouts(stages, 2, bindGroupLayouts);
+	WGPUBindGroupLayout bindGroupLayout = bindGroupLayouts[0];
 
 	// pipeline layout (used by the render pipeline, released after its creation)
 	WGPUPipelineLayoutDescriptor layoutDesc = {};
-	layoutDesc.bindGroupLayoutCount = 1;
-	layoutDesc.bindGroupLayouts = &bindGroupLayout;
+	layoutDesc.bindGroupLayoutCount = groupCount;
+	layoutDesc.bindGroupLayouts = bindGroupLayouts;
 	WGPUPipelineLayout pipelineLayout = wgpuDeviceCreatePipelineLayout(device, &layoutDesc);
 
 	// describe buffer layouts
-	WGPUVertexAttribute vertAttrs[2] = {};
-	vertAttrs[0].format = WGPUVertexFormat_Float32x3;
-	vertAttrs[0].offset = 0;
-	vertAttrs[0].shaderLocation = 0;
-	vertAttrs[1].format = WGPUVertexFormat_Float32x3;
-	vertAttrs[1].offset = 3 * sizeof(float);
-	vertAttrs[1].shaderLocation = 1;
-	WGPUVertexBufferLayout vertexBufferLayout = {};
-	vertexBufferLayout.arrayStride = 6 * sizeof(float);
-	vertexBufferLayout.attributeCount = 2;
-	vertexBufferLayout.attributes = vertAttrs;
+	WGPUVertexBufferLayout vertexBufferLayout = reflect::vertexLayout(*vertInfo);
 
 	// Fragment state
 	WGPUBlendState blend = {};
@@ -251,7 +499,9 @@ static void createPipelineAndBuffers() {
 	desc.layout = pipelineLayout;
 
 	desc.depthStencil = &depth_stencil_state;
-	desc.vertex.module = vertMod;
+	desc.vertex.module = vert.module;
+	desc.vertex.constantCount = vert.constantCount;
+	desc.vertex.constants = vert.constants;
 	desc.vertex.entryPoint = "main";
 	desc.vertex.bufferCount = 1;//0;
 	desc.vertex.buffers = &vertexBufferLayout;
@@ -265,13 +515,44 @@ static void createPipelineAndBuffers() {
 	desc.primitive.topology = WGPUPrimitiveTopology_TriangleList;
 	desc.primitive.stripIndexFormat = WGPUIndexFormat_Undefined;
 
-	pipeline = wgpuDeviceCreateRenderPipeline(device, &desc);
+	if (async) {
+		wgpuDeviceCreateRenderPipelineAsync(device, &desc, pipelineCreated, nullptr);
+	} else {
+		pipeline = wgpuDeviceCreateRenderPipeline(device, &desc);
+	}
 
 	// partial clean-up (just move to the end, no?)
 	wgpuPipelineLayoutRelease(pipelineLayout);
 
 	wgpuShaderModuleRelease(fragMod);
-	wgpuShaderModuleRelease(vertMod);
+
+	for (unsigned n = 1; n < groupCount; n++) {
+		binding::release(bindGroupLayouts[n]);
+	}
+	return bindGroupLayout;
+}
+
+/**
+ * \return \c true if \a mesh has the cube's vertex layout (position then colour, with 16-bit indices)
+ */
+static bool cubeLayout(const archive::Mesh& mesh) {
+	return mesh.stride == 6 * sizeof(float) && mesh.indexSize == sizeof(uint16_t) && mesh.indexCount <= 0xFFFF;
+}
+
+/**
+ * Creates the pipeline, then the cube's buffers and bind group.
+ */
+static void createPipelineAndBuffers() {
+	// (the fragment shader used straight from the archive's pages if packed)
+	archive::Blob fragBlob;
+	const char* fragWgsl = triangle_frag_wgsl;
+	if (assets && archive::find(assets, "triangle_frag.wgsl", fragBlob) && fragBlob.type == archive::TYPE_SHADER) {
+		fragWgsl = static_cast<const char*>(fragBlob.data);
+	}
+	WGPUBindGroupLayout bindGroupLayout = createPipeline(fragWgsl, false);
+	if (!bindGroupLayout && fragWgsl != triangle_frag_wgsl) {
+		bindGroupLayout = createPipeline(triangle_frag_wgsl, false);
+	}
 
 	// create the buffers (x, y, z,  r, g, b)
 	float const vertData[] = {
@@ -306,113 +587,318 @@ static void createPipelineAndBuffers() {
 		4, 1, 5
 	};
 
-	cube.indexCount = sizeof(indxData)/sizeof(uint16_t);
-	cube.instanceCount = cube.indexCount / 3;
-
-	vertBuf = createBuffer(vertData, sizeof(vertData), WGPUBufferUsage_Vertex);
-	indxBuf = createBuffer(indxData, sizeof(indxData), WGPUBufferUsage_Index);
+	/*
+	 * A packed mesh in the same layout replaces the built-in one, uploaded
+	 * directly from the mapped pages.
+	 */
+	archive::Blob meshBlob;
+	archive::Mesh mesh;
+	if (assets && archive::find(assets, "cube.obj", meshBlob) && archive::mesh(meshBlob, mesh) && cubeLayout(mesh)) {
+		cube.indexCount = static_cast<uint16_t>(mesh.indexCount);
+		cube.vertBytes  = mesh.vertexCount * mesh.stride;
+		cube.indxBytes  = (mesh.indexCount * mesh.indexSize + 3) & ~3;
+		vertBuf = createBuffer(mesh.vertices, cube.vertBytes, WGPUBufferUsage_Vertex);
+		indxBuf = createBuffer(mesh.indices,  cube.indxBytes, WGPUBufferUsage_Index);
+	} else {
+		cube.indexCount = sizeof(indxData)/sizeof(uint16_t);
+		cube.vertBytes  = sizeof(vertData);
+		cube.indxBytes  = sizeof(indxData);
+		vertBuf = createBuffer(vertData, sizeof(vertData), WGPUBufferUsage_Vertex);
+		indxBuf = createBuffer(indxData, sizeof(indxData), WGPUBufferUsage_Index);
+	}
+#if ANIMATE_ON_GPU
+	// the animator's instances (written by its compute pass)
+	instBuf = animator->instances();
+	wgpuBufferReference(instBuf);
+#else
+	// room for every cube to be visible
+	WGPUBufferDescriptor instDesc = {};
+	instDesc.usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage;
+	instDesc.size  = CUBE_COUNT * sizeof(instance::Instance);
+	instBuf = wgpuDeviceCreateBuffer(device, &instDesc);
+#endif
 
-	// create the uniform bind group (note 'rotDeg' is copied here, not bound in any way)
-	uRotBuf = createBuffer(&rotDeg, sizeof(rotDeg), WGPUBufferUsage_Uniform);
+	// create the uniform bind group
+	uniforms = new uniform::Buffer(device);
+	uMVPSlot = uniforms->add<MVP>();
 
 	view_mtr.model = mat4(1.0f);
 	setProjectionAndView();
 
-	uMVPBuf = createBuffer(&view_mtr, sizeof(view_mtr)+256, WGPUBufferUsage_Uniform);
+	uniforms->write(uMVPSlot, view_mtr);
 
 	WGPUBindGroupEntry bgEntry[2] = {};
 	bgEntry[0].binding = 0;
-	bgEntry[0].buffer = uRotBuf;
-	bgEntry[0].offset = 0;
-	bgEntry[0].size = sizeof(rotDeg);
+	bgEntry[0].buffer = uniforms->buffer();
+	bgEntry[0].offset = uMVPSlot.offset;
+	bgEntry[0].size = uMVPSlot.size;
 
 	bgEntry[1].binding = 1;
-	bgEntry[1].buffer = uMVPBuf;
+	bgEntry[1].buffer = instBuf;
 	bgEntry[1].offset = 0;
-	bgEntry[1].size = sizeof(view_mtr);
+	bgEntry[1].size = CUBE_COUNT * sizeof(instance::Instance);
 
 	WGPUBindGroupDescriptor bgDesc = {};
 	bgDesc.layout = bindGroupLayout;
 	bgDesc.entryCount = 2;
 	bgDesc.entries = bgEntry;
 
-	bindGroup = wgpuDeviceCreateBindGroup(device, &bgDesc);
+	bindGroup = binding::group(bgDesc);
 
 	// last bit of clean-up
-	wgpuBindGroupLayoutRelease(bindGroupLayout);
+	if (bindGroupLayout) {
+		binding::release(bindGroupLayout);
+	}
+}
+
+/**
+ * Hot reload handler for the cube mesh, writing the buffers in place unless
+ * they change size.
+ */
+static void reloadMesh(const archive::Blob& blob, void* /*user*/) {
+	archive::Mesh mesh;
+	if (!archive::mesh(blob, mesh) || !cubeLayout(mesh)) {
+		printf("Mesh not reloaded (needs a position and colour per vertex): %s\n", blob.name);
+		return;
+	}
+	vertBuf = reload::patch(device, queue, vertBuf, cube.vertBytes, mesh.vertices, mesh.vertexCount * mesh.stride, WGPUBufferUsage_Vertex);
+	indxBuf = reload::patch(device, queue, indxBuf, cube.indxBytes, mesh.indices, (mesh.indexCount * mesh.indexSize + 3) & ~3, WGPUBufferUsage_Index);
+	cube.indexCount = static_cast<uint16_t>(mesh.indexCount);
+}
+
+#if ANIMATE_ON_GPU
+/**
+ * Hand over system: copies each entity's transform and spin into the
+ * animator's states (at the entity's position across the chunks).
+ */
+static void handOver(const ecs::Chunk& chunk, void* user) {
+	spin::State* states = static_cast<spin::State*>(user) + chunk.first;
+	const Transform* transform = chunk.get<Transform>();
+	const AngularVelocity* spin = chunk.get<AngularVelocity>();
+	for (unsigned n = 0; n < chunk.count; n++) {
+		states[n].rotation = transform[n].rotation;
+		states[n].position = transform[n].position;
+		states[n].scale    = transform[n].scale;
+		states[n].axis     = spin[n].axis;
+		states[n].speed    = spin[n].speed;
+	}
 }
+#endif
 
+/**
+ * Builds the scene hierarchy. Only the spinner is set per update, so only
+ * its branch is recomputed (the stage staying put).
+ */
+static void buildScene() {
+	sceneGraph = new scene::Graph();
+	scene::Node stage = sceneGraph->add();
+	spinNode = sceneGraph->add(stage);
+	cubeNode = sceneGraph->add(spinNode);
+	/*
+	 * A marker root with a child, added after the deeper nodes (so the graph
+	 * is re-sorted by depth) then removed again with its child (both being
+	 * compacted out on the first update).
+	 */
+	scene::Node marker = sceneGraph->add(scene::NONE, translate(mat4(1.0f), vec3(0.0f, 2.0f, 0.0f)));
+	sceneGraph->add(marker);
+	sceneGraph->remove(marker);
+}
 
 /**
- * Draws using the above pipeline and buffers.
+ * Fills the world with a grid of cubes, each spinning about its own axis at
+ * its own speed.
  */
-static bool redraw() {
-	WGPUTextureView backBufView = wgpuSwapChainGetCurrentTextureView(swapchain);			// create textureView
+static void spawnCubes() {
+	const ecs::Mask parts = ecs::mask<Transform, Bounds, MeshRef, Material, AngularVelocity, Visible>();
+	const float spacing = 2.4f / CUBE_GRID;
+	const float origin  = -0.5f * spacing * (CUBE_GRID - 1);
+	srand(1);
+	for (unsigned z = 0; z < CUBE_GRID; z++) {
+		for (unsigned y = 0; y < CUBE_GRID; y++) {
+			for (unsigned x = 0; x < CUBE_GRID; x++) {
+				ecs::Entity cube = world->create(parts);
+				Transform transform = {
+					quat(1.0f, 0.0f, 0.0f, 0.0f),
+					vec3(origin + x * spacing, origin + y * spacing, origin + z * spacing),
+					0.4f * spacing
+				};
+				vec3 axis(rand() / (float) RAND_MAX - 0.5f, rand() / (float) RAND_MAX - 0.5f, rand() / (float) RAND_MAX - 0.5f);
+				AngularVelocity spin = {
+					(length(axis) > 0.01f) ? normalize(axis) : vec3(0.0f, 1.0f, 0.0f),
+					0.5f + 3.0f * rand() / (float) RAND_MAX
+				};
+				// (the built-in cube's corners are 0.8 from the centre on each axis)
+				Bounds bounds = {vec3(0.0f), 0.8f * sqrt(3.0f)};
+				world->set(cube, transform);
+				world->set(cube, bounds);
+				world->set(cube, MeshRef {MESH_CUBE});
+				world->set(cube, Material{MATERIAL_VERTEX_COLOUR});
+				world->set(cube, spin);
+			}
+		}
+	}
+	world->flush();
+#if ANIMATE_ON_GPU
+	/*
+	 * From here on the GPU owns the spinning, only the time step being
+	 * uploaded per frame.
+	 */
+	spin::State* states = new spin::State[CUBE_COUNT];
+	unsigned count = world->each(ecs::mask<Transform, AngularVelocity>(), handOver, states);
+	animator->write(queue, states, 0, count);
+	delete[] states;
+#endif
+}
 
-	WGPURenderPassColorAttachment colorDesc = {};
-	colorDesc.view    = backBufView;
-	colorDesc.loadOp  = WGPULoadOp_Clear;
-	colorDesc.storeOp = WGPUStoreOp_Store;
-#ifdef __EMSCRIPTEN__
-	// Dawn has both clearValue/clearColor but only Color works; Emscripten only has Value
-	colorDesc.clearValue.r = 0.3f;
-	colorDesc.clearValue.g = 0.3f;
-	colorDesc.clearValue.b = 0.3f;
-	colorDesc.clearValue.a = 1.0f;
+#if !ANIMATE_ON_GPU
+/**
+ * Animation system: spins each entity about its axis.
+ */
+static void animate(const ecs::Chunk& chunk, void* user) {
+	const float delta = *static_cast<const float*>(user);
+	Transform* transform = chunk.get<Transform>();
+	const AngularVelocity* spin = chunk.get<AngularVelocity>();
+	for (unsigned n = 0; n < chunk.count; n++) {
+		transform[n].rotation = normalize(angleAxis(spin[n].speed * delta, spin[n].axis) * transform[n].rotation);
+	}
+}
+#endif
+
+/**
+ * \return the frustum planes of \a clip (the matrix from the entity transforms' space to clip space)
+ */
+static Frustum frustum(const mat4& clip) {
+	vec4 rows[4];
+	for (int r = 0; r < 4; r++) {
+		rows[r] = vec4(clip[0][r], clip[1][r], clip[2][r], clip[3][r]);
+	}
+	Frustum planes;
+	planes.planes[0] = rows[3] + rows[0];
+	planes.planes[1] = rows[3] - rows[0];
+	planes.planes[2] = rows[3] + rows[1];
+	planes.planes[3] = rows[3] - rows[1];
+	planes.planes[4] = rows[3] + rows[2];
+	planes.planes[5] = rows[3] - rows[2];
+	for (int p = 0; p < 6; p++) {
+		planes.planes[p] /= length(vec3(planes.planes[p]));
+	}
+	return planes;
+}
+
+/**
+ * Culling system: marks the entities whose bounding spheres are in view.
+ * Spun on the GPU the entities keep their first rotation, which is still
+ * exact for spheres centred on the cube.
+ */
+static void cull(const ecs::Chunk& chunk, void* user) {
+	const Frustum& view = *static_cast<const Frustum*>(user);
+	const Transform* transform = chunk.get<Transform>();
+	const Bounds* bounds = chunk.get<Bounds>();
+	Visible* visible = chunk.get<Visible>();
+	for (unsigned n = 0; n < chunk.count; n++) {
+		vec3 center  = transform[n].position + transform[n].rotation * (bounds[n].center * transform[n].scale);
+		float radius = bounds[n].radius * transform[n].scale;
+		uint32_t inside = 1;
+		for (int p = 0; p < 6; p++) {
+			if (dot(vec3(view.planes[p]), center) + view.planes[p].w < -radius) {
+				inside = 0;
+				break;
+			}
+		}
+		visible[n].visible = inside;
+	}
+}
+
+#if !ANIMATE_ON_GPU
+/**
+ * Draw building system: appends the transform of each visible entity using
+ * the batch's mesh and material (each chunk reserving its instances in one
+ * go, then packing each run of consecutive visible entities together).
+ */
+static void build(const ecs::Chunk& chunk, void* user) {
+	Batch* batch = static_cast<Batch*>(user);
+	const Transform* transform = chunk.get<Transform>();
+	const MeshRef* mesh = chunk.get<MeshRef>();
+	const Material* material = chunk.get<Material>();
+	const Visible* visible = chunk.get<Visible>();
+	unsigned drawn = 0;
+	for (unsigned n = 0; n < chunk.count; n++) {
+		if (visible[n].visible && mesh[n].mesh == batch->mesh && material[n].material == batch->material) {
+			drawn++;
+		}
+	}
+	if (drawn == 0) {
+		return;
+	}
+	instance::Instance* out = batch->instances + batch->count.fetch_add(drawn, std::memory_order_relaxed);
+	for (unsigned n = 0; n < chunk.count;) {
+		unsigned first = n;
+		while (n < chunk.count && visible[n].visible && mesh[n].mesh == batch->mesh && material[n].material == batch->material) {
+			n++;
+		}
+		if (n > first) {
+			instance::pack(transform + first, out, n - first);
+			out += n - first;
+		} else {
+			n++;
+		}
+	}
+}
 #else
-	colorDesc.clearColor.r = 0.3f;
-	colorDesc.clearColor.g = 0.3f;
-	colorDesc.clearColor.b = 0.3f;
-	colorDesc.clearColor.a = 1.0f;
+/**
+ * Range gathering system: appends each run of consecutive visible entities
+ * as a range of instances. Instances are in the order they were handed over
+ * (see \c #handOver()), which the entities' matching order still follows
+ * with every spinning entity being a cube.
+ */
+static void gather(const ecs::Chunk& chunk, void* user) {
+	Runs* runs = static_cast<Runs*>(user);
+	const Visible* visible = chunk.get<Visible>();
+	for (unsigned n = 0; n < chunk.count;) {
+		if (!visible[n].visible) {
+			n++;
+			continue;
+		}
+		unsigned first = n;
+		while (n < chunk.count && visible[n].visible) {
+			n++;
+		}
+		Range& range = runs->ranges[runs->count.fetch_add(1, std::memory_order_relaxed)];
+		range.first = chunk.first + first;
+		range.count = n - first;
+	}
+}
+
+/**
+ * Spin pass contents: advances the cubes on the GPU by the snapshot's step.
+ */
+static void spinCubes(WGPUCommandEncoder encoder, const graph::Graph& /*graph*/, void* user) {
+	animator->encode(queue, encoder, static_cast<const Snapshot*>(user)->delta);
+}
 #endif
 
-	WGPUTextureFormat format = {};
-	format = WGPUTextureFormat_Depth24Plus;
-	
-	WGPUExtent3D size = {};
-	size.width = 800;
-	size.height = 450;
-	size.depthOrArrayLayers = 1;
-
-	WGPUTextureDescriptor depth_texture_desc = {};
-	depth_texture_desc.usage = WGPUTextureUsage_RenderAttachment;
-	depth_texture_desc.format = format;
-	depth_texture_desc.dimension = WGPUTextureDimension_2D;
-	depth_texture_desc.mipLevelCount = 1;
-	depth_texture_desc.sampleCount = 1;
-	depth_texture_desc.size = size;
-
-	WGPUTexture depth_stencil_texture = wgpuDeviceCreateTexture(device, &depth_texture_desc);
-
-	WGPUTextureViewDescriptor depth_texture_view_dec = {};
-	depth_texture_view_dec.format = depth_texture_desc.format;
-	depth_texture_view_dec.dimension = WGPUTextureViewDimension_2D;
-	depth_texture_view_dec.baseMipLevel = 0;
-	depth_texture_view_dec.mipLevelCount = 1;
-	depth_texture_view_dec.baseArrayLayer = 0;
-	depth_texture_view_dec.arrayLayerCount = 1;
-	depth_texture_view_dec.aspect = WGPUTextureAspect_All;
-
-	WGPUTextureView depth_stencil_texture_view = wgpuTextureCreateView(depth_stencil_texture, &depth_texture_view_dec);
-
-	WGPURenderPassDepthStencilAttachment depthDesc = {};
-	depthDesc.view = depth_stencil_texture_view;
-	depthDesc.depthLoadOp = WGPULoadOp_Clear;
-	depthDesc.depthStoreOp = WGPUStoreOp_Store;
-	depthDesc.depthClearValue = 1.0f;
-	depthDesc.clearDepth = 1.0f;
-	depthDesc.clearStencil = 0;
-	//depthDesc.stencilLoadOp = WGPULoadOp_Clear;
-	//depthDesc.stencilStoreOp = WGPUStoreOp_Store;
+/**
+ * Hot reload handler for the fragment shader, rebuilding the pipeline in the
+ * background.
+ */
+static void reloadShader(const archive::Blob& blob, void* /*user*/) {
+	if (WGPUBindGroupLayout layout = createPipeline(static_cast<const char*>(blob.data), true)) {
+		binding::release(layout);
+	}
+}
 
-		
-	// set up render pass
-	WGPURenderPassDescriptor renderPass = {};
-	renderPass.colorAttachmentCount = 1;
-	renderPass.colorAttachments = &colorDesc;
-	renderPass.depthStencilAttachment = &depthDesc;
-	WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, nullptr);			// create encoder
-	WGPURenderPassEncoder pass = wgpuCommandEncoderBeginRenderPass(encoder, &renderPass);	// create pass
+
+/**
+ * Simulation stage: advances the rotation, runs the entity systems and fills
+ * in the frame's snapshot.
+ * Runs on the simulation thread so touches no WebGPU objects (see \c frame#Stages).
+ */
+static bool update(void* snapshot, double delta, void* /*user*/) {
+	profile::Zone zone("update");
+	arena::step();
+
+	timeStamp.deltaTime    = delta;
+	timeStamp.currentTime += delta;
 
 	// mvp update
 	setProjectionAndView();
@@ -421,35 +907,276 @@ static bool redraw() {
 	double now = clock()/1000.f;
 	const float sin_now = sin(now);
 	const float cos_now = cos(now);
-	view_mtr.model = rotate(view_mtr.model, 0.1f, vec3(sin_now, cos_now, 0.0f));
-	
-	// Rotate 2° 
-	rotDeg += 0.2f;
-	wgpuQueueWriteBuffer(queue, uRotBuf, 0, &rotDeg, sizeof(rotDeg));
-	wgpuQueueWriteBuffer(queue, uMVPBuf, 0, &view_mtr, sizeof(view_mtr));
-
-	// draw the triangle (comment these five lines to simply clear the screen)
-	wgpuRenderPassEncoderSetPipeline(pass, pipeline);
-	wgpuRenderPassEncoderSetBindGroup(pass, 0, bindGroup, 0, 0);
-	wgpuRenderPassEncoderSetVertexBuffer(pass, 0, vertBuf, 0, WGPU_WHOLE_SIZE);
-	wgpuRenderPassEncoderSetIndexBuffer(pass, indxBuf, WGPUIndexFormat_Uint16, 0, WGPU_WHOLE_SIZE);
-	wgpuRenderPassEncoderDrawIndexed(pass, cube.indexCount, cube.instanceCount, 0, 0, 0);
-
-	wgpuRenderPassEncoderEnd(pass);
-	wgpuRenderPassEncoderRelease(pass);														// release pass
-	WGPUCommandBuffer commands = wgpuCommandEncoderFinish(encoder, nullptr);				// create commands
-	wgpuCommandEncoderRelease(encoder);														// release encoder
+	sceneGraph->set(spinNode, rotate(sceneGraph->local(spinNode), 0.2f * static_cast<float>(delta), vec3(sin_now, cos_now, 0.0f)));
+	sceneGraph->update();
+	view_mtr.model = sceneGraph->world(cubeNode);
+
+	Snapshot* snap = static_cast<Snapshot*>(snapshot);
+	snap->mvp = view_mtr;
+
+	/*
+	 * Entities queued for creation or destruction last frame arrive here,
+	 * before any system runs. Each cube then spins at its own speed, and
+	 * those in view have their matrices written to the snapshot's arena
+	 * (or, on the GPU, just the step and the runs in view are passed on).
+	 */
+	world->flush();
+	float step = static_cast<float>(delta);
+#if ANIMATE_ON_GPU
+	snap->delta = step;
+	Frustum view = frustum(view_mtr.projection * view_mtr.view * view_mtr.model);
+	world->each(ecs::mask<Transform, Bounds, Visible>(), cull, &view);
+	Runs runs;
+	runs.ranges = arena::snapshot().alloc<Range>(CUBE_COUNT);
+	runs.count.store(0, std::memory_order_relaxed);
+	if (runs.ranges) {
+		world->each(ecs::mask<Transform, AngularVelocity, Visible>(), gather, &runs);
+	}
+	snap->ranges     = runs.ranges;
+	snap->rangeCount = runs.count.load(std::memory_order_relaxed);
+#else
+	world->each(ecs::mask<Transform, AngularVelocity>(), animate, &step);
+	Frustum view = frustum(view_mtr.projection * view_mtr.view * view_mtr.model);
+	world->each(ecs::mask<Transform, Bounds, Visible>(), cull, &view);
+	Batch cubes;
+	cubes.mesh      = MESH_CUBE;
+	cubes.material  = MATERIAL_VERTEX_COLOUR;
+	cubes.instances = arena::snapshot().alloc<instance::Instance>(CUBE_COUNT);
+	cubes.count.store(0, std::memory_order_relaxed);
+	if (cubes.instances) {
+		world->each(ecs::mask<Transform, MeshRef, Material, Visible>(), build, &cubes);
+	}
+	snap->instances     = cubes.instances;
+	snap->instanceCount = cubes.count.load(std::memory_order_relaxed);
+#endif
+	return true;
+}
+
+/**
+ * Scene pass contents: draws the cube using the above pipeline and buffers.
+ */
+static void drawScene(WGPURenderPassEncoder pass, const graph::Graph& /*graph*/, void* /*user*/) {
+	drawQueue->encode(pass, PASS_SCENE);
+}
+
+/**
+ * Recording stage: declares the frame's passes and records them.
+ */
+static void record(const void* snapshot, void* user) {
+	profile::Zone zone("record");
+	arena::begin();
 
-	wgpuQueueSubmit(queue, 1, &commands);
-	wgpuCommandBufferRelease(commands);														// release commands
-#ifndef __EMSCRIPTEN__
 	/*
-	 * TODO: wgpuSwapChainPresent is unsupported in Emscripten, so what do we do?
+	 * Resizes are applied here, between frames, before the back buffer is
+	 * taken. The size-dependent attachments follow on their own (the graph
+	 * pool reallocating for the new size).
 	 */
-	wgpuSwapChainPresent(swapchain);
+	unsigned newW, newH;
+	if (window::resized(static_cast<window::Handle>(user), newW, newH)) {
+		swapchain   = webgpu::resizeSwapChain(device, swapchain, newW, newH);
+		SWAP_WIDTH  = newW;
+		SWAP_HEIGHT = newH;
+	}
+	/*
+	 * Streamed levels finished since the last frame are uploaded before any
+	 * texture views are taken.
+	 */
+	stream::update();
+	/*
+	 * As are assets rebuilt since the last frame (and a pipeline rebuilt in
+	 * the background, once ready).
+	 */
+	reload::update();
+	if (rebuilt) {
+		wgpuRenderPipelineRelease(pipeline);
+		pipeline = rebuilt;
+		rebuilt  = nullptr;
+	}
+
+	const Snapshot* snap = static_cast<const Snapshot*>(snapshot);
+
+	{
+		profile::Zone wait("acquire", true);
+		backBufView = wgpuSwapChainGetCurrentTextureView(swapchain);					// create textureView
+	}
+
+	uniforms->write(uMVPSlot, snap->mvp);
+	uniforms->flush(queue);
+#if ANIMATE_ON_GPU
+	unsigned instanceCount = animator->size();
+#else
+	unsigned instanceCount = snap->instanceCount;
+	if (instanceCount) {
+		wgpuQueueWriteBuffer(queue, instBuf, 0, snap->instances, instanceCount * sizeof(instance::Instance));
+	}
 #endif
-	wgpuTextureViewRelease(backBufView);													// release textureView
 
+	// queue the draws (comment these lines to simply clear the screen)
+	drawQueue->clear();
+	draw::Packet cubeDraw = {};
+	cubeDraw.key = draw::key(PASS_SCENE, 0, 0, 0, 0.0f);
+	cubeDraw.pipeline  = pipeline;
+	cubeDraw.bindGroup = bindGroup;
+	cubeDraw.vertBuf   = vertBuf;
+	cubeDraw.indxBuf   = indxBuf;
+	cubeDraw.indxFmt   = WGPUIndexFormat_Uint16;
+	cubeDraw.indexCount    = cube.indexCount;
+	cubeDraw.instanceCount = instanceCount;
+#if ANIMATE_ON_GPU
+	/*
+	 * A draw per run of visible cubes (or all of them if the runs couldn't
+	 * be gathered).
+	 */
+	if (snap->ranges) {
+		for (uint32_t n = 0; n < snap->rangeCount; n++) {
+			cubeDraw.firstInstance = snap->ranges[n].first;
+			cubeDraw.instanceCount = snap->ranges[n].count;
+			drawQueue->push(cubeDraw);
+		}
+	} else {
+		drawQueue->push(cubeDraw);
+	}
+#else
+	drawQueue->push(cubeDraw);
+#endif
+	drawQueue->sort();
+
+	/*
+	 * The depth buffer is transient: the graph pools it (rather than creating
+	 * one per frame) and, with nothing reading it afterwards, discards it.
+	 * Below full resolution the scene also gets its own transient colour
+	 * target, upscaled into the back buffer (the pool only reallocating when
+	 * the scale steps).
+	 */
+	uint32_t sceneW, sceneH;
+	bool scaled = renderScale.size(SWAP_WIDTH, SWAP_HEIGHT, sceneW, sceneH);
+	frameGraph->reset();
+	graph::TextureDesc depthDesc = {};
+	depthDesc.format = WGPUTextureFormat_Depth24Plus;
+	depthDesc.width  = sceneW;
+	depthDesc.height = sceneH;
+	graph::Resource depth = frameGraph->create("depth", depthDesc);
+	graph::Resource color = frameGraph->import("backbuffer", backBufView);
+	graph::Resource target = color;
+	if (scaled) {
+		graph::TextureDesc targetDesc = {};
+		targetDesc.format = webgpu::getSwapChainFormat(device);
+		targetDesc.width  = sceneW;
+		targetDesc.height = sceneH;
+		target = frameGraph->create("scene", targetDesc);
+	}
+
+#if ANIMATE_ON_GPU
+	/*
+	 * The cube matrices are written before the scene reads them (the graph
+	 * knowing nothing of the buffer, so the pass is kept as a side effect).
+	 */
+	graph::PassDesc spinPass = {};
+	spinPass.name   = "spin";
+	spinPass.depth  = graph::NONE;
+	spinPass.writes = graph::NONE;
+	spinPass.sideEffects = true;
+	spinPass.encode = spinCubes;
+	spinPass.user   = const_cast<Snapshot*>(snap);
+	frameGraph->addPass(spinPass);
+#endif
+
+	graph::PassDesc scene = {};
+	scene.name = "scene";
+	scene.color[0]   = target;
+	scene.colorCount = 1;
+	scene.depth  = depth;
+	scene.writes = graph::NONE;
+	scene.clear  = true;
+	scene.clearColor.r = 0.3f;
+	scene.clearColor.g = 0.3f;
+	scene.clearColor.b = 0.3f;
+	scene.clearColor.a = 1.0f;
+	scene.clearDepth = 1.0f;
+	scene.execute = drawScene;
+	frameGraph->addPass(scene);
+	if (scaled) {
+		upscaler->addPass(*frameGraph, target, color);
+	}
+	frameGraph->compile();
+
+	WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, nullptr);			// create encoder
+	frameGraph->execute(encoder);
+	profile::resolve(encoder);
+	commands = wgpuCommandEncoderFinish(encoder, nullptr);							// create commands
+	wgpuCommandEncoderRelease(encoder);														// release encoder
+}
+
+/**
+ * \return CPU time of the busiest thread in the last frame (simulation or render), less the render thread's waits to acquire and present the back buffer (which block on the display, not the CPU)
+ */
+static double cpuTime() {
+	profile::Entry entries[PROFILE_MAX_ZONES * 2];
+	size_t count = profile::report(entries, PROFILE_MAX_ZONES * 2);
+	double sim = 0.0, render = 0.0;
+	for (size_t n = 0; n < count; n++) {
+		if (!entries[n].gpu) {
+			if (strcmp(entries[n].name, "update") == 0) {
+				sim += entries[n].ms;
+			} else if (strcmp(entries[n].name, "record") == 0 || strcmp(entries[n].name, "submit") == 0) {
+				render += entries[n].ms;
+			} else if (strcmp(entries[n].name, "acquire") == 0 || strcmp(entries[n].name, "present") == 0) {
+				render -= entries[n].ms;
+			}
+		}
+	}
+	if (render < 0.0) {
+		render = 0.0;
+	}
+	return (sim > render) ? sim : render;
+}
+
+/**
+ * Submission stage: submits the recorded commands and presents.
+ */
+static bool submit(void* /*user*/) {
+	{
+		profile::Zone zone("submit");
+		wgpuQueueSubmit(queue, 1, &commands);
+		profile::submitted(queue);
+		wgpuCommandBufferRelease(commands);													// release commands
+	#ifndef __EMSCRIPTEN__
+		/*
+		 * TODO: wgpuSwapChainPresent is unsupported in Emscripten, so what do we do?
+		 */
+		profile::begin("present", true);
+		wgpuSwapChainPresent(swapchain);
+		profile::end();
+	#endif
+		wgpuTextureViewRelease(backBufView);												// release textureView
+		capture::frame();
+	}
+	profile::frame();
+	/*
+	 * A scale change reallocates the scaled targets on the next compile, the
+	 * graph dropping the bind groups of the previous size's as it frees them.
+	 */
+	renderScale.update(cpuTime(), profile::gpuTime());
+	alloctrack::frame();
+	apistats::Stats stats = apistats::frame();
+#ifdef _DEBUG
+	static unsigned frames = 0;
+	if (++frames % PROFILE_PRINT_PERIOD == 0) {
+		profile::print();
+		if (apistats::installed()) {
+			apistats::print(stats);
+		}
+		binding::print();
+		arena::print();
+		stream::print();
+		printf("render scale %.3f (%u changes)\n", renderScale.factor(), renderScale.changes());
+		const draw::Stats& draws = drawQueue->stats();
+		printf("draws %u (pipelines %u, bind groups %u, state changes avoided %u)\n",
+			draws.draws, draws.pipelines, draws.bindGroups, draws.avoided);
+	}
+#else
+	(void) stats;
+#endif
 	return true;
 }
 
@@ -457,22 +1184,97 @@ extern "C" int __main__(int /*argc*/, char* /*argv*/[]) {
 	if (window::Handle wHnd = window::create(WINDOW_WIDTH, WINDOW_HEIGHT)) {
 		if ((device = webgpu::create(wHnd))) {
 			queue = wgpuDeviceGetQueue(device);
-
-			swapchain = webgpu::createSwapChain(device);
+			profile::init(device);
+			binding::init(device);
+			arena::init();
+			jobs::init();
+		#if TRANSCODE_CHECK
+			transcode::check();
+		#endif
+		#if MIPGEN_CHECK
+			mipgen::check(device, queue);
+		#endif
+			stream::init(device);
+		#if STREAM_CHECK
+			stream::check();
+		#endif
+			frameGraph = new graph::Graph(device);
+			drawQueue  = new draw::Queue();
+			shaders    = new shader::Library(device);
+			buildScene();
+			world      = new ecs::World(CUBE_COUNT);
+		#if ANIMATE_ON_GPU
+			animator   = new spin::Animator(device, CUBE_COUNT);
+		#endif
+			spawnCubes();
+
+			unsigned swapW, swapH;
+			window::size(wHnd, swapW, swapH);
+			if (swapW && swapH) {
+				SWAP_WIDTH  = swapW;
+				SWAP_HEIGHT = swapH;
+			}
+			swapchain = webgpu::createSwapChain(device, SWAP_WIDTH, SWAP_HEIGHT);
+			upscaler  = new dynres::Upscaler(device, webgpu::getSwapChainFormat(device));
+			assets    = archive::open(ASSETS_PATH);
 			createPipelineAndBuffers();
+			if (reload::init(ASSETS_SOURCE)) {
+				reload::watch("cube.obj", reloadMesh);
+				reload::watch("triangle_frag.wgsl", reloadShader);
+			}
 
 			window::show(wHnd);
-			window::loop(wHnd, redraw);
+			frame::Stages stages = {};
+			stages.update = update;
+			stages.record = record;
+			stages.submit = submit;
+			stages.size   = sizeof(Snapshot);
+			stages.user   = wHnd;
+			/*
+			 * The cube never stops spinning, so even in on-demand mode every
+			 * frame is drawn.
+			 */
+			window::animate(wHnd);
+			window::loop(wHnd, &stages);
 
 		#ifndef __EMSCRIPTEN__
-			wgpuBindGroupRelease(bindGroup);
-			wgpuBufferRelease(uRotBuf);
+			reload::destroy();
+			binding::release(bindGroup);
+			delete uniforms;
+			wgpuBufferRelease(instBuf);
 			wgpuBufferRelease(indxBuf);
 			wgpuBufferRelease(vertBuf);
 			wgpuRenderPipelineRelease(pipeline);
+			if (rebuilt) {
+				wgpuRenderPipelineRelease(rebuilt);
+			}
+			if (assets) {
+			#ifdef _DEBUG
+				archive::record(assets, ASSETS_ORDER);
+			#endif
+				archive::close(assets);
+			}
+			delete upscaler;
+			delete world;
+		#if ANIMATE_ON_GPU
+			delete animator;
+		#endif
+			delete sceneGraph;
+			delete shaders;
+			delete drawQueue;
+			delete frameGraph;
+			stream::destroy();
+			jobs::destroy();
+			arena::destroy();
+			binding::destroy();
+			profile::destroy();
 			wgpuSwapChainRelease(swapchain);
 			wgpuQueueRelease(queue);
 			wgpuDeviceRelease(device);
+			capture::end();
+			if (alloctrack::enabled()) {
+				alloctrack::flame();
+			}
 		#endif
 		}
 	#ifndef __EMSCRIPTEN__
@@ -0,0 +1,620 @@
+#include "mipgen.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "binding.h"
+#include "shader.h"
+
+//****************************************************************************/
+
+namespace impl {
+/**
+ * Levels written per dispatch.
+ */
+static const unsigned LEVELS = 4;
+
+/**
+ * Storage formats (the shader's source flags, in \c #mip_flags order after
+ * \c SRGB).
+ */
+static const WGPUTextureFormat FORMATS[] = {
+	WGPUTextureFormat_RGBA8Unorm,
+	WGPUTextureFormat_RGBA16Float,
+	WGPUTextureFormat_RGBA32Float,
+};
+
+static const unsigned FORMAT_COUNT = sizeof FORMATS / sizeof FORMATS[0];
+
+/**
+ * \return index into \c #FORMATS (or \c #FORMAT_COUNT if unsupported)
+ */
+static unsigned formatIndex(WGPUTextureFormat format) {
+	unsigned n = 0;
+	while (n < FORMAT_COUNT && FORMATS[n] != format) {
+		n++;
+	}
+	return n;
+}
+
+/**
+ * Each invocation filters a 2x2 quad of the source into the first level,
+ * then the workgroup's 8x8 results are halved in workgroup memory for the
+ * next three (the out of range levels of a short chain writing to 1x1
+ * placeholders).
+ */
+static char const mip_wgsl[] = R"(
+	@group(0) @binding(0) var src : texture_2d<f32>;
+//#if HALF
+	@group(0) @binding(1) var dst1 : texture_storage_2d<rgba16float, write>;
+	@group(0) @binding(2) var dst2 : texture_storage_2d<rgba16float, write>;
+	@group(0) @binding(3) var dst3 : texture_storage_2d<rgba16float, write>;
+	@group(0) @binding(4) var dst4 : texture_storage_2d<rgba16float, write>;
+//#else
+//#if FULL
+	@group(0) @binding(1) var dst1 : texture_storage_2d<rgba32float, write>;
+	@group(0) @binding(2) var dst2 : texture_storage_2d<rgba32float, write>;
+	@group(0) @binding(3) var dst3 : texture_storage_2d<rgba32float, write>;
+	@group(0) @binding(4) var dst4 : texture_storage_2d<rgba32float, write>;
+//#else
+	@group(0) @binding(1) var dst1 : texture_storage_2d<rgba8unorm, write>;
+	@group(0) @binding(2) var dst2 : texture_storage_2d<rgba8unorm, write>;
+	@group(0) @binding(3) var dst3 : texture_storage_2d<rgba8unorm, write>;
+	@group(0) @binding(4) var dst4 : texture_storage_2d<rgba8unorm, write>;
+//#endif
+//#endif
+	var<workgroup> tile : array<vec4<f32>, 64>;
+
+	fn texel(pos : vec2<i32>, size : vec2<i32>) -> vec4<f32> {
+		let c = textureLoad(src, clamp(pos, vec2<i32>(0, 0), size - vec2<i32>(1, 1)), 0);
+		if (SRGB) {
+			let lo = c.rgb / 12.92;
+			let hi = pow((c.rgb + vec3<f32>(0.055)) / 1.055, vec3<f32>(2.4));
+			return vec4<f32>(select(hi, lo, c.rgb <= vec3<f32>(0.04045)), c.a);
+		}
+		return c;
+	}
+	fn stored(c : vec4<f32>) -> vec4<f32> {
+		if (SRGB) {
+			let lo = c.rgb * 12.92;
+			let hi = pow(c.rgb, vec3<f32>(1.0 / 2.4)) * 1.055 - vec3<f32>(0.055);
+			return vec4<f32>(select(hi, lo, c.rgb <= vec3<f32>(0.0031308)), c.a);
+		}
+		return c;
+	}
+	fn average(i : u32) -> vec4<f32> {
+		return (tile[i] + tile[i + 1u] + tile[i + 8u] + tile[i + 9u]) * 0.25;
+	}
+	@stage(compute) @workgroup_size(8, 8)
+	fn main(@builtin(workgroup_id) group : vec3<u32>, @builtin(local_invocation_id) local : vec3<u32>, @builtin(local_invocation_index) index : u32) {
+		let size = vec2<i32>(textureDimensions(src, 0));
+		var pos = vec2<i32>(group.xy * 8u + local.xy);
+		let s = pos * 2;
+		var c = (texel(s, size) + texel(s + vec2<i32>(1, 0), size) + texel(s + vec2<i32>(0, 1), size) + texel(s + vec2<i32>(1, 1), size)) * 0.25;
+		if (all(pos < vec2<i32>(textureDimensions(dst1)))) {
+			textureStore(dst1, pos, stored(c));
+		}
+		tile[index] = c;
+		workgroupBarrier();
+		let inHalf = local.x < 4u && local.y < 4u;
+		if (inHalf) {
+			c = average(local.y * 16u + local.x * 2u);
+			pos = vec2<i32>(group.xy * 4u + local.xy);
+			if (all(pos < vec2<i32>(textureDimensions(dst2)))) {
+				textureStore(dst2, pos, stored(c));
+			}
+		}
+		workgroupBarrier();
+		if (inHalf) {
+			tile[local.y * 8u + local.x] = c;
+		}
+		workgroupBarrier();
+		let inQuarter = local.x < 2u && local.y < 2u;
+		if (inQuarter) {
+			c = average(local.y * 16u + local.x * 2u);
+			pos = vec2<i32>(group.xy * 2u + local.xy);
+			if (all(pos < vec2<i32>(textureDimensions(dst3)))) {
+				textureStore(dst3, pos, stored(c));
+			}
+		}
+		workgroupBarrier();
+		if (inQuarter) {
+			tile[local.y * 8u + local.x] = c;
+		}
+		workgroupBarrier();
+		if (index == 0u) {
+			pos = vec2<i32>(group.xy);
+			if (all(pos < vec2<i32>(textureDimensions(dst4)))) {
+				textureStore(dst4, pos, stored(average(0u)));
+			}
+		}
+	}
+)";
+
+static shader::Flag const mip_flags[] = {
+	{"SRGB", true},
+	{"HALF", false},
+	{"FULL", false},
+};
+
+static shader::Source const mip = {
+	mip_wgsl, mip_flags, 3, "mipgen"
+};
+
+/**
+ * Queued texture.
+ */
+struct Entry {
+	WGPUTexture texture;
+	mipgen::TextureDesc desc;
+};
+
+/**
+ * \return \a dim at \a level (never less than one)
+ */
+static uint32_t extent(uint32_t dim, unsigned level) {
+	dim >>= level;
+	return (dim) ? dim : 1;
+}
+
+/**
+ * \return view of a single level of \a texture
+ */
+static WGPUTextureView levelView(WGPUTexture texture, WGPUTextureFormat format, uint32_t level) {
+	WGPUTextureViewDescriptor desc = {};
+	desc.format = format;
+	desc.dimension = WGPUTextureViewDimension_2D;
+	desc.baseMipLevel    = level;
+	desc.mipLevelCount   = 1;
+	desc.baseArrayLayer  = 0;
+	desc.arrayLayerCount = 1;
+	desc.aspect = WGPUTextureAspect_All;
+	return wgpuTextureCreateView(texture, &desc);
+}
+#if MIPGEN_CHECK
+/**
+ * Size of the test textures (a power of two, so every level halves exactly).
+ */
+static const uint32_t CHECK_SIZE = 64;
+
+/**
+ * Row pitch of every level in the readback buffer (copies needing 256 byte
+ * aligned rows, which also fits the widest level).
+ */
+static const uint32_t CHECK_PITCH = 256;
+
+static_assert(CHECK_SIZE * 4 <= CHECK_PITCH, "Test texture rows don't fit the readback pitch");
+
+/**
+ * Test textures awaiting readback (the plain texture's levels followed by
+ * the sRGB texture's).
+ */
+struct Check {
+	FILE* out;
+	WGPUBuffer readback;
+	uint32_t levels;
+	uint64_t size;  ///< Bytes of readback per texture
+	uint8_t source[CHECK_SIZE * CHECK_SIZE * 4];
+};
+
+/**
+ * \return offset of \a level in one texture's readback
+ */
+static uint64_t checkOffset(uint32_t level) {
+	uint64_t offset = 0;
+	for (uint32_t n = 0; n < level; n++) {
+		offset += uint64_t(CHECK_PITCH) * extent(CHECK_SIZE, n);
+	}
+	return offset;
+}
+
+/**
+ * Matches the shader's \c texel().
+ */
+static float decoded(uint8_t v, bool srgb) {
+	float c = v / 255.0f;
+	if (srgb) {
+		return (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+	}
+	return c;
+}
+
+/**
+ * Matches the shader's \c stored() then quantises (as the unorm store does).
+ */
+static uint8_t encoded(float c, bool srgb) {
+	if (srgb) {
+		c = (c <= 0.0031308f) ? c * 12.92f : powf(c, 1.0f / 2.4f) * 1.055f - 0.055f;
+	}
+	c = c * 255.0f + 0.5f;
+	return static_cast<uint8_t>((c < 0.0f) ? 0.0f : ((c > 255.0f) ? 255.0f : c));
+}
+
+/**
+ * Compares one texture's readback with the CPU's chain, filtered as the
+ * shader does: each dispatch decodes one stored level then averages in
+ * float for the next four, storing (and so quantising) each.
+ *
+ * \return largest difference in any channel (or 256 if the CPU ran out of memory)
+ */
+static unsigned compare(const Check& check, const uint8_t* gpu, bool srgb, uint32_t& worst) {
+	float* work = static_cast<float*>(malloc(CHECK_SIZE * CHECK_SIZE * 4 * sizeof(float)));
+	uint8_t* level = static_cast<uint8_t*>(malloc(CHECK_SIZE * CHECK_SIZE * 4));
+	if (!work || !level) {
+		free(level);
+		free(work);
+		return 256;
+	}
+	unsigned error = 0;
+	worst = 0;
+	memcpy(level, check.source, sizeof check.source);
+	for (uint32_t n = 1; n < check.levels; n++) {
+		uint32_t size = extent(CHECK_SIZE, n);
+		if ((n - 1) % LEVELS == 0) {
+			for (uint32_t i = 0; i < size * size * 16; i++) {
+				work[i] = decoded(level[i], srgb && i % 4 < 3);
+			}
+		}
+		/*
+		 * Halved in place (each output texel only reading from at or after
+		 * its own position).
+		 */
+		for (uint32_t y = 0; y < size; y++) {
+			for (uint32_t x = 0; x < size; x++) {
+				const float* p = work + (y * 2 * size * 2 + x * 2) * 4;
+				for (unsigned c = 0; c < 4; c++) {
+					float v = (p[c] + p[4 + c] + p[size * 8 + c] + p[size * 8 + 4 + c]) * 0.25f;
+					work[(y * size + x) * 4 + c] = v;
+					level[(y * size + x) * 4 + c] = encoded(v, srgb && c < 3);
+				}
+			}
+		}
+		const uint8_t* row = gpu + checkOffset(n);
+		for (uint32_t y = 0; y < size; y++, row += CHECK_PITCH) {
+			for (uint32_t i = 0; i < size * 4; i++) {
+				int d = row[i] - level[y * size * 4 + i];
+				unsigned diff = static_cast<unsigned>((d < 0) ? -d : d);
+				if (diff > error) {
+					error = diff;
+					worst = n;
+				}
+			}
+		}
+	}
+	free(level);
+	free(work);
+	return error;
+}
+
+/**
+ * Readback complete callback (adheres to \c WGPUBufferMapCallback).
+ */
+static void onChecked(WGPUBufferMapAsyncStatus status, void* user) {
+	Check* check = static_cast<Check*>(user);
+	const uint8_t* data = nullptr;
+	if (status == WGPUBufferMapAsyncStatus_Success) {
+		data = static_cast<const uint8_t*>(wgpuBufferGetConstMappedRange(check->readback, 0, static_cast<size_t>(check->size * 2)));
+	}
+	if (data) {
+		for (unsigned s = 0; s < 2; s++) {
+			uint32_t worst;
+			unsigned error = compare(*check, data + check->size * s, s != 0, worst);
+			if (error <= 1) {
+				fprintf(check->out, "mipgen: %s ok (largest difference %u)\n", (s) ? "srgb" : "linear", error);
+			} else {
+				fprintf(check->out, "mipgen: %s FAILED (difference %u at level %u)\n", (s) ? "srgb" : "linear", error, worst);
+			}
+		}
+	} else {
+		fprintf(check->out, "mipgen: readback FAILED\n");
+	}
+	if (status == WGPUBufferMapAsyncStatus_Success) {
+		wgpuBufferUnmap(check->readback);
+	}
+	wgpuBufferRelease(check->readback);
+	delete check;
+}
+#endif
+}
+
+/**
+ * Pipelines (per format, with and without sRGB) plus the queue.
+ */
+struct mipgen::Generator::Impl {
+	Impl(WGPUDevice device)
+		: device (device)
+		, shaders(device)
+		, count  (0) {
+		for (unsigned f = 0; f < impl::FORMAT_COUNT; f++) {
+			layouts[f] = nullptr;
+			for (unsigned n = 0; n < impl::LEVELS - 1; n++) {
+				dummies[f][n] = nullptr;
+			}
+			pipelines[f][0] = nullptr;
+			pipelines[f][1] = nullptr;
+		}
+	}
+
+	~Impl() {
+		for (unsigned n = 0; n < count; n++) {
+			wgpuTextureRelease(queued[n].texture);
+		}
+		for (unsigned f = 0; f < impl::FORMAT_COUNT; f++) {
+			for (unsigned s = 0; s < 2; s++) {
+				if (pipelines[f][s]) {
+					wgpuComputePipelineRelease(pipelines[f][s]);
+				}
+			}
+			for (unsigned n = 0; n < impl::LEVELS - 1; n++) {
+				if (dummies[f][n]) {
+					wgpuTextureViewRelease(dummies[f][n]);
+				}
+			}
+			if (layouts[f]) {
+				binding::release(layouts[f]);
+			}
+		}
+	}
+
+	/**
+	 * Gets the pipeline for a format (creating it, its layout and the
+	 * placeholder levels on first use).
+	 */
+	WGPUComputePipeline pipeline(unsigned f, bool srgb) {
+		if (pipelines[f][srgb]) {
+			return pipelines[f][srgb];
+		}
+		if (!layouts[f]) {
+			WGPUBindGroupLayoutEntry entries[impl::LEVELS + 1] = {};
+			entries[0].binding    = 0;
+			entries[0].visibility = WGPUShaderStage_Compute;
+			entries[0].texture.sampleType    = WGPUTextureSampleType_UnfilterableFloat;
+			entries[0].texture.viewDimension = WGPUTextureViewDimension_2D;
+			for (unsigned n = 1; n <= impl::LEVELS; n++) {
+				entries[n].binding    = n;
+				entries[n].visibility = WGPUShaderStage_Compute;
+				entries[n].storageTexture.access        = WGPUStorageTextureAccess_WriteOnly;
+				entries[n].storageTexture.format        = impl::FORMATS[f];
+				entries[n].storageTexture.viewDimension = WGPUTextureViewDimension_2D;
+			}
+			WGPUBindGroupLayoutDescriptor layoutDesc = {};
+			layoutDesc.entryCount = impl::LEVELS + 1;
+			layoutDesc.entries    = entries;
+			layouts[f] = binding::layout(layoutDesc);
+			/*
+			 * A placeholder per slot (rather than one shared) since a
+			 * subresource can only be bound once as writable storage.
+			 */
+			for (unsigned n = 0; n < impl::LEVELS - 1; n++) {
+				WGPUTextureDescriptor desc = {};
+				desc.label = "mipgen placeholder";
+				desc.usage = WGPUTextureUsage_StorageBinding;
+				desc.dimension = WGPUTextureDimension_2D;
+				desc.size.width  = 1;
+				desc.size.height = 1;
+				desc.size.depthOrArrayLayers = 1;
+				desc.format = impl::FORMATS[f];
+				desc.mipLevelCount = 1;
+				desc.sampleCount   = 1;
+				WGPUTexture texture = wgpuDeviceCreateTexture(device, &desc);
+				dummies[f][n] = wgpuTextureCreateView(texture, nullptr);
+				wgpuTextureRelease(texture);
+			}
+		}
+		shader::Features features = (srgb) ? 1 : 0;
+		if (f > 0) {
+			features |= 1U << f; // HALF or FULL
+		}
+		shader::Variant variant = shaders.get(impl::mip, features);
+		WGPUPipelineLayoutDescriptor pipeLayoutDesc = {};
+		pipeLayoutDesc.bindGroupLayoutCount = 1;
+		pipeLayoutDesc.bindGroupLayouts = &layouts[f];
+		WGPUPipelineLayout pipeLayout = wgpuDeviceCreatePipelineLayout(device, &pipeLayoutDesc);
+		WGPUComputePipelineDescriptor desc = {};
+		desc.label  = "mipgen";
+		desc.layout = pipeLayout;
+		desc.compute.module        = variant.module;
+		desc.compute.entryPoint    = "main";
+		desc.compute.constantCount = variant.constantCount;
+		desc.compute.constants     = variant.constants;
+		pipelines[f][srgb] = wgpuDeviceCreateComputePipeline(device, &desc);
+		wgpuPipelineLayoutRelease(pipeLayout);
+		return pipelines[f][srgb];
+	}
+
+	/**
+	 * Records the dispatches for one texture.
+	 */
+	void generate(WGPUComputePassEncoder pass, const impl::Entry& entry) {
+		const TextureDesc& desc = entry.desc;
+		unsigned f = impl::formatIndex(desc.format);
+		wgpuComputePassEncoderSetPipeline(pass, pipeline(f, desc.srgb && f == 0));
+		for (uint32_t level = desc.base; level + 1 < desc.levels; level += impl::LEVELS) {
+			WGPUTextureView views[impl::LEVELS + 1] = {};
+			WGPUBindGroupEntry entries[impl::LEVELS + 1] = {};
+			for (unsigned n = 0; n <= impl::LEVELS; n++) {
+				if (level + n < desc.levels) {
+					views[n] = impl::levelView(entry.texture, desc.format, level + n);
+				}
+				entries[n].binding     = n;
+				entries[n].textureView = (views[n]) ? views[n] : dummies[f][n - 2];
+			}
+			/*
+			 * Groups are made directly rather than through the cache, the
+			 * views being new every time.
+			 */
+			WGPUBindGroupDescriptor groupDesc = {};
+			groupDesc.layout     = layouts[f];
+			groupDesc.entryCount = impl::LEVELS + 1;
+			groupDesc.entries    = entries;
+			WGPUBindGroup group = wgpuDeviceCreateBindGroup(device, &groupDesc);
+			wgpuComputePassEncoderSetBindGroup(pass, 0, group, 0, nullptr);
+			wgpuComputePassEncoderDispatch(pass,
+				(impl::extent(desc.width,  level + 1) + 7) / 8,
+				(impl::extent(desc.height, level + 1) + 7) / 8, 1);
+			wgpuBindGroupRelease(group);
+			for (unsigned n = 0; n <= impl::LEVELS; n++) {
+				if (views[n]) {
+					wgpuTextureViewRelease(views[n]);
+				}
+			}
+		}
+	}
+
+	WGPUDevice device;
+	shader::Library shaders;
+	WGPUBindGroupLayout layouts[impl::FORMAT_COUNT];
+	WGPUTextureView dummies[impl::FORMAT_COUNT][impl::LEVELS - 1]; ///< Placeholders for levels 2-4
+	WGPUComputePipeline pipelines[impl::FORMAT_COUNT][2];
+	impl::Entry queued[MIPGEN_MAX_TEXTURES];
+	unsigned count;
+};
+
+//******************************** Public API ********************************/
+
+uint32_t mipgen::levels(uint32_t width, uint32_t height) {
+	uint32_t longest = (width > height) ? width : height;
+	uint32_t levels  = 1;
+	while (longest >>= 1) {
+		levels++;
+	}
+	return levels;
+}
+
+bool mipgen::supported(WGPUTextureFormat format) {
+	return impl::formatIndex(format) < impl::FORMAT_COUNT;
+}
+
+mipgen::Generator::Generator(WGPUDevice device)
+	: impl(new Impl(device)) {}
+
+mipgen::Generator::~Generator() {
+	delete impl;
+}
+
+bool mipgen::Generator::add(WGPUTexture texture, const TextureDesc& desc) {
+	if (!supported(desc.format) || impl->count == MIPGEN_MAX_TEXTURES) {
+		return false;
+	}
+	if (desc.base + 1 < desc.levels) {
+		wgpuTextureReference(texture);
+		impl->queued[impl->count].texture = texture;
+		impl->queued[impl->count].desc    = desc;
+		impl->count++;
+	}
+	return true;
+}
+
+void mipgen::Generator::encode(WGPUCommandEncoder encoder) {
+	if (impl->count == 0) {
+		return;
+	}
+	WGPUComputePassDescriptor desc = {};
+	desc.label = "mipgen";
+	WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass(encoder, &desc);
+	for (unsigned n = 0; n < impl->count; n++) {
+		impl->generate(pass, impl->queued[n]);
+	}
+	wgpuComputePassEncoderEnd(pass);
+	wgpuComputePassEncoderRelease(pass);
+	for (unsigned n = 0; n < impl->count; n++) {
+		wgpuTextureRelease(impl->queued[n].texture);
+	}
+	impl->count = 0;
+}
+
+void mipgen::Generator::submit(WGPUQueue queue) {
+	if (impl->count == 0) {
+		return;
+	}
+	WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(impl->device, nullptr);
+	encode(encoder);
+	WGPUCommandBuffer commands = wgpuCommandEncoderFinish(encoder, nullptr);
+	wgpuCommandEncoderRelease(encoder);
+	wgpuQueueSubmit(queue, 1, &commands);
+	wgpuCommandBufferRelease(commands);
+}
+
+unsigned mipgen::Generator::pending() const {
+	return impl->count;
+}
+
+#if MIPGEN_CHECK
+void mipgen::check(WGPUDevice device, WGPUQueue queue, FILE* out) {
+	impl::Check* check = new impl::Check();
+	check->out    = out;
+	check->levels = levels(impl::CHECK_SIZE, impl::CHECK_SIZE);
+	check->size   = impl::checkOffset(check->levels);
+	for (uint32_t y = 0; y < impl::CHECK_SIZE; y++) {
+		for (uint32_t x = 0; x < impl::CHECK_SIZE; x++) {
+			uint8_t* p = check->source + (y * impl::CHECK_SIZE + x) * 4;
+			p[0] = static_cast<uint8_t>(x * 4);
+			p[1] = static_cast<uint8_t>(y * 4);
+			p[2] = static_cast<uint8_t>(((x ^ y) & 1) ? 255 : 0);
+			p[3] = static_cast<uint8_t>(255 - (x + y));
+		}
+	}
+	WGPUBufferDescriptor bufferDesc = {};
+	bufferDesc.label = "mipgen check";
+	bufferDesc.usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
+	bufferDesc.size  = check->size * 2;
+	check->readback  = wgpuDeviceCreateBuffer(device, &bufferDesc);
+
+	Generator generator(device);
+	WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, nullptr);
+	WGPUTexture textures[2];
+	for (unsigned s = 0; s < 2; s++) {
+		WGPUTextureDescriptor texDesc = {};
+		texDesc.label = "mipgen check";
+		texDesc.usage = USAGE | WGPUTextureUsage_CopyDst | WGPUTextureUsage_CopySrc;
+		texDesc.dimension = WGPUTextureDimension_2D;
+		texDesc.size.width  = impl::CHECK_SIZE;
+		texDesc.size.height = impl::CHECK_SIZE;
+		texDesc.size.depthOrArrayLayers = 1;
+		texDesc.format = WGPUTextureFormat_RGBA8Unorm;
+		texDesc.mipLevelCount = check->levels;
+		texDesc.sampleCount   = 1;
+		textures[s] = wgpuDeviceCreateTexture(device, &texDesc);
+
+		WGPUImageCopyTexture dst = {};
+		dst.texture = textures[s];
+		dst.aspect  = WGPUTextureAspect_All;
+		WGPUTextureDataLayout layout = {};
+		layout.bytesPerRow  = impl::CHECK_SIZE * 4;
+		layout.rowsPerImage = impl::CHECK_SIZE;
+		WGPUExtent3D size = {impl::CHECK_SIZE, impl::CHECK_SIZE, 1};
+		wgpuQueueWriteTexture(queue, &dst, check->source, sizeof check->source, &layout, &size);
+
+		TextureDesc desc = {};
+		desc.width  = impl::CHECK_SIZE;
+		desc.height = impl::CHECK_SIZE;
+		desc.levels = check->levels;
+		desc.format = WGPUTextureFormat_RGBA8Unorm;
+		desc.srgb   = s != 0;
+		generator.add(textures[s], desc);
+	}
+	generator.encode(encoder);
+	for (unsigned s = 0; s < 2; s++) {
+		for (uint32_t n = 1; n < check->levels; n++) {
+			WGPUImageCopyTexture src = {};
+			src.texture  = textures[s];
+			src.mipLevel = n;
+			src.aspect   = WGPUTextureAspect_All;
+			WGPUImageCopyBuffer dst = {};
+			dst.buffer = check->readback;
+			dst.layout.offset       = check->size * s + impl::checkOffset(n);
+			dst.layout.bytesPerRow  = impl::CHECK_PITCH;
+			dst.layout.rowsPerImage = impl::extent(impl::CHECK_SIZE, n);
+			WGPUExtent3D size = {impl::extent(impl::CHECK_SIZE, n), impl::extent(impl::CHECK_SIZE, n), 1};
+			wgpuCommandEncoderCopyTextureToBuffer(encoder, &src, &dst, &size);
+		}
+		wgpuTextureRelease(textures[s]);
+	}
+	WGPUCommandBuffer commands = wgpuCommandEncoderFinish(encoder, nullptr);
+	wgpuCommandEncoderRelease(encoder);
+	wgpuQueueSubmit(queue, 1, &commands);
+	wgpuCommandBufferRelease(commands);
+	wgpuBufferMapAsync(check->readback, WGPUMapMode_Read, 0, static_cast<size_t>(check->size * 2), impl::onChecked, check);
+}
+#endif
@@ -0,0 +1,353 @@
+#include "profile.h"
+
+#include <atomic>
+#include <chrono>
+
+/**
+ * \def PROFILE_MAX_DEPTH
+ * Maximum nesting of CPU zones per thread (deeper zones are ignored).
+ */
+#ifndef PROFILE_MAX_DEPTH
+#define PROFILE_MAX_DEPTH 16
+#endif
+
+//****************************************************************************/
+
+namespace impl {
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * Name used for the whole submission when timing with the CPU fallback.
+ */
+static const char* const FALLBACK_NAME = "(submit to done)";
+
+/**
+ * Timings for a single named zone or pass.
+ */
+struct Slot {
+	std::atomic<const char*> name; ///< Zone name (\c null if the slot is free)
+	std::atomic<unsigned long long> nanos; ///< CPU time accumulated this frame
+	std::atomic<unsigned> count;           ///< CPU calls accumulated this frame
+	double ms;      ///< Last complete frame's time (render thread only)
+	unsigned calls; ///< Last complete frame's calls (render thread only)
+};
+
+/**
+ * Open-addressed tables of all CPU zones and GPU passes. Entries are only
+ * ever added, so any thread can find or claim a slot without locking.
+ */
+static Slot cpuSlots[PROFILE_MAX_ZONES];
+static Slot gpuSlots[PROFILE_MAX_ZONES];
+
+/**
+ * Per-thread stack of open CPU zones.
+ */
+struct Open {
+	Slot* slot;
+	Clock::time_point start;
+	bool wait; ///< Blocks on the display (see \c #waited)
+};
+static thread_local Open stack[PROFILE_MAX_DEPTH];
+static thread_local unsigned depth = 0;
+
+/**
+ * Finds (or claims) the slot for \a name.
+ *
+ * \return the slot (or \c null if the table is full)
+ */
+static Slot* find(const char* name, bool gpu) {
+	Slot* table = (gpu) ? gpuSlots : cpuSlots;
+	size_t hash = reinterpret_cast<size_t>(name) >> 3;
+	for (unsigned n = 0; n < PROFILE_MAX_ZONES; n++) {
+		Slot& slot = table[(hash + n) % PROFILE_MAX_ZONES];
+		const char* have = nullptr;
+		if (slot.name.compare_exchange_strong(have, name, std::memory_order_acq_rel) || have == name) {
+			return &slot;
+		}
+	}
+	return nullptr;
+}
+
+/**
+ * One frame's worth of GPU timings, from recording until read back.
+ */
+struct Readback {
+	WGPUQuerySet queries;  ///< Begin/end timestamp pairs (one per pass)
+	WGPUBuffer   resolved; ///< Destination of the query resolve
+	WGPUBuffer   mapped;   ///< Mappable copy of \c #resolved
+	Slot* passes[PROFILE_MAX_PASSES]; ///< Timed passes, in recorded order
+	unsigned count;        ///< Number of \c #passes (and timestamp pairs)
+	bool pending;          ///< Set from submit until the results arrive
+	Clock::time_point submitted; ///< When submitted (for the CPU fallback)
+	unsigned long long waitedAt; ///< \c #waited when submitted (for the CPU fallback)
+};
+
+static WGPUDevice device = nullptr;
+static bool timestamps = false;
+static Readback ring[PROFILE_READBACK_RING];
+static unsigned current = 0;
+static bool passOpen = false;
+static Clock::time_point lastFrame;
+static double frameMs = 0.0;
+/**
+ * Nanoseconds spent in display wait zones (for the CPU fallback to take off
+ * the time from submit to the work done callback).
+ */
+static std::atomic<unsigned long long> waited(0);
+
+/**
+ * Clears the times of every pass before a readback fills them (so passes
+ * recorded more than once per frame sum correctly, and passes no longer run,
+ * culled by the graph for example, drop out instead of keeping their last
+ * time).
+ */
+static void clearPasses() {
+	for (unsigned n = 0; n < PROFILE_MAX_ZONES; n++) {
+		gpuSlots[n].ms    = 0.0;
+		gpuSlots[n].calls = 0;
+	}
+}
+
+/**
+ * Readback complete callback (adheres to \c WGPUBufferMapCallback).
+ */
+static void onMapped(WGPUBufferMapAsyncStatus status, void* user) {
+	Readback& r = *static_cast<Readback*>(user);
+	if (status == WGPUBufferMapAsyncStatus_Success) {
+		const uint64_t* ticks = static_cast<const uint64_t*>(
+			wgpuBufferGetConstMappedRange(r.mapped, 0, r.count * 2 * sizeof(uint64_t)));
+		if (ticks) {
+			clearPasses();
+			for (unsigned n = 0; n < r.count; n++) {
+				/*
+				 * Dawn reports timestamps in nanoseconds. Some drivers reset
+				 * the counter (or run it backwards) across power states, so
+				 * bogus pairs are zeroed rather than reported as huge.
+				 */
+				uint64_t beg = ticks[n * 2 + 0];
+				uint64_t end = ticks[n * 2 + 1];
+				r.passes[n]->ms   += (end > beg) ? (end - beg) / 1000000.0 : 0.0;
+				r.passes[n]->calls++;
+			}
+		}
+		wgpuBufferUnmap(r.mapped);
+	}
+	r.count   = 0;
+	r.pending = false;
+}
+
+/**
+ * Queue work done callback for the CPU fallback (adheres to \c WGPUQueueWorkDoneCallback).
+ */
+static void onDone(WGPUQueueWorkDoneStatus status, void* user) {
+	Readback& r = *static_cast<Readback*>(user);
+	if (status == WGPUQueueWorkDoneStatus_Success) {
+		if (Slot* slot = find(FALLBACK_NAME, true)) {
+			/*
+			 * Stamped when the device is ticked, which is after presenting
+			 * (and possibly acquiring the next back buffer), so the time
+			 * blocked on the display since submitting is taken off.
+			 */
+			double ms = std::chrono::duration<double, std::milli>(Clock::now() - r.submitted).count()
+				- (waited.load(std::memory_order_relaxed) - r.waitedAt) / 1000000.0;
+			slot->ms    = (ms > 0.0) ? ms : 0.0;
+			slot->calls = r.count;
+		}
+	}
+	r.count   = 0;
+	r.pending = false;
+}
+}
+
+//******************************** Public API ********************************/
+
+void profile::begin(const char* name, bool wait) {
+	if (impl::depth < PROFILE_MAX_DEPTH) {
+		impl::Open& open = impl::stack[impl::depth];
+		open.slot  = impl::find(name, false);
+		open.start = impl::Clock::now();
+		open.wait  = wait;
+	}
+	impl::depth++;
+}
+
+void profile::end() {
+	if (impl::depth > 0) {
+		impl::depth--;
+		if (impl::depth < PROFILE_MAX_DEPTH) {
+			impl::Open& open = impl::stack[impl::depth];
+			unsigned long long nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				impl::Clock::now() - open.start).count();
+			if (open.slot) {
+				open.slot->nanos.fetch_add(nanos, std::memory_order_relaxed);
+				open.slot->count.fetch_add(1, std::memory_order_relaxed);
+			}
+			if (open.wait) {
+				impl::waited.fetch_add(nanos, std::memory_order_relaxed);
+			}
+		}
+	}
+}
+
+size_t profile::zones(const char** names, size_t max) {
+	size_t count = (impl::depth < PROFILE_MAX_DEPTH) ? impl::depth : PROFILE_MAX_DEPTH;
+	if (count > max) {
+		count = max;
+	}
+	for (size_t n = 0; n < count; n++) {
+		impl::Slot* slot = impl::stack[n].slot;
+		names[n] = (slot) ? slot->name.load(std::memory_order_relaxed) : nullptr;
+	}
+	return count;
+}
+
+void profile::init(WGPUDevice device) {
+	impl::device     = device;
+	impl::timestamps = wgpuDeviceHasFeature(device, WGPUFeatureName_TimestampQuery);
+	impl::lastFrame  = impl::Clock::now();
+	if (impl::timestamps) {
+		size_t size = PROFILE_MAX_PASSES * 2 * sizeof(uint64_t);
+		for (unsigned n = 0; n < PROFILE_READBACK_RING; n++) {
+			WGPUQuerySetDescriptor queryDesc = {};
+			queryDesc.type  = WGPUQueryType_Timestamp;
+			queryDesc.count = PROFILE_MAX_PASSES * 2;
+			impl::ring[n].queries = wgpuDeviceCreateQuerySet(device, &queryDesc);
+
+			WGPUBufferDescriptor bufDesc = {};
+			bufDesc.usage = WGPUBufferUsage_QueryResolve | WGPUBufferUsage_CopySrc;
+			bufDesc.size  = size;
+			impl::ring[n].resolved = wgpuDeviceCreateBuffer(device, &bufDesc);
+			bufDesc.usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
+			impl::ring[n].mapped = wgpuDeviceCreateBuffer(device, &bufDesc);
+		}
+	}
+}
+
+void profile::destroy() {
+	for (unsigned n = 0; n < PROFILE_READBACK_RING; n++) {
+		impl::Readback& r = impl::ring[n];
+		if (r.queries) {
+			wgpuQuerySetRelease(r.queries);
+			wgpuBufferRelease(r.resolved);
+			wgpuBufferRelease(r.mapped);
+		}
+		r = impl::Readback();
+	}
+	impl::device = nullptr;
+}
+
+bool profile::hasTimestamps() {
+	return impl::timestamps;
+}
+
+void profile::beginPass(WGPUCommandEncoder encoder, const char* name) {
+	impl::Readback& r = impl::ring[impl::current];
+	if (impl::device && !r.pending && r.count < PROFILE_MAX_PASSES) {
+		if ((r.passes[r.count] = impl::find(name, true))) {
+			if (impl::timestamps) {
+				wgpuCommandEncoderWriteTimestamp(encoder, r.queries, r.count * 2 + 0);
+			}
+			impl::passOpen = true;
+		}
+	}
+}
+
+void profile::endPass(WGPUCommandEncoder encoder) {
+	if (impl::passOpen) {
+		impl::Readback& r = impl::ring[impl::current];
+		if (impl::timestamps) {
+			wgpuCommandEncoderWriteTimestamp(encoder, r.queries, r.count * 2 + 1);
+		}
+		r.count++;
+		impl::passOpen = false;
+	}
+}
+
+void profile::resolve(WGPUCommandEncoder encoder) {
+	impl::Readback& r = impl::ring[impl::current];
+	if (impl::timestamps && !r.pending && r.count > 0) {
+		wgpuCommandEncoderResolveQuerySet(encoder, r.queries, 0, r.count * 2, r.resolved, 0);
+		wgpuCommandEncoderCopyBufferToBuffer(encoder, r.resolved, 0, r.mapped, 0, r.count * 2 * sizeof(uint64_t));
+	}
+}
+
+void profile::submitted(WGPUQueue queue) {
+	impl::Readback& r = impl::ring[impl::current];
+	if (r.pending || r.count == 0) {
+		return;
+	}
+	r.pending = true;
+	if (impl::timestamps) {
+		wgpuBufferMapAsync(r.mapped, WGPUMapMode_Read, 0, r.count * 2 * sizeof(uint64_t), impl::onMapped, &r);
+	} else {
+		r.submitted = impl::Clock::now();
+		r.waitedAt  = impl::waited.load(std::memory_order_relaxed);
+		wgpuQueueOnSubmittedWorkDone(queue, 0, impl::onDone, &r);
+	}
+	impl::current = (impl::current + 1) % PROFILE_READBACK_RING;
+}
+
+void profile::frame() {
+#ifndef __EMSCRIPTEN__
+	/*
+	 * Dawn only fires the map/work done callbacks when ticked (the browser
+	 * does this for us).
+	 */
+	if (impl::device) {
+		wgpuDeviceTick(impl::device);
+	}
+#endif
+	for (unsigned n = 0; n < PROFILE_MAX_ZONES; n++) {
+		impl::Slot& slot = impl::cpuSlots[n];
+		if (slot.name.load(std::memory_order_acquire)) {
+			slot.ms    = slot.nanos.exchange(0, std::memory_order_relaxed) / 1000000.0;
+			slot.calls = slot.count.exchange(0, std::memory_order_relaxed);
+		}
+	}
+	impl::Clock::time_point now = impl::Clock::now();
+	impl::frameMs   = std::chrono::duration<double, std::milli>(now - impl::lastFrame).count();
+	impl::lastFrame = now;
+}
+
+size_t profile::report(Entry* entries, size_t max) {
+	size_t used = 0;
+	for (unsigned n = 0; n < PROFILE_MAX_ZONES * 2 && used < max; n++) {
+		bool gpu = n >= PROFILE_MAX_ZONES;
+		impl::Slot& slot = (gpu) ? impl::gpuSlots[n - PROFILE_MAX_ZONES] : impl::cpuSlots[n];
+		if (const char* name = slot.name.load(std::memory_order_acquire)) {
+			entries[used].name  = name;
+			entries[used].gpu   = gpu;
+			entries[used].calls = slot.calls;
+			entries[used].ms    = slot.ms;
+			used++;
+		}
+	}
+	return used;
+}
+
+double profile::frameTime() {
+	return impl::frameMs;
+}
+
+double profile::gpuTime() {
+	double ms = 0.0;
+	for (unsigned n = 0; n < PROFILE_MAX_ZONES; n++) {
+		impl::Slot& slot = impl::gpuSlots[n];
+		if (slot.name.load(std::memory_order_acquire)) {
+			ms += slot.ms;
+		}
+	}
+	return ms;
+}
+
+void profile::print(FILE* out) {
+	Entry entries[PROFILE_MAX_ZONES * 2];
+	size_t count = report(entries, PROFILE_MAX_ZONES * 2);
+	fprintf(out, "%-24s %-4s %6s %9s\n", "zone", "side", "calls", "ms");
+	for (size_t n = 0; n < count; n++) {
+		fprintf(out, "%-24s %-4s %6u %9.3f\n", entries[n].name,
+			(entries[n].gpu) ? "gpu" : "cpu", entries[n].calls, entries[n].ms);
+	}
+	fprintf(out, "frame %.3fms (gpu %.3fms, %s)\n", frameTime(), gpuTime(),
+		(hasTimestamps()) ? "timestamps" : "submit to done");
+}
@@ -0,0 +1,856 @@
+#include "reflect.h"
+
+#include <string.h>
+
+#include "binding.h"
+
+/**
+ * \def REFLECT_MAX_STRUCTS
+ * Maximum number of structs per shader (further structs have an unknown size).
+ */
+#ifndef REFLECT_MAX_STRUCTS
+#define REFLECT_MAX_STRUCTS 32
+#endif
+
+/**
+ * \def REFLECT_MAX_MEMBERS
+ * Maximum number of struct members per shader (in total).
+ */
+#ifndef REFLECT_MAX_MEMBERS
+#define REFLECT_MAX_MEMBERS 256
+#endif
+
+/**
+ * \def REFLECT_MAX_NAME
+ * Longest identifier or type (including template arguments) kept.
+ */
+#ifndef REFLECT_MAX_NAME
+#define REFLECT_MAX_NAME 48
+#endif
+
+//****************************************************************************/
+
+namespace impl {
+/**
+ * Source token (pointing into the source, with a zero length at the end).
+ */
+struct Token {
+	const char* str;
+	size_t len;
+	bool is(const char* text) const {
+		return strlen(text) == len && strncmp(str, text, len) == 0;
+	}
+	bool starts(const char* text) const {
+		size_t n = strlen(text);
+		return n <= len && strncmp(str, text, n) == 0;
+	}
+	bool ident() const {
+		return len > 0 && (*str == '_' || (*str >= 'A' && *str <= 'Z') || (*str >= 'a' && *str <= 'z'));
+	}
+	/**
+	 * \return the token as an unsigned number (or \c -1 if it isn't one)
+	 */
+	int number() const {
+		int value = 0;
+		size_t n = 0;
+		for (; n < len && str[n] >= '0' && str[n] <= '9'; n++) {
+			value = value * 10 + (str[n] - '0');
+		}
+		return (n > 0) ? value : -1;
+	}
+};
+
+/**
+ * Splits WGSL into tokens, skipping whitespace and comments.
+ */
+class Lexer {
+public:
+	Lexer(const char* code)
+		: pos(code) {
+		advance();
+	}
+	/**
+	 * \return the current token
+	 */
+	const Token& peek() const {
+		return tok;
+	}
+	/**
+	 * \return the current token, moving to the next
+	 */
+	Token take() {
+		Token prev = tok;
+		advance();
+		return prev;
+	}
+	/**
+	 * Takes the current token if it matches \a text.
+	 */
+	bool accept(const char* text) {
+		if (tok.is(text)) {
+			advance();
+			return true;
+		}
+		return false;
+	}
+	/**
+	 * Skips tokens up to and including the next \a end not nested in brackets.
+	 */
+	void skip(char end) {
+		int depth = 0;
+		while (tok.len) {
+			char c = *tok.str;
+			advance();
+			if (c == '(' || c == '[' || c == '{') {
+				depth++;
+			} else if (c == ')' || c == ']' || c == '}') {
+				depth--;
+			}
+			if (c == end && depth <= 0) {
+				break;
+			}
+		}
+	}
+	bool done() const {
+		return tok.len == 0;
+	}
+private:
+	void advance() {
+		while (*pos) {
+			if (*pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == '\n') {
+				pos++;
+			} else if (pos[0] == '/' && pos[1] == '/') {
+				while (*pos && *pos != '\n') {
+					pos++;
+				}
+			} else if (pos[0] == '/' && pos[1] == '*') {
+				pos += 2;
+				while (*pos && !(pos[0] == '*' && pos[1] == '/')) {
+					pos++;
+				}
+				if (*pos) {
+					pos += 2;
+				}
+			} else {
+				break;
+			}
+		}
+		tok.str = pos;
+		if (*pos == '_' || (*pos >= 'A' && *pos <= 'Z') || (*pos >= 'a' && *pos <= 'z') || (*pos >= '0' && *pos <= '9')) {
+			while (*pos == '_' || *pos == '.' || (*pos >= 'A' && *pos <= 'Z') || (*pos >= 'a' && *pos <= 'z') || (*pos >= '0' && *pos <= '9')) {
+				pos++;
+			}
+		} else if (*pos) {
+			pos++;
+		}
+		tok.len = pos - tok.str;
+	}
+	const char* pos;
+	Token tok;
+};
+
+/**
+ * Attributes preceding a declaration (\c -1 if not given).
+ */
+struct Attributes {
+	int group;
+	int binding;
+	int location;
+	int size;
+	int align;
+	bool builtin;
+	WGPUShaderStageFlags stage;
+	void reset() {
+		group    = -1;
+		binding  = -1;
+		location = -1;
+		size     = -1;
+		align    = -1;
+		builtin  = false;
+		stage    = WGPUShaderStage_None;
+	}
+};
+
+/**
+ * Parsed type, with its host-shareable size and alignment (\c 0 size if not
+ * known, or not host-shareable).
+ */
+struct Type {
+	char name[REFLECT_MAX_NAME]; ///< Full type, e.g. \c vec3<f32>
+	uint32_t size;
+	uint32_t align;
+	bool is(const char* text) const {
+		return strcmp(name, text) == 0;
+	}
+	bool starts(const char* text) const {
+		return strncmp(name, text, strlen(text)) == 0;
+	}
+};
+
+struct Member {
+	Type type;
+	int location;
+};
+
+struct Struct {
+	char name[REFLECT_MAX_NAME];
+	unsigned first; ///< Index of the first member
+	unsigned count;
+	uint32_t size;
+	uint32_t align;
+};
+
+static uint32_t roundUp(uint32_t value, uint32_t align) {
+	return (value + align - 1) / align * align;
+}
+
+/**
+ * Copies a token as a terminated string (truncating).
+ */
+static void copy(char (&dst)[REFLECT_MAX_NAME], const Token& tok) {
+	size_t len = (tok.len < REFLECT_MAX_NAME - 1) ? tok.len : REFLECT_MAX_NAME - 1;
+	memcpy(dst, tok.str, len);
+	dst[len] = '\0';
+}
+
+/**
+ * \return vector component count from a type name following \a prefix (\c 0 if none)
+ */
+static unsigned components(const char* name, const char* prefix) {
+	size_t len = strlen(prefix);
+	if (strncmp(name, prefix, len) == 0 && name[len] >= '2' && name[len] <= '4') {
+		return name[len] - '0';
+	}
+	return 0;
+}
+
+/**
+ * \return vertex format for a vertex input type (or \c Undefined)
+ */
+static WGPUVertexFormat vertexFormat(const Type& type, uint32_t& size) {
+	static const WGPUVertexFormat f32[] = {WGPUVertexFormat_Float32, WGPUVertexFormat_Float32x2, WGPUVertexFormat_Float32x3, WGPUVertexFormat_Float32x4};
+	static const WGPUVertexFormat i32[] = {WGPUVertexFormat_Sint32,  WGPUVertexFormat_Sint32x2,  WGPUVertexFormat_Sint32x3,  WGPUVertexFormat_Sint32x4};
+	static const WGPUVertexFormat u32[] = {WGPUVertexFormat_Uint32,  WGPUVertexFormat_Uint32x2,  WGPUVertexFormat_Uint32x3,  WGPUVertexFormat_Uint32x4};
+	unsigned count = 1;
+	const char* scalar = type.name;
+	if (unsigned n = components(type.name, "vec")) {
+		count  = n;
+		scalar = type.name + 4;
+		if (*scalar++ != '<') {
+			return WGPUVertexFormat_Undefined;
+		}
+	}
+	size = 4 * count;
+	if (strncmp(scalar, "f32", 3) == 0) {
+		return f32[count - 1];
+	}
+	if (strncmp(scalar, "i32", 3) == 0) {
+		return i32[count - 1];
+	}
+	if (strncmp(scalar, "u32", 3) == 0) {
+		return u32[count - 1];
+	}
+	return WGPUVertexFormat_Undefined;
+}
+
+/**
+ * \return view dimension from a texture type's suffix (e.g. \c 2d_array)
+ */
+static WGPUTextureViewDimension viewDimension(const char* dim) {
+	if (strncmp(dim, "1d", 2) == 0) {
+		return WGPUTextureViewDimension_1D;
+	}
+	if (strncmp(dim, "2d_array", 8) == 0) {
+		return WGPUTextureViewDimension_2DArray;
+	}
+	if (strncmp(dim, "2d", 2) == 0) {
+		return WGPUTextureViewDimension_2D;
+	}
+	if (strncmp(dim, "3d", 2) == 0) {
+		return WGPUTextureViewDimension_3D;
+	}
+	if (strncmp(dim, "cube_array", 10) == 0) {
+		return WGPUTextureViewDimension_CubeArray;
+	}
+	if (strncmp(dim, "cube", 4) == 0) {
+		return WGPUTextureViewDimension_Cube;
+	}
+	return WGPUTextureViewDimension_Undefined;
+}
+
+/**
+ * \return sample type from a texture's template argument
+ */
+static WGPUTextureSampleType sampleType(const char* name, bool multisampled) {
+	const char* arg = strchr(name, '<');
+	if (arg) {
+		if (strncmp(arg + 1, "i32", 3) == 0) {
+			return WGPUTextureSampleType_Sint;
+		}
+		if (strncmp(arg + 1, "u32", 3) == 0) {
+			return WGPUTextureSampleType_Uint;
+		}
+	}
+	return (multisampled) ? WGPUTextureSampleType_UnfilterableFloat : WGPUTextureSampleType_Float;
+}
+
+/**
+ * \return storage texture format from its WGSL name (or \c Undefined)
+ */
+static WGPUTextureFormat storageFormat(const char* name) {
+	static const struct {
+		const char* name;
+		WGPUTextureFormat format;
+	} formats[] = {
+		{"rgba8unorm",  WGPUTextureFormat_RGBA8Unorm},
+		{"rgba8snorm",  WGPUTextureFormat_RGBA8Snorm},
+		{"rgba8uint",   WGPUTextureFormat_RGBA8Uint},
+		{"rgba8sint",   WGPUTextureFormat_RGBA8Sint},
+		{"rgba16uint",  WGPUTextureFormat_RGBA16Uint},
+		{"rgba16sint",  WGPUTextureFormat_RGBA16Sint},
+		{"rgba16float", WGPUTextureFormat_RGBA16Float},
+		{"r32uint",     WGPUTextureFormat_R32Uint},
+		{"r32sint",     WGPUTextureFormat_R32Sint},
+		{"r32float",    WGPUTextureFormat_R32Float},
+		{"rg32uint",    WGPUTextureFormat_RG32Uint},
+		{"rg32sint",    WGPUTextureFormat_RG32Sint},
+		{"rg32float",   WGPUTextureFormat_RG32Float},
+		{"rgba32uint",  WGPUTextureFormat_RGBA32Uint},
+		{"rgba32sint",  WGPUTextureFormat_RGBA32Sint},
+		{"rgba32float", WGPUTextureFormat_RGBA32Float},
+	};
+	if (const char* arg = strchr(name, '<')) {
+		arg++;
+		size_t len = strcspn(arg, ",>");
+		for (unsigned n = 0; n < sizeof formats / sizeof formats[0]; n++) {
+			if (strlen(formats[n].name) == len && strncmp(formats[n].name, arg, len) == 0) {
+				return formats[n].format;
+			}
+		}
+	}
+	return WGPUTextureFormat_Undefined;
+}
+
+/**
+ * Declaration parser, filling in a \c reflect#Shader.
+ */
+class Parser {
+public:
+	Parser(const char* code, reflect::Shader& out)
+		: lex(code)
+		, out(out)
+		, structCount(0)
+		, memberCount(0)
+		, failed(false) {
+		attrs.reset();
+	}
+
+	/**
+	 * \return \c true if the whole source was read
+	 */
+	bool parse() {
+		while (!lex.done() && !failed) {
+			if (lex.peek().is("@")) {
+				attribute(attrs);
+				continue;
+			}
+			if (lex.accept("struct")) {
+				structure();
+			} else if (lex.accept("var")) {
+				variable();
+			} else if (lex.accept("fn")) {
+				function();
+			} else {
+				lex.skip(';');
+			}
+			attrs.reset();
+		}
+		if (!failed) {
+			layoutAttributes();
+		}
+		return !failed;
+	}
+
+private:
+	/**
+	 * Reads one \c @attribute (with any arguments) into \a into.
+	 */
+	void attribute(Attributes& into) {
+		lex.take();
+		Token name = lex.take();
+		int value = -1;
+		Token arg = {};
+		if (lex.peek().is("(")) {
+			lex.take();
+			arg   = lex.peek();
+			value = arg.number();
+			lex.skip(')');
+		}
+		if (name.is("group")) {
+			into.group = value;
+		} else if (name.is("binding")) {
+			into.binding = value;
+		} else if (name.is("location")) {
+			into.location = value;
+		} else if (name.is("size")) {
+			into.size = value;
+		} else if (name.is("align")) {
+			into.align = value;
+		} else if (name.is("builtin")) {
+			into.builtin = true;
+		} else if (name.is("vertex") || (name.is("stage") && arg.is("vertex"))) {
+			into.stage = WGPUShaderStage_Vertex;
+		} else if (name.is("fragment") || (name.is("stage") && arg.is("fragment"))) {
+			into.stage = WGPUShaderStage_Fragment;
+		} else if (name.is("compute") || (name.is("stage") && arg.is("compute"))) {
+			into.stage = WGPUShaderStage_Compute;
+		}
+	}
+
+	/**
+	 * Reads a type (including any template arguments) and works out its layout.
+	 */
+	Type type() {
+		Type type = {};
+		Token name = lex.take();
+		if (!name.ident()) {
+			failed = true;
+			return type;
+		}
+		size_t len = 0;
+		append(type, len, name);
+		if (lex.peek().is("<")) {
+			int depth = 0;
+			do {
+				Token tok = lex.take();
+				if (tok.is("<")) {
+					depth++;
+				} else if (tok.is(">")) {
+					depth--;
+				}
+				append(type, len, tok);
+			} while (depth > 0 && !lex.done());
+		}
+		measure(type);
+		return type;
+	}
+
+	void append(Type& type, size_t& len, const Token& tok) {
+		size_t n = tok.len;
+		if (len + n >= REFLECT_MAX_NAME) {
+			n = REFLECT_MAX_NAME - 1 - len;
+		}
+		memcpy(type.name + len, tok.str, n);
+		len += n;
+		type.name[len] = '\0';
+	}
+
+	/**
+	 * Fills in the size and alignment of a type (following WGSL's layout rules).
+	 */
+	void measure(Type& type) {
+		type.size  = 0;
+		type.align = 1;
+		if (type.is("f32") || type.is("i32") || type.is("u32")) {
+			type.size  = 4;
+			type.align = 4;
+		} else if (unsigned n = components(type.name, "vec")) {
+			type.size  = 4 * n;
+			type.align = (n == 2) ? 8 : 16;
+		} else if (type.starts("mat") && strlen(type.name) > 5) {
+			unsigned cols = components(type.name, "mat");
+			unsigned rows = (type.name[4] == 'x') ? components(type.name + 5, "") : 0;
+			if (cols && rows) {
+				type.align = (rows == 2) ? 8 : 16;
+				type.size  = cols * type.align;
+			}
+		} else if (type.starts("array<")) {
+			/*
+			 * Element type, then the count (or none for runtime-sized, for
+			 * which the minimum is one element). The element's own template
+			 * arguments are skipped to find the top-level separator.
+			 */
+			Type elem = {};
+			const char* arg = type.name + 6;
+			size_t len = 0;
+			for (int depth = 0; arg[len]; len++) {
+				if (arg[len] == '<') {
+					depth++;
+				} else if (arg[len] == '>') {
+					if (depth-- == 0) {
+						break;
+					}
+				} else if (arg[len] == ',' && depth == 0) {
+					break;
+				}
+			}
+			if (len < REFLECT_MAX_NAME) {
+				memcpy(elem.name, arg, len);
+				elem.name[len] = '\0';
+				measure(elem);
+				if (elem.size) {
+					uint32_t stride = roundUp(elem.size, elem.align);
+					int count = (arg[len] == ',') ? Token{arg + len + 1, strlen(arg + len + 1)}.number() : 1;
+					type.align = elem.align;
+					type.size  = (count > 0) ? stride * count : 0;
+				}
+			}
+		} else {
+			for (unsigned n = 0; n < structCount; n++) {
+				if (strcmp(structs[n].name, type.name) == 0) {
+					type.size  = structs[n].size;
+					type.align = structs[n].align;
+					break;
+				}
+			}
+		}
+	}
+
+	/**
+	 * Reads \c struct declarations (after the keyword).
+	 */
+	void structure() {
+		Struct info = {};
+		copy(info.name, lex.take());
+		info.first = memberCount;
+		info.align = 1;
+		if (!lex.accept("{")) {
+			failed = true;
+			return;
+		}
+		uint32_t offset = 0;
+		bool known = true;
+		while (!lex.done() && !lex.accept("}")) {
+			Attributes member;
+			member.reset();
+			while (lex.peek().is("@")) {
+				attribute(member);
+			}
+			lex.take();
+			if (!lex.accept(":")) {
+				failed = true;
+				return;
+			}
+			Type memberType = type();
+			if (member.size  > 0) {
+				memberType.size  = static_cast<uint32_t>(member.size);
+			}
+			if (member.align > 0) {
+				memberType.align = static_cast<uint32_t>(member.align);
+			}
+			known  = known && memberType.size > 0;
+			offset = roundUp(offset, memberType.align) + memberType.size;
+			if (memberType.align > info.align) {
+				info.align = memberType.align;
+			}
+			if (memberCount < REFLECT_MAX_MEMBERS) {
+				members[memberCount].type     = memberType;
+				members[memberCount].location = (member.builtin) ? -1 : member.location;
+				memberCount++;
+				info.count++;
+			}
+			if (!lex.accept(";")) {
+				lex.accept(",");
+			}
+		}
+		lex.accept(";");
+		info.size = (known) ? roundUp(offset, info.align) : 0;
+		if (structCount < REFLECT_MAX_STRUCTS) {
+			structs[structCount++] = info;
+		}
+	}
+
+	/**
+	 * Reads module-scope \c var declarations, adding any bindings.
+	 */
+	void variable() {
+		Token space = {};
+		Token access = {};
+		if (lex.accept("<")) {
+			space = lex.take();
+			if (lex.accept(",")) {
+				access = lex.take();
+			}
+			lex.accept(">");
+		}
+		lex.take();
+		if (!lex.accept(":")) {
+			failed = true;
+			return;
+		}
+		Type varType = type();
+		lex.skip(';');
+		if (attrs.group < 0 || attrs.binding < 0) {
+			return;
+		}
+		if (out.bindingCount == REFLECT_MAX_BINDINGS || attrs.group >= REFLECT_MAX_GROUPS) {
+			failed = true;
+			return;
+		}
+		reflect::Binding& binding = out.bindings[out.bindingCount];
+		binding = reflect::Binding();
+		binding.group = static_cast<uint32_t>(attrs.group);
+		binding.entry.binding = static_cast<uint32_t>(attrs.binding);
+		WGPUBindGroupLayoutEntry& entry = binding.entry;
+		if (space.is("uniform")) {
+			entry.buffer.type = WGPUBufferBindingType_Uniform;
+			entry.buffer.minBindingSize = varType.size;
+		} else if (space.is("storage")) {
+			entry.buffer.type = (access.is("read_write")) ? WGPUBufferBindingType_Storage : WGPUBufferBindingType_ReadOnlyStorage;
+			entry.buffer.minBindingSize = varType.size;
+		} else if (varType.is("sampler_comparison")) {
+			entry.sampler.type = WGPUSamplerBindingType_Comparison;
+		} else if (varType.is("sampler")) {
+			entry.sampler.type = WGPUSamplerBindingType_Filtering;
+		} else if (varType.starts("texture_storage_")) {
+			entry.storageTexture.access = WGPUStorageTextureAccess_WriteOnly;
+			entry.storageTexture.format = storageFormat(varType.name);
+			entry.storageTexture.viewDimension = viewDimension(varType.name + 16);
+		} else if (varType.starts("texture_depth_multisampled_")) {
+			entry.texture.sampleType    = WGPUTextureSampleType_Depth;
+			entry.texture.viewDimension = WGPUTextureViewDimension_2D;
+			entry.texture.multisampled  = true;
+		} else if (varType.starts("texture_depth_")) {
+			entry.texture.sampleType    = WGPUTextureSampleType_Depth;
+			entry.texture.viewDimension = viewDimension(varType.name + 14);
+		} else if (varType.starts("texture_multisampled_")) {
+			entry.texture.sampleType    = sampleType(varType.name, true);
+			entry.texture.viewDimension = WGPUTextureViewDimension_2D;
+			entry.texture.multisampled  = true;
+		} else if (varType.starts("texture_") && !varType.is("texture_external")) {
+			entry.texture.sampleType    = sampleType(varType.name, false);
+			entry.texture.viewDimension = viewDimension(varType.name + 8);
+		} else {
+			/*
+			 * External textures (and anything else) are ignored.
+			 */
+			return;
+		}
+		out.bindingCount++;
+	}
+
+	/**
+	 * Reads \c fn declarations, noting entry points and vertex inputs.
+	 */
+	void function() {
+		WGPUShaderStageFlags stage = attrs.stage;
+		lex.take();
+		if (!lex.accept("(")) {
+			failed = true;
+			return;
+		}
+		while (!lex.done() && !lex.accept(")")) {
+			Attributes param;
+			param.reset();
+			while (lex.peek().is("@")) {
+				attribute(param);
+			}
+			lex.take();
+			if (!lex.accept(":")) {
+				failed = true;
+				return;
+			}
+			Type paramType = type();
+			if (stage == WGPUShaderStage_Vertex && !param.builtin) {
+				if (param.location >= 0) {
+					input(paramType, param.location);
+				} else {
+					for (unsigned n = 0; n < structCount; n++) {
+						if (strcmp(structs[n].name, paramType.name) == 0) {
+							for (unsigned m = 0; m < structs[n].count; m++) {
+								const Member& member = members[structs[n].first + m];
+								if (member.location >= 0) {
+									input(member.type, member.location);
+								}
+							}
+							break;
+						}
+					}
+				}
+			}
+			lex.accept(",");
+		}
+		/*
+		 * Skip the return type then the body.
+		 */
+		while (!lex.done() && !lex.peek().is("{")) {
+			lex.take();
+		}
+		lex.skip('}');
+		out.stages |= stage;
+	}
+
+	/**
+	 * Adds a vertex input (laid out afterwards).
+	 */
+	void input(const Type& type, int location) {
+		uint32_t size = 0;
+		WGPUVertexFormat format = vertexFormat(type, size);
+		if (format == WGPUVertexFormat_Undefined || out.attributeCount == REFLECT_MAX_ATTRIBUTES) {
+			failed = true;
+			return;
+		}
+		WGPUVertexAttribute& attr = out.attributes[out.attributeCount++];
+		attr.format = format;
+		attr.offset = size; // size until laid out
+		attr.shaderLocation = static_cast<uint32_t>(location);
+	}
+
+	/**
+	 * Sorts the vertex inputs by location and packs them.
+	 */
+	void layoutAttributes() {
+		for (unsigned i = 1; i < out.attributeCount; i++) {
+			WGPUVertexAttribute attr = out.attributes[i];
+			unsigned j = i;
+			for (; j > 0 && out.attributes[j - 1].shaderLocation > attr.shaderLocation; j--) {
+				out.attributes[j] = out.attributes[j - 1];
+			}
+			out.attributes[j] = attr;
+		}
+		uint64_t offset = 0;
+		for (unsigned n = 0; n < out.attributeCount; n++) {
+			uint64_t size = out.attributes[n].offset;
+			out.attributes[n].offset = offset;
+			offset += size;
+		}
+		out.stride = offset;
+	}
+
+	Lexer lex;
+	reflect::Shader& out;
+	Attributes attrs;
+	Struct structs[REFLECT_MAX_STRUCTS];
+	unsigned structCount;
+	Member members[REFLECT_MAX_MEMBERS];
+	unsigned memberCount;
+	bool failed;
+};
+
+/**
+ * \return FNV-1a hash of \a str
+ */
+static uint64_t hash(const char* str) {
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	while (*str) {
+		hash ^= static_cast<unsigned char>(*str++);
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+/**
+ * \return \c true if two entries describe the same resource (ignoring visibility and size)
+ */
+static bool same(const WGPUBindGroupLayoutEntry& a, const WGPUBindGroupLayoutEntry& b) {
+	return a.buffer.type == b.buffer.type
+		&& a.sampler.type == b.sampler.type
+		&& memcmp(&a.texture, &b.texture, sizeof a.texture) == 0
+		&& memcmp(&a.storageTexture, &b.storageTexture, sizeof a.storageTexture) == 0;
+}
+
+static reflect::Shader cache[REFLECT_CACHE_SIZE];
+static unsigned cacheCount = 0;
+/**
+ * Result for when the cache is full.
+ */
+static reflect::Shader uncached;
+}
+
+//******************************** Public API ********************************/
+
+const reflect::Shader* reflect::shader(const char* code) {
+	uint64_t hash = impl::hash(code);
+	for (unsigned n = 0; n < impl::cacheCount; n++) {
+		if (impl::cache[n].hash == hash) {
+			return impl::cache + n;
+		}
+	}
+	Shader* shader = (impl::cacheCount < REFLECT_CACHE_SIZE) ? impl::cache + impl::cacheCount : &impl::uncached;
+	*shader = Shader();
+	shader->hash = hash;
+	/*
+	 * The parser's tables are a few tens of KB, so off the stack.
+	 */
+	impl::Parser* parser = new impl::Parser(code, *shader);
+	bool parsed = parser->parse();
+	delete parser;
+	if (!parsed) {
+		return nullptr;
+	}
+	for (unsigned n = 0; n < shader->bindingCount; n++) {
+		shader->bindings[n].entry.visibility = shader->stages;
+	}
+	if (shader != &impl::uncached) {
+		impl::cacheCount++;
+	}
+	return shader;
+}
+
+unsigned reflect::layouts(const Shader* const* shaders, unsigned count, WGPUBindGroupLayout (&layouts)[REFLECT_MAX_GROUPS]) {
+	Binding merged[REFLECT_MAX_BINDINGS];
+	unsigned mergedCount = 0;
+	unsigned groups = 0;
+	for (unsigned s = 0; s < count; s++) {
+		for (unsigned n = 0; n < shaders[s]->bindingCount; n++) {
+			const Binding& binding = shaders[s]->bindings[n];
+			unsigned m = 0;
+			for (; m < mergedCount; m++) {
+				if (merged[m].group == binding.group && merged[m].entry.binding == binding.entry.binding) {
+					break;
+				}
+			}
+			if (m < mergedCount) {
+				if (!impl::same(merged[m].entry, binding.entry)) {
+					return 0;
+				}
+				merged[m].entry.visibility |= binding.entry.visibility;
+				if (merged[m].entry.buffer.minBindingSize < binding.entry.buffer.minBindingSize) {
+					merged[m].entry.buffer.minBindingSize = binding.entry.buffer.minBindingSize;
+				}
+			} else {
+				if (mergedCount == REFLECT_MAX_BINDINGS) {
+					return 0;
+				}
+				merged[mergedCount++] = binding;
+				if (groups < binding.group + 1) {
+					groups = binding.group + 1;
+				}
+			}
+		}
+	}
+	/*
+	 * Entries are sorted by binding so identical layouts hash the same.
+	 */
+	for (unsigned g = 0; g < groups; g++) {
+		WGPUBindGroupLayoutEntry entries[REFLECT_MAX_BINDINGS];
+		unsigned entryCount = 0;
+		for (unsigned n = 0; n < mergedCount; n++) {
+			if (merged[n].group == g) {
+				unsigned i = entryCount++;
+				for (; i > 0 && entries[i - 1].binding > merged[n].entry.binding; i--) {
+					entries[i] = entries[i - 1];
+				}
+				entries[i] = merged[n].entry;
+			}
+		}
+		WGPUBindGroupLayoutDescriptor desc = {};
+		desc.entryCount = entryCount;
+		desc.entries    = entries;
+		layouts[g] = binding::layout(desc);
+	}
+	return groups;
+}
+
+WGPUVertexBufferLayout reflect::vertexLayout(const Shader& shader, WGPUVertexStepMode mode) {
+	WGPUVertexBufferLayout layout = {};
+	layout.arrayStride    = shader.stride;
+	layout.stepMode       = mode;
+	layout.attributeCount = shader.attributeCount;
+	layout.attributes     = shader.attributes;
+	return layout;
+}
+
+void reflect::clear() {
+	impl::cacheCount = 0;
+}
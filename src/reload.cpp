@@ -0,0 +1,394 @@
+#include "reload.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frame.h"
+
+/**
+ * \def RELOAD_WATCHER
+ * Set if files can be watched (needing threads and a file system).
+ */
+#if FRAME_THREADED && !defined(__EMSCRIPTEN__)
+#define RELOAD_WATCHER 1
+#include <sys/stat.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+#else
+#define RELOAD_WATCHER 0
+#endif
+
+//****************************************************************************/
+
+namespace impl {
+#if RELOAD_WATCHER
+/**
+ * Watched asset.
+ */
+struct Watch {
+	char name[RELOAD_MAX_PATH]; ///< Path relative to the root (as watched)
+	char path[RELOAD_MAX_PATH]; ///< Root and name combined
+	reload::Handler handler;
+	void* user;
+	uint64_t hash;    ///< Hash of the last build (watcher thread only)
+	long long stamp;  ///< Modification time when last polled (watcher thread only)
+	long long length; ///< File size when last polled (watcher thread only)
+	bool dirty;       ///< Changed since the last build (watcher thread only)
+	bool primed;      ///< Built once (the first build only recording the hash)
+	archive::Blob ready; ///< Rebuilt and awaiting hand over, if \c data is set (guarded by \c #lock)
+};
+
+static Watch watches[RELOAD_MAX_ASSETS];
+static std::atomic<unsigned> count(0); ///< Watches in use (published once filled in)
+static std::mutex lock;                ///< Guards adding watches and their \c Watch#ready
+static std::thread watcher;
+static std::atomic<bool> running(false);
+static char root[RELOAD_MAX_PATH];
+
+#ifdef __linux__
+/**
+ * Watched directory (inotify not being recursive, one per directory holding
+ * watched assets).
+ */
+struct Dir {
+	int wd;
+	char name[RELOAD_MAX_PATH]; ///< Path relative to the root (empty for the root)
+};
+
+static int notify = -1;
+static Dir dirs[RELOAD_MAX_ASSETS + 1];
+static unsigned dirCount = 0; ///< Guarded by \c #lock
+
+/**
+ * Watches the directory holding the asset \a name (called with the lock held).
+ *
+ * \return \c false if the directory can't be watched
+ */
+static bool addDir(const char* name) {
+	const char* slash = strrchr(name, '/');
+	size_t len = (slash) ? slash - name : 0;
+	for (unsigned n = 0; n < dirCount; n++) {
+		if (strlen(dirs[n].name) == len && strncmp(dirs[n].name, name, len) == 0) {
+			return true;
+		}
+	}
+	if (dirCount == RELOAD_MAX_ASSETS + 1) {
+		return false;
+	}
+	Dir& dir = dirs[dirCount];
+	memcpy(dir.name, name, len);
+	dir.name[len] = 0;
+	char path[RELOAD_MAX_PATH];
+	snprintf(path, sizeof path, (len) ? "%s/%s" : "%s%s", root, dir.name);
+	/*
+	 * Editors either write in place or write a copy then rename it over the
+	 * original, so both closes and moves are caught.
+	 */
+	dir.wd = inotify_add_watch(notify, path, IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (dir.wd < 0) {
+		return false;
+	}
+	dirCount++;
+	return true;
+}
+
+/**
+ * Marks the watched asset \a file in watch descriptor \a wd's directory as
+ * changed.
+ */
+static void changed(int wd, const char* file) {
+	char name[RELOAD_MAX_PATH] = {};
+	{
+		std::lock_guard<std::mutex> hold(lock);
+		for (unsigned n = 0; n < dirCount; n++) {
+			if (dirs[n].wd == wd) {
+				snprintf(name, sizeof name, (dirs[n].name[0]) ? "%s/%s" : "%s%s", dirs[n].name, file);
+				break;
+			}
+		}
+	}
+	unsigned used = count.load(std::memory_order_acquire);
+	for (unsigned n = 0; n < used; n++) {
+		if (strcmp(watches[n].name, name) == 0) {
+			watches[n].dirty = true;
+		}
+	}
+}
+
+/**
+ * Waits up to \c #RELOAD_POLL_MS for file events, marking the watched assets
+ * they're for as changed.
+ */
+static void wait() {
+	pollfd pending = {notify, POLLIN, 0};
+	if (poll(&pending, 1, RELOAD_POLL_MS) > 0) {
+		alignas(inotify_event) char events[4096];
+		ssize_t size;
+		while ((size = read(notify, events, sizeof events)) > 0) {
+			for (ssize_t pos = 0; pos < size;) {
+				const inotify_event* event = reinterpret_cast<const inotify_event*>(events + pos);
+				if (event->len) {
+					changed(event->wd, event->name);
+				}
+				pos += sizeof(inotify_event) + event->len;
+			}
+		}
+	}
+}
+#else
+/**
+ * Reads the modification time and size of \a path.
+ *
+ * \return \c false if the file couldn't be read
+ */
+static bool stamp(const char* path, long long& time, long long& length) {
+	struct stat info;
+	if (stat(path, &info) != 0) {
+		return false;
+	}
+	time   = static_cast<long long>(info.st_mtime);
+	length = static_cast<long long>(info.st_size);
+	return true;
+}
+
+/**
+ * Waits \c #RELOAD_POLL_MS then marks the watched assets whose modification
+ * time or size changed.
+ */
+static void wait() {
+	std::this_thread::sleep_for(std::chrono::milliseconds(RELOAD_POLL_MS));
+	unsigned used = count.load(std::memory_order_acquire);
+	for (unsigned n = 0; n < used; n++) {
+		Watch& watch = watches[n];
+		long long time, length;
+		if (stamp(watch.path, time, length) && (time != watch.stamp || length != watch.length)) {
+			watch.stamp  = time;
+			watch.length = length;
+			watch.dirty  = true;
+		}
+	}
+}
+#endif
+
+/**
+ * Reads the whole of \a path.
+ *
+ * \param[out] size size of the contents in bytes
+ * \return contents allocated with \c malloc() (or \c null if unreadable)
+ */
+static void* load(const char* path, size_t& size) {
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		return nullptr;
+	}
+	void* data = nullptr;
+	if (fseek(file, 0, SEEK_END) == 0) {
+		long end = ftell(file);
+		if (end >= 0 && fseek(file, 0, SEEK_SET) == 0 && (data = malloc(end + 1))) {
+			size = fread(data, 1, static_cast<size_t>(end), file);
+		}
+	}
+	fclose(file);
+	return data;
+}
+
+/**
+ * Rebuilds the changed assets, queuing those whose contents differ from their
+ * last build for hand over.
+ */
+static void rebuild() {
+	unsigned used = count.load(std::memory_order_acquire);
+	for (unsigned n = 0; n < used; n++) {
+		Watch& watch = watches[n];
+		if (!watch.dirty) {
+			continue;
+		}
+		watch.dirty = false;
+		size_t size = 0;
+		void* data = load(watch.path, size);
+		if (!data) {
+			continue;
+		}
+		archive::Blob blob;
+		bool built = archive::build(watch.name, data, size, blob);
+		free(data);
+		if (!built) {
+			printf("Unable to rebuild: %s\n", watch.path);
+			continue;
+		}
+		/*
+		 * Saves touching the file without changing it (or the first build,
+		 * being of what's already loaded) from reaching the GPU.
+		 */
+		bool same = blob.hash == watch.hash || !watch.primed;
+		watch.hash   = blob.hash;
+		watch.primed = true;
+		if (same) {
+			free(const_cast<void*>(blob.data));
+			continue;
+		}
+		std::lock_guard<std::mutex> hold(lock);
+		free(const_cast<void*>(watch.ready.data));
+		watch.ready = blob;
+	}
+}
+
+/**
+ * Watcher thread entry point.
+ */
+static void work() {
+	while (running.load(std::memory_order_relaxed)) {
+		wait();
+		rebuild();
+	}
+}
+#endif
+}
+
+//******************************** Public API ********************************/
+
+bool reload::init(const char* root) {
+#if RELOAD_WATCHER
+	if (impl::running.load(std::memory_order_relaxed) || strlen(root) >= RELOAD_MAX_PATH) {
+		return false;
+	}
+	memcpy(impl::root, root, strlen(root) + 1);
+#ifdef __linux__
+	impl::notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (impl::notify < 0) {
+		return false;
+	}
+	if (!impl::addDir("")) {
+		close(impl::notify);
+		impl::notify = -1;
+		return false;
+	}
+#else
+	struct stat info;
+	if (stat(root, &info) != 0 || !(info.st_mode & S_IFDIR)) {
+		return false;
+	}
+#endif
+	impl::running.store(true, std::memory_order_relaxed);
+	impl::watcher = std::thread(impl::work);
+	return true;
+#else
+	(void) root;
+	return false;
+#endif
+}
+
+void reload::destroy() {
+#if RELOAD_WATCHER
+	if (!impl::running.load(std::memory_order_relaxed)) {
+		return;
+	}
+	impl::running.store(false, std::memory_order_relaxed);
+	impl::watcher.join();
+#ifdef __linux__
+	close(impl::notify);
+	impl::notify   = -1;
+	impl::dirCount = 0;
+#endif
+	unsigned used = impl::count.load(std::memory_order_relaxed);
+	for (unsigned n = 0; n < used; n++) {
+		free(const_cast<void*>(impl::watches[n].ready.data));
+		impl::watches[n].ready.data = nullptr;
+	}
+	impl::count.store(0, std::memory_order_relaxed);
+#endif
+}
+
+bool reload::watch(const char* name, Handler handler, void* user) {
+#if RELOAD_WATCHER
+	if (!impl::running.load(std::memory_order_relaxed)) {
+		return false;
+	}
+	std::lock_guard<std::mutex> hold(impl::lock);
+	unsigned used = impl::count.load(std::memory_order_relaxed);
+	if (used == RELOAD_MAX_ASSETS || strlen(name) >= RELOAD_MAX_PATH) {
+		return false;
+	}
+	impl::Watch& watch = impl::watches[used];
+	if (snprintf(watch.path, sizeof watch.path, "%s/%s", impl::root, name) >= RELOAD_MAX_PATH) {
+		return false;
+	}
+#ifdef __linux__
+	if (!impl::addDir(name)) {
+		return false;
+	}
+#else
+	impl::stamp(watch.path, watch.stamp, watch.length);
+#endif
+	memcpy(watch.name, name, strlen(name) + 1);
+	watch.handler = handler;
+	watch.user    = user;
+	watch.hash    = 0;
+	watch.dirty   = true;
+	watch.primed  = false;
+	watch.ready   = archive::Blob();
+	impl::count.store(used + 1, std::memory_order_release);
+	return true;
+#else
+	(void) name;
+	(void) handler;
+	(void) user;
+	return false;
+#endif
+}
+
+unsigned reload::update() {
+#if RELOAD_WATCHER
+	archive::Blob ready[RELOAD_MAX_ASSETS];
+	unsigned owner[RELOAD_MAX_ASSETS];
+	unsigned found = 0;
+	{
+		std::unique_lock<std::mutex> hold(impl::lock, std::try_to_lock);
+		if (!hold.owns_lock()) {
+			return 0;
+		}
+		unsigned used = impl::count.load(std::memory_order_relaxed);
+		for (unsigned n = 0; n < used; n++) {
+			if (impl::watches[n].ready.data) {
+				ready[found] = impl::watches[n].ready;
+				owner[found++] = n;
+				impl::watches[n].ready.data = nullptr;
+			}
+		}
+	}
+	for (unsigned n = 0; n < found; n++) {
+		const impl::Watch& watch = impl::watches[owner[n]];
+		ready[n].name = watch.name;
+		watch.handler(ready[n], watch.user);
+		free(const_cast<void*>(ready[n].data));
+	}
+	return found;
+#else
+	return 0;
+#endif
+}
+
+WGPUBuffer reload::patch(WGPUDevice device, WGPUQueue queue, WGPUBuffer buffer, uint64_t& size,
+		const void* data, uint64_t bytes, WGPUBufferUsageFlags usage) {
+	if (bytes != size) {
+		WGPUBufferDescriptor desc = {};
+		desc.usage = WGPUBufferUsage_CopyDst | usage;
+		desc.size  = bytes;
+		WGPUBuffer grown = wgpuDeviceCreateBuffer(device, &desc);
+		wgpuBufferRelease(buffer);
+		buffer = grown;
+		size   = bytes;
+	}
+	wgpuQueueWriteBuffer(queue, buffer, 0, data, static_cast<size_t>(bytes));
+	return buffer;
+}
@@ -0,0 +1,299 @@
+#include "scene.h"
+
+#include <string.h>
+
+//****************************************************************************/
+
+namespace impl {
+/**
+ * Moves \a array's first \a count entries to the positions in \a to (into a
+ * new array of \a capacity entries, replacing \a array).
+ */
+template<typename T>
+static void permute(T*& array, const uint32_t* to, unsigned count, unsigned capacity) {
+	T* sorted = new T[capacity];
+	for (unsigned n = 0; n < count; n++) {
+		sorted[to[n]] = array[n];
+	}
+	delete[] array;
+	array = sorted;
+}
+}
+
+/**
+ * Node arrays, indexed by position (depth sorted once restructured) apart
+ * from \c #position (indexed by handle).
+ */
+struct scene::Graph::Impl {
+	Impl(unsigned capacity)
+		: capacity  (capacity)
+		, count     (0)
+		, node      (new Node     [capacity])
+		, parent    (new uint32_t [capacity])
+		, depth     (new uint32_t [capacity])
+		, local     (new glm::mat4[capacity])
+		, world     (new glm::mat4[capacity])
+		, stamp     (new uint32_t [capacity])
+		, dirty     (new uint8_t  [capacity])
+		, dead      (new uint8_t  [capacity])
+		, position  (new uint32_t [capacity])
+		, spare     (new Node     [capacity])
+		, scratch   (new uint32_t [capacity])
+		, spareCount(0)
+		, handles   (0)
+		, generation(0)
+		, firstDirty(0)
+		, unsorted  (false)
+		, removed   (false)
+		, changedFirst(0)
+		, changedCount(0) {}
+
+	~Impl() {
+		delete[] scratch;
+		delete[] spare;
+		delete[] position;
+		delete[] dead;
+		delete[] dirty;
+		delete[] stamp;
+		delete[] world;
+		delete[] local;
+		delete[] depth;
+		delete[] parent;
+		delete[] node;
+	}
+
+	/**
+	 * Restores the depth order (stable, so siblings keep their order).
+	 */
+	void sort() {
+		uint32_t deepest = 0;
+		for (unsigned n = 0; n < count; n++) {
+			if (depth[n] > deepest) {
+				deepest = depth[n];
+			}
+		}
+		uint32_t* starts = new uint32_t[deepest + 1]();
+		for (unsigned n = 0; n < count; n++) {
+			starts[depth[n]]++;
+		}
+		for (uint32_t d = 0, total = 0; d <= deepest; d++) {
+			uint32_t level = starts[d];
+			starts[d] = total;
+			total += level;
+		}
+		uint32_t* to = scratch;
+		for (unsigned n = 0; n < count; n++) {
+			to[n] = starts[depth[n]]++;
+		}
+		delete[] starts;
+		for (unsigned n = 0; n < count; n++) {
+			if (parent[n] != NONE) {
+				parent[n] = to[parent[n]];
+			}
+			position[node[n]] = to[n];
+		}
+		impl::permute(node,   to, count, capacity);
+		impl::permute(parent, to, count, capacity);
+		impl::permute(depth,  to, count, capacity);
+		impl::permute(local,  to, count, capacity);
+		impl::permute(world,  to, count, capacity);
+		impl::permute(dead,   to, count, capacity);
+		unsorted = false;
+	}
+
+	/**
+	 * Drops the removed nodes and their descendants, freeing their handles
+	 * (in depth order, so parents are always seen first).
+	 */
+	void compact() {
+		uint32_t* to = scratch;
+		unsigned kept = 0;
+		for (unsigned n = 0; n < count; n++) {
+			uint32_t up = parent[n];
+			if (dead[n] || (up != NONE && to[up] == NONE)) {
+				to[n] = NONE;
+				position[node[n]] = NONE;
+				spare[spareCount++] = node[n];
+				continue;
+			}
+			to[n] = kept;
+			node  [kept] = node[n];
+			parent[kept] = (up != NONE) ? to[up] : NONE;
+			depth [kept] = depth[n];
+			local [kept] = local[n];
+			world [kept] = world[n];
+			dead  [kept] = 0;
+			position[node[kept]] = kept;
+			kept++;
+		}
+		count   = kept;
+		removed = false;
+	}
+
+	unsigned capacity;
+	unsigned count;      ///< Nodes (including removed ones not yet compacted)
+	Node* node;          ///< Handle of the node at each position
+	uint32_t* parent;    ///< Position of the parent (or \c #NONE)
+	uint32_t* depth;     ///< Number of ancestors
+	glm::mat4* local;
+	glm::mat4* world;
+	uint32_t* stamp;     ///< Generation the world transform was last recomputed in
+	uint8_t* dirty;      ///< Local transform set since the last update
+	uint8_t* dead;       ///< Removed (compacted out on the next update)
+	uint32_t* position;  ///< Position of each handle (\c #NONE if free)
+	Node* spare;         ///< Freed handles
+	uint32_t* scratch;   ///< Position remapping (when sorting or compacting)
+	unsigned spareCount;
+	unsigned handles;    ///< Handles handed out so far (any after never used)
+	uint32_t generation; ///< Incremented per update recomputing anything
+	uint32_t firstDirty; ///< Lowest dirty position (\c #count if none)
+	bool unsorted;       ///< A node was added shallower than the one before it
+	bool removed;        ///< Nodes are waiting to be compacted out
+	uint32_t changedFirst;
+	uint32_t changedCount;
+};
+
+//******************************** Public API ********************************/
+
+scene::Graph::Graph(unsigned capacity)
+	: impl(new Impl(capacity)) {}
+
+scene::Graph::~Graph() {
+	delete impl;
+}
+
+scene::Node scene::Graph::add(Node parent, const glm::mat4& local) {
+	uint32_t up = NONE;
+	uint32_t depth = 0;
+	if (parent != NONE) {
+		up = impl->position[parent];
+		if (up == NONE) {
+			return NONE;
+		}
+		depth = impl->depth[up] + 1;
+	}
+	if (impl->count == impl->capacity) {
+		return NONE;
+	}
+	Node node = (impl->spareCount) ? impl->spare[--impl->spareCount] : impl->handles++;
+	uint32_t pos = impl->count++;
+	impl->node  [pos] = node;
+	impl->parent[pos] = up;
+	impl->depth [pos] = depth;
+	impl->local [pos] = local;
+	impl->world [pos] = local;
+	impl->stamp [pos] = 0;
+	impl->dirty [pos] = 1;
+	impl->dead  [pos] = 0;
+	impl->position[node] = pos;
+	if (pos > 0 && depth < impl->depth[pos - 1]) {
+		impl->unsorted = true;
+	}
+	if (pos < impl->firstDirty) {
+		impl->firstDirty = pos;
+	}
+	return node;
+}
+
+void scene::Graph::remove(Node node) {
+	uint32_t pos = impl->position[node];
+	if (pos != NONE && !impl->dead[pos]) {
+		impl->dead[pos] = 1;
+		impl->removed   = true;
+	}
+}
+
+void scene::Graph::set(Node node, const glm::mat4& local) {
+	uint32_t pos = impl->position[node];
+	impl->local[pos] = local;
+	if (!impl->dirty[pos]) {
+		impl->dirty[pos] = 1;
+		if (pos < impl->firstDirty) {
+			impl->firstDirty = pos;
+		}
+	}
+}
+
+const glm::mat4& scene::Graph::local(Node node) const {
+	return impl->local[impl->position[node]];
+}
+
+const glm::mat4& scene::Graph::world(Node node) const {
+	return impl->world[impl->position[node]];
+}
+
+unsigned scene::Graph::update() {
+	/*
+	 * Moving nodes around invalidates any copies of the world transforms, so
+	 * after a structural change everything is recomputed (and reported).
+	 */
+	if (impl->unsorted || impl->removed) {
+		if (impl->unsorted) {
+			impl->sort();
+		}
+		if (impl->removed) {
+			impl->compact();
+		}
+		memset(impl->dirty, 1, impl->count);
+		impl->firstDirty = 0;
+	}
+	impl->changedFirst = 0;
+	impl->changedCount = 0;
+	if (impl->firstDirty >= impl->count) {
+		return 0;
+	}
+	if (++impl->generation == 0) {
+		memset(impl->stamp, 0, impl->count * sizeof(uint32_t));
+		impl->generation = 1;
+	}
+	/*
+	 * Parents precede their children, so a parent recomputed this pass
+	 * (stamped with this generation) is always seen before its children.
+	 */
+	const uint32_t gen = impl->generation;
+	const uint32_t* parent = impl->parent;
+	uint32_t* stamp = impl->stamp;
+	uint8_t* dirty = impl->dirty;
+	glm::mat4* world = impl->world;
+	const glm::mat4* local = impl->local;
+	unsigned recomputed = 0;
+	uint32_t first = NONE;
+	uint32_t last  = 0;
+	for (uint32_t n = impl->firstDirty; n < impl->count; n++) {
+		uint32_t up = parent[n];
+		if (dirty[n] || (up != NONE && stamp[up] == gen)) {
+			world[n] = (up != NONE) ? world[up] * local[n] : local[n];
+			stamp[n] = gen;
+			dirty[n] = 0;
+			if (first == NONE) {
+				first = n;
+			}
+			last = n;
+			recomputed++;
+		}
+	}
+	impl->firstDirty = impl->count;
+	if (recomputed) {
+		impl->changedFirst = first;
+		impl->changedCount = last - first + 1;
+	}
+	return recomputed;
+}
+
+const glm::mat4* scene::Graph::worlds() const {
+	return impl->world;
+}
+
+unsigned scene::Graph::size() const {
+	return impl->count;
+}
+
+unsigned scene::Graph::index(Node node) const {
+	return impl->position[node];
+}
+
+bool scene::Graph::changed(unsigned& first, unsigned& count) const {
+	first = impl->changedFirst;
+	count = impl->changedCount;
+	return count != 0;
+}
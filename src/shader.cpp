@@ -0,0 +1,375 @@
+#include "shader.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * \def SHADER_MAX_NESTING
+ * Maximum nesting of \c //\#if blocks (deeper blocks are ignored).
+ */
+#ifndef SHADER_MAX_NESTING
+#define SHADER_MAX_NESTING 16
+#endif
+
+//****************************************************************************/
+
+namespace impl {
+/**
+ * Source line directives.
+ */
+enum Directive {
+	NONE,
+	IF,
+	ELSE,
+	ENDIF,
+};
+
+/**
+ * Parses a line for a directive.
+ *
+ * \param[in] line start of the line
+ * \param[in] end end of the line
+ * \param[out] name start of the directive's flag name (for \c #IF)
+ * \param[out] len length of \a name
+ * \param[out] negate set if the flag was negated
+ * \return the directive (or \c #NONE for a regular line)
+ */
+static Directive parse(const char* line, const char* end, const char*& name, size_t& len, bool& negate) {
+	while (line < end && (*line == ' ' || *line == '\t')) {
+		line++;
+	}
+	if (end - line < 3 || strncmp(line, "//#", 3) != 0) {
+		return NONE;
+	}
+	line += 3;
+	if (end - line >= 5 && strncmp(line, "endif", 5) == 0) {
+		return ENDIF;
+	}
+	if (end - line >= 4 && strncmp(line, "else", 4) == 0) {
+		return ELSE;
+	}
+	if (end - line >= 2 && strncmp(line, "if", 2) == 0) {
+		line += 2;
+		while (line < end && (*line == ' ' || *line == '\t')) {
+			line++;
+		}
+		negate = line < end && *line == '!';
+		if (negate) {
+			line++;
+		}
+		name = line;
+		while (line < end && (*line == '_' || (*line >= '0' && *line <= '9')
+				|| (*line >= 'A' && *line <= 'Z') || (*line >= 'a' && *line <= 'z'))) {
+			line++;
+		}
+		len = line - name;
+		return IF;
+	}
+	return NONE;
+}
+
+/**
+ * \return index of the flag called \a name (or -1 if there isn't one)
+ */
+static int find(const shader::Source& source, const char* name, size_t len) {
+	for (unsigned n = 0; n < source.flagCount && n < SHADER_MAX_FLAGS; n++) {
+		if (strlen(source.flags[n].name) == len && strncmp(source.flags[n].name, name, len) == 0) {
+			return static_cast<int>(n);
+		}
+	}
+	return -1;
+}
+
+/**
+ * \return the end of the line starting at \a line (pointing at the newline or terminator)
+ */
+static const char* eol(const char* line) {
+	while (*line && *line != '\n') {
+		line++;
+	}
+	return line;
+}
+
+/**
+ * \return flags tested by the source's directives
+ */
+static shader::Features tested(const shader::Source& source) {
+	shader::Features used = 0;
+	for (const char* line = source.code; *line;) {
+		const char* end = eol(line);
+		const char* name = nullptr;
+		size_t len = 0;
+		bool negate = false;
+		if (parse(line, end, name, len, negate) == IF) {
+			int flag = find(source, name, len);
+			if (flag >= 0) {
+				used |= 1U << flag;
+			}
+		}
+		line = (*end) ? end + 1 : end;
+	}
+	return used;
+}
+
+/**
+ * \return the \e constant flags
+ */
+static shader::Features constants(const shader::Source& source) {
+	shader::Features bits = 0;
+	for (unsigned n = 0; n < source.flagCount && n < SHADER_MAX_FLAGS; n++) {
+		if (source.flags[n].constant) {
+			bits |= 1U << n;
+		}
+	}
+	return bits;
+}
+
+/**
+ * Bounded string output (counting what would have been written).
+ */
+struct Writer {
+	char* out;
+	size_t size;
+	size_t len;
+	void put(const char* str, size_t n) {
+		if (out && len < size) {
+			size_t fits = (len + n <= size) ? n : size - len;
+			memcpy(out + len, str, fits);
+		}
+		len += n;
+	}
+	void put(const char* str) {
+		put(str, strlen(str));
+	}
+};
+
+/**
+ * \return FNV-1a hash of \a str
+ */
+static uint64_t hash(const char* str) {
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	while (*str) {
+		hash ^= static_cast<unsigned char>(*str++);
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+/**
+ * Compiled module, shared by every variant specialising to the same code.
+ */
+struct Module {
+	uint64_t hash;
+	char* code; ///< Specialised source (compared when the hashes match)
+	WGPUShaderModule module;
+};
+
+/**
+ * Requested variant.
+ */
+struct Entry {
+	const shader::Source* source;
+	shader::Features key; ///< Requested flags the variant depends on
+	unsigned module;      ///< Index into the modules
+	WGPUConstantEntry constants[SHADER_MAX_FLAGS];
+	uint32_t constantCount;
+};
+}
+
+/**
+ * Library tables.
+ */
+struct shader::Library::Impl {
+	Impl(WGPUDevice device)
+		: device(device)
+		, variantCount(0)
+		, moduleCount (0)
+		, stats() {
+		wgpuDeviceReference(device);
+	}
+
+	~Impl() {
+		for (unsigned n = 0; n < moduleCount; n++) {
+			if (modules[n].module) {
+				wgpuShaderModuleRelease(modules[n].module);
+			}
+			free(modules[n].code);
+		}
+		wgpuDeviceRelease(device);
+	}
+
+	/**
+	 * \return index of the module for \a code, compiling it if needed (or
+	 * \c #SHADER_MAX_VARIANTS if the table is full)
+	 */
+	unsigned module(const char* code, const char* label) {
+		uint64_t key = impl::hash(code);
+		for (unsigned n = 0; n < moduleCount; n++) {
+			if (modules[n].hash == key && strcmp(modules[n].code, code) == 0) {
+				return n;
+			}
+		}
+		size_t size = strlen(code) + 1;
+		char* copy = static_cast<char*>(malloc(size));
+		if (moduleCount == SHADER_MAX_VARIANTS || !copy) {
+			free(copy);
+			return SHADER_MAX_VARIANTS;
+		}
+		memcpy(copy, code, size);
+		WGPUShaderModuleWGSLDescriptor wgsl = {};
+		wgsl.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor;
+		wgsl.source = code;
+		WGPUShaderModuleDescriptor desc = {};
+		desc.nextInChain = reinterpret_cast<WGPUChainedStruct*>(&wgsl);
+		desc.label = label;
+		modules[moduleCount].hash   = key;
+		modules[moduleCount].code   = copy;
+		modules[moduleCount].module = wgpuDeviceCreateShaderModule(device, &desc);
+		stats.modules++;
+		return moduleCount++;
+	}
+
+	WGPUDevice device;
+	impl::Entry variants[SHADER_MAX_VARIANTS];
+	unsigned variantCount;
+	impl::Module modules[SHADER_MAX_VARIANTS];
+	unsigned moduleCount;
+	Stats stats;
+};
+
+//******************************** Public API ********************************/
+
+size_t shader::specialise(const Source& source, Features features, char* out, size_t size) {
+	impl::Writer dst = {out, size, 0};
+	/*
+	 * Declarations for the constant flags come first.
+	 */
+	for (unsigned n = 0; n < source.flagCount && n < SHADER_MAX_FLAGS; n++) {
+		const Flag& flag = source.flags[n];
+		if (flag.constant) {
+		#if SHADER_OVERRIDES
+			dst.put("override ");
+			dst.put(flag.name);
+			dst.put(" : bool = false;\n");
+		#else
+			dst.put("let ");
+			dst.put(flag.name);
+			dst.put((features & (1U << n)) ? " : bool = true;\n" : " : bool = false;\n");
+		#endif
+		}
+	}
+	/*
+	 * Then each line, unless inside a block whose condition failed.
+	 */
+	bool active[SHADER_MAX_NESTING + 1] = {true};
+	bool taken [SHADER_MAX_NESTING + 1] = {true};
+	unsigned depth = 0;
+	unsigned skipped = 0; ///< Blocks nested deeper than the stack
+	for (const char* line = source.code; *line;) {
+		const char* end = impl::eol(line);
+		const char* name = nullptr;
+		size_t len = 0;
+		bool negate = false;
+		switch (impl::parse(line, end, name, len, negate)) {
+		case impl::IF:
+			if (depth < SHADER_MAX_NESTING) {
+				int flag = impl::find(source, name, len);
+				bool set = flag >= 0 && (features & (1U << flag)) != 0;
+				depth++;
+				taken [depth] = set != negate;
+				active[depth] = active[depth - 1] && taken[depth];
+			} else {
+				skipped++;
+			}
+			break;
+		case impl::ELSE:
+			if (skipped == 0 && depth > 0) {
+				active[depth] = active[depth - 1] && !taken[depth];
+			}
+			break;
+		case impl::ENDIF:
+			if (skipped > 0) {
+				skipped--;
+			} else if (depth > 0) {
+				depth--;
+			}
+			break;
+		default:
+			if (active[depth]) {
+				dst.put(line, end - line);
+				dst.put("\n", 1);
+			}
+		}
+		line = (*end) ? end + 1 : end;
+	}
+	dst.put("", 1);
+	if (out && size > 0) {
+		out[size - 1] = '\0';
+	}
+	return dst.len;
+}
+
+shader::Library::Library(WGPUDevice device)
+	: impl(new Impl(device)) {}
+
+shader::Library::~Library() {
+	delete impl;
+}
+
+shader::Variant shader::Library::get(const Source& source, Features features) {
+	impl->stats.requests++;
+	Features constants = impl::constants(source);
+	/*
+	 * Only the flags the code tests (plus the constants, whose values are
+	 * per variant) make a difference.
+	 */
+	Features key = features & (impl::tested(source) | constants);
+	Variant result = {};
+	for (unsigned n = 0; n < impl->variantCount; n++) {
+		impl::Entry& entry = impl->variants[n];
+		if (entry.source == &source && entry.key == key) {
+			result.module        = impl->modules[entry.module].module;
+			result.constants     = entry.constants;
+			result.constantCount = entry.constantCount;
+			return result;
+		}
+	}
+	if (impl->variantCount == SHADER_MAX_VARIANTS) {
+		return result;
+	}
+	size_t size = specialise(source, key, nullptr, 0);
+	char* code = static_cast<char*>(malloc(size));
+	if (!code) {
+		return result;
+	}
+	specialise(source, key, code, size);
+	unsigned module = impl->module(code, source.label);
+	free(code);
+	if (module == SHADER_MAX_VARIANTS) {
+		return result;
+	}
+	impl::Entry& entry = impl->variants[impl->variantCount++];
+	entry.source = &source;
+	entry.key    = key;
+	entry.module = module;
+	entry.constantCount = 0;
+#if SHADER_OVERRIDES
+	for (unsigned n = 0; n < source.flagCount && n < SHADER_MAX_FLAGS; n++) {
+		if (constants & (1U << n)) {
+			WGPUConstantEntry& constant = entry.constants[entry.constantCount++];
+			constant = WGPUConstantEntry();
+			constant.key   = source.flags[n].name;
+			constant.value = (key & (1U << n)) ? 1.0 : 0.0;
+		}
+	}
+#endif
+	impl->stats.variants++;
+	result.module        = impl->modules[module].module;
+	result.constants     = (entry.constantCount) ? entry.constants : nullptr;
+	result.constantCount = entry.constantCount;
+	return result;
+}
+
+const shader::Stats& shader::Library::stats() const {
+	return impl->stats;
+}
@@ -0,0 +1,208 @@
+#include "spin.h"
+
+#include "binding.h"
+
+//****************************************************************************/
+
+namespace impl {
+static_assert(sizeof(spin::State) == 48, "spin::State differs from the WGSL State");
+
+/**
+ * Instances per workgroup (matching the shader's \c workgroup_size).
+ */
+static const uint32_t GROUP_SIZE = 64;
+
+/**
+ * Most workgroups per dispatch dimension (larger counts spilling into \c y).
+ */
+static const uint32_t MAX_GROUPS = 65535;
+
+/**
+ * Each invocation turns one instance by its angular velocity over the time
+ * step (composing quaternions, renormalised so the error never builds up),
+ * then packs the instance for the vertex shader to expand.
+ */
+static char const spin_wgsl[] = INSTANCE_WGSL R"(
+	struct Params {
+		delta : f32;
+		count : u32;
+	};
+	struct State {
+		rotation : vec4<f32>;
+		position : vec3<f32>;
+		scale : f32;
+		axis : vec3<f32>;
+		speed : f32;
+	};
+	struct States {
+		items : array<State>;
+	};
+	struct Instances {
+		items : array<Instance>;
+	};
+	@group(0) @binding(0) var<uniform> params : Params;
+	@group(0) @binding(1) var<storage, read_write> states : States;
+	@group(0) @binding(2) var<storage, read_write> instances : Instances;
+
+	@stage(compute) @workgroup_size(64)
+	fn main(@builtin(global_invocation_id) id : vec3<u32>, @builtin(num_workgroups) groups : vec3<u32>) {
+		let i = id.y * groups.x * 64u + id.x;
+		if (i >= params.count) {
+			return;
+		}
+		let s = states.items[i];
+		let angle = 0.5 * s.speed * params.delta;
+		let d = vec4<f32>(s.axis * sin(angle), cos(angle));
+		let r = s.rotation;
+		let q = normalize(vec4<f32>(d.w * r.xyz + r.w * d.xyz + cross(d.xyz, r.xyz), d.w * r.w - dot(d.xyz, r.xyz)));
+		states.items[i].rotation = q;
+		instances.items[i] = instancePack(q, s.position, s.scale);
+	}
+)";
+
+/**
+ * \return a buffer of \a size bytes (never zero)
+ */
+static WGPUBuffer createBuffer(WGPUDevice device, uint64_t size, WGPUBufferUsageFlags usage, const char* label) {
+	WGPUBufferDescriptor desc = {};
+	desc.label = label;
+	desc.usage = usage;
+	desc.size  = (size) ? size : 16;
+	return wgpuDeviceCreateBuffer(device, &desc);
+}
+}
+
+/**
+ * Buffers and the pipeline (created up front, the buffers never changing).
+ */
+struct spin::Animator::Impl {
+	Impl(WGPUDevice device, unsigned capacity)
+		: capacity (capacity)
+		, count    (0)
+		, params   (impl::createBuffer(device, 16, WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst, "spin params"))
+		, states   (impl::createBuffer(device, uint64_t(capacity) * sizeof(State), WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst, "spin states"))
+		, instances(impl::createBuffer(device, uint64_t(capacity) * sizeof(instance::Instance), WGPUBufferUsage_Storage, "spin instances")) {
+		WGPUBindGroupLayoutEntry entries[3] = {};
+		entries[0].binding    = 0;
+		entries[0].visibility = WGPUShaderStage_Compute;
+		entries[0].buffer.type = WGPUBufferBindingType_Uniform;
+		entries[0].buffer.minBindingSize = 8;
+		entries[1].binding    = 1;
+		entries[1].visibility = WGPUShaderStage_Compute;
+		entries[1].buffer.type = WGPUBufferBindingType_Storage;
+		entries[1].buffer.minBindingSize = sizeof(State);
+		entries[2].binding    = 2;
+		entries[2].visibility = WGPUShaderStage_Compute;
+		entries[2].buffer.type = WGPUBufferBindingType_Storage;
+		entries[2].buffer.minBindingSize = sizeof(instance::Instance);
+		WGPUBindGroupLayoutDescriptor layoutDesc = {};
+		layoutDesc.entryCount = 3;
+		layoutDesc.entries    = entries;
+		layout = binding::layout(layoutDesc);
+
+		WGPUShaderModuleWGSLDescriptor wgsl = {};
+		wgsl.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor;
+		wgsl.source = impl::spin_wgsl;
+		WGPUShaderModuleDescriptor moduleDesc = {};
+		moduleDesc.nextInChain = reinterpret_cast<WGPUChainedStruct*>(&wgsl);
+		moduleDesc.label = "spin";
+		WGPUShaderModule module = wgpuDeviceCreateShaderModule(device, &moduleDesc);
+		WGPUPipelineLayoutDescriptor pipeLayoutDesc = {};
+		pipeLayoutDesc.bindGroupLayoutCount = 1;
+		pipeLayoutDesc.bindGroupLayouts = &layout;
+		WGPUPipelineLayout pipeLayout = wgpuDeviceCreatePipelineLayout(device, &pipeLayoutDesc);
+		WGPUComputePipelineDescriptor desc = {};
+		desc.label  = "spin";
+		desc.layout = pipeLayout;
+		desc.compute.module     = module;
+		desc.compute.entryPoint = "main";
+		pipeline = wgpuDeviceCreateComputePipeline(device, &desc);
+		wgpuPipelineLayoutRelease(pipeLayout);
+		wgpuShaderModuleRelease(module);
+
+		WGPUBindGroupEntry groupEntries[3] = {};
+		groupEntries[0].binding = 0;
+		groupEntries[0].buffer  = params;
+		groupEntries[0].size    = 8;
+		groupEntries[1].binding = 1;
+		groupEntries[1].buffer  = states;
+		groupEntries[1].size    = WGPU_WHOLE_SIZE;
+		groupEntries[2].binding = 2;
+		groupEntries[2].buffer  = instances;
+		groupEntries[2].size    = WGPU_WHOLE_SIZE;
+		WGPUBindGroupDescriptor groupDesc = {};
+		groupDesc.layout     = layout;
+		groupDesc.entryCount = 3;
+		groupDesc.entries    = groupEntries;
+		group = binding::group(groupDesc);
+	}
+
+	~Impl() {
+		binding::release(group);
+		wgpuComputePipelineRelease(pipeline);
+		binding::release(layout);
+		wgpuBufferRelease(instances);
+		wgpuBufferRelease(states);
+		wgpuBufferRelease(params);
+	}
+
+	unsigned capacity;
+	unsigned count;   ///< Instances animated (one past the last written)
+	WGPUBuffer params; ///< Time step and instance count
+	WGPUBuffer states;
+	WGPUBuffer instances;
+	WGPUBindGroupLayout layout;
+	WGPUComputePipeline pipeline;
+	WGPUBindGroup group;
+};
+
+//******************************** Public API ********************************/
+
+spin::Animator::Animator(WGPUDevice device, unsigned capacity)
+	: impl(new Impl(device, capacity)) {}
+
+spin::Animator::~Animator() {
+	delete impl;
+}
+
+bool spin::Animator::write(WGPUQueue queue, const State* states, unsigned first, unsigned count) {
+	if (first > impl->capacity || count > impl->capacity - first) {
+		return false;
+	}
+	if (count) {
+		wgpuQueueWriteBuffer(queue, impl->states, uint64_t(first) * sizeof(State), states, count * sizeof(State));
+		if (first + count > impl->count) {
+			impl->count = first + count;
+		}
+	}
+	return true;
+}
+
+void spin::Animator::encode(WGPUQueue queue, WGPUCommandEncoder encoder, float delta) {
+	if (impl->count == 0) {
+		return;
+	}
+	struct {
+		float delta;
+		uint32_t count;
+	} params = {delta, impl->count};
+	wgpuQueueWriteBuffer(queue, impl->params, 0, &params, sizeof params);
+	uint32_t groups = (impl->count + impl::GROUP_SIZE - 1) / impl::GROUP_SIZE;
+	uint32_t groupsX = (groups < impl::MAX_GROUPS) ? groups : impl::MAX_GROUPS;
+	WGPUComputePassDescriptor desc = {};
+	desc.label = "spin";
+	WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass(encoder, &desc);
+	wgpuComputePassEncoderSetPipeline(pass, impl->pipeline);
+	wgpuComputePassEncoderSetBindGroup(pass, 0, impl->group, 0, nullptr);
+	wgpuComputePassEncoderDispatch(pass, groupsX, (groups + groupsX - 1) / groupsX, 1);
+	wgpuComputePassEncoderEnd(pass);
+	wgpuComputePassEncoderRelease(pass);
+}
+
+WGPUBuffer spin::Animator::instances() const {
+	return impl->instances;
+}
+
+unsigned spin::Animator::size() const {
+	return impl->count;
+}
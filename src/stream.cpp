@@ -0,0 +1,839 @@
+#include "stream.h"
+
+#include <math.h>
+#include <stdlib.h>
+#if STREAM_CHECK
+#include <string.h>
+#endif
+
+#include "binding.h"
+#include "frame.h"
+#include "profile.h"
+
+#if FRAME_THREADED
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#if STREAM_CHECK
+#include <chrono>
+#endif
+#endif
+
+//****************************************************************************/
+
+namespace impl {
+/**
+ * Most mip levels per texture (enough for 32k).
+ */
+static const unsigned MAX_LEVELS = 16;
+}
+
+/**
+ * Streamed texture state (owned by the render thread).
+ */
+struct stream::TextureImpl {
+	TextureDesc desc;
+	unsigned block;      ///< Block size in texels (one if uncompressed)
+	unsigned blockBytes; ///< Bytes per block (or texel)
+	unsigned tail;   ///< Coarsest level the texture can be cut down to (the tail being always resident)
+	unsigned base;   ///< Finest resident level
+	unsigned target; ///< Finest level to keep after this update (working value)
+	unsigned want;   ///< Finest level requested since the last update
+	unsigned long long used[impl::MAX_LEVELS]; ///< Update each level was last needed
+	WGPUTexture texture; ///< Levels \c #base onwards
+	WGPUTextureView view;
+	size_t bytes;    ///< Resident bytes
+	bool loading;    ///< A level load is in flight
+	bool dead;       ///< Released whilst loading (freed once the load returns)
+	TextureImpl* next;
+};
+
+namespace impl {
+/**
+ * Level load, handed from the render thread to the loading thread and back.
+ */
+struct Load {
+	enum State {
+		FREE,
+		QUEUED,
+		READING,
+		DONE,
+	};
+	stream::Texture tex;
+	stream::Loader load;
+	void* user;
+	unsigned level;
+	unsigned char* data; ///< Staging buffer (kept between loads)
+	size_t capacity;
+	size_t size;
+	State state;
+	bool ok;
+};
+
+static WGPUDevice device = nullptr;
+static WGPUQueue  queue  = nullptr;
+
+static stream::Texture textures = nullptr; ///< Live textures
+static Load loads[STREAM_MAX_LOADS];
+static size_t budget   = 0;
+static size_t resident = 0; ///< Bytes held by the GPU textures
+static size_t reserved = 0; ///< Bytes of the loads in flight
+static unsigned long long frame = 0;
+static stream::Stats stats = {};
+
+#if FRAME_THREADED
+static std::thread loader;
+static std::mutex lock; ///< Guards each \c Load#state and \c #running
+static std::condition_variable wake;
+static bool running = false;
+#endif
+
+/**
+ * \return \a dim at \a level (never less than one)
+ */
+static uint32_t extent(uint32_t dim, unsigned level) {
+	dim >>= level;
+	return (dim) ? dim : 1;
+}
+
+/**
+ * \return \a dim at \a level rounded up to whole blocks
+ */
+static uint32_t physical(const stream::TextureImpl* tex, uint32_t dim, unsigned level) {
+	return (extent(dim, level) + tex->block - 1) / tex->block * tex->block;
+}
+
+/**
+ * \return size of \a level in bytes
+ */
+static size_t levelBytes(const stream::TextureImpl* tex, unsigned level) {
+	return static_cast<size_t>(physical(tex, tex->desc.width,  level) / tex->block)
+		 * static_cast<size_t>(physical(tex, tex->desc.height, level) / tex->block) * tex->blockBytes;
+}
+
+/**
+ * \return bytes of levels \a from onwards
+ */
+static size_t chainBytes(const stream::TextureImpl* tex, unsigned from) {
+	size_t bytes = 0;
+	for (unsigned n = from; n < tex->desc.levels; n++) {
+		bytes += levelBytes(tex, n);
+	}
+	return bytes;
+}
+
+/**
+ * Gets the block size and bytes per block of the formats that can be streamed.
+ *
+ * \return \c false if \a fmt isn't supported
+ */
+static bool footprint(WGPUTextureFormat fmt, unsigned& block, unsigned& bytes) {
+	block = 1;
+	switch (fmt) {
+	case WGPUTextureFormat_R8Unorm:
+		bytes = 1;
+		return true;
+	case WGPUTextureFormat_RG8Unorm:
+		bytes = 2;
+		return true;
+	case WGPUTextureFormat_RGBA8Unorm:
+	case WGPUTextureFormat_RGBA8UnormSrgb:
+	case WGPUTextureFormat_BGRA8Unorm:
+	case WGPUTextureFormat_BGRA8UnormSrgb:
+		bytes = 4;
+		return true;
+	case WGPUTextureFormat_RGBA16Float:
+		bytes = 8;
+		return true;
+	case WGPUTextureFormat_RGBA32Float:
+		bytes = 16;
+		return true;
+	case WGPUTextureFormat_BC1RGBAUnorm:
+	case WGPUTextureFormat_BC1RGBAUnormSrgb:
+	case WGPUTextureFormat_ETC2RGB8Unorm:
+	case WGPUTextureFormat_ETC2RGB8UnormSrgb:
+		block = 4;
+		bytes = 8;
+		return true;
+	case WGPUTextureFormat_BC3RGBAUnorm:
+	case WGPUTextureFormat_BC3RGBAUnormSrgb:
+	case WGPUTextureFormat_BC7RGBAUnorm:
+	case WGPUTextureFormat_BC7RGBAUnormSrgb:
+	case WGPUTextureFormat_ETC2RGBA8Unorm:
+	case WGPUTextureFormat_ETC2RGBA8UnormSrgb:
+	case WGPUTextureFormat_ASTC4x4Unorm:
+	case WGPUTextureFormat_ASTC4x4UnormSrgb:
+		block = 4;
+		bytes = 16;
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * Uploads \a level of \a tex (which must be resident in its GPU texture).
+ */
+static void upload(stream::TextureImpl* tex, unsigned level, const void* data) {
+	WGPUImageCopyTexture dst = {};
+	dst.texture  = tex->texture;
+	dst.mipLevel = level - tex->base;
+	dst.aspect   = WGPUTextureAspect_All;
+	WGPUTextureDataLayout layout = {};
+	layout.bytesPerRow  = physical(tex, tex->desc.width,  level) / tex->block * tex->blockBytes;
+	layout.rowsPerImage = physical(tex, tex->desc.height, level) / tex->block;
+	WGPUExtent3D size = {};
+	size.width  = physical(tex, tex->desc.width,  level);
+	size.height = physical(tex, tex->desc.height, level);
+	size.depthOrArrayLayers = 1;
+	size_t bytes = levelBytes(tex, level);
+	wgpuQueueWriteTexture(queue, &dst, data, bytes, &layout, &size);
+	stats.uploaded += bytes;
+}
+
+/**
+ * Reallocates the GPU texture to hold levels \a base onwards, copying across
+ * the levels both have (via \a encoder, created on first use). The old
+ * texture and view are released (WebGPU keeping them alive for the copies).
+ */
+static void reallocate(stream::TextureImpl* tex, unsigned base, WGPUCommandEncoder& encoder) {
+	WGPUTextureDescriptor desc = {};
+	desc.label = tex->desc.label;
+	desc.usage = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst | WGPUTextureUsage_CopySrc;
+	desc.dimension = WGPUTextureDimension_2D;
+	desc.size.width  = extent(tex->desc.width,  base);
+	desc.size.height = extent(tex->desc.height, base);
+	desc.size.depthOrArrayLayers = 1;
+	desc.format = tex->desc.format;
+	desc.mipLevelCount = tex->desc.levels - base;
+	desc.sampleCount   = 1;
+	WGPUTexture texture = wgpuDeviceCreateTexture(device, &desc);
+	if (tex->texture) {
+		if (!encoder) {
+			encoder = wgpuDeviceCreateCommandEncoder(device, nullptr);
+		}
+		for (unsigned n = (base > tex->base) ? base : tex->base; n < tex->desc.levels; n++) {
+			WGPUImageCopyTexture src = {};
+			src.texture  = tex->texture;
+			src.mipLevel = n - tex->base;
+			src.aspect   = WGPUTextureAspect_All;
+			WGPUImageCopyTexture dst = {};
+			dst.texture  = texture;
+			dst.mipLevel = n - base;
+			dst.aspect   = WGPUTextureAspect_All;
+			WGPUExtent3D size = {};
+			size.width  = physical(tex, tex->desc.width,  n);
+			size.height = physical(tex, tex->desc.height, n);
+			size.depthOrArrayLayers = 1;
+			wgpuCommandEncoderCopyTextureToTexture(encoder, &src, &dst, &size);
+		}
+		binding::invalidate(tex->view);
+		wgpuTextureViewRelease(tex->view);
+		wgpuTextureRelease(tex->texture);
+	}
+	size_t bytes = chainBytes(tex, base);
+	resident = resident - tex->bytes + bytes;
+	tex->texture = texture;
+	tex->view    = wgpuTextureCreateView(texture, nullptr);
+	tex->bytes   = bytes;
+	tex->base    = base;
+	tex->target  = base;
+}
+
+/**
+ * Frees a texture's GPU objects and state.
+ */
+static void drop(stream::TextureImpl* tex) {
+	if (tex->texture) {
+		binding::invalidate(tex->view);
+		wgpuTextureViewRelease(tex->view);
+		wgpuTextureRelease(tex->texture);
+		resident -= tex->bytes;
+	}
+	delete tex;
+}
+
+/**
+ * Plans dropping the least recently needed levels (not needed this update
+ * and not being loaded) until \a need more bytes fit in the budget. Only the
+ * finest planned level of each texture is a candidate, so residency stays a
+ * contiguous run of levels.
+ *
+ * \param[in,out] planned bytes resident once the planned drops are applied
+ * \return \c true if \a need fits
+ */
+static bool makeRoom(size_t need, size_t& planned) {
+	while (planned + reserved + need > budget) {
+		stream::TextureImpl* victim = nullptr;
+		for (stream::TextureImpl* tex = textures; tex; tex = tex->next) {
+			if (tex->target < tex->tail && !tex->loading && tex->used[tex->target] < frame) {
+				if (!victim || tex->used[tex->target] < victim->used[victim->target]) {
+					victim = tex;
+				}
+			}
+		}
+		if (!victim) {
+			return false;
+		}
+		planned -= levelBytes(victim, victim->target++);
+		stats.evictions++;
+	}
+	return true;
+}
+
+/**
+ * Runs a queued load (on whichever thread).
+ */
+static void read(Load& load) {
+	if (load.capacity < load.size) {
+		free(load.data);
+		load.data     = static_cast<unsigned char*>(malloc(load.size));
+		load.capacity = (load.data) ? load.size : 0;
+	}
+	load.ok = load.data && load.load && load.load(load.level, load.data, load.size, load.user);
+}
+
+#if FRAME_THREADED
+/**
+ * Loading thread entry point, reading queued levels one at a time (the
+ * reading being I/O bound, more threads wouldn't help).
+ */
+static void work() {
+	while (true) {
+		Load* load = nullptr;
+		{
+			std::unique_lock<std::mutex> hold(lock);
+			wake.wait(hold, [&load] {
+				for (unsigned n = 0; n < STREAM_MAX_LOADS; n++) {
+					if (loads[n].state == Load::QUEUED) {
+						load = &loads[n];
+						return true;
+					}
+				}
+				return !running;
+			});
+			if (!load) {
+				return;
+			}
+			load->state = Load::READING;
+		}
+		read(*load);
+		std::lock_guard<std::mutex> hold(lock);
+		load->state = Load::DONE;
+	}
+}
+#endif
+
+/**
+ * \return \c true if \a load has finished (running it now if there's no loading thread)
+ */
+static bool finished(Load& load) {
+#if FRAME_THREADED
+	std::lock_guard<std::mutex> hold(lock);
+	return load.state == Load::DONE;
+#else
+	if (load.state == Load::QUEUED) {
+		read(load);
+		load.state = Load::DONE;
+	}
+	return load.state == Load::DONE;
+#endif
+}
+
+/**
+ * Queues the next finer level of \a tex into a free slot.
+ */
+static void enqueue(Load& load, stream::TextureImpl* tex) {
+	load.tex   = tex;
+	load.load  = tex->desc.load;
+	load.user  = tex->desc.user;
+	load.level = tex->base - 1;
+	load.size  = levelBytes(tex, load.level);
+	tex->loading = true;
+	reserved += load.size;
+#if FRAME_THREADED
+	{
+		std::lock_guard<std::mutex> hold(lock);
+		load.state = Load::QUEUED;
+	}
+	wake.notify_one();
+#else
+	load.state = Load::QUEUED;
+#endif
+}
+
+#if STREAM_CHECK
+/**
+ * Size of the test texture (a power of two, with levels finer than the tail
+ * to stream).
+ */
+static const uint32_t CHECK_SIZE = 256;
+
+/**
+ * Row pitch of every level in the readback buffer (copies needing 256 byte
+ * aligned rows, which also fits the widest level).
+ */
+static const uint32_t CHECK_PITCH = CHECK_SIZE * 4;
+
+/**
+ * Most updates waited for the test texture to reach a residency.
+ */
+static const unsigned CHECK_UPDATES = 1000;
+
+/**
+ * Test texture readback awaiting mapping.
+ */
+struct Check {
+	FILE* out;
+	WGPUBuffer readback;
+	uint32_t levels;
+	uint64_t size; ///< Bytes of readback
+};
+
+/**
+ * \return the test texel at \a x, \a y in \a level (tagged with the level, so
+ * a level copied to the wrong place shows up)
+ */
+static uint32_t checkTexel(unsigned level, uint32_t x, uint32_t y) {
+	return (level * 16) | (x & 0xFF) << 8 | (y & 0xFF) << 16 | 0xFF000000;
+}
+
+/**
+ * Test texture loader (adheres to \c stream#Loader).
+ */
+static bool checkLoad(unsigned level, void* dst, size_t size, void* /*user*/) {
+	uint32_t dim = extent(CHECK_SIZE, level);
+	if (size != dim * dim * 4) {
+		return false;
+	}
+	uint8_t* out = static_cast<uint8_t*>(dst);
+	for (uint32_t y = 0; y < dim; y++) {
+		for (uint32_t x = 0; x < dim; x++, out += 4) {
+			uint32_t texel = checkTexel(level, x, y);
+			memcpy(out, &texel, 4);
+		}
+	}
+	return true;
+}
+
+/**
+ * \return offset of \a level in the readback
+ */
+static uint64_t checkOffset(uint32_t level) {
+	uint64_t offset = 0;
+	for (uint32_t n = 0; n < level; n++) {
+		offset += uint64_t(CHECK_PITCH) * extent(CHECK_SIZE, n);
+	}
+	return offset;
+}
+
+/**
+ * Takes (then gives back) a bind group for \a view, leaving it cached.
+ */
+static void checkBind(WGPUBindGroupLayout layout, WGPUTextureView view) {
+	WGPUBindGroupEntry entry = {};
+	entry.binding     = 0;
+	entry.textureView = view;
+	WGPUBindGroupDescriptor desc = {};
+	desc.layout     = layout;
+	desc.entryCount = 1;
+	desc.entries    = &entry;
+	binding::release(binding::group(desc));
+}
+
+/**
+ * Runs updates (requesting \a texels each time) until \a tex has \a base as
+ * its finest resident level, binding each new view. Each new view should
+ * have dropped the group bound to the old one, leaving \a groups cached, with
+ * any more counted in \a stale.
+ *
+ * \return \c true if \a base was reached
+ */
+static bool checkReach(stream::Texture tex, unsigned base, float texels, WGPUBindGroupLayout layout, unsigned groups, unsigned& stale) {
+	for (unsigned n = 0; n < CHECK_UPDATES && tex->base != base; n++) {
+		WGPUTextureView view = tex->view;
+		stream::request(tex, texels);
+		stream::update();
+		if (tex->view != view) {
+			if (binding::stats().groups != groups) {
+				stale++;
+			}
+			checkBind(layout, tex->view);
+		}
+	#if FRAME_THREADED
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	#endif
+	}
+	return tex->base == base;
+}
+
+/**
+ * Readback complete callback (adheres to \c WGPUBufferMapCallback).
+ */
+static void onChecked(WGPUBufferMapAsyncStatus status, void* user) {
+	Check* check = static_cast<Check*>(user);
+	const uint8_t* data = nullptr;
+	if (status == WGPUBufferMapAsyncStatus_Success) {
+		data = static_cast<const uint8_t*>(wgpuBufferGetConstMappedRange(check->readback, 0, static_cast<size_t>(check->size)));
+	}
+	if (data) {
+		unsigned wrong = 0;
+		unsigned worst = 0;
+		for (uint32_t n = 0; n < check->levels; n++) {
+			uint32_t dim = extent(CHECK_SIZE, n);
+			const uint8_t* row = data + checkOffset(n);
+			for (uint32_t y = 0; y < dim; y++, row += CHECK_PITCH) {
+				for (uint32_t x = 0; x < dim; x++) {
+					uint32_t texel;
+					memcpy(&texel, row + x * 4, 4);
+					if (texel != checkTexel(n, x, y)) {
+						if (wrong++ == 0) {
+							worst = n;
+						}
+					}
+				}
+			}
+		}
+		if (wrong == 0) {
+			fprintf(check->out, "stream: contents ok\n");
+		} else {
+			fprintf(check->out, "stream: contents FAILED (%u texels differ, first at level %u)\n", wrong, worst);
+		}
+	} else {
+		fprintf(check->out, "stream: readback FAILED\n");
+	}
+	if (status == WGPUBufferMapAsyncStatus_Success) {
+		wgpuBufferUnmap(check->readback);
+	}
+	wgpuBufferRelease(check->readback);
+	delete check;
+}
+#endif
+}
+
+//******************************** Public API ********************************/
+
+void stream::init(WGPUDevice device, size_t budget) {
+	destroy();
+	impl::device = device;
+	impl::queue  = wgpuDeviceGetQueue(device);
+	impl::budget = (budget) ? budget : static_cast<size_t>(STREAM_BUDGET_MB) * 1024 * 1024;
+#if FRAME_THREADED
+	impl::running = true;
+	impl::loader  = std::thread(impl::work);
+#endif
+}
+
+void stream::destroy() {
+#if FRAME_THREADED
+	if (impl::loader.joinable()) {
+		{
+			std::lock_guard<std::mutex> hold(impl::lock);
+			impl::running = false;
+		}
+		impl::wake.notify_all();
+		impl::loader.join();
+	}
+#endif
+	for (unsigned n = 0; n < STREAM_MAX_LOADS; n++) {
+		impl::Load& load = impl::loads[n];
+		if (load.state != impl::Load::FREE && load.tex->dead) {
+			impl::drop(load.tex);
+		}
+		free(load.data);
+		load = impl::Load();
+	}
+	while (impl::textures) {
+		TextureImpl* next = impl::textures->next;
+		impl::drop(impl::textures);
+		impl::textures = next;
+	}
+	if (impl::queue) {
+		wgpuQueueRelease(impl::queue);
+		impl::queue = nullptr;
+	}
+	impl::resident = 0;
+	impl::reserved = 0;
+}
+
+stream::Texture stream::create(const TextureDesc& desc) {
+	unsigned block, blockBytes;
+	if (!impl::device || !impl::footprint(desc.format, block, blockBytes) || desc.width % block || desc.height % block) {
+		return nullptr;
+	}
+	TextureImpl* tex = new TextureImpl();
+	tex->desc = desc;
+	tex->block      = block;
+	tex->blockBytes = blockBytes;
+	uint32_t longest = (desc.width > desc.height) ? desc.width : desc.height;
+	unsigned chain = 1;
+	while (chain < impl::MAX_LEVELS && (longest >> chain)) {
+		chain++;
+	}
+	if (tex->desc.levels == 0 || tex->desc.levels > chain) {
+		tex->desc.levels = chain;
+	}
+	/*
+	 * The tail starts at the first level within the tail size, or earlier if
+	 * a compressed level no longer divides into blocks (WebGPU needing the
+	 * reallocated texture's size to be whole blocks).
+	 */
+	tex->tail = tex->desc.levels - 1;
+	for (unsigned n = 1; n < tex->desc.levels; n++) {
+		if (impl::extent(desc.width, n) % block || impl::extent(desc.height, n) % block) {
+			tex->tail = n - 1;
+			break;
+		}
+		if (impl::extent(longest, n) <= STREAM_TAIL_SIZE) {
+			tex->tail = n;
+			break;
+		}
+	}
+	tex->base   = tex->desc.levels;
+	tex->target = tex->desc.levels;
+	tex->want   = tex->tail;
+	WGPUCommandEncoder encoder = nullptr;
+	impl::reallocate(tex, tex->tail, encoder);
+	/*
+	 * The tail is small, so it's read here and now rather than queued.
+	 */
+	size_t size = impl::levelBytes(tex, tex->tail);
+	if (void* data = malloc(size)) {
+		for (unsigned n = tex->tail; n < tex->desc.levels; n++) {
+			if (desc.load && desc.load(n, data, impl::levelBytes(tex, n), desc.user)) {
+				impl::upload(tex, n, data);
+				impl::stats.loads++;
+			} else {
+				impl::stats.failures++;
+			}
+		}
+		free(data);
+	}
+	tex->next = impl::textures;
+	impl::textures = tex;
+	impl::stats.textures++;
+	return tex;
+}
+
+void stream::release(Texture tex) {
+	for (TextureImpl** link = &impl::textures; *link; link = &(*link)->next) {
+		if (*link == tex) {
+			*link = tex->next;
+			break;
+		}
+	}
+	impl::stats.textures--;
+	if (tex->loading) {
+		tex->dead = true;
+	} else {
+		impl::drop(tex);
+	}
+}
+
+void stream::request(Texture tex, float texels) {
+	unsigned level = tex->tail;
+	if (texels > 0.0f) {
+		uint32_t longest = (tex->desc.width > tex->desc.height) ? tex->desc.width : tex->desc.height;
+		float lod = log2f(static_cast<float>(longest) / texels) + STREAM_LOD_BIAS;
+		if (lod < static_cast<float>(tex->tail)) {
+			level = (lod > 0.0f) ? static_cast<unsigned>(lod) : 0;
+		}
+	}
+	if (level < tex->want) {
+		tex->want = level;
+	}
+}
+
+void stream::update() {
+	profile::Zone zone("stream");
+	impl::frame++;
+	for (TextureImpl* tex = impl::textures; tex; tex = tex->next) {
+		for (unsigned n = tex->want; n <= tex->tail; n++) {
+			tex->used[n] = impl::frame;
+		}
+		tex->want = tex->tail;
+	}
+	/*
+	 * Finished loads are uploaded first, up to the per-frame limit (the rest
+	 * waiting in their slots), by growing the texture a level. A load no
+	 * longer adjoining the resident levels (the texture having shrunk since)
+	 * is thrown away.
+	 */
+	WGPUCommandEncoder encoder = nullptr;
+	size_t uploaded = 0;
+	for (unsigned n = 0; n < STREAM_MAX_LOADS; n++) {
+		impl::Load& load = impl::loads[n];
+		if (load.state == impl::Load::FREE || !impl::finished(load)) {
+			continue;
+		}
+		if (uploaded && uploaded + load.size > STREAM_UPLOAD_BYTES) {
+			continue;
+		}
+		TextureImpl* tex = load.tex;
+		impl::reserved -= load.size;
+		tex->loading = false;
+		if (tex->dead) {
+			impl::drop(tex);
+		} else if (!load.ok) {
+			impl::stats.failures++;
+		} else if (load.level + 1 == tex->base) {
+			impl::reallocate(tex, load.level, encoder);
+			impl::upload(tex, load.level, load.data);
+			impl::stats.loads++;
+			uploaded += load.size;
+		}
+		load.state = impl::Load::FREE;
+		load.tex   = nullptr;
+	}
+	/*
+	 * Levels are then dropped until back within the budget, and the next
+	 * finer level queued for each texture wanting more (if it fits, dropping
+	 * levels no longer needed to make room).
+	 */
+	size_t planned = impl::resident;
+	impl::makeRoom(0, planned);
+	unsigned slot = 0;
+	for (TextureImpl* tex = impl::textures; tex; tex = tex->next) {
+		if (tex->loading || tex->target != tex->base || tex->base == 0 || tex->used[tex->base - 1] != impl::frame) {
+			continue;
+		}
+		while (slot < STREAM_MAX_LOADS && impl::loads[slot].state != impl::Load::FREE) {
+			slot++;
+		}
+		if (slot == STREAM_MAX_LOADS) {
+			break;
+		}
+		if (impl::makeRoom(impl::levelBytes(tex, tex->base - 1), planned)) {
+			impl::enqueue(impl::loads[slot], tex);
+		}
+	}
+	for (TextureImpl* tex = impl::textures; tex; tex = tex->next) {
+		if (tex->target != tex->base) {
+			impl::reallocate(tex, tex->target, encoder);
+		}
+	}
+	if (encoder) {
+		WGPUCommandBuffer commands = wgpuCommandEncoderFinish(encoder, nullptr);
+		wgpuCommandEncoderRelease(encoder);
+		wgpuQueueSubmit(impl::queue, 1, &commands);
+		wgpuCommandBufferRelease(commands);
+	}
+}
+
+WGPUTextureView stream::view(Texture tex) {
+	return tex->view;
+}
+
+unsigned stream::resident(Texture tex) {
+	return tex->base;
+}
+
+void stream::budget(size_t bytes) {
+	impl::budget = bytes;
+}
+
+stream::Stats stream::stats() {
+	Stats stats = impl::stats;
+	stats.resident = impl::resident;
+	stats.budget   = impl::budget;
+	return stats;
+}
+
+void stream::print(FILE* out) {
+	Stats s = stats();
+	fprintf(out, "streamed textures %u, %.1f/%.1f MB resident, %llu loads (%llu failed), %llu evictions, %.1f MB uploaded\n",
+		s.textures, s.resident / (1024.0 * 1024.0), s.budget / (1024.0 * 1024.0),
+		s.loads, s.failures, s.evictions, s.uploaded / (1024.0 * 1024.0));
+}
+
+#if STREAM_CHECK
+void stream::check(FILE* out) {
+	TextureDesc desc = {};
+	desc.label  = "stream check";
+	desc.width  = impl::CHECK_SIZE;
+	desc.height = impl::CHECK_SIZE;
+	desc.format = WGPUTextureFormat_RGBA8Unorm;
+	desc.load   = impl::checkLoad;
+	Texture tex = create(desc);
+	if (!tex) {
+		fprintf(out, "stream: create FAILED\n");
+		return;
+	}
+	WGPUBindGroupLayoutEntry layoutEntry = {};
+	layoutEntry.binding    = 0;
+	layoutEntry.visibility = WGPUShaderStage_Fragment;
+	layoutEntry.texture.sampleType    = WGPUTextureSampleType_Float;
+	layoutEntry.texture.viewDimension = WGPUTextureViewDimension_2D;
+	WGPUBindGroupLayoutDescriptor layoutDesc = {};
+	layoutDesc.entryCount = 1;
+	layoutDesc.entries    = &layoutEntry;
+	WGPUBindGroupLayout layout = binding::layout(layoutDesc);
+	unsigned groups = binding::stats().groups;
+	impl::checkBind(layout, tex->view);
+	/*
+	 * Drawn at full size every level is wanted, each arriving by growing the
+	 * texture a level (so a new view per level).
+	 */
+	Stats before = stats();
+	unsigned stale = 0;
+	unsigned tail  = tex->tail;
+	if (impl::checkReach(tex, 0, static_cast<float>(impl::CHECK_SIZE), layout, groups, stale)) {
+		fprintf(out, "stream: residency ok (%llu levels loaded)\n", stats().loads - before.loads);
+	} else {
+		fprintf(out, "stream: residency FAILED (level %u resident, wanted 0)\n", tex->base);
+	}
+	/*
+	 * Every level is read back, those from the tail having been copied over
+	 * with each reallocation.
+	 */
+	impl::Check* check = new impl::Check();
+	check->out    = out;
+	check->levels = tex->desc.levels - tex->base;
+	check->size   = impl::checkOffset(check->levels);
+	WGPUBufferDescriptor bufferDesc = {};
+	bufferDesc.label = "stream check";
+	bufferDesc.usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
+	bufferDesc.size  = check->size;
+	check->readback  = wgpuDeviceCreateBuffer(impl::device, &bufferDesc);
+	WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(impl::device, nullptr);
+	for (uint32_t n = 0; n < check->levels; n++) {
+		WGPUImageCopyTexture src = {};
+		src.texture  = tex->texture;
+		src.mipLevel = n;
+		src.aspect   = WGPUTextureAspect_All;
+		WGPUImageCopyBuffer dst = {};
+		dst.buffer = check->readback;
+		dst.layout.offset       = impl::checkOffset(n);
+		dst.layout.bytesPerRow  = impl::CHECK_PITCH;
+		dst.layout.rowsPerImage = impl::extent(impl::CHECK_SIZE, n);
+		WGPUExtent3D size = {impl::extent(impl::CHECK_SIZE, n), impl::extent(impl::CHECK_SIZE, n), 1};
+		wgpuCommandEncoderCopyTextureToBuffer(encoder, &src, &dst, &size);
+	}
+	WGPUCommandBuffer commands = wgpuCommandEncoderFinish(encoder, nullptr);
+	wgpuCommandEncoderRelease(encoder);
+	wgpuQueueSubmit(impl::queue, 1, &commands);
+	wgpuCommandBufferRelease(commands);
+	wgpuBufferMapAsync(check->readback, WGPUMapMode_Read, 0, static_cast<size_t>(check->size), impl::onChecked, check);
+	/*
+	 * Then, no longer drawn and with only room for the tail, the finer
+	 * levels are evicted.
+	 */
+	size_t saved = impl::budget;
+	impl::budget = impl::chainBytes(tex, tail);
+	before = stats();
+	if (impl::checkReach(tex, tail, 0.0f, layout, groups, stale)) {
+		fprintf(out, "stream: eviction ok (%llu levels evicted)\n", stats().evictions - before.evictions);
+	} else {
+		fprintf(out, "stream: eviction FAILED (level %u resident, wanted %u)\n", tex->base, tail);
+	}
+	impl::budget = saved;
+	if (stale == 0) {
+		fprintf(out, "stream: invalidation ok\n");
+	} else {
+		fprintf(out, "stream: invalidation FAILED (%u stale bind groups)\n", stale);
+	}
+	release(tex);
+	binding::release(layout);
+	binding::trim();
+}
+#endif
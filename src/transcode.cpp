@@ -0,0 +1,1469 @@
+#include "transcode.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jobs.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRANSCODE_SSE2 1
+#else
+#define TRANSCODE_SSE2 0
+#endif
+
+//****************************************************************************/
+
+namespace impl {
+/**
+ * Texels in a 4x4 block.
+ */
+static const unsigned TEXELS = 16;
+
+/**
+ * Shortest LZ match.
+ */
+static const unsigned MIN_MATCH = 4;
+
+/**
+ * LZ match finder hash table size (a power of two).
+ */
+static const unsigned HASH_SIZE = 4096;
+
+/**
+ * \return \a val clamped to a byte
+ */
+static inline uint8_t clamp8(int val) {
+	return static_cast<uint8_t>((val < 0) ? 0 : ((val > 255) ? 255 : val));
+}
+
+/**
+ * \return \a dim at \a level (never less than one)
+ */
+static uint32_t extent(uint32_t dim, unsigned level) {
+	dim >>= level;
+	return (dim) ? dim : 1;
+}
+
+//************************************ LZ ************************************/
+
+/*
+ * Levels are packed as LZ4 style sequences: a token (literal count in the
+ * high nibble, match length less the minimum in the low, each extended with
+ * 255 bytes when 15), the literals, then a two byte match offset. The last
+ * sequence has only literals.
+ */
+
+static uint8_t* putLength(uint8_t* out, size_t len) {
+	while (len >= 255) {
+		*out++ = 255;
+		len -= 255;
+	}
+	*out++ = static_cast<uint8_t>(len);
+	return out;
+}
+
+static uint8_t* putSequence(uint8_t* out, const uint8_t* lits, size_t litLen, size_t offset, size_t matchLen) {
+	uint8_t* token = out++;
+	size_t extra = (matchLen) ? matchLen - MIN_MATCH : 0;
+	*token = static_cast<uint8_t>(((litLen < 15) ? litLen : 15) << 4 | ((extra < 15) ? extra : 15));
+	if (litLen >= 15) {
+		out = putLength(out, litLen - 15);
+	}
+	memcpy(out, lits, litLen);
+	out += litLen;
+	if (matchLen) {
+		*out++ = static_cast<uint8_t>(offset);
+		*out++ = static_cast<uint8_t>(offset >> 8);
+		if (extra >= 15) {
+			out = putLength(out, extra - 15);
+		}
+	}
+	return out;
+}
+
+/**
+ * \return worst case compressed size of \a size bytes
+ */
+static size_t lzBound(size_t size) {
+	return size + size / 255 + 16;
+}
+
+/**
+ * Compresses \a size bytes of \a src (\a dst being at least \c #lzBound()).
+ *
+ * \return compressed size
+ */
+static size_t compress(const uint8_t* src, size_t size, uint8_t* dst) {
+	uint32_t table[HASH_SIZE];
+	memset(table, 0xFF, sizeof table);
+	uint8_t* out = dst;
+	size_t anchor = 0;
+	size_t pos = 0;
+	while (pos + MIN_MATCH <= size) {
+		uint32_t seq;
+		memcpy(&seq, src + pos, sizeof seq);
+		uint32_t slot = (seq * 2654435761U) >> 20 & (HASH_SIZE - 1);
+		size_t cand = table[slot];
+		table[slot] = static_cast<uint32_t>(pos);
+		if (cand < pos && pos - cand <= 0xFFFF && memcmp(src + cand, src + pos, MIN_MATCH) == 0) {
+			size_t len = MIN_MATCH;
+			while (pos + len < size && src[cand + len] == src[pos + len]) {
+				len++;
+			}
+			out = putSequence(out, src + anchor, pos - anchor, pos - cand, len);
+			pos += len;
+			anchor = pos;
+		} else {
+			pos++;
+		}
+	}
+	out = putSequence(out, src + anchor, size - anchor, 0, 0);
+	return static_cast<size_t>(out - dst);
+}
+
+/**
+ * Reads an extended length.
+ *
+ * \return \c false if the input ran out
+ */
+static bool getLength(const uint8_t*& in, const uint8_t* end, size_t& len) {
+	uint8_t byte;
+	do {
+		if (in == end) {
+			return false;
+		}
+		byte = *in++;
+		len += byte;
+	} while (byte == 255);
+	return true;
+}
+
+/**
+ * Decompresses exactly \a size bytes into \a dst.
+ *
+ * \return \c false if the input is corrupt
+ */
+static bool decompress(const uint8_t* in, size_t packed, uint8_t* dst, size_t size) {
+	const uint8_t* end = in + packed;
+	size_t pos = 0;
+	while (in < end) {
+		uint8_t token = *in++;
+		size_t lits = token >> 4;
+		if (lits == 15 && !getLength(in, end, lits)) {
+			return false;
+		}
+		if (lits > static_cast<size_t>(end - in) || lits > size - pos) {
+			return false;
+		}
+		memcpy(dst + pos, in, lits);
+		in  += lits;
+		pos += lits;
+		if (in == end) {
+			break;
+		}
+		if (end - in < 2) {
+			return false;
+		}
+		size_t offset = in[0] | in[1] << 8;
+		in += 2;
+		size_t len = (token & 15);
+		if (len == 15 && !getLength(in, end, len)) {
+			return false;
+		}
+		len += MIN_MATCH;
+		if (offset == 0 || offset > pos || len > size - pos) {
+			return false;
+		}
+		for (size_t n = 0; n < len; n++, pos++) {
+			dst[pos] = dst[pos - offset]; // overlapping copies repeat
+		}
+	}
+	return pos == size;
+}
+
+//*********************************** Blocks **********************************/
+
+/**
+ * Gathers the 4x4 block at \a bx, \a by (in blocks), repeating the last row
+ * and column past the edges.
+ */
+static void gather(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, uint8_t block[TEXELS * 4]) {
+	for (uint32_t y = 0; y < 4; y++) {
+		uint32_t sy = by * 4 + y;
+		if (sy >= height) {
+			sy = height - 1;
+		}
+		for (uint32_t x = 0; x < 4; x++) {
+			uint32_t sx = bx * 4 + x;
+			if (sx >= width) {
+				sx = width - 1;
+			}
+			memcpy(block + (y * 4 + x) * 4, rgba + (static_cast<size_t>(sy) * width + sx) * 4, 4);
+		}
+	}
+}
+
+/**
+ * Finds the per-channel minimum and maximum of a block.
+ */
+static void bounds(const uint8_t block[TEXELS * 4], uint8_t lo[4], uint8_t hi[4]) {
+#if TRANSCODE_SSE2
+	const __m128i* px = reinterpret_cast<const __m128i*>(block);
+	__m128i mn = _mm_loadu_si128(px);
+	__m128i mx = mn;
+	for (unsigned n = 1; n < 4; n++) {
+		__m128i v = _mm_loadu_si128(px + n);
+		mn = _mm_min_epu8(mn, v);
+		mx = _mm_max_epu8(mx, v);
+	}
+	mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 8));
+	mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 4));
+	mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 8));
+	mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 4));
+	uint32_t l = static_cast<uint32_t>(_mm_cvtsi128_si32(mn));
+	uint32_t h = static_cast<uint32_t>(_mm_cvtsi128_si32(mx));
+	memcpy(lo, &l, 4);
+	memcpy(hi, &h, 4);
+#else
+	memcpy(lo, block, 4);
+	memcpy(hi, block, 4);
+	for (unsigned n = 1; n < TEXELS; n++) {
+		for (unsigned c = 0; c < 4; c++) {
+			uint8_t v = block[n * 4 + c];
+			lo[c] = (v < lo[c]) ? v : lo[c];
+			hi[c] = (v > hi[c]) ? v : hi[c];
+		}
+	}
+#endif
+}
+
+/**
+ * Dot product of each texel with \a axis (whose components must fit in 16
+ * bits).
+ */
+static void project(const uint8_t block[TEXELS * 4], const int axis[4], int dots[TEXELS]) {
+#if TRANSCODE_SSE2
+	const __m128i* px = reinterpret_cast<const __m128i*>(block);
+	__m128i zero = _mm_setzero_si128();
+	__m128i weights = _mm_setr_epi16(
+		static_cast<short>(axis[0]), static_cast<short>(axis[1]), static_cast<short>(axis[2]), static_cast<short>(axis[3]),
+		static_cast<short>(axis[0]), static_cast<short>(axis[1]), static_cast<short>(axis[2]), static_cast<short>(axis[3]));
+	for (unsigned n = 0; n < 4; n++) {
+		__m128i v  = _mm_loadu_si128(px + n);
+		__m128i dl = _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), weights); // texels 0-1 as (rg, ba) pairs
+		__m128i dh = _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), weights); // texels 2-3
+		__m128 fl = _mm_castsi128_ps(dl);
+		__m128 fh = _mm_castsi128_ps(dh);
+		__m128i rg = _mm_castps_si128(_mm_shuffle_ps(fl, fh, _MM_SHUFFLE(2, 0, 2, 0)));
+		__m128i ba = _mm_castps_si128(_mm_shuffle_ps(fl, fh, _MM_SHUFFLE(3, 1, 3, 1)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dots + n * 4), _mm_add_epi32(rg, ba));
+	}
+#else
+	for (unsigned n = 0; n < TEXELS; n++) {
+		const uint8_t* p = block + n * 4;
+		dots[n] = p[0] * axis[0] + p[1] * axis[1] + p[2] * axis[2] + p[3] * axis[3];
+	}
+#endif
+}
+
+/**
+ * Fits a line through a block's texels, picking as endpoints the two texels
+ * at either end of the principal axis (found by power iteration on the
+ * covariance, seeded with the bounding box diagonal).
+ *
+ * \param[in] channels three to ignore alpha, otherwise four
+ */
+static void fit(const uint8_t block[TEXELS * 4], unsigned channels, uint8_t e0[4], uint8_t e1[4]) {
+	uint8_t lo[4], hi[4];
+	bounds(block, lo, hi);
+	float mean[4] = {};
+	for (unsigned n = 0; n < TEXELS; n++) {
+		for (unsigned c = 0; c < channels; c++) {
+			mean[c] += block[n * 4 + c];
+		}
+	}
+	float cov[4][4] = {};
+	for (unsigned c = 0; c < channels; c++) {
+		mean[c] /= TEXELS;
+	}
+	for (unsigned n = 0; n < TEXELS; n++) {
+		float d[4] = {};
+		for (unsigned c = 0; c < channels; c++) {
+			d[c] = block[n * 4 + c] - mean[c];
+		}
+		for (unsigned i = 0; i < channels; i++) {
+			for (unsigned j = 0; j < channels; j++) {
+				cov[i][j] += d[i] * d[j];
+			}
+		}
+	}
+	float dir[4] = {};
+	for (unsigned c = 0; c < channels; c++) {
+		dir[c] = static_cast<float>(hi[c] - lo[c]);
+	}
+	for (unsigned iter = 0; iter < 4; iter++) {
+		float next[4] = {};
+		float len = 0.0f;
+		for (unsigned i = 0; i < channels; i++) {
+			for (unsigned j = 0; j < channels; j++) {
+				next[i] += cov[i][j] * dir[j];
+			}
+			len = (fabsf(next[i]) > len) ? fabsf(next[i]) : len;
+		}
+		if (len == 0.0f) {
+			break;
+		}
+		for (unsigned c = 0; c < channels; c++) {
+			dir[c] = next[c] / len;
+		}
+	}
+	float len = 0.0f;
+	for (unsigned c = 0; c < channels; c++) {
+		len = (fabsf(dir[c]) > len) ? fabsf(dir[c]) : len;
+	}
+	int axis[4] = {};
+	for (unsigned c = 0; c < channels; c++) {
+		axis[c] = (len > 0.0f) ? static_cast<int>(dir[c] / len * 1024.0f) : 0;
+	}
+	int dots[TEXELS];
+	project(block, axis, dots);
+	unsigned lowest = 0, highest = 0;
+	for (unsigned n = 1; n < TEXELS; n++) {
+		lowest  = (dots[n] < dots[lowest])  ? n : lowest;
+		highest = (dots[n] > dots[highest]) ? n : highest;
+	}
+	memcpy(e0, block + lowest  * 4, 4);
+	memcpy(e1, block + highest * 4, 4);
+	if (channels == 3) {
+		e0[3] = e1[3] = 255;
+	}
+}
+
+/**
+ * Places each texel on the line from \a e0 to \a e1, as one of \a steps
+ * evenly spaced steps (zero being \a e0).
+ */
+static void place(const uint8_t block[TEXELS * 4], unsigned channels, const uint8_t e0[4], const uint8_t e1[4], unsigned steps, uint8_t out[TEXELS]) {
+	int axis[4] = {};
+	int span = 0;
+	for (unsigned c = 0; c < channels; c++) {
+		axis[c] = e1[c] - e0[c];
+		span += axis[c] * axis[c];
+	}
+	if (span == 0) {
+		memset(out, 0, TEXELS);
+		return;
+	}
+	int base = 0;
+	for (unsigned c = 0; c < channels; c++) {
+		base += e0[c] * axis[c];
+	}
+	int dots[TEXELS];
+	project(block, axis, dots);
+	int last = static_cast<int>(steps) - 1;
+	for (unsigned n = 0; n < TEXELS; n++) {
+		int step = static_cast<int>(((dots[n] - base) * static_cast<int64_t>(last) * 2 + span) / (span * 2));
+		out[n] = static_cast<uint8_t>((step < 0) ? 0 : ((step > last) ? last : step));
+	}
+}
+
+/**
+ * Writes \a bits of \a value at bit \a pos of a little-endian block.
+ */
+static void put(uint8_t* block, unsigned& pos, uint32_t value, unsigned bits) {
+	for (unsigned n = 0; n < bits; n++, pos++) {
+		if (value >> n & 1) {
+			block[pos >> 3] |= static_cast<uint8_t>(1 << (pos & 7));
+		}
+	}
+}
+
+//************************************ BCn ************************************/
+
+static uint16_t to565(const uint8_t c[4]) {
+	return static_cast<uint16_t>((c[0] * 31 + 127) / 255 << 11 | (c[1] * 63 + 127) / 255 << 5 | (c[2] * 31 + 127) / 255);
+}
+
+static void from565(uint16_t v, uint8_t c[4]) {
+	unsigned r = v >> 11 & 31, g = v >> 5 & 63, b = v & 31;
+	c[0] = static_cast<uint8_t>(r << 3 | r >> 2);
+	c[1] = static_cast<uint8_t>(g << 2 | g >> 4);
+	c[2] = static_cast<uint8_t>(b << 3 | b >> 2);
+	c[3] = 255;
+}
+
+/**
+ * BC1 colour block, always in four colour mode (so also usable in BC3).
+ */
+static void bc1(const uint8_t block[TEXELS * 4], uint8_t out[8]) {
+	uint8_t e0[4], e1[4];
+	fit(block, 3, e0, e1);
+	uint16_t c0 = to565(e1);
+	uint16_t c1 = to565(e0);
+	uint32_t indices = 0;
+	if (c0 != c1) {
+		if (c0 < c1) {
+			uint16_t swap = c0;
+			c0 = c1;
+			c1 = swap;
+		}
+		/*
+		 * Steps are placed between the quantised endpoints, then mapped to
+		 * BC1's palette order (c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1).
+		 */
+		static const uint8_t order[4] = {0, 2, 3, 1};
+		uint8_t q0[4], q1[4], steps[TEXELS];
+		from565(c0, q0);
+		from565(c1, q1);
+		place(block, 3, q0, q1, 4, steps);
+		for (unsigned n = 0; n < TEXELS; n++) {
+			indices |= static_cast<uint32_t>(order[steps[n]]) << (n * 2);
+		}
+	}
+	out[0] = static_cast<uint8_t>(c0);
+	out[1] = static_cast<uint8_t>(c0 >> 8);
+	out[2] = static_cast<uint8_t>(c1);
+	out[3] = static_cast<uint8_t>(c1 >> 8);
+	memcpy(out + 4, &indices, 4);
+}
+
+/**
+ * BC4 style alpha block (as used by BC3), in eight value mode.
+ */
+static void bc4(const uint8_t block[TEXELS * 4], uint8_t out[8]) {
+	uint8_t a0 = 0, a1 = 255;
+	for (unsigned n = 0; n < TEXELS; n++) {
+		uint8_t a = block[n * 4 + 3];
+		a0 = (a > a0) ? a : a0;
+		a1 = (a < a1) ? a : a1;
+	}
+	memset(out, 0, 8);
+	out[0] = a0;
+	out[1] = a1;
+	if (a0 == a1) {
+		return;
+	}
+	uint64_t indices = 0;
+	int range = a0 - a1;
+	for (unsigned n = 0; n < TEXELS; n++) {
+		int step = ((a0 - block[n * 4 + 3]) * 14 + range) / (range * 2); // 0 is a0, 7 is a1
+		unsigned index = (step == 0) ? 0 : ((step == 7) ? 1 : step + 1);
+		indices |= static_cast<uint64_t>(index) << (n * 3);
+	}
+	for (unsigned n = 0; n < 6; n++) {
+		out[2 + n] = static_cast<uint8_t>(indices >> (n * 8));
+	}
+}
+
+static void bc3(const uint8_t block[TEXELS * 4], uint8_t out[16]) {
+	bc4(block, out);
+	bc1(block, out + 8);
+}
+
+/**
+ * BC7 mode 6 (one subset, 7-bit RGBA endpoints each with a p-bit, and 4-bit
+ * indices).
+ */
+static void bc7(const uint8_t block[TEXELS * 4], uint8_t out[16]) {
+	uint8_t e[2][4];
+	fit(block, 4, e[0], e[1]);
+	/*
+	 * Each endpoint is quantised with whichever p-bit is closer overall.
+	 */
+	uint8_t q[2][4];
+	unsigned pbit[2];
+	for (unsigned i = 0; i < 2; i++) {
+		int best = -1;
+		for (unsigned p = 0; p < 2; p++) {
+			uint8_t trial[4];
+			int err = 0;
+			for (unsigned c = 0; c < 4; c++) {
+				int v = (e[i][c] - static_cast<int>(p) + 1) >> 1;
+				v = (v < 0) ? 0 : ((v > 127) ? 127 : v);
+				trial[c] = static_cast<uint8_t>(v);
+				int d = (v << 1 | static_cast<int>(p)) - e[i][c];
+				err += d * d;
+			}
+			if (best < 0 || err < best) {
+				best = err;
+				pbit[i] = p;
+				memcpy(q[i], trial, 4);
+			}
+		}
+	}
+	uint8_t d0[4], d1[4], steps[TEXELS];
+	for (unsigned c = 0; c < 4; c++) {
+		d0[c] = static_cast<uint8_t>(q[0][c] << 1 | pbit[0]);
+		d1[c] = static_cast<uint8_t>(q[1][c] << 1 | pbit[1]);
+	}
+	place(block, 4, d0, d1, 16, steps);
+	/*
+	 * The first index's top bit is implied zero, so the endpoints swap if
+	 * it's set.
+	 */
+	unsigned lo = 0;
+	if (steps[0] & 8) {
+		lo = 1;
+		for (unsigned n = 0; n < TEXELS; n++) {
+			steps[n] = static_cast<uint8_t>(15 - steps[n]);
+		}
+	}
+	memset(out, 0, 16);
+	unsigned pos = 0;
+	put(out, pos, 1 << 6, 7);
+	for (unsigned c = 0; c < 4; c++) {
+		put(out, pos, q[lo][c], 7);
+		put(out, pos, q[lo ^ 1][c], 7);
+	}
+	put(out, pos, pbit[lo], 1);
+	put(out, pos, pbit[lo ^ 1], 1);
+	put(out, pos, steps[0], 3);
+	for (unsigned n = 1; n < TEXELS; n++) {
+		put(out, pos, steps[n], 4);
+	}
+}
+
+//************************************ ETC2 ***********************************/
+
+/**
+ * ETC1/ETC2 intensity modifier tables (the small and large modifier of each).
+ */
+static const int ETC_MODIFIERS[8][2] = {
+	{ 2,   8}, { 5,  17}, { 9,  29}, {13,  42},
+	{18,  60}, {24,  80}, {33, 106}, {47, 183},
+};
+
+/**
+ * EAC alpha modifier tables.
+ */
+static const int EAC_MODIFIERS[16][8] = {
+	{-3, -6,  -9, -15, 2, 5, 8, 14},
+	{-3, -7, -10, -13, 2, 6, 9, 12},
+	{-2, -5,  -8, -13, 1, 4, 7, 12},
+	{-2, -4,  -6, -13, 1, 3, 5, 12},
+	{-3, -6,  -8, -12, 2, 5, 7, 11},
+	{-3, -7,  -9, -11, 2, 6, 8, 10},
+	{-4, -7,  -8, -11, 3, 6, 7, 10},
+	{-3, -5,  -8, -11, 2, 4, 7, 10},
+	{-2, -6,  -8, -10, 1, 5, 7,  9},
+	{-2, -5,  -8, -10, 1, 4, 7,  9},
+	{-2, -4,  -8, -10, 1, 3, 7,  9},
+	{-2, -5,  -7, -10, 1, 4, 6,  9},
+	{-3, -4,  -7, -10, 2, 3, 6,  9},
+	{-1, -2,  -3, -10, 0, 1, 2,  9},
+	{-4, -6,  -8,  -9, 3, 5, 7,  8},
+	{-3, -5,  -7,  -9, 2, 4, 6,  8},
+};
+
+/**
+ * \return index of texel \a x, \a y in ETC's column-major order
+ */
+static inline unsigned etcIndex(unsigned x, unsigned y) {
+	return x * 4 + y;
+}
+
+/**
+ * Picks the modifier table and per-texel modifiers for one half of a block.
+ *
+ * \param[in] flip \c true for horizontal halves (otherwise vertical)
+ * \param[in] half which half
+ * \param[in] base expanded base colour
+ * \param[out] table chosen table
+ * \param[in,out] msb, lsb texel index bits
+ * \return squared error
+ */
+static int etcHalf(const uint8_t block[TEXELS * 4], bool flip, unsigned half, const int base[3], unsigned& table, uint32_t& msb, uint32_t& lsb) {
+	int best = -1;
+	for (unsigned t = 0; t < 8; t++) {
+		int mods[4] = {ETC_MODIFIERS[t][0], ETC_MODIFIERS[t][1], -ETC_MODIFIERS[t][0], -ETC_MODIFIERS[t][1]};
+		int err = 0;
+		uint32_t m = 0, l = 0;
+		for (unsigned i = 0; i < 8; i++) {
+			unsigned x = (flip) ? i & 3 : half * 2 + (i & 1);
+			unsigned y = (flip) ? half * 2 + (i >> 2) : i >> 1;
+			const uint8_t* p = block + (y * 4 + x) * 4;
+			int pick = 0, pickErr = -1;
+			for (unsigned s = 0; s < 4; s++) {
+				int e = 0;
+				for (unsigned c = 0; c < 3; c++) {
+					int d = clamp8(base[c] + mods[s]) - p[c];
+					e += d * d;
+				}
+				if (pickErr < 0 || e < pickErr) {
+					pickErr = e;
+					pick = static_cast<int>(s);
+				}
+			}
+			err += pickErr;
+			unsigned bit = etcIndex(x, y);
+			m |= static_cast<uint32_t>(pick >> 1) << bit;
+			l |= static_cast<uint32_t>(pick &  1) << bit;
+			if (best >= 0 && err >= best) {
+				break;
+			}
+		}
+		if (best < 0 || err < best) {
+			best  = err;
+			table = t;
+			uint32_t mask = 0;
+			for (unsigned i = 0; i < 8; i++) {
+				unsigned x = (flip) ? i & 3 : half * 2 + (i & 1);
+				unsigned y = (flip) ? half * 2 + (i >> 2) : i >> 1;
+				mask |= 1U << etcIndex(x, y);
+			}
+			msb = (msb & ~mask) | m;
+			lsb = (lsb & ~mask) | l;
+		}
+	}
+	return best;
+}
+
+/**
+ * ETC2 RGB block, using ETC1's individual and differential modes (which are
+ * valid ETC2), trying both orientations.
+ */
+static void etc2(const uint8_t block[TEXELS * 4], uint8_t out[8]) {
+	uint64_t bestBits = 0;
+	int bestErr = -1;
+	for (unsigned flip = 0; flip < 2; flip++) {
+		int avg[2][3] = {};
+		for (unsigned half = 0; half < 2; half++) {
+			for (unsigned i = 0; i < 8; i++) {
+				unsigned x = (flip) ? i & 3 : half * 2 + (i & 1);
+				unsigned y = (flip) ? half * 2 + (i >> 2) : i >> 1;
+				for (unsigned c = 0; c < 3; c++) {
+					avg[half][c] += block[(y * 4 + x) * 4 + c];
+				}
+			}
+			for (unsigned c = 0; c < 3; c++) {
+				avg[half][c] = (avg[half][c] + 4) / 8;
+			}
+		}
+		/*
+		 * Differential mode (5-bit bases, the second within -4 to 3 of the
+		 * first) if the halves are close enough, otherwise individual mode
+		 * (two 4-bit bases).
+		 */
+		int q[2][3], base[2][3];
+		bool diff = true;
+		for (unsigned c = 0; c < 3; c++) {
+			q[0][c] = (avg[0][c] * 31 + 127) / 255;
+			q[1][c] = (avg[1][c] * 31 + 127) / 255;
+			int delta = q[1][c] - q[0][c];
+			diff = diff && delta >= -4 && delta <= 3;
+		}
+		for (unsigned h = 0; h < 2; h++) {
+			for (unsigned c = 0; c < 3; c++) {
+				if (diff) {
+					base[h][c] = q[h][c] << 3 | q[h][c] >> 2;
+				} else {
+					q[h][c] = (avg[h][c] * 15 + 127) / 255;
+					base[h][c] = q[h][c] << 4 | q[h][c];
+				}
+			}
+		}
+		unsigned table[2] = {};
+		uint32_t msb = 0, lsb = 0;
+		int err = etcHalf(block, flip != 0, 0, base[0], table[0], msb, lsb)
+				+ etcHalf(block, flip != 0, 1, base[1], table[1], msb, lsb);
+		if (bestErr >= 0 && err >= bestErr) {
+			continue;
+		}
+		bestErr = err;
+		uint64_t bits = 0;
+		for (unsigned c = 0; c < 3; c++) {
+			unsigned shift = 59 - c * 8;
+			if (diff) {
+				bits |= static_cast<uint64_t>(q[0][c]) << shift;
+				bits |= static_cast<uint64_t>((q[1][c] - q[0][c]) & 7) << (shift - 3);
+			} else {
+				bits |= static_cast<uint64_t>(q[0][c]) << (shift + 1);
+				bits |= static_cast<uint64_t>(q[1][c]) << (shift - 3);
+			}
+		}
+		bits |= static_cast<uint64_t>(table[0]) << 37;
+		bits |= static_cast<uint64_t>(table[1]) << 34;
+		bits |= static_cast<uint64_t>(diff) << 33;
+		bits |= static_cast<uint64_t>(flip) << 32;
+		bits |= static_cast<uint64_t>(msb & 0xFFFF) << 16;
+		bits |= lsb & 0xFFFF;
+		bestBits = bits;
+	}
+	for (unsigned n = 0; n < 8; n++) {
+		out[n] = static_cast<uint8_t>(bestBits >> (56 - n * 8)); // big-endian
+	}
+}
+
+/**
+ * EAC alpha block, searching every table with multipliers around the one
+ * fitting the block's range.
+ */
+static void eac(const uint8_t block[TEXELS * 4], uint8_t out[8]) {
+	int lo = 255, hi = 0;
+	for (unsigned n = 0; n < TEXELS; n++) {
+		int a = block[n * 4 + 3];
+		lo = (a < lo) ? a : lo;
+		hi = (a > hi) ? a : hi;
+	}
+	int base = (lo + hi + 1) / 2;
+	uint64_t bestBits = static_cast<uint64_t>(base) << 56 | 1ULL << 52 | 13ULL << 48 | 0x924924924924ULL; // all index 4 (modifier 0)
+	int bestErr = -1;
+	for (unsigned t = 0; t < 16 && lo != hi; t++) {
+		int spread = EAC_MODIFIERS[t][7] - EAC_MODIFIERS[t][3];
+		int guess = (hi - lo + spread / 2) / spread;
+		for (int mul = guess - 1; mul <= guess + 1; mul++) {
+			if (mul < 1 || mul > 15) {
+				continue;
+			}
+			int err = 0;
+			uint64_t indices = 0;
+			for (unsigned x = 0; x < 4; x++) {
+				for (unsigned y = 0; y < 4; y++) {
+					int a = block[(y * 4 + x) * 4 + 3];
+					int pick = 0, pickErr = -1;
+					for (unsigned s = 0; s < 8; s++) {
+						int d = clamp8(base + EAC_MODIFIERS[t][s] * mul) - a;
+						if (pickErr < 0 || d * d < pickErr) {
+							pickErr = d * d;
+							pick = static_cast<int>(s);
+						}
+					}
+					err += pickErr;
+					indices |= static_cast<uint64_t>(pick) << (45 - etcIndex(x, y) * 3);
+				}
+			}
+			if (bestErr < 0 || err < bestErr) {
+				bestErr  = err;
+				bestBits = static_cast<uint64_t>(base) << 56 | static_cast<uint64_t>(mul) << 52 | static_cast<uint64_t>(t) << 48 | indices;
+			}
+		}
+	}
+	for (unsigned n = 0; n < 8; n++) {
+		out[n] = static_cast<uint8_t>(bestBits >> (56 - n * 8));
+	}
+}
+
+static void etc2a(const uint8_t block[TEXELS * 4], uint8_t out[16]) {
+	eac (block, out);
+	etc2(block, out + 8);
+}
+
+//************************************ ASTC ***********************************/
+
+/**
+ * ASTC 4x4 block: one partition, LDR RGBA direct endpoints (CEM 12) at 8 bits
+ * and a 4x4 grid of 2-bit weights. Block mode 0x042 is a 4x4 grid with the
+ * weight range 0-3, which leaves room for 256 level endpoints.
+ */
+static void astc(const uint8_t block[TEXELS * 4], uint8_t out[16]) {
+	uint8_t e0[4], e1[4], steps[TEXELS];
+	fit(block, 4, e0, e1);
+	/*
+	 * Endpoints are decoded swapped (with blue contraction) if the second's
+	 * RGB sum is the smaller, so they're stored the other way round.
+	 */
+	if (e1[0] + e1[1] + e1[2] < e0[0] + e0[1] + e0[2]) {
+		uint8_t swap[4];
+		memcpy(swap, e0, 4);
+		memcpy(e0, e1, 4);
+		memcpy(e1, swap, 4);
+	}
+	place(block, 4, e0, e1, 4, steps);
+	memset(out, 0, 16);
+	unsigned pos = 0;
+	put(out, pos, 0x042, 11); // block mode
+	put(out, pos, 0, 2);      // one partition
+	put(out, pos, 12, 4);     // CEM
+	for (unsigned c = 0; c < 4; c++) {
+		put(out, pos, e0[c], 8);
+		put(out, pos, e1[c], 8);
+	}
+	/*
+	 * Weights fill the block from the top bit down.
+	 */
+	for (unsigned n = 0; n < TEXELS; n++) {
+		for (unsigned b = 0; b < 2; b++) {
+			if (steps[n] >> b & 1) {
+				unsigned bit = 127 - (n * 2 + b);
+				out[bit >> 3] |= static_cast<uint8_t>(1 << (bit & 7));
+			}
+		}
+	}
+}
+
+//********************************** Levels ***********************************/
+
+/**
+ * Block encoder.
+ */
+typedef void (*Encoder)(const uint8_t block[TEXELS * 4], uint8_t* out);
+
+/**
+ * \return the encoder and its block size for \a format (or \c null)
+ */
+static Encoder encoder(WGPUTextureFormat format, unsigned& bytes) {
+	switch (format) {
+	case WGPUTextureFormat_BC1RGBAUnorm:
+	case WGPUTextureFormat_BC1RGBAUnormSrgb:
+		bytes = 8;
+		return bc1;
+	case WGPUTextureFormat_BC3RGBAUnorm:
+	case WGPUTextureFormat_BC3RGBAUnormSrgb:
+		bytes = 16;
+		return bc3;
+	case WGPUTextureFormat_BC7RGBAUnorm:
+	case WGPUTextureFormat_BC7RGBAUnormSrgb:
+		bytes = 16;
+		return bc7;
+	case WGPUTextureFormat_ETC2RGB8Unorm:
+	case WGPUTextureFormat_ETC2RGB8UnormSrgb:
+		bytes = 8;
+		return etc2;
+	case WGPUTextureFormat_ETC2RGBA8Unorm:
+	case WGPUTextureFormat_ETC2RGBA8UnormSrgb:
+		bytes = 16;
+		return etc2a;
+	case WGPUTextureFormat_ASTC4x4Unorm:
+	case WGPUTextureFormat_ASTC4x4UnormSrgb:
+		bytes = 16;
+		return astc;
+	default:
+		bytes = 0;
+		return nullptr;
+	}
+}
+
+/**
+ * Level being encoded (shared with the workers).
+ */
+struct Task {
+	const uint8_t* rgba;
+	uint32_t width;
+	uint32_t height;
+	uint32_t blocksX;
+	unsigned bytes;
+	Encoder func;
+	uint8_t* dst;
+};
+
+/**
+ * Encodes rows of blocks (the \c jobs#Range callback).
+ */
+static void encodeRows(size_t begin, size_t end, void* user) {
+	const Task* task = static_cast<const Task*>(user);
+	uint8_t block[TEXELS * 4];
+	for (size_t by = begin; by < end; by++) {
+		uint8_t* out = task->dst + by * task->blocksX * task->bytes;
+		for (uint32_t bx = 0; bx < task->blocksX; bx++, out += task->bytes) {
+			gather(task->rgba, task->width, task->height, bx, static_cast<uint32_t>(by), block);
+			task->func(block, out);
+		}
+	}
+}
+
+/**
+ * \return sRGB encoded \a v (0 to 1) converted to linear
+ */
+static float toLinear(float v) {
+	return (v <= 0.04045f) ? v / 12.92f : powf((v + 0.055f) / 1.055f, 2.4f);
+}
+
+/**
+ * \return linear \a v (0 to 1) converted to sRGB encoded
+ */
+static float toSrgb(float v) {
+	return (v <= 0.0031308f) ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+}
+
+/**
+ * Box filters \a src down to the next level (a single row or column halving
+ * in one direction only).
+ */
+static void downsample(const uint8_t* src, uint32_t w, uint32_t h, bool srgb, uint8_t* dst) {
+	static float linear[256];
+	if (srgb && linear[255] == 0.0f) {
+		for (unsigned n = 0; n < 256; n++) {
+			linear[n] = toLinear(n / 255.0f);
+		}
+	}
+	uint32_t dw = extent(w, 1);
+	uint32_t dh = extent(h, 1);
+	for (uint32_t y = 0; y < dh; y++) {
+		for (uint32_t x = 0; x < dw; x++) {
+			uint32_t x0 = x * 2, x1 = (x0 + 1 < w) ? x0 + 1 : x0;
+			uint32_t y0 = y * 2, y1 = (y0 + 1 < h) ? y0 + 1 : y0;
+			const uint8_t* p[4] = {
+				src + (static_cast<size_t>(y0) * w + x0) * 4, src + (static_cast<size_t>(y0) * w + x1) * 4,
+				src + (static_cast<size_t>(y1) * w + x0) * 4, src + (static_cast<size_t>(y1) * w + x1) * 4,
+			};
+			uint8_t* out = dst + (static_cast<size_t>(y) * dw + x) * 4;
+			for (unsigned c = 0; c < 4; c++) {
+				if (srgb && c < 3) {
+					float sum = linear[p[0][c]] + linear[p[1][c]] + linear[p[2][c]] + linear[p[3][c]];
+					out[c] = clamp8(static_cast<int>(toSrgb(sum * 0.25f) * 255.0f + 0.5f));
+				} else {
+					out[c] = static_cast<uint8_t>((p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) / 4);
+				}
+			}
+		}
+	}
+}
+
+#if TRANSCODE_CHECK
+//*********************************** Check ***********************************/
+
+/**
+ * Block decoder, for the modes the encoders emit.
+ *
+ * \return \c false if the block uses any other mode
+ */
+typedef bool (*Decoder)(const uint8_t* in, uint8_t block[TEXELS * 4]);
+
+/**
+ * \return \a bits from bit \a pos of a little-endian block
+ */
+static uint32_t get(const uint8_t* block, unsigned pos, unsigned bits) {
+	uint32_t value = 0;
+	for (unsigned n = 0; n < bits; n++, pos++) {
+		value |= static_cast<uint32_t>(block[pos >> 3] >> (pos & 7) & 1) << n;
+	}
+	return value;
+}
+
+/**
+ * \return a big-endian block half
+ */
+static uint64_t getBE(const uint8_t* in) {
+	uint64_t bits = 0;
+	for (unsigned n = 0; n < 8; n++) {
+		bits = bits << 8 | in[n];
+	}
+	return bits;
+}
+
+/**
+ * BC1 colour (three colour mode when \c c0 <= \c c1, unless \a four).
+ */
+static void unbc1(const uint8_t* in, bool four, uint8_t block[TEXELS * 4]) {
+	uint16_t c0 = static_cast<uint16_t>(in[0] | in[1] << 8);
+	uint16_t c1 = static_cast<uint16_t>(in[2] | in[3] << 8);
+	uint8_t pal[4][4];
+	from565(c0, pal[0]);
+	from565(c1, pal[1]);
+	for (unsigned c = 0; c < 4; c++) {
+		if (four || c0 > c1) {
+			pal[2][c] = static_cast<uint8_t>((pal[0][c] * 2 + pal[1][c]) / 3);
+			pal[3][c] = static_cast<uint8_t>((pal[0][c] + pal[1][c] * 2) / 3);
+		} else {
+			pal[2][c] = static_cast<uint8_t>((pal[0][c] + pal[1][c]) / 2);
+			pal[3][c] = 0;
+		}
+	}
+	for (unsigned n = 0; n < TEXELS; n++) {
+		unsigned index = in[4 + n / 4] >> (n % 4 * 2) & 3;
+		memcpy(block + n * 4, pal[index], (four) ? 3 : 4);
+	}
+}
+
+/**
+ * BC4 style alpha.
+ */
+static void unbc4(const uint8_t* in, uint8_t block[TEXELS * 4]) {
+	int a0 = in[0], a1 = in[1];
+	uint8_t pal[8] = {in[0], in[1], 0, 0, 0, 0, 0, 255};
+	if (a0 > a1) {
+		for (int i = 1; i <= 6; i++) {
+			pal[i + 1] = static_cast<uint8_t>(((7 - i) * a0 + i * a1 + 3) / 7);
+		}
+	} else {
+		for (int i = 1; i <= 4; i++) {
+			pal[i + 1] = static_cast<uint8_t>(((5 - i) * a0 + i * a1 + 2) / 5);
+		}
+	}
+	for (unsigned n = 0; n < TEXELS; n++) {
+		block[n * 4 + 3] = pal[get(in + 2, n * 3, 3)];
+	}
+}
+
+static bool unbc1(const uint8_t* in, uint8_t block[TEXELS * 4]) {
+	unbc1(in, false, block);
+	return true;
+}
+
+static bool unbc3(const uint8_t* in, uint8_t block[TEXELS * 4]) {
+	unbc4(in, block);
+	unbc1(in + 8, true, block);
+	return true;
+}
+
+/**
+ * BC7 mode 6.
+ */
+static bool unbc7(const uint8_t* in, uint8_t block[TEXELS * 4]) {
+	static const int WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+	if (get(in, 0, 7) != 1 << 6) {
+		return false;
+	}
+	int e[2][4];
+	unsigned pos = 7;
+	for (unsigned c = 0; c < 4; c++) {
+		for (unsigned i = 0; i < 2; i++, pos += 7) {
+			e[i][c] = static_cast<int>(get(in, pos, 7) << 1);
+		}
+	}
+	for (unsigned i = 0; i < 2; i++, pos++) {
+		for (unsigned c = 0; c < 4; c++) {
+			e[i][c] |= static_cast<int>(get(in, pos, 1));
+		}
+	}
+	for (unsigned n = 0; n < TEXELS; n++) {
+		unsigned bits = (n == 0) ? 3 : 4;
+		int w = WEIGHTS[get(in, pos, bits)];
+		pos += bits;
+		for (unsigned c = 0; c < 4; c++) {
+			block[n * 4 + c] = static_cast<uint8_t>(((64 - w) * e[0][c] + w * e[1][c] + 32) >> 6);
+		}
+	}
+	return true;
+}
+
+/**
+ * ETC2 RGB individual and differential modes.
+ */
+static bool unetc2(const uint8_t* in, uint8_t block[TEXELS * 4]) {
+	uint64_t bits = getBE(in);
+	bool diff = (bits >> 33 & 1) != 0;
+	bool flip = (bits >> 32 & 1) != 0;
+	int base[2][3];
+	for (unsigned c = 0; c < 3; c++) {
+		unsigned shift = 59 - c * 8;
+		if (diff) {
+			int b0 = static_cast<int>(bits >> shift & 31);
+			int d  = static_cast<int>(bits >> (shift - 3) & 7);
+			int b1 = b0 + ((d < 4) ? d : d - 8);
+			if (b1 < 0 || b1 > 31) {
+				return false; // T, H or planar mode
+			}
+			base[0][c] = b0 << 3 | b0 >> 2;
+			base[1][c] = b1 << 3 | b1 >> 2;
+		} else {
+			int b0 = static_cast<int>(bits >> (shift + 1) & 15);
+			int b1 = static_cast<int>(bits >> (shift - 3) & 15);
+			base[0][c] = b0 << 4 | b0;
+			base[1][c] = b1 << 4 | b1;
+		}
+	}
+	unsigned table[2] = {
+		static_cast<unsigned>(bits >> 37 & 7),
+		static_cast<unsigned>(bits >> 34 & 7),
+	};
+	for (unsigned y = 0; y < 4; y++) {
+		for (unsigned x = 0; x < 4; x++) {
+			unsigned half = (flip) ? y >> 1 : x >> 1;
+			unsigned bit  = etcIndex(x, y);
+			int mod = ETC_MODIFIERS[table[half]][bits >> bit & 1];
+			if (bits >> (16 + bit) & 1) {
+				mod = -mod;
+			}
+			for (unsigned c = 0; c < 3; c++) {
+				block[(y * 4 + x) * 4 + c] = clamp8(base[half][c] + mod);
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * EAC alpha.
+ */
+static void uneac(const uint8_t* in, uint8_t block[TEXELS * 4]) {
+	uint64_t bits = getBE(in);
+	int base = static_cast<int>(bits >> 56 & 255);
+	int mul  = static_cast<int>(bits >> 52 & 15);
+	unsigned table = static_cast<unsigned>(bits >> 48 & 15);
+	for (unsigned y = 0; y < 4; y++) {
+		for (unsigned x = 0; x < 4; x++) {
+			unsigned s = static_cast<unsigned>(bits >> (45 - etcIndex(x, y) * 3) & 7);
+			block[(y * 4 + x) * 4 + 3] = clamp8(base + EAC_MODIFIERS[table][s] * mul);
+		}
+	}
+}
+
+static bool unetc2a(const uint8_t* in, uint8_t block[TEXELS * 4]) {
+	uneac(in, block);
+	return unetc2(in + 8, block);
+}
+
+/**
+ * ASTC 4x4 with block mode 0x042, one partition and CEM 12.
+ */
+static bool unastc(const uint8_t* in, uint8_t block[TEXELS * 4]) {
+	static const int WEIGHTS[4] = {0, 21, 43, 64};
+	if (get(in, 0, 11) != 0x042 || get(in, 11, 2) != 0 || get(in, 13, 4) != 12) {
+		return false;
+	}
+	int v[8];
+	for (unsigned i = 0; i < 8; i++) {
+		v[i] = static_cast<int>(get(in, 17 + i * 8, 8));
+	}
+	int e[2][4] = {
+		{v[0], v[2], v[4], v[6]},
+		{v[1], v[3], v[5], v[7]},
+	};
+	if (v[1] + v[3] + v[5] < v[0] + v[2] + v[4]) {
+		int blue[2][4] = {
+			{(v[1] + v[5]) >> 1, (v[3] + v[5]) >> 1, v[5], v[7]},
+			{(v[0] + v[4]) >> 1, (v[2] + v[4]) >> 1, v[4], v[6]},
+		};
+		memcpy(e, blue, sizeof e);
+	}
+	for (unsigned n = 0; n < TEXELS; n++) {
+		unsigned index = 0;
+		for (unsigned b = 0; b < 2; b++) {
+			unsigned bit = 127 - (n * 2 + b);
+			index |= static_cast<unsigned>(in[bit >> 3] >> (bit & 7) & 1) << b;
+		}
+		int w = WEIGHTS[index];
+		for (unsigned c = 0; c < 4; c++) {
+			int c0 = e[0][c] << 8 | e[0][c];
+			int c1 = e[1][c] << 8 | e[1][c];
+			block[n * 4 + c] = static_cast<uint8_t>(((c0 * (64 - w) + c1 * w + 32) / 64) >> 8);
+		}
+	}
+	return true;
+}
+
+/**
+ * Fills \a rgba with smooth gradients crossed by hard edges (part way into
+ * blocks, so some have two colour clusters), with alpha ramping down
+ * diagonally.
+ */
+static void pattern(uint8_t* rgba, uint32_t width, uint32_t height) {
+	for (uint32_t y = 0; y < height; y++) {
+		for (uint32_t x = 0; x < width; x++) {
+			uint8_t* p = rgba + (static_cast<size_t>(y) * width + x) * 4;
+			p[0] = static_cast<uint8_t>(x * 255 / (width  - 1));
+			p[1] = static_cast<uint8_t>(y * 255 / (height - 1));
+			p[2] = clamp8(static_cast<int>(128.0f + 96.0f * sinf((x + y) * 0.15f)));
+			p[3] = clamp8(255 - static_cast<int>(x + y) * 2);
+			if (x * 3 > width * 2) {
+				p[0] = static_cast<uint8_t>(255 - p[0]);
+				p[2] = static_cast<uint8_t>(255 - p[2]);
+			}
+			if (y * 5 > height * 2 && y * 5 < height * 3) {
+				p[1] = static_cast<uint8_t>(255 - p[1]);
+			}
+		}
+	}
+}
+
+/**
+ * Encodes \a src to \a format then decodes it back, comparing the result.
+ *
+ * \param[in] channels channels compared (three for formats without alpha)
+ * \return PSNR in dB (or a negative value if a block failed to decode)
+ */
+static double roundTrip(const uint8_t* src, uint32_t width, uint32_t height, WGPUTextureFormat format, Decoder func, unsigned channels) {
+	unsigned bytes;
+	encoder(format, bytes);
+	uint8_t* blocks = static_cast<uint8_t*>(malloc(transcode::bytes(width, height, format)));
+	if (!blocks || !transcode::encode(src, width, height, format, blocks)) {
+		free(blocks);
+		return -1.0;
+	}
+	double sum = 0.0;
+	const uint8_t* in = blocks;
+	for (uint32_t by = 0; by < height; by += 4) {
+		for (uint32_t bx = 0; bx < width; bx += 4, in += bytes) {
+			uint8_t block[TEXELS * 4];
+			if (!func(in, block)) {
+				free(blocks);
+				return -1.0;
+			}
+			for (uint32_t y = by; y < by + 4 && y < height; y++) {
+				for (uint32_t x = bx; x < bx + 4 && x < width; x++) {
+					const uint8_t* p = src + (static_cast<size_t>(y) * width + x) * 4;
+					const uint8_t* q = block + ((y - by) * 4 + (x - bx)) * 4;
+					for (unsigned c = 0; c < channels; c++) {
+						double d = static_cast<double>(p[c]) - q[c];
+						sum += d * d;
+					}
+				}
+			}
+		}
+	}
+	free(blocks);
+	double mse = sum / (static_cast<double>(width) * height * channels);
+	return (mse > 0.0) ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+#endif
+}
+
+//******************************** Public API ********************************/
+
+bool transcode::open(const void* data, size_t size, Image& image) {
+	Header head;
+	if (size < sizeof head) {
+		return false;
+	}
+	memcpy(&head, data, sizeof head);
+	if (head.magic != TRANSCODE_MAGIC || head.width == 0 || head.height == 0
+		|| head.levels == 0 || head.levels > TRANSCODE_MAX_LEVELS
+		|| size < sizeof head + head.levels * sizeof(Level)) {
+		return false;
+	}
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (unsigned n = 0; n < head.levels; n++) {
+		Level level;
+		memcpy(&level, bytes + sizeof head + n * sizeof level, sizeof level);
+		if (level.offset > size || level.packed > size - level.offset) {
+			return false;
+		}
+	}
+	image.data   = bytes;
+	image.size   = size;
+	image.width  = head.width;
+	image.height = head.height;
+	image.levels = head.levels;
+	image.srgb   = (head.flags & FLAG_SRGB)  != 0;
+	image.alpha  = (head.flags & FLAG_ALPHA) != 0;
+	return true;
+}
+
+WGPUTextureFormat transcode::pick(WGPUDevice device, bool alpha, bool srgb) {
+	if (wgpuDeviceHasFeature(device, WGPUFeatureName_TextureCompressionBC)) {
+		if (alpha) {
+			return (srgb) ? WGPUTextureFormat_BC7RGBAUnormSrgb : WGPUTextureFormat_BC7RGBAUnorm;
+		}
+		return (srgb) ? WGPUTextureFormat_BC1RGBAUnormSrgb : WGPUTextureFormat_BC1RGBAUnorm;
+	}
+	if (wgpuDeviceHasFeature(device, WGPUFeatureName_TextureCompressionETC2)) {
+		if (alpha) {
+			return (srgb) ? WGPUTextureFormat_ETC2RGBA8UnormSrgb : WGPUTextureFormat_ETC2RGBA8Unorm;
+		}
+		return (srgb) ? WGPUTextureFormat_ETC2RGB8UnormSrgb : WGPUTextureFormat_ETC2RGB8Unorm;
+	}
+	if (wgpuDeviceHasFeature(device, WGPUFeatureName_TextureCompressionASTC)) {
+		return (srgb) ? WGPUTextureFormat_ASTC4x4UnormSrgb : WGPUTextureFormat_ASTC4x4Unorm;
+	}
+	return (srgb) ? WGPUTextureFormat_RGBA8UnormSrgb : WGPUTextureFormat_RGBA8Unorm;
+}
+
+size_t transcode::bytes(uint32_t width, uint32_t height, WGPUTextureFormat format) {
+	if (format == WGPUTextureFormat_RGBA8Unorm || format == WGPUTextureFormat_RGBA8UnormSrgb) {
+		return static_cast<size_t>(width) * height * 4;
+	}
+	unsigned block;
+	if (!impl::encoder(format, block)) {
+		return 0;
+	}
+	return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * block;
+}
+
+bool transcode::decode(const Image& image, unsigned level, uint8_t* rgba) {
+	if (level >= image.levels) {
+		return false;
+	}
+	Level entry;
+	memcpy(&entry, image.data + sizeof(Header) + level * sizeof entry, sizeof entry);
+	size_t size = static_cast<size_t>(impl::extent(image.width, level)) * impl::extent(image.height, level) * 4;
+	if (!impl::decompress(image.data + entry.offset, entry.packed, rgba, size)) {
+		return false;
+	}
+	/*
+	 * Undoes the packing's filter (each byte stored as the difference from
+	 * the same channel of the previous texel).
+	 */
+	for (size_t n = 4; n < size; n++) {
+		rgba[n] = static_cast<uint8_t>(rgba[n] + rgba[n - 4]);
+	}
+	return true;
+}
+
+bool transcode::encode(const uint8_t* rgba, uint32_t width, uint32_t height, WGPUTextureFormat format, void* dst) {
+	if (format == WGPUTextureFormat_RGBA8Unorm || format == WGPUTextureFormat_RGBA8UnormSrgb) {
+		memcpy(dst, rgba, bytes(width, height, format));
+		return true;
+	}
+	impl::Task task;
+	task.func = impl::encoder(format, task.bytes);
+	if (!task.func) {
+		return false;
+	}
+	task.rgba    = rgba;
+	task.width   = width;
+	task.height  = height;
+	task.blocksX = (width + 3) / 4;
+	task.dst     = static_cast<uint8_t*>(dst);
+	jobs::parallel((height + 3) / 4, 4, impl::encodeRows, &task);
+	return true;
+}
+
+size_t transcode::bound(uint32_t width, uint32_t height) {
+	size_t size = sizeof(Header) + TRANSCODE_MAX_LEVELS * sizeof(Level);
+	for (unsigned n = 0; n < TRANSCODE_MAX_LEVELS; n++) {
+		size += impl::lzBound(static_cast<size_t>(impl::extent(width, n)) * impl::extent(height, n) * 4);
+	}
+	return size;
+}
+
+size_t transcode::pack(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb, void* dst, size_t capacity) {
+	if (width == 0 || height == 0 || capacity < bound(width, height)) {
+		return 0;
+	}
+	uint32_t longest = (width > height) ? width : height;
+	unsigned levels = 1;
+	while (levels < TRANSCODE_MAX_LEVELS && (longest >> levels)) {
+		levels++;
+	}
+	size_t texels = static_cast<size_t>(width) * height;
+	uint8_t* work[2] = {
+		static_cast<uint8_t*>(malloc(texels * 4)),
+		static_cast<uint8_t*>(malloc(texels * 4)),
+	};
+	if (!work[0] || !work[1]) {
+		free(work[0]);
+		free(work[1]);
+		return 0;
+	}
+	Header head = {};
+	head.magic  = TRANSCODE_MAGIC;
+	head.width  = width;
+	head.height = height;
+	head.levels = static_cast<uint16_t>(levels);
+	head.flags  = (srgb) ? FLAG_SRGB : 0;
+	for (size_t n = 0; n < texels; n++) {
+		if (rgba[n * 4 + 3] != 255) {
+			head.flags |= FLAG_ALPHA;
+			break;
+		}
+	}
+	uint8_t* out = static_cast<uint8_t*>(dst);
+	memcpy(out, &head, sizeof head);
+	size_t pos = sizeof head + levels * sizeof(Level);
+	const uint8_t* src = rgba;
+	for (unsigned n = 0; n < levels; n++) {
+		uint32_t w = impl::extent(width,  n);
+		uint32_t h = impl::extent(height, n);
+		if (n > 0) {
+			impl::downsample(src, impl::extent(width, n - 1), impl::extent(height, n - 1), srgb, work[n & 1]);
+			src = work[n & 1];
+		}
+		/*
+		 * Filtered into the other buffer, so the unfiltered level is still
+		 * there to downsample next.
+		 */
+		size_t size = static_cast<size_t>(w) * h * 4;
+		uint8_t* filtered = work[(n & 1) ^ 1];
+		memcpy(filtered, src, (size < 4) ? size : 4);
+		for (size_t i = 4; i < size; i++) {
+			filtered[i] = static_cast<uint8_t>(src[i] - src[i - 4]);
+		}
+		Level level;
+		level.offset = static_cast<uint32_t>(pos);
+		level.packed = static_cast<uint32_t>(impl::compress(filtered, size, out + pos));
+		memcpy(out + sizeof head + n * sizeof level, &level, sizeof level);
+		pos += level.packed;
+	}
+	free(work[0]);
+	free(work[1]);
+	return pos;
+}
+
+transcode::Source::Source(const Image& image, WGPUTextureFormat format)
+	: image   (image)
+	, format  (format)
+	, scratch (nullptr)
+	, capacity(0) {}
+
+transcode::Source::~Source() {
+	free(scratch);
+}
+
+bool transcode::load(unsigned level, void* dst, size_t size, void* user) {
+	Source* src = static_cast<Source*>(user);
+	if (!src || level >= src->image.levels) {
+		return false;
+	}
+	uint32_t w = impl::extent(src->image.width,  level);
+	uint32_t h = impl::extent(src->image.height, level);
+	if (size != bytes(w, h, src->format)) {
+		return false;
+	}
+	if (src->format == WGPUTextureFormat_RGBA8Unorm || src->format == WGPUTextureFormat_RGBA8UnormSrgb) {
+		return decode(src->image, level, static_cast<uint8_t*>(dst));
+	}
+	size_t need = static_cast<size_t>(w) * h * 4;
+	if (src->capacity < need) {
+		free(src->scratch);
+		src->scratch  = static_cast<uint8_t*>(malloc(need));
+		src->capacity = (src->scratch) ? need : 0;
+	}
+	return src->scratch
+		&& decode(src->image, level, src->scratch)
+		&& encode(src->scratch, w, h, src->format, dst);
+}
+
+void transcode::describe(Source& src, stream::TextureDesc& desc) {
+	desc.width  = src.image.width;
+	desc.height = src.image.height;
+	desc.levels = src.image.levels;
+	desc.format = src.format;
+	desc.load   = load;
+	desc.user   = &src;
+}
+
+#if TRANSCODE_CHECK
+bool transcode::check(FILE* out) {
+	/*
+	 * Sizes which aren't multiples of four cover the edge block padding.
+	 */
+	const uint32_t width  = 61;
+	const uint32_t height = 37;
+	size_t size = static_cast<size_t>(width) * height * 4;
+	uint8_t* src = static_cast<uint8_t*>(malloc(size));
+	uint8_t* dst = static_cast<uint8_t*>(malloc(size));
+	size_t capacity = bound(width, height);
+	uint8_t* file = static_cast<uint8_t*>(malloc(capacity));
+	bool ok = src && dst && file;
+	if (ok) {
+		impl::pattern(src, width, height);
+		Image image;
+		size_t packed = pack(src, width, height, false, file, capacity);
+		ok = packed && open(file, packed, image) && image.alpha && image.levels == 6;
+		for (unsigned n = 0; ok && n < image.levels; n++) {
+			ok = decode(image, n, dst) && (n > 0 || memcmp(src, dst, size) == 0);
+		}
+		fprintf(out, "transcode: pack %s\n", (ok) ? "ok" : "FAILED");
+	}
+	static const struct {
+		const char* name;
+		WGPUTextureFormat format;
+		impl::Decoder func;
+		unsigned channels;
+	} formats[] = {
+		{"BC1",   WGPUTextureFormat_BC1RGBAUnorm,   impl::unbc1,   3},
+		{"BC3",   WGPUTextureFormat_BC3RGBAUnorm,   impl::unbc3,   4},
+		{"BC7",   WGPUTextureFormat_BC7RGBAUnorm,   impl::unbc7,   4},
+		{"ETC2",  WGPUTextureFormat_ETC2RGB8Unorm,  impl::unetc2,  3},
+		{"ETC2A", WGPUTextureFormat_ETC2RGBA8Unorm, impl::unetc2a, 4},
+		{"ASTC",  WGPUTextureFormat_ASTC4x4Unorm,   impl::unastc,  4},
+	};
+	for (unsigned n = 0; src && n < sizeof formats / sizeof formats[0]; n++) {
+		double psnr = impl::roundTrip(src, width, height, formats[n].format, formats[n].func, formats[n].channels);
+		bool pass = psnr >= TRANSCODE_CHECK_PSNR;
+		if (psnr < 0.0) {
+			fprintf(out, "transcode: %-5s undecodable block FAILED\n", formats[n].name);
+		} else {
+			fprintf(out, "transcode: %-5s %5.1f dB%s\n", formats[n].name, psnr, (pass) ? "" : " FAILED");
+		}
+		ok = ok && pass;
+	}
+	free(file);
+	free(dst);
+	free(src);
+	return ok;
+}
+#endif
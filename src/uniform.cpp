@@ -0,0 +1,124 @@
+#include "uniform.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//****************************************************************************/
+
+/**
+ * CPU copy and the range written since the last flush.
+ */
+struct uniform::Buffer::Impl {
+	Impl(WGPUDevice device)
+		: device(device)
+		, buffer(nullptr)
+		, data  (nullptr)
+		, size  (0)
+		, dirtyBeg(SIZE_MAX)
+		, dirtyEnd(0) {
+		wgpuDeviceReference(device);
+	}
+
+	~Impl() {
+		if (buffer) {
+			wgpuBufferRelease(buffer);
+		}
+		free(data);
+		wgpuDeviceRelease(device);
+	}
+
+	WGPUDevice device;
+	WGPUBuffer buffer;
+	unsigned char* data;
+	size_t size;     ///< Bytes added so far (the buffer size once created)
+	size_t dirtyBeg; ///< Start of the range to upload (\c SIZE_MAX if nothing)
+	size_t dirtyEnd; ///< End of the range to upload
+};
+
+//******************************** Public API ********************************/
+
+uniform::Buffer::Buffer(WGPUDevice device)
+	: impl(new Impl(device)) {}
+
+uniform::Buffer::~Buffer() {
+	delete impl;
+}
+
+uniform::Slot uniform::Buffer::add(size_t size) {
+	Slot slot = {};
+	if (!impl->buffer) {
+		size_t offset = roundUp(impl->size, UNIFORM_OFFSET_ALIGNMENT);
+		if (void* more = realloc(impl->data, offset + size)) {
+			impl->data = static_cast<unsigned char*>(more);
+			memset(impl->data + impl->size, 0, offset + size - impl->size);
+			impl->size  = offset + size;
+			slot.offset = offset;
+			slot.size   = size;
+		}
+	}
+	return slot;
+}
+
+void uniform::Buffer::write(const Slot& slot, const void* data, size_t size) {
+	if (size > slot.size) {
+		size = static_cast<size_t>(slot.size);
+	}
+	if (size > 0) {
+		size_t beg = static_cast<size_t>(slot.offset);
+		memcpy(impl->data + beg, data, size);
+		if (impl->dirtyBeg > beg) {
+			impl->dirtyBeg = beg;
+		}
+		if (impl->dirtyEnd < beg + size) {
+			impl->dirtyEnd = beg + size;
+		}
+	}
+}
+
+void uniform::Buffer::flush(WGPUQueue queue) {
+	if (impl->dirtyBeg < impl->dirtyEnd) {
+		/*
+		 * Buffer writes need to be multiples of four bytes (as do the offsets
+		 * and sizes of the blocks, but a block's size may not be).
+		 */
+		size_t beg = impl->dirtyBeg & ~static_cast<size_t>(3);
+		size_t end = roundUp(impl->dirtyEnd, 4);
+		if (end > impl->size) {
+			end = impl->size;
+		}
+		wgpuQueueWriteBuffer(queue, buffer(), beg, impl->data + beg, end - beg);
+	}
+	impl->dirtyBeg = SIZE_MAX;
+	impl->dirtyEnd = 0;
+}
+
+WGPUBuffer uniform::Buffer::buffer() {
+	if (!impl->buffer) {
+		/*
+		 * The size is padded so the whole CPU copy is always writable.
+		 */
+		size_t padded = roundUp(impl->size, 4);
+		if (void* more = realloc(impl->data, (padded) ? padded : 4)) {
+			impl->data = static_cast<unsigned char*>(more);
+			memset(impl->data + impl->size, 0, padded - impl->size);
+			impl->size = padded;
+		}
+		WGPUBufferDescriptor desc = {};
+		desc.usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst;
+		desc.size  = impl->size;
+		desc.mappedAtCreation = true;
+		impl->buffer = wgpuDeviceCreateBuffer(impl->device, &desc);
+		/*
+		 * Blocks written before creation are uploaded along with it.
+		 */
+		if (impl->size > 0) {
+			if (void* mapped = wgpuBufferGetMappedRange(impl->buffer, 0, impl->size)) {
+				memcpy(mapped, impl->data, impl->size);
+			}
+		}
+		wgpuBufferUnmap(impl->buffer);
+		impl->dirtyBeg = SIZE_MAX;
+		impl->dirtyEnd = 0;
+	}
+	return impl->buffer;
+}
@@ -1,5 +1,7 @@
 #include "window.h"
 
+#include <atomic>
+
 #include "glue.h"
 
 #include <mmsystem.h>
@@ -51,7 +53,8 @@
  * resolution and the sleep time between frame updates. A value of zero will
  * give a glitch-free playback at the expense of CPU (and battery). 10 will
  * drop CPU usage to zero but struggle to maintain framerate (but an even
- * paced struggle). 1-5 is a good choice (2 being a good compromise).
+ * paced struggle). 1-5 is a good choice (2 being a good compromise). Only
+ * applies whilst animating (idle windows block waiting for messages).
  */
 #ifndef WINDOW_SLEEP_PERIOD
 #define WINDOW_SLEEP_PERIOD 2
@@ -201,6 +204,26 @@ MAKE_DYNAMIC_FUNC("User32.dll", AdjustWindowRectExForDpi);
 #define TO_WIN(hnd) reinterpret_cast<HWND>(hnd)
 
 namespace impl {
+/*
+ * Redraw state.
+ *
+ * TODO: this currently only works for a single window
+ */
+static std::atomic<bool> dirty(true); // a frame was requested (by input, resizing, etc.)
+static std::atomic<bool> animating(!WINDOW_ON_DEMAND); // draw every frame
+static bool minimised = false; // nothing is drawn whilst set
+
+/*
+ * Resize state (only touched on the window's thread, which the render stages
+ * also run on).
+ */
+static unsigned sizeW = 0; // last size reported by window::resized()
+static unsigned sizeH = 0;
+static unsigned pendW = 0; // latest size from WM_SIZE
+static unsigned pendH = 0;
+static bool pending = false; // WM_SIZE arrived since the last report
+static bool sizing  = false; // in the modal size/move loop (reports wait until the end)
+
 //**************************** Windows Event Loop ****************************/
 
 /**
@@ -304,13 +327,35 @@ LRESULT CALLBACK windowEvents(HWND const hWnd, UINT const uMsg, WPARAM const wPa
 	switch (uMsg) {
 	case WM_SIZE:
 		/*
-		 * See note about the swap in surfaceResize and WM_WINDOWPOSCHANGED,
-		 * so look into a better way of doing this.
+		 * The size is held until the next frame polls window::resized() (or
+		 * whilst dragging, until the drag ends), so however many of these
+		 * arrive the swap chain is reconfigured once. DPI changes arrive
+		 * here too (via the SetWindowPos in WM_DPICHANGED).
 		 */
 		if (wParam != SIZE_MINIMIZED) {
-			//impl::surfaceResize(LOWORD(lParam), HIWORD(lParam), dpiScale);
+			pendW   = LOWORD(lParam);
+			pendH   = HIWORD(lParam);
+			pending = true;
+			dirty   = true;
 		}
+		minimised = (wParam == SIZE_MINIMIZED);
+		break;
+	case WM_ENTERSIZEMOVE:
+		sizing = true;
 		break;
+	case WM_EXITSIZEMOVE:
+		sizing = false;
+		dirty  = true;
+		break;
+	case WM_PAINT:
+		/*
+		 * Validated without painting (the next frame draws everything),
+		 * otherwise Windows keeps sending WM_PAINT. This is also how another
+		 * thread requests a frame (see window::invalidate()).
+		 */
+		ValidateRect(hWnd, NULL);
+		dirty = true;
+		return 0;
 	case WM_CLOSE:
 		PostQuitMessage(0);
 		return 0;
@@ -421,19 +466,40 @@ LRESULT CALLBACK windowEvents(HWND const hWnd, UINT const uMsg, WPARAM const wPa
 }
 
 /**
+ * \return \c true if there's no reason to draw the next frame
+ */
+static bool idle() {
+	return minimised || !(animating || dirty);
+}
+
+/**
+ * Processes any pending messages. Whilst animating this sleeps for the \c
+ * #WINDOW_SLEEP_PERIOD after, otherwise, if \a wait is set, it blocks until
+ * the first message arrives (using no CPU until then).
+ *
+ * \param[in] wait \c true to block waiting for messages
  * \return \c true if the application is still running (i.e. did not quit)
  */
-bool yield() {
+bool yield(bool wait = false) {
+	if (wait) {
+		MsgWaitForMultipleObjects(0, NULL, FALSE, INFINITE, QS_ALLINPUT);
+	}
 	bool running = true;
 	MSG msg;
 	while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
 		if (msg.message == WM_QUIT) {
 			running = false;
 		}
+		if ((msg.message >= WM_KEYFIRST   && msg.message <= WM_KEYLAST) ||
+			(msg.message >= WM_MOUSEFIRST && msg.message <= WM_MOUSELAST)) {
+			dirty = true;
+		}
 		TranslateMessage(&msg);
 		DispatchMessage (&msg); 
 	}
-	Sleep(WINDOW_SLEEP_PERIOD);
+	if (!wait) {
+		Sleep(WINDOW_SLEEP_PERIOD);
+	}
 	return running; 
 }
 }
@@ -511,6 +577,7 @@ window::Handle window::create(unsigned winW, unsigned winH, const char* /*name*/
 			 */
 			DragAcceptFiles(window, FALSE);
 			RegisterHotKey (window, VK_SNAPSHOT, 0, VK_SNAPSHOT);
+			window::size(TO_HND(window), impl::sizeW, impl::sizeH);
 			return TO_HND(window);
 		}
 		UnregisterClass(wndClass.lpszClassName, wndClass.hInstance);
@@ -526,12 +593,65 @@ void window::show(window::Handle wHnd, bool show) {
 	ShowWindow(TO_WIN(wHnd), (show) ? SW_SHOWDEFAULT : SW_HIDE);
 }
 
-void window::loop(window::Handle /*wHnd*/, window::Redraw func) {
-	while (impl::yield()) {
-		if (func) {
-			if (!func()) {
-				break;
+void window::loop(window::Handle wHnd, const frame::Stages* stages) {
+	if (stages) {
+		/*
+		 * Idle windows block on the message queue (skipping frames entirely
+		 * whilst minimised). The simulation thread, having produced its one
+		 * snapshot ahead, also waits until the next tick.
+		 */
+		frame::Scheduler sched(*stages);
+		while (impl::yield(impl::idle())) {
+			if (impl::minimised || IsIconic(TO_WIN(wHnd))) {
+				continue;
+			}
+			if (impl::animating || impl::dirty.exchange(false)) {
+				if (!sched.tick()) {
+					break;
+				}
 			}
 		}
+	} else {
+		while (impl::yield(true)) {}
+	}
+}
+
+void window::size(window::Handle wHnd, unsigned& w, unsigned& h) {
+	/*
+	 * Being per-monitor DPI aware, the client area is already in pixels.
+	 */
+	RECT rect;
+	if (GetClientRect(TO_WIN(wHnd), &rect)) {
+		w = static_cast<unsigned>(rect.right  - rect.left);
+		h = static_cast<unsigned>(rect.bottom - rect.top);
+	} else {
+		w = 0;
+		h = 0;
+	}
+}
+
+bool window::resized(window::Handle /*wHnd*/, unsigned& w, unsigned& h) {
+	if (impl::pending && !impl::sizing) {
+		impl::pending = false;
+		if (impl::pendW && impl::pendH && (impl::pendW != impl::sizeW || impl::pendH != impl::sizeH)) {
+			impl::sizeW = impl::pendW;
+			impl::sizeH = impl::pendH;
+			w = impl::sizeW;
+			h = impl::sizeH;
+			return true;
+		}
 	}
+	return false;
+}
+
+void window::invalidate(window::Handle wHnd) {
+	/*
+	 * Generates a WM_PAINT (which wakes the message wait).
+	 */
+	InvalidateRect(TO_WIN(wHnd), NULL, FALSE);
+}
+
+void window::animate(window::Handle wHnd, bool active) {
+	impl::animating = active;
+	PostMessage(TO_WIN(wHnd), WM_NULL, 0, 0);
 }
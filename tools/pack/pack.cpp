@@ -0,0 +1,270 @@
+/**
+ * \file pack.cpp
+ * Packs a directory of assets into an archive (see \c archive.h). Files are
+ * named by their path relative to the directory (with forward slashes) and
+ * stored in the form \c archive#build() converts them to by extension
+ * (\c .obj meshes, \c .wgsl shaders and \c .utx textures, anything else
+ * being stored as-is).
+ * \n
+ * Files starting with a dot are skipped. With \c -order, the blobs are laid
+ * out in the order listed in the file (as saved by \c archive#record()), with
+ * any unlisted after them in name order.
+ *
+ * \code
+ * pack [-order assets.order] assets assets.pak
+ * \endcode
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#include "archive.h"
+
+//****************************************************************************/
+
+namespace impl {
+/**
+ * File being packed.
+ */
+struct Asset {
+	std::string name;          ///< Path relative to the packed directory
+	std::vector<uint8_t> data; ///< Contents as stored (without a shader's terminator)
+	archive::Type type;
+	uint64_t hash;             ///< \c archive#hash() of the contents
+	uint64_t id;               ///< \c archive#hash() of the name
+	size_t rank;               ///< Position in the recorded order (or past the end if unlisted)
+	uint64_t offset;           ///< Start in the archive
+};
+
+/**
+ * Reads the whole of \a path into \a data.
+ */
+static bool load(const char* path, std::vector<uint8_t>& data) {
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		return false;
+	}
+	uint8_t block[64 * 1024];
+	size_t read;
+	while ((read = fread(block, 1, sizeof block, file)) > 0) {
+		data.insert(data.end(), block, block + read);
+	}
+	fclose(file);
+	return true;
+}
+
+/**
+ * Lists the files under \a root (in \a dir, relative to \a root, recursively).
+ */
+static void list(const std::string& root, const std::string& dir, std::vector<std::string>& files) {
+	std::string path = (dir.empty()) ? root : root + "/" + dir;
+#ifdef _WIN32
+	WIN32_FIND_DATAA found;
+	HANDLE search = FindFirstFileA((path + "/*").c_str(), &found);
+	if (search == INVALID_HANDLE_VALUE) {
+		return;
+	}
+	do {
+		if (found.cFileName[0] == '.') {
+			continue;
+		}
+		std::string name = (dir.empty()) ? found.cFileName : dir + "/" + found.cFileName;
+		if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+			list(root, name, files);
+		} else {
+			files.push_back(name);
+		}
+	} while (FindNextFileA(search, &found));
+	FindClose(search);
+#else
+	DIR* search = opendir(path.c_str());
+	if (!search) {
+		return;
+	}
+	while (dirent* found = readdir(search)) {
+		if (found->d_name[0] == '.') {
+			continue;
+		}
+		std::string name = (dir.empty()) ? found->d_name : dir + "/" + found->d_name;
+		struct stat info;
+		if (stat((root + "/" + name).c_str(), &info) != 0) {
+			continue;
+		}
+		if (S_ISDIR(info.st_mode)) {
+			list(root, name, files);
+		} else if (S_ISREG(info.st_mode)) {
+			files.push_back(name);
+		}
+	}
+	closedir(search);
+#endif
+}
+
+/**
+ * Pads \a file with zeros to the next \c #ARCHIVE_ALIGN boundary.
+ *
+ * \return the new file position
+ */
+static uint64_t pad(FILE* file, uint64_t pos) {
+	static const uint8_t zeros[ARCHIVE_ALIGN] = {};
+	uint64_t fill = (ARCHIVE_ALIGN - pos % ARCHIVE_ALIGN) % ARCHIVE_ALIGN;
+	fwrite(zeros, 1, static_cast<size_t>(fill), file);
+	return pos + fill;
+}
+}
+
+//****************************************************************************/
+
+int main(int argc, char* argv[]) {
+	const char* orderPath = nullptr;
+	const char* paths[2] = {};
+	int pathCount = 0;
+	for (int n = 1; n < argc; n++) {
+		if (strcmp(argv[n], "-order") == 0 && n + 1 < argc) {
+			orderPath = argv[++n];
+		} else if (pathCount < 2) {
+			paths[pathCount++] = argv[n];
+		}
+	}
+	if (pathCount < 2) {
+		fprintf(stderr, "Usage: pack [-order file] dir archive\n");
+		return 1;
+	}
+	std::vector<std::string> order;
+	if (orderPath) {
+		std::vector<uint8_t> text;
+		if (impl::load(orderPath, text)) {
+			std::string line;
+			for (size_t n = 0; n <= text.size(); n++) {
+				if (n == text.size() || text[n] == '\n') {
+					if (!line.empty()) {
+						order.push_back(line);
+					}
+					line.clear();
+				} else if (text[n] != '\r') {
+					line += static_cast<char>(text[n]);
+				}
+			}
+		} else {
+			fprintf(stderr, "No access order (packing by name): %s\n", orderPath);
+		}
+	}
+
+	std::vector<std::string> files;
+	impl::list(paths[0], "", files);
+	std::vector<impl::Asset> assets(files.size());
+	for (size_t n = 0; n < files.size(); n++) {
+		impl::Asset& asset = assets[n];
+		asset.name = files[n];
+		std::vector<uint8_t> data;
+		if (!impl::load((std::string(paths[0]) + "/" + asset.name).c_str(), data)) {
+			fprintf(stderr, "Unable to read: %s\n", asset.name.c_str());
+			return 1;
+		}
+		archive::Blob blob;
+		if (!archive::build(asset.name.c_str(), data.data(), data.size(), blob)) {
+			fprintf(stderr, "Unable to convert: %s\n", asset.name.c_str());
+			return 1;
+		}
+		const uint8_t* built = static_cast<const uint8_t*>(blob.data);
+		asset.data.assign(built, built + blob.size);
+		asset.type = blob.type;
+		asset.hash = blob.hash;
+		free(const_cast<void*>(blob.data));
+		asset.id   = archive::hash(asset.name.c_str(), asset.name.size());
+		asset.rank = std::find(order.begin(), order.end(), asset.name) - order.begin();
+	}
+
+	/*
+	 * The TOC is sorted by name hash (for the binary search) and the blobs
+	 * by access order.
+	 */
+	std::vector<size_t> byId(assets.size());
+	std::vector<size_t> layout(assets.size());
+	for (size_t n = 0; n < assets.size(); n++) {
+		byId[n]   = n;
+		layout[n] = n;
+	}
+	std::sort(byId.begin(), byId.end(), [&assets](size_t a, size_t b) {
+		return assets[a].id < assets[b].id;
+	});
+	for (size_t n = 1; n < byId.size(); n++) {
+		if (assets[byId[n]].id == assets[byId[n - 1]].id) {
+			fprintf(stderr, "Name hashes collide: %s and %s\n", assets[byId[n]].name.c_str(), assets[byId[n - 1]].name.c_str());
+			return 1;
+		}
+	}
+	std::sort(layout.begin(), layout.end(), [&assets](size_t a, size_t b) {
+		return (assets[a].rank != assets[b].rank) ? assets[a].rank < assets[b].rank : assets[a].name < assets[b].name;
+	});
+	size_t namesSize = 0;
+	for (size_t n = 0; n < assets.size(); n++) {
+		namesSize += assets[n].name.size() + 1;
+	}
+	uint64_t pos = sizeof(archive::Header) + assets.size() * sizeof(archive::Entry) + namesSize;
+	for (size_t n = 0; n < layout.size(); n++) {
+		impl::Asset& asset = assets[layout[n]];
+		pos = (pos + ARCHIVE_ALIGN - 1) / ARCHIVE_ALIGN * ARCHIVE_ALIGN;
+		asset.offset = pos;
+		pos += asset.data.size() + ((asset.type == archive::TYPE_SHADER) ? 1 : 0);
+	}
+	std::vector<archive::Entry> toc(assets.size());
+	std::string names;
+	for (size_t n = 0; n < byId.size(); n++) {
+		const impl::Asset& asset = assets[byId[n]];
+		toc[n].id     = asset.id;
+		toc[n].hash   = asset.hash;
+		toc[n].offset = asset.offset;
+		toc[n].size   = asset.data.size();
+		toc[n].name   = static_cast<uint32_t>(names.size());
+		toc[n].type   = asset.type;
+		names.append(asset.name.c_str(), asset.name.size() + 1);
+	}
+
+	FILE* file = fopen(paths[1], "wb");
+	if (!file) {
+		fprintf(stderr, "Unable to write: %s\n", paths[1]);
+		return 1;
+	}
+	archive::Header header = {};
+	header.magic   = ARCHIVE_MAGIC;
+	header.version = ARCHIVE_VERSION;
+	header.flags   = (order.empty()) ? 0 : archive::FLAG_ORDERED;
+	header.count   = static_cast<uint32_t>(toc.size());
+	header.names   = static_cast<uint32_t>(names.size());
+	fwrite(&header, sizeof header, 1, file);
+	fwrite(toc.data(), sizeof(archive::Entry), toc.size(), file);
+	fwrite(names.data(), 1, names.size(), file);
+	pos = sizeof header + toc.size() * sizeof(archive::Entry) + names.size();
+	for (size_t n = 0; n < layout.size(); n++) {
+		const impl::Asset& asset = assets[layout[n]];
+		pos = impl::pad(file, pos);
+		fwrite(asset.data.data(), 1, asset.data.size(), file);
+		pos += asset.data.size();
+		if (asset.type == archive::TYPE_SHADER) {
+			fputc(0, file);
+			pos++;
+		}
+	}
+	pos = impl::pad(file, pos);
+	if (fclose(file) != 0) {
+		fprintf(stderr, "Unable to write: %s\n", paths[1]);
+		return 1;
+	}
+	printf("Packed %u files (%llu bytes): %s\n", header.count, static_cast<unsigned long long>(pos), paths[1]);
+	return 0;
+}
@@ -0,0 +1,186 @@
+/**
+ * \file replay.cpp
+ * Plays back a capture file (see \c capture.h) against Dawn as fast as
+ * possible, with none of the app's logic, and reports the CPU cost of each
+ * frame. Run with \c -null to use the Null backend (measuring Dawn's own
+ * overhead, without a driver or vsync), \c -frames to list every frame.
+ *
+ * \code
+ * replay [-null] [-frames] [capture.wgpc]
+ * \endcode
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <dawn/dawn_proc_table.h>
+#include <dawn/wire/WireServer.h>
+
+#include "capture.h"
+#include "webgpu.h"
+
+#ifdef _MSC_VER
+#pragma comment(lib, "dawn_wire.dll.lib")
+#endif
+
+//****************************************************************************/
+
+namespace impl {
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * Server replies (for callbacks the app isn't around to receive) are dropped.
+ */
+class Sink : public dawn::wire::CommandSerializer {
+public:
+	Sink()
+		: scratch(nullptr) {}
+	~Sink() override {
+		free(scratch);
+	}
+	void* GetCmdSpace(size_t size) override {
+		if (!scratch) {
+			scratch = malloc(CAPTURE_MAX_ALLOCATION);
+		}
+		return (size <= CAPTURE_MAX_ALLOCATION) ? scratch : nullptr;
+	}
+	bool Flush() override {
+		return true;
+	}
+	size_t GetMaximumAllocationSize() const override {
+		return CAPTURE_MAX_ALLOCATION;
+	}
+private:
+	void* scratch;
+};
+
+/**
+ * Reads the whole of \a path into \a data (so file access isn't timed).
+ */
+static bool load(const char* path, std::vector<char>& data) {
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		return false;
+	}
+	char block[64 * 1024];
+	size_t read;
+	while ((read = fread(block, 1, sizeof block, file)) > 0) {
+		data.insert(data.end(), block, block + read);
+	}
+	fclose(file);
+	return true;
+}
+
+/**
+ * \return the \a pct percentile of the sorted \a times
+ */
+static double percentile(const std::vector<double>& times, double pct) {
+	size_t n = static_cast<size_t>(pct / 100.0 * (times.size() - 1) + 0.5);
+	return times[std::min(n, times.size() - 1)];
+}
+}
+
+//****************************************************************************/
+
+extern "C" int __main__(int argc, char* argv[]) {
+	const char* path = WEBGPU_CAPTURE_FILE;
+	WGPUBackendType backend = WGPUBackendType_Force32;
+	bool listFrames = false;
+	for (int n = 1; n < argc; n++) {
+		if (strcmp(argv[n], "-null") == 0) {
+			backend = WGPUBackendType_Null;
+		} else if (strcmp(argv[n], "-frames") == 0) {
+			listFrames = true;
+		} else {
+			path = argv[n];
+		}
+	}
+	std::vector<char> data;
+	if (!impl::load(path, data) || data.size() < sizeof(capture::format::Header)) {
+		fprintf(stderr, "Unable to read: %s\n", path);
+		return 1;
+	}
+	capture::format::Header header;
+	memcpy(&header, data.data(), sizeof header);
+	if (header.magic != capture::format::MAGIC || header.version != capture::format::VERSION) {
+		fprintf(stderr, "Not a (current) capture file: %s\n", path);
+		return 1;
+	}
+	int result = 0;
+	if (window::Handle wHnd = window::create()) {
+		if (WGPUDevice device = webgpu::create(wHnd, backend)) {
+			impl::Sink sink;
+			dawn::wire::WireServerDescriptor desc = {};
+			desc.procs      = &webgpu::procs();
+			desc.serializer = &sink;
+			dawn::wire::WireServer server(desc);
+			server.InjectDevice(device, header.deviceId, header.deviceGen);
+
+			WGPUSwapChain swapchain = nullptr;
+			std::vector<double> times;
+			size_t pos = sizeof header;
+			impl::Clock::time_point start = impl::Clock::now();
+			impl::Clock::time_point begun = start;
+			while (pos + sizeof(capture::format::Chunk) <= data.size()) {
+				capture::format::Chunk chunk;
+				memcpy(&chunk, data.data() + pos, sizeof chunk);
+				pos += sizeof chunk;
+				if (pos + chunk.size > data.size()) {
+					fprintf(stderr, "Truncated capture\n");
+					result = 1;
+					break;
+				}
+				const char* payload = data.data() + pos;
+				pos += chunk.size;
+				if (chunk.type == capture::format::COMMANDS) {
+					if (!server.HandleCommands(payload, chunk.size)) {
+						fprintf(stderr, "Invalid commands in frame %u\n", static_cast<unsigned>(times.size()));
+						result = 1;
+						break;
+					}
+				} else if (chunk.type == capture::format::FRAME) {
+					wgpuDeviceTick(device);
+					impl::Clock::time_point now = impl::Clock::now();
+					times.push_back(std::chrono::duration<double, std::milli>(now - start).count());
+					start = now;
+				} else if (chunk.type == capture::format::SWAPCHAIN && chunk.size >= sizeof(capture::format::SwapChain)) {
+					capture::format::SwapChain record;
+					memcpy(&record, payload, sizeof record);
+					if (!swapchain) {
+						swapchain = webgpu::createSwapChain(device);
+					}
+					server.InjectSwapChain(swapchain, record.id, record.gen, record.deviceId, record.deviceGen);
+				}
+			}
+			double total = std::chrono::duration<double, std::milli>(impl::Clock::now() - begun).count();
+			if (listFrames) {
+				for (size_t n = 0; n < times.size(); n++) {
+					printf("frame %5u %9.3fms\n", static_cast<unsigned>(n), times[n]);
+				}
+			}
+			if (!times.empty()) {
+				std::vector<double> sorted(times);
+				std::sort(sorted.begin(), sorted.end());
+				double sum = 0.0;
+				for (size_t n = 0; n < sorted.size(); n++) {
+					sum += sorted[n];
+				}
+				printf("%u frames, %.1fMB of commands in %.3fms\n", static_cast<unsigned>(times.size()),
+					data.size() / (1024.0 * 1024.0), total);
+				printf("per frame: mean %.3fms, min %.3fms, median %.3fms, 95%% %.3fms, max %.3fms\n",
+					sum / sorted.size(), sorted.front(), impl::percentile(sorted, 50.0),
+					impl::percentile(sorted, 95.0), sorted.back());
+			}
+			if (swapchain) {
+				wgpuSwapChainRelease(swapchain);
+			}
+			wgpuDeviceRelease(device);
+		}
+		window::destroy(wHnd);
+	}
+	return result;
+}